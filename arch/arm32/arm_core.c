@@ -187,6 +187,74 @@ void subtilis_arm_section_delete(subtilis_arm_section_t *s)
 	free(s);
 }
 
+static size_t prv_rebase_op(size_t op, size_t start, size_t base)
+{
+	return (op == SIZE_MAX) ? SIZE_MAX : op - start + base;
+}
+
+void subtilis_arm_section_move_ops(subtilis_arm_section_t *s,
+				   subtilis_arm_op_pool_t *pool, size_t start,
+				   size_t end, subtilis_error_t *err)
+{
+	size_t i;
+	size_t j;
+	size_t new_max;
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *new_ops;
+	subtilis_arm_call_site_t *site;
+	subtilis_arm_op_pool_t *old_pool = s->op_pool;
+	size_t count = end - start;
+	size_t base = pool->len;
+
+	if (pool->max_len - pool->len < count) {
+		new_max = pool->len + count + SUBTILIS_CONFIG_PROGRAM_GRAN;
+		new_ops = realloc(pool->ops, new_max * sizeof(*new_ops));
+		if (!new_ops) {
+			subtilis_error_set_oom(err);
+			return;
+		}
+		pool->max_len = new_max;
+		pool->ops = new_ops;
+	}
+
+	memcpy(&pool->ops[base], &old_pool->ops[start],
+	       count * sizeof(*pool->ops));
+	pool->len += count;
+
+	for (i = start; i < end; i++)
+		if (old_pool->ops[i].type == SUBTILIS_ARM_OP_STRING)
+			old_pool->ops[i].op.str = NULL;
+
+	for (i = base; i < pool->len; i++) {
+		op = &pool->ops[i];
+		op->next = prv_rebase_op(op->next, start, base);
+		op->prev = prv_rebase_op(op->prev, start, base);
+	}
+
+	s->first_op = prv_rebase_op(s->first_op, start, base);
+	s->last_op = prv_rebase_op(s->last_op, start, base);
+
+	for (i = 0; i < s->call_site_count; i++) {
+		site = &s->call_sites[i];
+		site->stm_site = prv_rebase_op(site->stm_site, start, base);
+		site->ldm_site = prv_rebase_op(site->ldm_site, start, base);
+		site->stf_site = prv_rebase_op(site->stf_site, start, base);
+		site->ldf_site = prv_rebase_op(site->ldf_site, start, base);
+		site->call_site = prv_rebase_op(site->call_site, start, base);
+		for (j = 4; j < site->int_args; j++)
+			site->int_arg_ops[j - 4] = prv_rebase_op(
+			    site->int_arg_ops[j - 4], start, base);
+		for (j = 4; j < site->real_args; j++)
+			site->real_arg_ops[j - 4] = prv_rebase_op(
+			    site->real_arg_ops[j - 4], start, base);
+	}
+
+	for (i = 0; i < s->ret_site_count; i++)
+		s->ret_sites[i] = prv_rebase_op(s->ret_sites[i], start, base);
+
+	s->op_pool = pool;
+}
+
 /* clang-format off */
 void subtilis_arm_section_add_call_site(subtilis_arm_section_t *s,
 					size_t stm_site, size_t ldm_site,
@@ -222,6 +290,8 @@ void subtilis_arm_section_add_call_site(subtilis_arm_section_t *s,
 	site->int_args = int_args;
 	site->real_args = real_args;
 	site->call_site = op;
+	site->int_regs_live = 0;
+	site->real_regs_live = 0;
 
 	if (int_args > 4)
 		for (i = 0; i < int_args - 4; i++)
@@ -581,19 +651,27 @@ subtilis_arm_instr_t *subtilis_arm_section_dup_instr(subtilis_arm_section_t *s,
 {
 	subtilis_arm_op_t *src;
 	subtilis_arm_op_t *op;
+	size_t src_ptr;
 
 	if (s->len == 0) {
 		subtilis_error_set_assertion_failed(err);
 		return NULL;
 	}
 
-	src = &s->op_pool->ops[s->last_op];
+	/*
+	 * The append may reallocate the op pool, so we need to look up
+	 * the source op after it's done.
+	 */
+
+	src_ptr = s->last_op;
 	op = prv_append_op(s, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return NULL;
 
+	src = &s->op_pool->ops[src_ptr];
 	*op = *src;
 	op->next = SIZE_MAX;
+	op->prev = src_ptr;
 
 	return &op->op.instr;
 }
@@ -998,6 +1076,272 @@ void subtilis_arm_add_rsub_imm(subtilis_arm_section_t *s,
 	datai->op2.op.integer = encoded;
 }
 
+/*
+ * The steps used to synthesise a multiplication of x, the register being
+ * multiplied, by a constant.  t is the result of the previous step, or x
+ * if there is no previous step.  Each step is a single data processing
+ * instruction that uses a shifted operand 2.
+ */
+
+typedef enum {
+	SUBTILIS_ARM_MUL_STEP_LSL,   /* MOV d, t LSL k      t << k */
+	SUBTILIS_ARM_MUL_STEP_ADD_T, /* ADD d, t, t LSL k   t + (t << k) */
+	SUBTILIS_ARM_MUL_STEP_RSB_T, /* RSB d, t, t LSL k   (t << k) - t */
+	SUBTILIS_ARM_MUL_STEP_ADD_X, /* ADD d, x, t LSL k   x + (t << k) */
+	SUBTILIS_ARM_MUL_STEP_RSB_X, /* RSB d, x, t LSL k   (t << k) - x */
+	SUBTILIS_ARM_MUL_STEP_SUB_X, /* SUB d, x, t LSL k   x - (t << k) */
+	SUBTILIS_ARM_MUL_STEP_NEG,   /* RSB d, t, #0        -t */
+} subtilis_arm_mul_step_type_t;
+
+struct subtilis_arm_mul_step_t_ {
+	subtilis_arm_mul_step_type_t type;
+	int32_t shift;
+};
+
+typedef struct subtilis_arm_mul_step_t_ subtilis_arm_mul_step_t;
+
+#define SUBTILIS_ARM_MUL_IMM_MAX_STEPS 4
+
+static size_t prv_mul_imm_search(int64_t n, size_t max_steps,
+				 subtilis_arm_mul_step_t *steps);
+
+static int32_t prv_mul_imm_ctz(int64_t n)
+{
+	int32_t k = 0;
+
+	while (!(n & 1)) {
+		n >>= 1;
+		k++;
+	}
+
+	return k;
+}
+
+/*
+ * Looks for a sequence that computes m * x, in fewer than best - 1
+ * steps, that can be followed by a step of type, to produce a sequence
+ * shorter than best.  If one is found it's copied to steps, and best is
+ * updated.
+ */
+
+static void prv_mul_imm_try(int64_t m, subtilis_arm_mul_step_type_t type,
+			    int32_t shift, subtilis_arm_mul_step_t *steps,
+			    size_t *best)
+{
+	size_t len;
+	subtilis_arm_mul_step_t tmp[SUBTILIS_ARM_MUL_IMM_MAX_STEPS];
+
+	if (*best < 2)
+		return;
+
+	len = prv_mul_imm_search(m, *best - 2, tmp);
+	if (len == SIZE_MAX)
+		return;
+
+	memcpy(steps, tmp, len * sizeof(*steps));
+	steps[len].type = type;
+	steps[len].shift = shift;
+	*best = len + 1;
+}
+
+/*
+ * Returns the length of the shortest sequence of at most max_steps steps
+ * that computes n * x, storing the steps in steps, or SIZE_MAX if there
+ * isn't one.  The arithmetic is done in 64 bits, so n and all the
+ * intermediate multipliers are exact.  The generated code computes
+ * these values modulo 2^32 which is what we want, as the bottom 32 bits
+ * of a product depend only on the bottom 32 bits of its operands.
+ */
+
+static size_t prv_mul_imm_search(int64_t n, size_t max_steps,
+				 subtilis_arm_mul_step_t *steps)
+{
+	int32_t k;
+	int64_t d;
+	size_t best = max_steps + 1;
+
+	if (n == 1)
+		return 0;
+
+	if ((max_steps == 0) || (n == 0))
+		return SIZE_MAX;
+
+	if (!(n & 1)) {
+		k = prv_mul_imm_ctz(n);
+		prv_mul_imm_try(n / ((int64_t)1 << k),
+				SUBTILIS_ARM_MUL_STEP_LSL, k, steps, &best);
+		return (best > max_steps) ? SIZE_MAX : best;
+	}
+
+	for (k = 1; k < 31; k++) {
+		d = ((int64_t)1 << k) + 1;
+		if (n % d == 0)
+			prv_mul_imm_try(n / d, SUBTILIS_ARM_MUL_STEP_ADD_T, k,
+					steps, &best);
+		d -= 2;
+		if ((d > 1) && (n % d == 0))
+			prv_mul_imm_try(n / d, SUBTILIS_ARM_MUL_STEP_RSB_T, k,
+					steps, &best);
+	}
+
+	k = prv_mul_imm_ctz(n - 1);
+	prv_mul_imm_try((n - 1) / ((int64_t)1 << k),
+			SUBTILIS_ARM_MUL_STEP_ADD_X, k, steps, &best);
+
+	if (n != -1) {
+		k = prv_mul_imm_ctz(n + 1);
+		prv_mul_imm_try((n + 1) / ((int64_t)1 << k),
+				SUBTILIS_ARM_MUL_STEP_RSB_X, k, steps, &best);
+	}
+
+	k = prv_mul_imm_ctz(1 - n);
+	prv_mul_imm_try((1 - n) / ((int64_t)1 << k),
+			SUBTILIS_ARM_MUL_STEP_SUB_X, k, steps, &best);
+
+	if (n < 0)
+		prv_mul_imm_try(-n, SUBTILIS_ARM_MUL_STEP_NEG, 0, steps, &best);
+
+	return (best > max_steps) ? SIZE_MAX : best;
+}
+
+/*
+ * A rough estimate of the number of cycles taken by an ARM2 to
+ * multiply by rs using MUL.  The multiplier is loaded into a register,
+ * which takes one instruction if it can be encoded as an immediate and
+ * an LDR otherwise.  The MUL itself terminates early once the remaining
+ * bits of rs are all zero, processing two bits per cycle.
+ */
+
+static size_t prv_mul_imm_cost(int32_t rs)
+{
+	uint32_t encoded;
+	uint32_t urs = (uint32_t)rs;
+	size_t cycles;
+
+	if (subtilis_arm_encode_imm(rs, &encoded) ||
+	    subtilis_arm_encode_imm(~rs, &encoded))
+		cycles = 1;
+	else
+		cycles = 3;
+
+	cycles++;
+	while (urs) {
+		urs >>= 2;
+		cycles++;
+	}
+
+	return cycles;
+}
+
+/*
+ * Adds a data processing instruction whose second operand is the
+ * register op2 shifted by a constant.
+ */
+
+static void prv_add_data_shift(subtilis_arm_section_t *s,
+			       subtilis_arm_instr_type_t itype,
+			       subtilis_arm_ccode_type_t ccode,
+			       subtilis_arm_reg_t dest, subtilis_arm_reg_t op1,
+			       subtilis_arm_reg_t op2,
+			       subtilis_arm_shift_type_t stype, int32_t shift,
+			       subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_data_instr_t *datai;
+
+	instr = subtilis_arm_section_add_instr(s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	datai = &instr->operands.data;
+	datai->status = false;
+	datai->ccode = ccode;
+	datai->dest = dest;
+	datai->op1 = op1;
+	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
+	datai->op2.op.shift.type = stype;
+	datai->op2.op.shift.reg = op2;
+	datai->op2.op.shift.shift_reg = false;
+	datai->op2.op.shift.shift.integer = shift;
+}
+
+static void prv_add_data_reg(subtilis_arm_section_t *s,
+			     subtilis_arm_instr_type_t itype,
+			     subtilis_arm_ccode_type_t ccode,
+			     subtilis_arm_reg_t dest, subtilis_arm_reg_t op1,
+			     subtilis_arm_reg_t op2, subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_data_instr_t *datai;
+
+	instr = subtilis_arm_section_add_instr(s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	datai = &instr->operands.data;
+	datai->status = false;
+	datai->ccode = ccode;
+	datai->dest = dest;
+	datai->op1 = op1;
+	datai->op2.type = SUBTILIS_ARM_OP2_REG;
+	datai->op2.op.reg = op2;
+}
+
+static void prv_add_mul_step(subtilis_arm_section_t *s,
+			     subtilis_arm_ccode_type_t ccode,
+			     subtilis_arm_reg_t dest, subtilis_arm_reg_t x,
+			     subtilis_arm_reg_t t,
+			     const subtilis_arm_mul_step_t *step,
+			     subtilis_error_t *err)
+{
+	subtilis_arm_instr_type_t itype;
+	subtilis_arm_reg_t op1 = x;
+
+	switch (step->type) {
+	case SUBTILIS_ARM_MUL_STEP_LSL:
+		itype = SUBTILIS_ARM_INSTR_MOV;
+		op1 = 0;
+		break;
+	case SUBTILIS_ARM_MUL_STEP_ADD_T:
+		op1 = t;
+		/* fall through */
+	case SUBTILIS_ARM_MUL_STEP_ADD_X:
+		itype = SUBTILIS_ARM_INSTR_ADD;
+		break;
+	case SUBTILIS_ARM_MUL_STEP_RSB_T:
+		op1 = t;
+		/* fall through */
+	case SUBTILIS_ARM_MUL_STEP_RSB_X:
+	case SUBTILIS_ARM_MUL_STEP_NEG:
+		itype = SUBTILIS_ARM_INSTR_RSB;
+		break;
+	case SUBTILIS_ARM_MUL_STEP_SUB_X:
+		itype = SUBTILIS_ARM_INSTR_SUB;
+		break;
+	default:
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+
+	if (step->type == SUBTILIS_ARM_MUL_STEP_NEG) {
+		subtilis_arm_add_rsub_imm(s, ccode, false, dest, t, 0, err);
+		return;
+	}
+
+	prv_add_data_shift(s, itype, ccode, dest, op1, t,
+			   SUBTILIS_ARM_SHIFT_LSL, step->shift, err);
+}
+
+/*
+ * Multiplication by a constant is synthesised from a short sequence of
+ * ADD, SUB, RSB and MOV instructions with shifted operands, e.g., x * 10
+ * becomes ADD d, x, x LSL #2 followed by MOV d, d LSL #1.  We only fall
+ * back to MUL when the sequence would take longer to execute than
+ * loading the constant and multiplying.  Each step of the sequence
+ * writes to dest and reads from dest and rm, so dest and rm must be
+ * different registers.
+ */
+
 void subtilis_arm_add_mul_imm(subtilis_arm_section_t *s,
 			      subtilis_arm_ccode_type_t ccode, bool status,
 			      subtilis_arm_reg_t dest, subtilis_arm_reg_t rm,
@@ -1006,10 +1350,54 @@ void subtilis_arm_add_mul_imm(subtilis_arm_section_t *s,
 	subtilis_arm_reg_t mov_dest;
 	subtilis_arm_instr_t *instr;
 	subtilis_arm_mul_instr_t *mul;
+	subtilis_arm_mul_step_t steps[SUBTILIS_ARM_MUL_IMM_MAX_STEPS];
+	size_t max_steps;
+	size_t len;
+	size_t i;
 
-	if (rm == dest) {
-		subtilis_error_set_assertion_failed(err);
-		return;
+	/*
+	 * The flags set by a MUL differ from those set by the data
+	 * processing instructions, so we leave those cases alone.
+	 */
+
+	if (!status) {
+		if (rs == 0) {
+			subtilis_arm_add_mov_imm(s, ccode, false, dest, 0, err);
+			return;
+		}
+
+		max_steps = prv_mul_imm_cost(rs);
+		if (max_steps > SUBTILIS_ARM_MUL_IMM_MAX_STEPS)
+			max_steps = SUBTILIS_ARM_MUL_IMM_MAX_STEPS;
+		len = prv_mul_imm_search(rs, max_steps, steps);
+		if (len == 0) {
+			subtilis_arm_add_mov_reg(s, ccode, false, dest, rm,
+						 err);
+			return;
+		}
+		if (len != SIZE_MAX) {
+			/*
+			 * Every step after the first reads rm, so it can't
+			 * be overwritten by the first step.
+			 */
+
+			if ((rm == dest) && (len > 1)) {
+				mov_dest = subtilis_arm_acquire_new_reg(s);
+				subtilis_arm_add_mov_reg(s, ccode, false,
+							 mov_dest, rm, err);
+				if (err->type != SUBTILIS_ERROR_OK)
+					return;
+				rm = mov_dest;
+			}
+			for (i = 0; i < len; i++) {
+				prv_add_mul_step(s, ccode, dest, rm,
+						 (i == 0) ? rm : dest,
+						 &steps[i], err);
+				if (err->type != SUBTILIS_ERROR_OK)
+					return;
+			}
+			return;
+		}
 	}
 
 	mov_dest = subtilis_arm_acquire_new_reg(s);
@@ -1017,18 +1405,21 @@ void subtilis_arm_add_mul_imm(subtilis_arm_section_t *s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	/* TODO: A whole pile of optimisations here */
-
 	instr = subtilis_arm_section_add_instr(s, SUBTILIS_ARM_INSTR_MUL, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	/*
+	 * The IR optimiser may coalesce dest and rm.  MUL requires that
+	 * dest and rm differ, so in that case we swap the operands.
+	 */
+
 	mul = &instr->operands.mul;
 	mul->status = status;
 	mul->ccode = ccode;
 	mul->dest = dest;
-	mul->rm = rm;
-	mul->rs = mov_dest;
+	mul->rm = (rm == dest) ? mov_dest : rm;
+	mul->rs = (rm == dest) ? rm : mov_dest;
 }
 
 void subtilis_arm_add_mul(subtilis_arm_section_t *s,
@@ -1040,14 +1431,25 @@ void subtilis_arm_add_mul(subtilis_arm_section_t *s,
 	subtilis_arm_reg_t tmp_reg;
 	subtilis_arm_mul_instr_t *mul;
 
+	/*
+	 * MUL requires that dest and rm differ.  If all three registers
+	 * are the same, e.g., a% = a% * a% after the IR optimiser has
+	 * coalesced the registers, we need to copy rm first.
+	 */
+
 	if (dest == rm) {
 		if (dest == rs) {
-			subtilis_error_set_assertion_failed(err);
-			return;
+			tmp_reg = subtilis_arm_acquire_new_reg(s);
+			subtilis_arm_add_mov_reg(s, ccode, false, tmp_reg, rm,
+						 err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				return;
+			rm = tmp_reg;
+		} else {
+			tmp_reg = rs;
+			rs = rm;
+			rm = tmp_reg;
 		}
-		tmp_reg = rs;
-		rs = rm;
-		rm = tmp_reg;
 	}
 
 	instr = subtilis_arm_section_add_instr(s, SUBTILIS_ARM_INSTR_MUL, err);
@@ -1062,6 +1464,172 @@ void subtilis_arm_add_mul(subtilis_arm_section_t *s,
 	mul->rs = rs;
 }
 
+void subtilis_arm_add_mull(subtilis_arm_section_t *s,
+			   subtilis_arm_instr_type_t itype,
+			   subtilis_arm_ccode_type_t ccode,
+			   subtilis_arm_reg_t dest_lo,
+			   subtilis_arm_reg_t dest_hi, subtilis_arm_reg_t rm,
+			   subtilis_arm_reg_t rs, subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_mul_instr_t *mul;
+
+	if (dest_lo == dest_hi) {
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+
+	instr = subtilis_arm_section_add_instr(s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	mul = &instr->operands.mul;
+	mul->status = false;
+	mul->ccode = ccode;
+	mul->dest = dest_hi;
+	mul->rn = dest_lo;
+	mul->rm = rm;
+	mul->rs = rs;
+}
+
+/*
+ * ARMv6 targets compute the top 32 bits of the product with a single
+ * SMULL, discarding the bottom 32 bits.
+ *
+ * There's no long multiply on the ARM2, so the top 32 bits of the
+ * product are computed from four 16 bit by 16 bit multiplies of the
+ * halves of rm and rs, treating both as unsigned.  The unsigned result
+ * is then corrected for the signs of the operands by subtracting rs if
+ * rm is negative and rm if rs is negative.
+ */
+
+void subtilis_arm_add_mulh(subtilis_arm_section_t *s,
+			   subtilis_arm_ccode_type_t ccode,
+			   subtilis_arm_reg_t dest, subtilis_arm_reg_t rm,
+			   subtilis_arm_reg_t rs, subtilis_error_t *err)
+{
+	subtilis_arm_reg_t ml;
+	subtilis_arm_reg_t mh;
+	subtilis_arm_reg_t sl;
+	subtilis_arm_reg_t sh;
+	subtilis_arm_reg_t ll;
+	subtilis_arm_reg_t lh;
+	subtilis_arm_reg_t hl;
+	subtilis_arm_reg_t mid;
+	subtilis_arm_reg_t tmp;
+	const subtilis_arm_instr_type_t mov = SUBTILIS_ARM_INSTR_MOV;
+	const subtilis_arm_instr_type_t add = SUBTILIS_ARM_INSTR_ADD;
+
+	if (s->fp_if && s->fp_if->armv6) {
+		ll = subtilis_arm_acquire_new_reg(s);
+		subtilis_arm_add_mull(s, SUBTILIS_ARM_INSTR_SMULL, ccode, ll,
+				      dest, rm, rs, err);
+		return;
+	}
+
+	ml = subtilis_arm_acquire_new_reg(s);
+	mh = subtilis_arm_acquire_new_reg(s);
+	sl = subtilis_arm_acquire_new_reg(s);
+	sh = subtilis_arm_acquire_new_reg(s);
+	ll = subtilis_arm_acquire_new_reg(s);
+	lh = subtilis_arm_acquire_new_reg(s);
+	hl = subtilis_arm_acquire_new_reg(s);
+	mid = subtilis_arm_acquire_new_reg(s);
+	tmp = subtilis_arm_acquire_new_reg(s);
+
+	prv_add_data_shift(s, mov, ccode, ml, 0, rm, SUBTILIS_ARM_SHIFT_LSL, 16,
+			   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, mov, ccode, ml, 0, ml, SUBTILIS_ARM_SHIFT_LSR, 16,
+			   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, mov, ccode, mh, 0, rm, SUBTILIS_ARM_SHIFT_LSR, 16,
+			   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, mov, ccode, sl, 0, rs, SUBTILIS_ARM_SHIFT_LSL, 16,
+			   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, mov, ccode, sl, 0, sl, SUBTILIS_ARM_SHIFT_LSR, 16,
+			   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, mov, ccode, sh, 0, rs, SUBTILIS_ARM_SHIFT_LSR, 16,
+			   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mul(s, ccode, false, ll, ml, sl, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	subtilis_arm_add_mul(s, ccode, false, lh, ml, sh, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	subtilis_arm_add_mul(s, ccode, false, hl, mh, sl, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	subtilis_arm_add_mul(s, ccode, false, dest, mh, sh, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/*
+	 * mid = (ll >> 16) + (lh & 0xffff) + (hl & 0xffff) is the carry
+	 * into the top half of the result.
+	 */
+
+	prv_add_data_shift(s, mov, ccode, mid, 0, ll, SUBTILIS_ARM_SHIFT_LSR,
+			   16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, mov, ccode, tmp, 0, lh, SUBTILIS_ARM_SHIFT_LSL,
+			   16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, add, ccode, mid, mid, tmp, SUBTILIS_ARM_SHIFT_LSR,
+			   16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, mov, ccode, tmp, 0, hl, SUBTILIS_ARM_SHIFT_LSL,
+			   16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, add, ccode, mid, mid, tmp, SUBTILIS_ARM_SHIFT_LSR,
+			   16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_shift(s, add, ccode, dest, dest, lh,
+			   SUBTILIS_ARM_SHIFT_LSR, 16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, add, ccode, dest, dest, hl,
+			   SUBTILIS_ARM_SHIFT_LSR, 16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, add, ccode, dest, dest, mid,
+			   SUBTILIS_ARM_SHIFT_LSR, 16, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_shift(s, SUBTILIS_ARM_INSTR_AND, ccode, tmp, rs, rm,
+			   SUBTILIS_ARM_SHIFT_ASR, 31, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_reg(s, SUBTILIS_ARM_INSTR_SUB, ccode, dest, dest, tmp,
+			 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_shift(s, SUBTILIS_ARM_INSTR_AND, ccode, tmp, rm, rs,
+			   SUBTILIS_ARM_SHIFT_ASR, 31, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_data_reg(s, SUBTILIS_ARM_INSTR_SUB, ccode, dest, dest, tmp,
+			 err);
+}
+
 void subtilis_arm_add_data_imm(subtilis_arm_section_t *s,
 			       subtilis_arm_instr_type_t itype,
 			       subtilis_arm_ccode_type_t ccode, bool status,
@@ -1739,3 +2307,23 @@ void subtilis_arm_add_signx(subtilis_arm_section_t *s,
 	signx->op1 = op1;
 	signx->rotate = rotate;
 }
+
+void subtilis_arm_add_pld(subtilis_arm_section_t *s, subtilis_arm_reg_t base,
+			  int32_t offset, subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_pld_instr_t *pld;
+
+	if ((offset > 4095) || (offset < -4095)) {
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+
+	instr = subtilis_arm_section_add_instr(s, SUBTILIS_ARM_INSTR_PLD, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	pld = &instr->operands.pld;
+	pld->base = base;
+	pld->offset = offset;
+}
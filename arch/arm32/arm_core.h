@@ -44,6 +44,8 @@
 
 typedef struct subtlis_arm_walker_t_ subtlis_arm_walker_t;
 
+typedef struct subtilis_arm_peephole_rule_t_ subtilis_arm_peephole_rule_t;
+
 typedef size_t subtilis_arm_reg_t;
 
 typedef enum {
@@ -309,6 +311,13 @@ typedef enum {
 	SUBTILIS_ARM_INSTR_SXTB,
 	SUBTILIS_ARM_INSTR_SXTB16,
 	SUBTILIS_ARM_INSTR_SXTH,
+	SUBTILIS_ARM_INSTR_UXTB,
+	SUBTILIS_ARM_INSTR_UXTB16,
+	SUBTILIS_ARM_INSTR_UXTH,
+	SUBTILIS_ARM_INSTR_REV,
+	SUBTILIS_ARM_INSTR_SMULL,
+	SUBTILIS_ARM_INSTR_UMULL,
+	SUBTILIS_ARM_INSTR_PLD,
 	SUBTILIS_ARM_INSTR_MAX,
 } subtilis_arm_instr_type_t;
 
@@ -333,6 +342,11 @@ struct subtilis_arm_data_instr_t_ {
 
 typedef struct subtilis_arm_data_instr_t_ subtilis_arm_data_instr_t;
 
+/*
+ * For SMULL and UMULL, dest holds RdHi and rn holds RdLo.  Unlike the
+ * rn of an MLA, which is read, the rn of a long multiply is written.
+ */
+
 struct subtilis_arm_mul_instr_t_ {
 	subtilis_arm_ccode_type_t ccode;
 	bool status;
@@ -510,6 +524,18 @@ struct subtilis_arm_signx_instr_t_ {
 
 typedef struct subtilis_arm_signx_instr_t_ subtilis_arm_signx_instr_t;
 
+/*
+ * PLD is unconditional and only supports an immediate offset from its
+ * base register.
+ */
+
+struct subtilis_arm_pld_instr_t_ {
+	subtilis_arm_reg_t base;
+	int32_t offset;
+};
+
+typedef struct subtilis_arm_pld_instr_t_ subtilis_arm_pld_instr_t;
+
 typedef enum {
 	SUBTILIS_FPA_ROUNDING_NEAREST,
 	SUBTILIS_FPA_ROUNDING_PLUS_INFINITY,
@@ -709,6 +735,7 @@ struct subtilis_arm_instr_t_ {
 		subtilis_arm_stran_misc_instr_t stran_misc;
 		subtilis_arm_reg_only_instr_t reg_only;
 		subtilis_arm_signx_instr_t signx;
+		subtilis_arm_pld_instr_t pld;
 	} operands;
 };
 
@@ -781,6 +808,15 @@ struct subtilis_arm_call_site_t_ {
 	size_t call_site;
 	size_t int_arg_ops[SUBTILIS_IR_MAX_ARGS_PER_TYPE - 4];
 	size_t real_arg_ops[SUBTILIS_IR_MAX_ARGS_PER_TYPE - 4];
+
+	/*
+	 * Masks of physical registers the register allocator knows to be
+	 * live across the call.  These are preserved by the call site in
+	 * addition to any registers found by subtilis_arm_save_regs.
+	 */
+
+	size_t int_regs_live;
+	size_t real_regs_live;
 };
 
 typedef struct subtilis_arm_call_site_t_ subtilis_arm_call_site_t;
@@ -822,6 +858,10 @@ struct subtilis_arm_section_t_ {
 	size_t no_cleanup_label;
 	int32_t start_address;
 	const subtilis_arm_fp_if_t *fp_if;
+
+	/* Number of spill loads and stores added by the register allocator */
+
+	size_t spill_count;
 };
 
 typedef struct subtilis_arm_section_t_ subtilis_arm_section_t;
@@ -984,6 +1024,21 @@ struct subtilis_arm_fp_if_t_ {
 	subtilis_arm_fp_init_walker_t init_dist_walker_fn;
 	subtilis_arm_fp_init_walker_t init_used_walker_fn;
 	subtilis_arm_fp_init_walker_t init_real_alloc_fn;
+
+	/*
+	 * Set when the target is at least an ARMv6, e.g., the ARM1176 of
+	 * PiTubeDirect, allowing the code generator to use SMULL and PLD.
+	 */
+
+	bool armv6;
+
+	/*
+	 * Additional peephole rules for the floating point instructions
+	 * generated by this interface.  See arm_peephole.h.
+	 */
+
+	const subtilis_arm_peephole_rule_t *peephole_rules;
+	size_t peephole_rule_count;
 };
 
 subtilis_arm_op_pool_t *subtilis_arm_op_pool_new(subtilis_error_t *err);
@@ -1025,6 +1080,17 @@ subtilis_arm_prog_section_new(subtilis_arm_prog_t *prog,
 /* clang-format on */
 void subtilis_arm_section_delete(subtilis_arm_section_t *s);
 
+/*
+ * Moves the ops of s, which must occupy the entries start to end - 1 of
+ * s's op pool, to the end of pool and makes pool the op pool of s.  All
+ * the references to ops held by s are updated.  Ownership of any strings
+ * stored in the moved ops is transferred to pool.
+ */
+
+void subtilis_arm_section_move_ops(subtilis_arm_section_t *s,
+				   subtilis_arm_op_pool_t *pool, size_t start,
+				   size_t end, subtilis_error_t *err);
+
 void subtilis_arm_prog_append_section(subtilis_arm_prog_t *prog,
 				      subtilis_arm_section_t *arm_s,
 				      subtilis_error_t *err);
@@ -1111,6 +1177,29 @@ void subtilis_arm_add_mul(subtilis_arm_section_t *s,
 			  subtilis_arm_ccode_type_t ccode, bool status,
 			  subtilis_arm_reg_t dest, subtilis_arm_reg_t rm,
 			  subtilis_arm_reg_t rs, subtilis_error_t *err);
+
+/*
+ * Stores the most significant 32 bits of the signed 64 bit product of
+ * rm and rs in dest.  dest must not be the same register as either rm
+ * or rs.
+ */
+
+void subtilis_arm_add_mulh(subtilis_arm_section_t *s,
+			   subtilis_arm_ccode_type_t ccode,
+			   subtilis_arm_reg_t dest, subtilis_arm_reg_t rm,
+			   subtilis_arm_reg_t rs, subtilis_error_t *err);
+
+/*
+ * Adds an SMULL or UMULL, storing the 64 bit product of rm and rs in
+ * dest_hi and dest_lo, which must be different registers.  ARMv6 only.
+ */
+
+void subtilis_arm_add_mull(subtilis_arm_section_t *s,
+			   subtilis_arm_instr_type_t itype,
+			   subtilis_arm_ccode_type_t ccode,
+			   subtilis_arm_reg_t dest_lo,
+			   subtilis_arm_reg_t dest_hi, subtilis_arm_reg_t rm,
+			   subtilis_arm_reg_t rs, subtilis_error_t *err);
 void subtilis_arm_add_data_imm(subtilis_arm_section_t *s,
 			       subtilis_arm_instr_type_t itype,
 			       subtilis_arm_ccode_type_t ccode, bool status,
@@ -1245,6 +1334,14 @@ void subtilis_arm_add_signx(subtilis_arm_section_t *s,
 			    subtilis_arm_signx_rotate_t rotate,
 			    subtilis_error_t *err);
 
+/*
+ * Adds a PLD hinting that the cache line containing base + offset will
+ * soon be read.  offset must lie between -4095 and 4095.  ARMv6 only.
+ */
+
+void subtilis_arm_add_pld(subtilis_arm_section_t *s, subtilis_arm_reg_t base,
+			  int32_t offset, subtilis_error_t *err);
+
 void subtilis_arm_add_byte(subtilis_arm_section_t *s, uint8_t byte,
 			   subtilis_error_t *err);
 void subtilis_arm_add_two_bytes(subtilis_arm_section_t *s, uint16_t two_bytes,
@@ -21,6 +21,7 @@
 
 #include "arm_core.h"
 #include "arm_core_test.h"
+#include "arm_peephole.h"
 
 static int prv_test_encode_imm(void)
 {
@@ -475,6 +476,977 @@ fail:
 	return 1;
 }
 
+static subtilis_arm_section_t *prv_new_section(subtilis_arm_op_pool_t *pool,
+					       subtilis_error_t *err)
+{
+	subtilis_arm_section_t *s;
+	subtilis_type_section_t *stype = NULL;
+
+	stype =
+	    subtilis_type_section_new(&subtilis_type_void, 0, NULL, NULL, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return NULL;
+
+	s = subtilis_arm_section_new(pool, stype, 0, 0, 0, 0, NULL, NULL,
+				     0x8000, err);
+	subtilis_type_section_delete(stype);
+
+	return s;
+}
+
+static void prv_add_b(subtilis_arm_section_t *s,
+		      subtilis_arm_ccode_type_t ccode, size_t label,
+		      subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_br_instr_t *br;
+
+	instr = subtilis_arm_section_add_instr(s, SUBTILIS_ARM_INSTR_B, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	br = &instr->operands.br;
+	br->ccode = ccode;
+	br->link = false;
+	br->local = false;
+	br->indirect = false;
+	br->link_type = SUBTILIS_ARM_BR_LINK_VOID;
+	br->target.label = label;
+}
+
+static subtilis_arm_instr_t *prv_nth_instr(subtilis_arm_section_t *s,
+					   size_t n)
+{
+	size_t ptr;
+	subtilis_arm_op_t *op;
+
+	for (ptr = s->first_op; ptr != SIZE_MAX; ptr = op->next) {
+		op = &s->op_pool->ops[ptr];
+		if (op->type != SUBTILIS_ARM_OP_INSTR)
+			continue;
+		if (n-- == 0)
+			return &op->op.instr;
+	}
+
+	return NULL;
+}
+
+static int prv_check_instr(subtilis_arm_section_t *s, size_t n,
+			   subtilis_arm_instr_type_t itype)
+{
+	subtilis_arm_instr_t *instr;
+
+	instr = prv_nth_instr(s, n);
+	if (!instr) {
+		fprintf(stderr, "Instruction %zu missing\n", n);
+		return 1;
+	}
+
+	if (instr->type != itype) {
+		fprintf(stderr, "Expected instruction %d, found %d\n", itype,
+			instr->type);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int prv_test_peephole_forward_store(void)
+{
+	subtilis_arm_section_t *s = NULL;
+	subtilis_error_t err;
+	subtilis_arm_data_instr_t *mov;
+	subtilis_arm_op_pool_t *pool;
+
+	printf("arm_peephole_forward_store");
+
+	subtilis_error_init(&err);
+
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	/*
+	 * STR R0, [R11, #4]
+	 * STR R2, [R11, #12]
+	 * LDR R1, [R11, #4]
+	 *
+	 * The load should be replaced by MOV R1, R0.
+	 */
+
+	subtilis_arm_add_stran_imm(s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, 0, 11, 4, false,
+				   &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_stran_imm(s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, 2, 11, 12, false,
+				   &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_stran_imm(s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, 1, 11, 4, false,
+				   &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_peephole(s, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	if (prv_check_instr(s, 2, SUBTILIS_ARM_INSTR_MOV))
+		goto fail;
+
+	mov = &prv_nth_instr(s, 2)->operands.data;
+	if ((mov->dest != 1) || (mov->op2.type != SUBTILIS_ARM_OP2_REG) ||
+	    (mov->op2.op.reg != 0)) {
+		fprintf(stderr, "Expected MOV R1, R0\n");
+		goto fail;
+	}
+
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [OK]\n");
+	return 0;
+
+fail:
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [FAIL]\n");
+	return 1;
+}
+
+static int prv_test_peephole_fold_cmp(void)
+{
+	subtilis_arm_section_t *s = NULL;
+	subtilis_error_t err;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_op_pool_t *pool;
+	size_t label;
+
+	printf("arm_peephole_fold_cmp");
+
+	subtilis_error_init(&err);
+
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	/*
+	 * AND R0, R1, #1
+	 * CMP R0, #0
+	 * BEQ label
+	 * MOV R2, #1
+	 * label:
+	 * CMP R2, #1
+	 *
+	 * The first compare should be folded into the AND and the branch
+	 * replaced by a MOVNE.
+	 */
+
+	label = s->label_counter;
+	subtilis_arm_add_data_imm(s, SUBTILIS_ARM_INSTR_AND,
+				  SUBTILIS_ARM_CCODE_AL, false, 0, 1, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_cmp_imm(s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 0, 0, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	prv_add_b(s, SUBTILIS_ARM_CCODE_EQ, label, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_movmvn_imm(s, SUBTILIS_ARM_INSTR_MOV,
+				    SUBTILIS_ARM_INSTR_MVN,
+				    SUBTILIS_ARM_CCODE_AL, false, 2, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_section_add_label(s, label, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_cmp_imm(s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 2, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_peephole(s, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	if (prv_check_instr(s, 0, SUBTILIS_ARM_INSTR_AND) ||
+	    prv_check_instr(s, 1, SUBTILIS_ARM_INSTR_MOV))
+		goto fail;
+
+	instr = prv_nth_instr(s, 0);
+	if (!instr->operands.data.status) {
+		fprintf(stderr, "Expected ANDS\n");
+		goto fail;
+	}
+
+	instr = prv_nth_instr(s, 1);
+	if (instr->operands.data.ccode != SUBTILIS_ARM_CCODE_NE) {
+		fprintf(stderr, "Expected MOVNE\n");
+		goto fail;
+	}
+
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [OK]\n");
+	return 0;
+
+fail:
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [FAIL]\n");
+	return 1;
+}
+
+static void prv_add_data_lsl(subtilis_arm_section_t *s,
+			     subtilis_arm_instr_type_t itype, bool status,
+			     subtilis_arm_reg_t dest, subtilis_arm_reg_t op1,
+			     subtilis_arm_reg_t rm, int32_t shift,
+			     subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_data_instr_t *datai;
+
+	instr = subtilis_arm_section_add_instr(s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	datai = &instr->operands.data;
+	datai->status = status;
+	datai->ccode = SUBTILIS_ARM_CCODE_AL;
+	datai->dest = dest;
+	datai->op1 = op1;
+	if (shift == 0) {
+		datai->op2.type = SUBTILIS_ARM_OP2_REG;
+		datai->op2.op.reg = rm;
+		return;
+	}
+	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
+	datai->op2.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
+	datai->op2.op.shift.reg = rm;
+	datai->op2.op.shift.shift_reg = false;
+	datai->op2.op.shift.shift.integer = shift;
+}
+
+static int prv_test_peephole_fold_shift(void)
+{
+	subtilis_arm_section_t *s = NULL;
+	subtilis_error_t err;
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_op_pool_t *pool;
+
+	printf("arm_peephole_fold_shift");
+
+	subtilis_error_init(&err);
+
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	/*
+	 * MOV R1, R0, LSL #2
+	 * ADD R1, R2, R1
+	 * MOV R4, R3, LSL #2
+	 * ANDS R4, R5, R4
+	 *
+	 * The first shift should be folded into the ADD.  The second
+	 * should be left alone as ANDS takes C from the shifter.
+	 */
+
+	prv_add_data_lsl(s, SUBTILIS_ARM_INSTR_MOV, false, 1, 0, 0, 2, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	prv_add_data_lsl(s, SUBTILIS_ARM_INSTR_ADD, false, 1, 2, 1, 0, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	prv_add_data_lsl(s, SUBTILIS_ARM_INSTR_MOV, false, 4, 0, 3, 2, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	prv_add_data_lsl(s, SUBTILIS_ARM_INSTR_AND, true, 4, 5, 4, 0, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_peephole(s, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	if (prv_check_instr(s, 0, SUBTILIS_ARM_INSTR_ADD) ||
+	    prv_check_instr(s, 1, SUBTILIS_ARM_INSTR_MOV) ||
+	    prv_check_instr(s, 2, SUBTILIS_ARM_INSTR_AND))
+		goto fail;
+
+	datai = &prv_nth_instr(s, 0)->operands.data;
+	if ((datai->op2.type != SUBTILIS_ARM_OP2_SHIFTED) ||
+	    (datai->op2.op.shift.reg != 0)) {
+		fprintf(stderr, "Expected ADD R1, R2, R0, LSL #2\n");
+		goto fail;
+	}
+
+	datai = &prv_nth_instr(s, 2)->operands.data;
+	if ((datai->op2.type != SUBTILIS_ARM_OP2_REG) ||
+	    (datai->op2.op.reg != 4)) {
+		fprintf(stderr, "Expected ANDS R4, R5, R4\n");
+		goto fail;
+	}
+
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [OK]\n");
+	return 0;
+
+fail:
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [FAIL]\n");
+	return 1;
+}
+
+static int prv_test_peephole_thread_branch(void)
+{
+	subtilis_arm_section_t *s = NULL;
+	subtilis_error_t err;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_op_pool_t *pool;
+	size_t label1;
+	size_t label2;
+
+	printf("arm_peephole_thread_branch");
+
+	subtilis_error_init(&err);
+
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	/*
+	 * BNE label1
+	 * MOV R0, #1
+	 * label1:
+	 * B label2
+	 * MOV R0, #2
+	 * label2:
+	 * MOV R0, #3
+	 *
+	 * The BNE should be redirected to label2.
+	 */
+
+	label1 = s->label_counter;
+	label2 = label1 + 1;
+	prv_add_b(s, SUBTILIS_ARM_CCODE_NE, label1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_movmvn_imm(s, SUBTILIS_ARM_INSTR_MOV,
+				    SUBTILIS_ARM_INSTR_MVN,
+				    SUBTILIS_ARM_CCODE_AL, false, 0, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_section_add_label(s, label1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	prv_add_b(s, SUBTILIS_ARM_CCODE_AL, label2, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_movmvn_imm(s, SUBTILIS_ARM_INSTR_MOV,
+				    SUBTILIS_ARM_INSTR_MVN,
+				    SUBTILIS_ARM_CCODE_AL, false, 0, 2, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_section_add_label(s, label2, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_movmvn_imm(s, SUBTILIS_ARM_INSTR_MOV,
+				    SUBTILIS_ARM_INSTR_MVN,
+				    SUBTILIS_ARM_CCODE_AL, false, 0, 3, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_peephole(s, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	if (prv_check_instr(s, 0, SUBTILIS_ARM_INSTR_B))
+		goto fail;
+
+	instr = prv_nth_instr(s, 0);
+	if (instr->operands.br.target.label != label2) {
+		fprintf(stderr, "Expected branch to label %zu, found %zu\n",
+			label2, instr->operands.br.target.label);
+		goto fail;
+	}
+
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [OK]\n");
+	return 0;
+
+fail:
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [FAIL]\n");
+	return 1;
+}
+
+static int prv_test_peephole_if_convert(void)
+{
+	subtilis_arm_section_t *s = NULL;
+	subtilis_error_t err;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_op_pool_t *pool;
+	size_t else_label;
+	size_t end_label;
+
+	printf("arm_peephole_if_convert");
+
+	subtilis_error_init(&err);
+
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	/*
+	 * CMP R0, #1
+	 * BLE else_label
+	 * MOV R1, #1
+	 * B end_label
+	 * else_label:
+	 * MOV R1, #2
+	 * end_label:
+	 * ADD R2, R1, #1
+	 *
+	 * should become
+	 *
+	 * CMP R0, #1
+	 * MOVGT R1, #1
+	 * MOVLE R1, #2
+	 * ADD R2, R1, #1
+	 */
+
+	else_label = s->label_counter;
+	end_label = else_label + 1;
+
+	subtilis_arm_add_cmp_imm(s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 0, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	prv_add_b(s, SUBTILIS_ARM_CCODE_LE, else_label, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_movmvn_imm(s, SUBTILIS_ARM_INSTR_MOV,
+				    SUBTILIS_ARM_INSTR_MVN,
+				    SUBTILIS_ARM_CCODE_AL, false, 1, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	prv_add_b(s, SUBTILIS_ARM_CCODE_AL, end_label, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_section_add_label(s, else_label, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_movmvn_imm(s, SUBTILIS_ARM_INSTR_MOV,
+				    SUBTILIS_ARM_INSTR_MVN,
+				    SUBTILIS_ARM_CCODE_AL, false, 1, 2, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_section_add_label(s, end_label, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_add_data_imm(s, SUBTILIS_ARM_INSTR_ADD,
+				  SUBTILIS_ARM_CCODE_AL, false, 2, 1, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_arm_peephole(s, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	if (prv_check_instr(s, 0, SUBTILIS_ARM_INSTR_CMP) ||
+	    prv_check_instr(s, 1, SUBTILIS_ARM_INSTR_MOV) ||
+	    prv_check_instr(s, 2, SUBTILIS_ARM_INSTR_MOV) ||
+	    prv_check_instr(s, 3, SUBTILIS_ARM_INSTR_ADD))
+		goto fail;
+
+	instr = prv_nth_instr(s, 1);
+	if (instr->operands.data.ccode != SUBTILIS_ARM_CCODE_GT) {
+		fprintf(stderr, "Expected MOVGT\n");
+		goto fail;
+	}
+
+	instr = prv_nth_instr(s, 2);
+	if (instr->operands.data.ccode != SUBTILIS_ARM_CCODE_LE) {
+		fprintf(stderr, "Expected MOVLE\n");
+		goto fail;
+	}
+
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [OK]\n");
+	return 0;
+
+fail:
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [FAIL]\n");
+	return 1;
+}
+
+/*
+ * Fills the op pool so that the append made by
+ * subtilis_arm_section_dup_instr needs to reallocate it and checks that
+ * the copy is made from the reallocated pool and is correctly linked to
+ * the instruction it was copied from.
+ */
+
+static int prv_test_dup_instr(void)
+{
+	subtilis_arm_section_t *s = NULL;
+	subtilis_error_t err;
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_op_pool_t *pool;
+	subtilis_arm_op_t *op;
+	size_t src_ptr;
+	size_t max_len;
+	size_t ptr;
+	size_t count;
+	subtilis_arm_reg_t reg = 0;
+
+	printf("arm_dup_instr");
+
+	subtilis_error_init(&err);
+
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	do {
+		subtilis_arm_add_mov_imm(s, SUBTILIS_ARM_CCODE_AL, false,
+					 reg++ & 7, 1, &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto fail;
+	} while (pool->len + 1 < pool->max_len);
+
+	instr = subtilis_arm_section_add_instr(s, SUBTILIS_ARM_INSTR_ADD, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+	datai = &instr->operands.data;
+	datai->ccode = SUBTILIS_ARM_CCODE_AL;
+	datai->status = false;
+	datai->dest = 1;
+	datai->op1 = 2;
+	datai->op2.type = SUBTILIS_ARM_OP2_I32;
+	datai->op2.op.integer = 0xff;
+
+	src_ptr = s->last_op;
+	max_len = pool->max_len;
+
+	instr = subtilis_arm_section_dup_instr(s, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	if (pool->max_len == max_len) {
+		fprintf(stderr, "Expected the op pool to be reallocated\n");
+		goto fail;
+	}
+
+	datai = &instr->operands.data;
+	if ((instr->type != SUBTILIS_ARM_INSTR_ADD) || (datai->dest != 1) ||
+	    (datai->op1 != 2) || (datai->op2.type != SUBTILIS_ARM_OP2_I32) ||
+	    (datai->op2.op.integer != 0xff)) {
+		fprintf(stderr, "Expected ADD R1, R2, #255\n");
+		goto fail;
+	}
+
+	op = &pool->ops[s->last_op];
+	if ((&op->op.instr != instr) || (op->prev != src_ptr) ||
+	    (op->next != SIZE_MAX) || (pool->ops[src_ptr].next != s->last_op)) {
+		fprintf(stderr, "Duplicated instruction incorrectly linked\n");
+		goto fail;
+	}
+
+	count = 0;
+	for (ptr = s->last_op; ptr != SIZE_MAX; ptr = pool->ops[ptr].prev)
+		count++;
+	if (count != s->len) {
+		fprintf(stderr, "Expected %zu ops walking back, found %zu\n",
+			s->len, count);
+		goto fail;
+	}
+
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [OK]\n");
+	return 0;
+
+fail:
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+
+	printf(": [FAIL]\n");
+	return 1;
+}
+
+static uint32_t prv_mul_op2(subtilis_arm_op2_t *op2, uint32_t *regs)
+{
+	uint32_t val;
+	uint32_t shift;
+
+	switch (op2->type) {
+	case SUBTILIS_ARM_OP2_REG:
+		return regs[op2->op.reg];
+	case SUBTILIS_ARM_OP2_I32:
+		val = op2->op.integer & 0xff;
+		shift = (op2->op.integer & 0xf00) >> 7;
+		if (shift == 0)
+			return val;
+		return (val >> shift) | (val << (32 - shift));
+	default:
+		val = regs[op2->op.shift.reg];
+		shift = op2->op.shift.shift.integer;
+		switch (op2->op.shift.type) {
+		case SUBTILIS_ARM_SHIFT_LSR:
+			return val >> shift;
+		case SUBTILIS_ARM_SHIFT_ASR:
+			return (uint32_t)((int32_t)val >> shift);
+		default:
+			return val << shift;
+		}
+	}
+}
+
+/*
+ * Interprets the code generated by subtilis_arm_add_mul_imm and
+ * subtilis_arm_add_mulh, updating the register file regs, which needs
+ * room for 32 registers.
+ */
+
+static int prv_eval_mul(subtilis_arm_section_t *s, uint32_t *regs)
+{
+	size_t ptr;
+	size_t i;
+	subtilis_arm_op_t *op;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_ldrc_instr_t *ldrc;
+
+	if (s->reg_counter > SUBTILIS_IR_REG_TEMP_START + 16) {
+		fprintf(stderr, "Too many registers %zu\n", s->reg_counter);
+		return 1;
+	}
+
+	for (ptr = s->first_op; ptr != SIZE_MAX; ptr = op->next) {
+		op = &s->op_pool->ops[ptr];
+		instr = &op->op.instr;
+		datai = &instr->operands.data;
+		switch (instr->type) {
+		case SUBTILIS_ARM_INSTR_MOV:
+			regs[datai->dest] = prv_mul_op2(&datai->op2, regs);
+			break;
+		case SUBTILIS_ARM_INSTR_MVN:
+			regs[datai->dest] = ~prv_mul_op2(&datai->op2, regs);
+			break;
+		case SUBTILIS_ARM_INSTR_ADD:
+			regs[datai->dest] =
+			    regs[datai->op1] + prv_mul_op2(&datai->op2, regs);
+			break;
+		case SUBTILIS_ARM_INSTR_SUB:
+			regs[datai->dest] =
+			    regs[datai->op1] - prv_mul_op2(&datai->op2, regs);
+			break;
+		case SUBTILIS_ARM_INSTR_RSB:
+			regs[datai->dest] =
+			    prv_mul_op2(&datai->op2, regs) - regs[datai->op1];
+			break;
+		case SUBTILIS_ARM_INSTR_AND:
+			regs[datai->dest] =
+			    regs[datai->op1] & prv_mul_op2(&datai->op2, regs);
+			break;
+		case SUBTILIS_ARM_INSTR_MUL:
+			regs[instr->operands.mul.dest] =
+			    regs[instr->operands.mul.rm] *
+			    regs[instr->operands.mul.rs];
+			break;
+		case SUBTILIS_ARM_INSTR_LDRC:
+			ldrc = &instr->operands.ldrc;
+			for (i = 0; i < s->constants.ui32_count; i++)
+				if (s->constants.ui32[i].label == ldrc->label)
+					break;
+			if (i == s->constants.ui32_count) {
+				fprintf(stderr, "Missing constant\n");
+				return 1;
+			}
+			regs[ldrc->dest] = s->constants.ui32[i].integer;
+			break;
+		default:
+			fprintf(stderr, "Unexpected instruction %d\n",
+				instr->type);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int prv_check_mul_imm(subtilis_arm_op_pool_t *pool, int32_t rs,
+			     subtilis_arm_reg_t dest, size_t *len)
+{
+	subtilis_arm_section_t *s;
+	subtilis_error_t err;
+	size_t i;
+	uint32_t regs[32];
+	int retval = 1;
+	const uint32_t xs[] = {0, 1, 3, 0xffffffff, 0x12345, 0x80000001};
+
+	subtilis_error_init(&err);
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	s->reg_counter = 2;
+	subtilis_arm_add_mul_imm(s, SUBTILIS_ARM_CCODE_AL, false, dest, 0, rs,
+				 &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	for (i = 0; i < sizeof(xs) / sizeof(xs[0]); i++) {
+		regs[0] = xs[i];
+		if (prv_eval_mul(s, regs))
+			goto cleanup;
+		if (regs[dest] != xs[i] * (uint32_t)rs) {
+			fprintf(stderr, "%u * %d: expected %u, got %u\n", xs[i],
+				rs, xs[i] * (uint32_t)rs, regs[dest]);
+			goto cleanup;
+		}
+	}
+
+	*len = s->len;
+	retval = 0;
+
+cleanup:
+
+	if (err.type != SUBTILIS_ERROR_OK)
+		subtilis_error_fprintf(stderr, &err, true);
+	subtilis_arm_section_delete(s);
+
+	return retval;
+}
+
+static int prv_test_mul_imm(void)
+{
+	subtilis_arm_op_pool_t *pool;
+	subtilis_error_t err;
+	int32_t rs;
+	size_t i;
+	size_t len;
+	int retval = 1;
+	const int32_t big[] = {INT32_MAX,  INT32_MIN, 0x12345678, 1000000,
+			       -1000000,   65537,     0x10001 * 255,
+			       0x7ffffffe, 0x40000001};
+
+	printf("arm_mul_imm");
+
+	subtilis_error_init(&err);
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	/* Register 1 receives the product, or register 0 in place. */
+
+	for (rs = -1100; rs <= 1100; rs++)
+		if (prv_check_mul_imm(pool, rs, 1, &len) ||
+		    prv_check_mul_imm(pool, rs, 0, &len))
+			goto cleanup;
+
+	for (i = 0; i < sizeof(big) / sizeof(big[0]); i++)
+		if (prv_check_mul_imm(pool, big[i], 1, &len) ||
+		    prv_check_mul_imm(pool, big[i], 0, &len))
+			goto cleanup;
+
+	/* x * 10 = (x + (x << 2)) << 1 */
+
+	if (prv_check_mul_imm(pool, 10, 1, &len))
+		goto cleanup;
+	if (len != 2) {
+		fprintf(stderr, "Expected 2 instructions for * 10, got %zu\n",
+			len);
+		goto cleanup;
+	}
+
+	retval = 0;
+
+cleanup:
+
+	subtilis_arm_op_pool_delete(pool);
+	printf(": [%s]\n", retval ? "FAIL" : "OK");
+
+	return retval;
+}
+
+/*
+ * Runs the mulh sequence in s with the operands x and y and checks the
+ * result against the high word of the 64 bit product computed by the
+ * host.
+ */
+
+static int prv_check_mulh(subtilis_arm_section_t *s, int32_t x, int32_t y)
+{
+	int32_t expected;
+	uint32_t regs[32];
+
+	regs[0] = (uint32_t)x;
+	regs[1] = (uint32_t)y;
+	if (prv_eval_mul(s, regs))
+		return 1;
+	expected = (int32_t)(((int64_t)x * y) >> 32);
+	if ((int32_t)regs[2] != expected) {
+		fprintf(stderr, "mulh %d, %d: expected %d, got %d\n", x, y,
+			expected, (int32_t)regs[2]);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns a pseudo-random operand for prv_test_mulh.  The operands are
+ * shifted right by a random amount so that their magnitudes are spread
+ * evenly across the 32 bit range.  Otherwise most of them would have
+ * one of their top few bits set.
+ */
+
+static int32_t prv_mulh_operand(uint32_t *seed)
+{
+	uint32_t shift;
+
+	*seed = *seed * 1103515245 + 12345;
+	shift = *seed >> 27;
+	*seed = *seed * 1103515245 + 12345;
+
+	return (int32_t)(*seed ^ (*seed >> 16)) >> shift;
+}
+
+static int prv_test_mulh(void)
+{
+	subtilis_arm_op_pool_t *pool;
+	subtilis_arm_section_t *s = NULL;
+	subtilis_error_t err;
+	size_t i;
+	size_t j;
+	int32_t x;
+	int32_t y;
+	uint32_t seed = 1;
+	int retval = 1;
+	const int32_t xs[] = {0, 1, -1, 2, 3, -3, 0x7fff, 0x8000, 0xfffe,
+			      0xffff, -0xffff, 0x10000, -0x10000, 0x10001,
+			      0x7fff0000, 0x12345678, -0x1234567, 0x55555556,
+			      0x66666667, INT32_MAX, INT32_MIN, INT32_MIN + 1};
+
+	printf("arm_mulh");
+
+	subtilis_error_init(&err);
+	pool = subtilis_arm_op_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	s = prv_new_section(pool, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	s->reg_counter = SUBTILIS_IR_REG_TEMP_START;
+	subtilis_arm_add_mulh(s, SUBTILIS_ARM_CCODE_AL, 2, 0, 1, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	for (i = 0; i < sizeof(xs) / sizeof(xs[0]); i++)
+		for (j = 0; j < sizeof(xs) / sizeof(xs[0]); j++)
+			if (prv_check_mulh(s, xs[i], xs[j]))
+				goto cleanup;
+
+	for (i = 0; i < 20000; i++) {
+		x = prv_mulh_operand(&seed);
+		y = prv_mulh_operand(&seed);
+		if (prv_check_mulh(s, x, y))
+			goto cleanup;
+		for (j = 0; j < sizeof(xs) / sizeof(xs[0]); j++)
+			if (prv_check_mulh(s, x, xs[j]) ||
+			    prv_check_mulh(s, xs[j], x))
+				goto cleanup;
+	}
+
+	retval = 0;
+
+cleanup:
+
+	if (err.type != SUBTILIS_ERROR_OK)
+		subtilis_error_fprintf(stderr, &err, true);
+	subtilis_arm_section_delete(s);
+	subtilis_arm_op_pool_delete(pool);
+	printf(": [%s]\n", retval ? "FAIL" : "OK");
+
+	return retval;
+}
+
 int arm_core_test(void)
 {
 	int retval;
@@ -487,6 +1459,14 @@ int arm_core_test(void)
 	retval |= prv_test_arm_add_data_neg_imm();
 	retval |= prv_test_arm_add_data_neg_2_imm();
 	retval |= prv_test_arm_add_data_ldr_imm();
+	retval |= prv_test_peephole_forward_store();
+	retval |= prv_test_peephole_fold_cmp();
+	retval |= prv_test_peephole_fold_shift();
+	retval |= prv_test_peephole_thread_branch();
+	retval |= prv_test_peephole_if_convert();
+	retval |= prv_test_dup_instr();
+	retval |= prv_test_mul_imm();
+	retval |= prv_test_mulh();
 
 	return retval;
 }
@@ -37,6 +37,55 @@ static void prv_decode_mul(subtilis_arm_instr_t *instr, uint32_t encoded,
 	mul->rm = encoded & 0x0f;
 }
 
+static void prv_decode_mull(subtilis_arm_instr_t *instr, uint32_t encoded,
+			    subtilis_error_t *err)
+{
+	subtilis_arm_mul_instr_t *mul = &instr->operands.mul;
+
+	/* We don't support the accumulating forms, SMLAL and UMLAL. */
+
+	if (encoded & (1 << 21)) {
+		subtilis_error_set_bad_instruction(err, encoded);
+		return;
+	}
+
+	if (encoded & (1 << 22))
+		instr->type = SUBTILIS_ARM_INSTR_SMULL;
+	else
+		instr->type = SUBTILIS_ARM_INSTR_UMULL;
+
+	mul->ccode = (subtilis_arm_ccode_type_t)(encoded >> 28);
+	mul->status = ((encoded >> 20) & 1);
+	mul->dest = (encoded >> 16) & 0x0f;
+	mul->rn = (encoded >> 12) & 0x0f;
+	mul->rs = (encoded >> 8) & 0x0f;
+	mul->rm = encoded & 0x0f;
+}
+
+static void prv_decode_pld(subtilis_arm_instr_t *instr, uint32_t encoded,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_pld_instr_t *pld = &instr->operands.pld;
+
+	instr->type = SUBTILIS_ARM_INSTR_PLD;
+	pld->base = (encoded >> 16) & 0x0f;
+	pld->offset = encoded & 0xfff;
+	if (!(encoded & (1 << 23)))
+		pld->offset = -pld->offset;
+}
+
+static void prv_decode_rev(subtilis_arm_instr_t *instr, uint32_t encoded,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_signx_instr_t *signx = &instr->operands.signx;
+
+	instr->type = SUBTILIS_ARM_INSTR_REV;
+	signx->ccode = encoded >> 28;
+	signx->rotate = SUBTILIS_ARM_SIGNX_ROR_NONE;
+	signx->dest = (encoded >> 12) & 0xf;
+	signx->op1 = encoded & 0xf;
+}
+
 static void prv_decode_swi(subtilis_arm_instr_t *instr, uint32_t encoded,
 			   subtilis_error_t *err)
 {
@@ -440,6 +489,15 @@ static void prv_decode_signx(subtilis_arm_instr_t *instr, uint32_t encoded,
 	case 11:
 		instr->type = SUBTILIS_ARM_INSTR_SXTH;
 		break;
+	case 14:
+		instr->type = SUBTILIS_ARM_INSTR_UXTB;
+		break;
+	case 12:
+		instr->type = SUBTILIS_ARM_INSTR_UXTB16;
+		break;
+	case 15:
+		instr->type = SUBTILIS_ARM_INSTR_UXTH;
+		break;
 	default:
 		subtilis_error_set_assertion_failed(err);
 		return;
@@ -923,7 +981,7 @@ static void prv_vfp_disass_tran_dbl(subtilis_arm_instr_t *instr,
 {
 	subtilis_vfp_tran_dbl_instr_t *tran_dbl = &instr->operands.vfp_tran_dbl;
 
-	switch (encoded & 0xf400af0) {
+	switch (encoded & 0xff00fd0) {
 	case 0xc400b10:
 		instr->type = SUBTILIS_VFP_INSTR_FMDRR;
 		tran_dbl->dest1 = encoded & 0xf;
@@ -938,14 +996,14 @@ static void prv_vfp_disass_tran_dbl(subtilis_arm_instr_t *instr,
 		tran_dbl->src1 = encoded & 0xf;
 		tran_dbl->src2 = 0;
 		break;
-	case 0xc400a10:
+	case 0xc500a10:
 		instr->type = SUBTILIS_VFP_INSTR_FMRRS;
 		tran_dbl->dest1 = (encoded >> 12) & 0xf;
 		tran_dbl->dest2 = (encoded >> 16) & 0xf;
 		tran_dbl->src1 = ((encoded & 0xf) << 1) | ((encoded >> 5) & 1);
 		tran_dbl->src2 = tran_dbl->src1 + 1;
 		break;
-	case 0xc500a10:
+	case 0xc400a10:
 		instr->type = SUBTILIS_VFP_INSTR_FMSRR;
 		tran_dbl->dest1 = ((encoded & 0xf) << 1) | ((encoded >> 5) & 1);
 		tran_dbl->dest2 = tran_dbl->dest1 + 1;
@@ -1150,6 +1208,16 @@ void subtilis_arm_disass(subtilis_arm_instr_t *instr, uint32_t encoded,
 		return;
 	}
 
+	if ((encoded & 0x0f8000f0) == 0x00800090) {
+		prv_decode_mull(instr, encoded, err);
+		return;
+	}
+
+	if ((encoded & 0xff70f000) == 0xf550f000) {
+		prv_decode_pld(instr, encoded, err);
+		return;
+	}
+
 	mask = encoded & (0xf << 24);
 	if (mask == 0x0f000000) {
 		prv_decode_swi(instr, encoded, err);
@@ -1183,6 +1251,11 @@ void subtilis_arm_disass(subtilis_arm_instr_t *instr, uint32_t encoded,
 		return;
 	}
 
+	if ((encoded & 0x0fff0ff0) == 0x06bf0f30) {
+		prv_decode_rev(instr, encoded, err);
+		return;
+	}
+
 	mask = (encoded & (0x3 << 26)) >> 26;
 	if (mask == 1) {
 		prv_decode_stran(instr, encoded, err);
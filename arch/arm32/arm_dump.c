@@ -213,6 +213,13 @@ static const char *const instr_desc[] = {
 	"SXTB",     // SUBTILIS_ARM_INSTR_SXTB
 	"SXTB16",   // SUBTILIS_ARM_INSTR_SXTB16
 	"SXTH",     // SUBTILIS_ARM_INSTR_SXTH
+	"UXTB",     // SUBTILIS_ARM_INSTR_UXTB
+	"UXTB16",   // SUBTILIS_ARM_INSTR_UXTB16
+	"UXTH",     // SUBTILIS_ARM_INSTR_UXTH
+	"REV",      // SUBTILIS_ARM_INSTR_REV
+	"SMULL",    // SUBTILIS_ARM_INSTR_SMULL
+	"UMULL",    // SUBTILIS_ARM_INSTR_UMULL
+	"PLD",      // SUBTILIS_ARM_INSTR_PLD
 };
 
 static const char *const shift_desc[] = {
@@ -292,6 +299,10 @@ static void prv_dump_mul_instr(void *user_data, subtilis_arm_op_t *op,
 	if (type == SUBTILIS_ARM_INSTR_MLA)
 		printf(" R%zu, R%zu, R%zu, R%zu\n", instr->dest, instr->rm,
 		       instr->rs, instr->rn);
+	else if ((type == SUBTILIS_ARM_INSTR_SMULL) ||
+		 (type == SUBTILIS_ARM_INSTR_UMULL))
+		printf(" R%zu, R%zu, R%zu, R%zu\n", instr->rn, instr->dest,
+		       instr->rm, instr->rs);
 	else
 		printf(" R%zu, R%zu, R%zu\n", instr->dest, instr->rm,
 		       instr->rs);
@@ -1077,6 +1088,15 @@ static void prv_dump_signx_instr(void *user_data, subtilis_arm_op_t *op,
 	printf(", ROR %d\n", ror);
 }
 
+static void prv_dump_pld_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_pld_instr_t *instr,
+			       subtilis_error_t *err)
+{
+	printf("\t%s [R%zu, #%d]\n", instr_desc[type], instr->base,
+	       instr->offset);
+}
+
 void subtilis_arm_section_dump(subtilis_arm_prog_t *p,
 			       subtilis_arm_section_t *s)
 {
@@ -1123,6 +1143,7 @@ void subtilis_arm_section_dump(subtilis_arm_prog_t *p,
 	walker.stran_misc_fn = prv_dump_stran_misc_instr;
 	walker.simd_fn = prv_dump_reg_only_instr;
 	walker.signx_fn = prv_dump_signx_instr;
+	walker.pld_fn = prv_dump_pld_instr;
 
 	subtilis_arm_walk(s, &walker, &err);
 
@@ -1174,6 +1195,8 @@ void subtilis_arm_instr_dump(subtilis_arm_instr_t *instr)
 		break;
 	case SUBTILIS_ARM_INSTR_MUL:
 	case SUBTILIS_ARM_INSTR_MLA:
+	case SUBTILIS_ARM_INSTR_SMULL:
+	case SUBTILIS_ARM_INSTR_UMULL:
 		prv_dump_mul_instr(NULL, NULL, instr->type,
 				   &instr->operands.mul, NULL);
 		break;
@@ -1431,9 +1454,17 @@ void subtilis_arm_instr_dump(subtilis_arm_instr_t *instr)
 	case SUBTILIS_ARM_INSTR_SXTB:
 	case SUBTILIS_ARM_INSTR_SXTB16:
 	case SUBTILIS_ARM_INSTR_SXTH:
+	case SUBTILIS_ARM_INSTR_UXTB:
+	case SUBTILIS_ARM_INSTR_UXTB16:
+	case SUBTILIS_ARM_INSTR_UXTH:
+	case SUBTILIS_ARM_INSTR_REV:
 		prv_dump_signx_instr(NULL, NULL, instr->type,
 				     &instr->operands.signx, NULL);
 		break;
+	case SUBTILIS_ARM_INSTR_PLD:
+		prv_dump_pld_instr(NULL, NULL, instr->type,
+				   &instr->operands.pld, NULL);
+		break;
 	default:
 		printf("\tUNKNOWN INSTRUCTION\n");
 		break;
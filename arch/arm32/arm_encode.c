@@ -92,6 +92,7 @@ struct subtilis_arm_encode_ud_t_ {
 	subtilis_arm_link_t *link;
 	size_t ldrc_real;
 	size_t ldrc_int;
+	size_t code_end;
 };
 
 typedef struct subtilis_arm_encode_ud_t_ subtilis_arm_encode_ud_t;
@@ -538,6 +539,52 @@ fail:
 	(void)fclose(fp);
 }
 
+/*
+ * Writes a text file containing one line per section, giving the address
+ * at which the section starts and the section's name.  The last line
+ * gives the address of the constants that follow the code.  This is used
+ * by the profiler to map addresses back to procedures and functions.
+ */
+
+static void prv_write_map(subtilis_arm_prog_t *arm_p,
+			  subtilis_arm_encode_ud_t *ud, const char *fname,
+			  subtilis_error_t *err)
+{
+	FILE *fp;
+	size_t i;
+	int32_t start = arm_p->start_address;
+
+	fp = fopen(fname, "w");
+	if (!fp) {
+		subtilis_error_set_file_open(err, fname);
+		return;
+	}
+
+	for (i = 0; i < arm_p->num_sections; i++) {
+		if (fprintf(fp, "%08x %s\n",
+			    (uint32_t)(start + ud->link->sections[i]),
+			    arm_p->string_pool->strings[i]) < 0) {
+			subtilis_error_set_file_write(err);
+			goto fail;
+		}
+	}
+
+	if (fprintf(fp, "%08x constants\n",
+		    (uint32_t)(start + ud->code_end)) < 0) {
+		subtilis_error_set_file_write(err);
+		goto fail;
+	}
+
+	if (fclose(fp) != 0)
+		subtilis_error_set_file_close(err);
+
+	return;
+
+fail:
+
+	(void)fclose(fp);
+}
+
 static uint32_t prv_convert_shift(subtilis_arm_shift_type_t type,
 				  subtilis_error_t *err)
 {
@@ -649,6 +696,16 @@ static void prv_encode_mul_instr(void *user_data, subtilis_arm_op_t *op,
 	if (type == SUBTILIS_ARM_INSTR_MLA) {
 		word |= 1 << 21;
 		word |= instr->rn << 12;
+	} else if ((type == SUBTILIS_ARM_INSTR_SMULL) ||
+		   (type == SUBTILIS_ARM_INSTR_UMULL)) {
+		if ((instr->rn > 15) || (instr->rn == instr->dest)) {
+			subtilis_error_set_assertion_failed(err);
+			return;
+		}
+		word |= 1 << 23;
+		if (type == SUBTILIS_ARM_INSTR_SMULL)
+			word |= 1 << 22;
+		word |= instr->rn << 12;
 	}
 
 	word |= instr->ccode << 28;
@@ -671,8 +728,21 @@ static void prv_encode_mov_instr(void *user_data, subtilis_arm_op_t *op,
 				 subtilis_error_t *err)
 {
 	subtilis_arm_encode_ud_t *ud = user_data;
+	size_t adj = 0;
 
-	prv_check_pool(ud, err);
+	/*
+	 * MOV R14, R15 is used to set up the return address for an
+	 * indirect call.  It must be immediately followed by the
+	 * branch, so we need to make sure that a constant pool doesn't
+	 * get flushed between the two instructions.
+	 */
+
+	if ((type == SUBTILIS_ARM_INSTR_MOV) && (instr->dest == 14) &&
+	    (instr->op2.type == SUBTILIS_ARM_OP2_REG) &&
+	    (instr->op2.op.reg == 15))
+		adj = 4;
+
+	prv_check_pool_adj(ud, adj, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
@@ -2278,6 +2348,22 @@ static void prv_encode_signx_instr(void *user_data, subtilis_arm_op_t *op,
 	case SUBTILIS_ARM_INSTR_SXTH:
 		word = 0x6bf0070;
 		break;
+	case SUBTILIS_ARM_INSTR_UXTB:
+		word = 0x6ef0070;
+		break;
+	case SUBTILIS_ARM_INSTR_UXTB16:
+		word = 0x6cf0070;
+		break;
+	case SUBTILIS_ARM_INSTR_UXTH:
+		word = 0x6ff0070;
+		break;
+	case SUBTILIS_ARM_INSTR_REV:
+		if (instr->rotate != SUBTILIS_ARM_SIGNX_ROR_NONE) {
+			subtilis_error_set_assertion_failed(err);
+			return;
+		}
+		word = 0x6bf0f30;
+		break;
 	default:
 		subtilis_error_set_assertion_failed(err);
 		return;
@@ -2312,6 +2398,38 @@ static void prv_encode_signx_instr(void *user_data, subtilis_arm_op_t *op,
 	prv_add_word(ud, word, err);
 }
 
+static void prv_encode_pld_instr(void *user_data, subtilis_arm_op_t *op,
+				 subtilis_arm_instr_type_t type,
+				 subtilis_arm_pld_instr_t *instr,
+				 subtilis_error_t *err)
+{
+	subtilis_arm_encode_ud_t *ud = user_data;
+	uint32_t word = 0xf550f000;
+
+	prv_check_pool(ud, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if ((instr->base > 15) || (instr->offset > 4095) ||
+	    (instr->offset < -4095)) {
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+
+	if (instr->offset >= 0) {
+		word |= 1 << 23;
+		word |= instr->offset;
+	} else {
+		word |= -instr->offset;
+	}
+	word |= instr->base << 16;
+
+	prv_ensure_code(ud, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	prv_add_word(ud, word, err);
+}
+
 static int32_t prv_compute_dist(size_t first, size_t second, size_t limit,
 				subtilis_error_t *err)
 {
@@ -2510,6 +2628,7 @@ static void prv_arm_encode(subtilis_arm_section_t *arm_s,
 	walker.stran_misc_fn = prv_encode_stran_misc_instr;
 	walker.simd_fn = prv_encode_simd_instr;
 	walker.signx_fn = prv_encode_signx_instr;
+	walker.pld_fn = prv_encode_pld_instr;
 
 	subtilis_arm_walk(arm_s, &walker, err);
 	if (err->type != SUBTILIS_ERROR_OK)
@@ -2580,6 +2699,8 @@ static void prv_encode_prog(subtilis_arm_prog_t *arm_p,
 			return;
 	}
 
+	ud->code_end = ud->bytes_written;
+
 	/* Let's write the constants arrays and strings */
 
 	if (arm_p->constant_pool->size > 0) {
@@ -2616,7 +2737,8 @@ cleanup:
 }
 
 void subtilis_arm_encode(subtilis_arm_prog_t *arm_p, const char *fname,
-			 subtilis_arm_encode_plat_t plat, subtilis_error_t *err)
+			 const char *map_fname, subtilis_arm_encode_plat_t plat,
+			 subtilis_error_t *err)
 {
 	subtilis_arm_encode_ud_t ud;
 
@@ -2635,6 +2757,11 @@ void subtilis_arm_encode(subtilis_arm_prog_t *arm_p, const char *fname,
 	}
 
 	prv_write_file(&ud, fname, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	if (map_fname)
+		prv_write_map(arm_p, &ud, map_fname, err);
 
 cleanup:
 
@@ -22,7 +22,14 @@
 typedef void (*subtilis_arm_encode_plat_t)(uint8_t *code, size_t bytes_written,
 					   subtilis_error_t *err);
 
+/*
+ * Encodes arm_p and writes the resulting binary to fname.  If map_fname
+ * is not NULL, a text file mapping the start address of each section to
+ * its name is written to map_fname.
+ */
+
 void subtilis_arm_encode(subtilis_arm_prog_t *arm_p, const char *fname,
+			 const char *map_fname,
 			 subtilis_arm_encode_plat_t plat,
 			 subtilis_error_t *err);
 uint8_t *subtilis_arm_encode_buf(subtilis_arm_prog_t *arm_p,
@@ -414,6 +414,16 @@ static void prv_dist_signx_instr(void *user_data, subtilis_arm_op_t *op,
 	ud->last_used++;
 }
 
+static void prv_dist_pld_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_pld_instr_t *instr,
+			       subtilis_error_t *err)
+{
+	subtilis_dist_data_t *ud = user_data;
+
+	ud->last_used++;
+}
+
 void subtilis_init_fpa_dist_walker(subtlis_arm_walker_t *walker,
 				   void *user_data)
 {
@@ -454,6 +464,7 @@ void subtilis_init_fpa_dist_walker(subtlis_arm_walker_t *walker,
 	walker->stran_misc_fn = NULL;
 	walker->simd_fn = NULL;
 	walker->signx_fn = prv_dist_signx_instr;
+	walker->pld_fn = prv_dist_pld_instr;
 }
 
 static void prv_used_fpa_data_dyadic_instr(void *user_data,
@@ -590,4 +601,5 @@ void subtilis_init_fpa_used_walker(subtlis_arm_walker_t *walker,
 	walker->stran_misc_fn = NULL;
 	walker->simd_fn = NULL;
 	walker->signx_fn = prv_dist_signx_instr;
+	walker->pld_fn = prv_dist_pld_instr;
 }
@@ -169,6 +169,23 @@ void subtilis_arm_gen_muli32(subtilis_ir_section_t *s, size_t start,
 			     op2, err);
 }
 
+void subtilis_arm_gen_mulhi32(subtilis_ir_section_t *s, size_t start,
+			      void *user_data, subtilis_error_t *err)
+{
+	subtilis_arm_reg_t dest;
+	subtilis_arm_reg_t op1;
+	subtilis_arm_reg_t op2;
+	subtilis_arm_section_t *arm_s = user_data;
+	subtilis_ir_inst_t *instr = &s->ops[start]->op.instr;
+
+	dest = subtilis_arm_ir_to_arm_reg(instr->operands[0].reg);
+	op1 = subtilis_arm_ir_to_arm_reg(instr->operands[1].reg);
+	op2 = subtilis_arm_ir_to_arm_reg(instr->operands[2].reg);
+
+	subtilis_arm_add_mulh(arm_s, SUBTILIS_ARM_CCODE_AL, dest, op1, op2,
+			      err);
+}
+
 void subtilis_arm_gen_addi32(subtilis_ir_section_t *s, size_t start,
 			     void *user_data, subtilis_error_t *err)
 {
@@ -1272,45 +1289,47 @@ void subtilis_arm_gen_sete_load_reg(subtilis_arm_section_t *arm_s,
 				   s->error_offset, false, err);
 }
 
-void subtilis_arm_gen_signx8to32_helper(subtilis_arm_section_t *arm_s,
-					subtilis_arm_reg_t dest,
-					subtilis_arm_reg_t src,
-					subtilis_error_t *err)
-
+static void prv_add_mov_shift_imm(subtilis_arm_section_t *arm_s,
+				  subtilis_arm_reg_t dest,
+				  subtilis_arm_reg_t src,
+				  subtilis_arm_shift_type_t type,
+				  int32_t shift, subtilis_error_t *err)
 {
 	subtilis_arm_instr_t *instr;
-	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_data_instr_t *mov;
 
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_TST,
-				 SUBTILIS_ARM_CCODE_AL, src, 1 << 7, err);
+	instr =
+	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
+	mov = &instr->operands.data;
 
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_EQ, false, dest, src,
-				 err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
+	mov->status = false;
+	mov->ccode = SUBTILIS_ARM_CCODE_AL;
+	mov->dest = dest;
+	mov->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
+	mov->op2.op.shift.type = type;
+	mov->op2.op.shift.reg = src;
+	mov->op2.op.shift.shift_reg = false;
+	mov->op2.op.shift.shift.integer = shift;
+}
 
-	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_AND,
-				  SUBTILIS_ARM_CCODE_EQ, false, dest, dest,
-				  0xff, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
+/*
+ * src is only read by the first instruction, so dest and src may be the
+ * same register.
+ */
 
-	subtilis_arm_add_mvn_imm(arm_s, SUBTILIS_ARM_CCODE_NE, false, dest, 255,
-				 err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
+void subtilis_arm_gen_signx8to32_helper(subtilis_arm_section_t *arm_s,
+					subtilis_arm_reg_t dest,
+					subtilis_arm_reg_t src,
+					subtilis_error_t *err)
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_ORR, err);
+{
+	prv_add_mov_shift_imm(arm_s, dest, src, SUBTILIS_ARM_SHIFT_LSL, 24,
+			      err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->status = false;
-	datai->ccode = SUBTILIS_ARM_CCODE_NE;
-	datai->dest = dest;
-	datai->op1 = dest;
-	datai->op2.type = SUBTILIS_ARM_OP2_REG;
-	datai->op2.op.reg = src;
+
+	prv_add_mov_shift_imm(arm_s, dest, dest, SUBTILIS_ARM_SHIFT_ASR, 24,
+			      err);
 }
@@ -0,0 +1,789 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "arm_global_alloc.h"
+#include "arm_op_regs.h"
+
+/*
+ * The global allocator works on whole sections rather than on basic
+ * blocks.  It computes the liveness of each virtual register that is
+ * live across a basic block boundary, taking loops into account, and
+ * converts this into an interval of basic blocks, in the order in which
+ * they appear in the section.  A linear scan over these intervals then
+ * assigns the most heavily used registers, weighted by loop depth, to a
+ * small pool of physical registers taken from the top of each register
+ * class.  The local allocator takes care of everything else.  The pool
+ * is kept small so that the local allocator always has enough registers
+ * to allocate the operands of any single instruction.
+ */
+
+#define SUBTILIS_ARM_GA_MAX_DEPTH 3
+
+struct subtilis_arm_ga_interval_t_ {
+	size_t reg;
+	size_t start;
+	size_t end;
+	size_t weight;
+	size_t phys;
+};
+
+typedef struct subtilis_arm_ga_interval_t_ subtilis_arm_ga_interval_t;
+
+struct subtilis_arm_ga_class_t_ {
+	subtilis_arm_reg_class_t *regs;
+	bool real;
+	bool disabled;
+	size_t first_virt;
+	size_t pool;
+	subtilis_bitset_t *def;
+	subtilis_bitset_t *live_in;
+	subtilis_bitset_t *live_out;
+	size_t *first;
+	size_t *last;
+	size_t *weight;
+	subtilis_arm_ga_interval_t *intervals;
+	size_t count;
+};
+
+typedef struct subtilis_arm_ga_class_t_ subtilis_arm_ga_class_t;
+
+struct subtilis_arm_ga_t_ {
+	subtilis_arm_reg_ud_t *ud;
+	subtilis_arm_subsections_t *sss;
+	subtilis_arm_ga_class_t int_class;
+	subtilis_arm_ga_class_t real_class;
+	size_t *freq;
+	size_t *block_of;
+	size_t base;
+	size_t len;
+};
+
+typedef struct subtilis_arm_ga_t_ subtilis_arm_ga_t;
+
+static subtilis_bitset_t *prv_new_bitsets(size_t count, subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_bitset_t *bs;
+
+	bs = malloc(count * sizeof(*bs));
+	if (!bs) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+
+	for (i = 0; i < count; i++)
+		subtilis_bitset_init(&bs[i]);
+
+	return bs;
+}
+
+static void prv_free_bitsets(subtilis_bitset_t *bs, size_t count)
+{
+	size_t i;
+
+	if (!bs)
+		return;
+
+	for (i = 0; i < count; i++)
+		subtilis_bitset_free(&bs[i]);
+	free(bs);
+}
+
+static void prv_class_init(subtilis_arm_ga_class_t *cls,
+			   subtilis_arm_reg_class_t *regs, bool real,
+			   size_t first_virt, size_t blocks,
+			   subtilis_error_t *err)
+{
+	size_t i;
+	size_t pool_size;
+
+	cls->regs = regs;
+	cls->real = real;
+	cls->disabled = false;
+	cls->first_virt = first_virt;
+	cls->pool = 0;
+	cls->intervals = NULL;
+	cls->count = 0;
+
+	/*
+	 * The pool is made up of the highest numbered physical registers
+	 * in the class, avoiding any that are used to pass arguments.
+	 */
+
+	pool_size = regs->max_regs / 3;
+	for (i = regs->max_regs - pool_size; i < regs->max_regs; i++)
+		if (i >= SUBTILIS_ARM_REG_MAX_ARGS)
+			cls->pool |= 1 << i;
+
+	cls->def = prv_new_bitsets(blocks, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	cls->live_in = prv_new_bitsets(blocks, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	cls->live_out = prv_new_bitsets(blocks, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	cls->first = malloc(regs->vr_reg_count * sizeof(*cls->first));
+	cls->last = malloc(regs->vr_reg_count * sizeof(*cls->last));
+	cls->weight = calloc(regs->vr_reg_count, sizeof(*cls->weight));
+	if (!cls->first || !cls->last || !cls->weight) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < regs->vr_reg_count; i++) {
+		cls->first[i] = SIZE_MAX;
+		cls->last[i] = 0;
+	}
+}
+
+static void prv_class_free(subtilis_arm_ga_class_t *cls, size_t blocks)
+{
+	prv_free_bitsets(cls->def, blocks);
+	prv_free_bitsets(cls->live_in, blocks);
+	prv_free_bitsets(cls->live_out, blocks);
+	free(cls->first);
+	free(cls->last);
+	free(cls->weight);
+	free(cls->intervals);
+}
+
+static void prv_touch(subtilis_arm_ga_class_t *cls, size_t reg, size_t block)
+{
+	if (cls->first[reg] == SIZE_MAX || block < cls->first[reg])
+		cls->first[reg] = block;
+	if (block > cls->last[reg])
+		cls->last[reg] = block;
+}
+
+static void prv_ga_init(subtilis_arm_ga_t *ga, subtilis_arm_reg_ud_t *ud,
+			subtilis_arm_subsections_t *sss, subtilis_error_t *err)
+{
+	size_t i;
+	size_t ptr;
+	size_t min_ptr = SIZE_MAX;
+	size_t max_ptr = 0;
+	subtilis_arm_section_t *arm_s = ud->arm_s;
+
+	ga->ud = ud;
+	ga->sss = sss;
+	ga->freq = NULL;
+	ga->block_of = NULL;
+	ga->int_class.def = NULL;
+	ga->int_class.live_in = NULL;
+	ga->int_class.live_out = NULL;
+	ga->int_class.first = NULL;
+	ga->int_class.last = NULL;
+	ga->int_class.weight = NULL;
+	ga->int_class.intervals = NULL;
+	ga->real_class = ga->int_class;
+
+	prv_class_init(&ga->int_class, ud->int_regs, false,
+		       SUBTILIS_ARM_INT_VIRT_REG_START + arm_s->stype->int_regs,
+		       sss->count, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_class_init(&ga->real_class, ud->real_regs, true,
+		       arm_s->fp_if->max_regs + arm_s->stype->fp_regs,
+		       sss->count, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	ga->freq = calloc(sss->count, sizeof(*ga->freq));
+	if (!ga->freq) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	/*
+	 * The op pool is shared between all the sections of a program so
+	 * the map from ops to basic blocks only covers the range of ops
+	 * used by this section.
+	 */
+
+	ptr = arm_s->first_op;
+	while (ptr != SIZE_MAX) {
+		if (ptr < min_ptr)
+			min_ptr = ptr;
+		if (ptr > max_ptr)
+			max_ptr = ptr;
+		if (ptr == arm_s->last_op)
+			break;
+		ptr = arm_s->op_pool->ops[ptr].next;
+	}
+
+	ga->base = min_ptr;
+	ga->len = max_ptr - min_ptr + 1;
+	ga->block_of = malloc(ga->len * sizeof(*ga->block_of));
+	if (!ga->block_of) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < ga->len; i++)
+		ga->block_of[i] = SIZE_MAX;
+}
+
+static void prv_ga_free(subtilis_arm_ga_t *ga)
+{
+	prv_class_free(&ga->int_class, ga->sss->count);
+	prv_class_free(&ga->real_class, ga->sss->count);
+	free(ga->freq);
+	free(ga->block_of);
+}
+
+static void prv_scan_reg(subtilis_arm_ga_t *ga, subtilis_arm_ga_class_t *cls,
+			 subtilis_arm_op_t *op, size_t reg, size_t block,
+			 subtilis_error_t *err)
+{
+	int delta;
+	subtilis_arm_reg_class_t *regs = cls->regs;
+
+	if (!subtilis_arm_reg_alloc_op_event(ga->ud, &regs->dist_walker, op,
+					     reg, &delta))
+		return;
+
+	if (reg < regs->max_regs) {
+		cls->pool &= ~(1 << reg);
+		return;
+	}
+
+	if (reg >= regs->vr_reg_count)
+		return;
+
+	prv_touch(cls, reg, block);
+	if (delta == -1)
+		subtilis_bitset_set(&cls->def[block], reg, err);
+}
+
+/*
+ * Walks the section once, recording the basic block of each op, the
+ * virtual registers defined and referenced by each block and the
+ * physical registers explicitly used by the section, which cannot be
+ * handed out by the global allocator.  Returns false if the section
+ * contains code that the global allocator cannot handle.
+ */
+
+static bool prv_scan(subtilis_arm_ga_t *ga, subtilis_error_t *err)
+{
+	size_t i;
+	size_t ptr;
+	size_t reg;
+	int delta;
+	size_t block = 0;
+	subtilis_arm_op_t *op;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_op_regs_t op_regs;
+	subtlis_arm_walker_t regs_walker;
+	subtilis_arm_reg_ud_t *ud = ga->ud;
+	subtilis_arm_section_t *arm_s = ud->arm_s;
+	subtilis_arm_subsections_t *sss = ga->sss;
+
+	subtilis_init_op_regs_walker(&regs_walker, &op_regs);
+
+	ptr = arm_s->first_op;
+	while (ptr != SIZE_MAX) {
+		if ((block + 1 < sss->count) &&
+		    (ptr == sss->sub_sections[block + 1].start))
+			block++;
+		ga->block_of[ptr - ga->base] = block;
+		op = &arm_s->op_pool->ops[ptr];
+
+		/*
+		 * Instructions from the wrong floating point architecture
+		 * prevent us from reasoning about the registers of that
+		 * class.
+		 */
+
+		if (subtilis_arm_reg_alloc_op_event(
+			ud, &ud->int_regs->dist_walker, op, SIZE_MAX, &delta))
+			ga->int_class.disabled = true;
+		if (subtilis_arm_reg_alloc_op_event(
+			ud, &ud->real_regs->dist_walker, op, SIZE_MAX, &delta))
+			ga->real_class.disabled = true;
+
+		if (op->type == SUBTILIS_ARM_OP_INSTR) {
+			instr = &op->op.instr;
+			switch (instr->type) {
+			case SUBTILIS_ARM_INSTR_B:
+				/*
+				 * Local calls introduce control flow that
+				 * isn't visible in the basic blocks.
+				 */
+
+				if (instr->operands.br.local)
+					return false;
+				break;
+			case SUBTILIS_ARM_INSTR_LDM:
+			case SUBTILIS_ARM_INSTR_STM:
+				ga->int_class.pool &=
+				    ~instr->operands.mtran.reg_list;
+				break;
+			case SUBTILIS_ARM_INSTR_SWI:
+				ga->int_class.pool &=
+				    ~(instr->operands.swi.reg_read_mask |
+				      instr->operands.swi.reg_write_mask);
+				break;
+			default:
+				break;
+			}
+		}
+
+		op_regs.count = 0;
+		subtilis_arm_walk_from_to(arm_s, &regs_walker, op, op, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return false;
+
+		/*
+		 * The op regs walker doesn't tell us the class of the
+		 * register so we try both.
+		 */
+
+		for (i = 0; i < op_regs.count; i++) {
+			reg = op_regs.regs[i];
+			prv_scan_reg(ga, &ga->int_class, op, reg, block, err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				return false;
+			prv_scan_reg(ga, &ga->real_class, op, reg, block, err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				return false;
+		}
+
+		if (ptr == arm_s->last_op)
+			break;
+		ptr = op->next;
+	}
+
+	return true;
+}
+
+static size_t prv_link_target(subtilis_arm_subsections_t *sss,
+			      subtilis_arm_ss_link_t *link,
+			      subtilis_error_t *err)
+{
+	size_t target;
+
+	if (link->link >= sss->link_count) {
+		subtilis_error_set_assertion_failed(err);
+		return SIZE_MAX;
+	}
+
+	target = sss->ss_link_map[link->link];
+	if (target >= sss->count) {
+		subtilis_error_set_assertion_failed(err);
+		return SIZE_MAX;
+	}
+
+	return target;
+}
+
+static subtilis_bitset_t *prv_inputs(subtilis_arm_ga_class_t *cls,
+				     subtilis_arm_ss_t *ss)
+{
+	return cls->real ? &ss->real_inputs : &ss->int_inputs;
+}
+
+static subtilis_bitset_t *prv_link_save(subtilis_arm_ga_class_t *cls,
+					subtilis_arm_ss_link_t *link)
+{
+	return cls->real ? &link->real_save : &link->int_save;
+}
+
+/*
+ * Standard backwards data flow analysis.  The inputs of each basic
+ * block, which have already been computed, are the registers read
+ * before they are written in that block.  The live in sets only ever
+ * grow so we can detect convergence by counting their members.
+ */
+
+static void prv_liveness(subtilis_arm_ga_t *ga, subtilis_arm_ga_class_t *cls,
+			 subtilis_error_t *err)
+{
+	size_t b;
+	size_t j;
+	size_t target;
+	bool changed;
+	subtilis_arm_ss_t *ss;
+	subtilis_bitset_t scratch;
+	subtilis_arm_subsections_t *sss = ga->sss;
+
+	subtilis_bitset_init(&scratch);
+
+	do {
+		changed = false;
+		for (b = sss->count; b-- > 0;) {
+			ss = &sss->sub_sections[b];
+			for (j = 0; j < ss->num_links; j++) {
+				target = prv_link_target(sss, &ss->links[j],
+							 err);
+				if (err->type != SUBTILIS_ERROR_OK)
+					goto cleanup;
+				subtilis_bitset_or(&cls->live_out[b],
+						   &cls->live_in[target], err);
+				if (err->type != SUBTILIS_ERROR_OK)
+					goto cleanup;
+			}
+
+			subtilis_bitset_reset(&scratch);
+			subtilis_bitset_or(&scratch, &cls->live_out[b], err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				goto cleanup;
+			subtilis_bitset_sub(&scratch, &cls->def[b]);
+			subtilis_bitset_or(&scratch, prv_inputs(cls, ss), err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				goto cleanup;
+
+			if (subtilis_bitset_count(&scratch) !=
+			    subtilis_bitset_count(&cls->live_in[b])) {
+				subtilis_bitset_claim(&cls->live_in[b],
+						      &scratch);
+				changed = true;
+			}
+		}
+	} while (changed);
+
+cleanup:
+
+	subtilis_bitset_free(&scratch);
+}
+
+/*
+ * Estimates how often each basic block is executed from the number of
+ * loops, i.e., backward links, that contain it.
+ */
+
+static void prv_block_freq(subtilis_arm_ga_t *ga, subtilis_error_t *err)
+{
+	size_t b;
+	size_t j;
+	size_t k;
+	size_t target;
+	subtilis_arm_ss_t *ss;
+	subtilis_arm_subsections_t *sss = ga->sss;
+
+	for (b = 0; b < sss->count; b++) {
+		ss = &sss->sub_sections[b];
+		for (j = 0; j < ss->num_links; j++) {
+			target = prv_link_target(sss, &ss->links[j], err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				return;
+			if (target > b)
+				continue;
+			for (k = target; k <= b; k++)
+				ga->freq[k]++;
+		}
+	}
+
+	for (b = 0; b < sss->count; b++) {
+		if (ga->freq[b] > SUBTILIS_ARM_GA_MAX_DEPTH)
+			ga->freq[b] = SUBTILIS_ARM_GA_MAX_DEPTH;
+		ga->freq[b] = 1 << (3 * ga->freq[b]);
+	}
+}
+
+static void prv_add_weights(subtilis_arm_ga_class_t *cls,
+			    subtilis_bitset_t *bs, size_t freq)
+{
+	int i;
+
+	for (i = cls->first_virt; i <= bs->max_value; i++)
+		if ((i < cls->regs->vr_reg_count) &&
+		    subtilis_bitset_isset(bs, i))
+			cls->weight[i] += freq;
+}
+
+static void prv_extend_intervals(subtilis_arm_ga_class_t *cls,
+				 subtilis_bitset_t *bs, size_t block)
+{
+	int i;
+
+	for (i = cls->first_virt; i <= bs->max_value; i++)
+		if ((i < cls->regs->vr_reg_count) &&
+		    subtilis_bitset_isset(bs, i))
+			prv_touch(cls, i, block);
+}
+
+/*
+ * Builds an interval for each virtual register that lives across a
+ * basic block boundary.  The weight of an interval is the number of
+ * loads and stores the local allocator would need to generate to
+ * transfer the register between basic blocks, scaled by loop depth.
+ */
+
+static void prv_make_intervals(subtilis_arm_ga_t *ga,
+			       subtilis_arm_ga_class_t *cls,
+			       subtilis_error_t *err)
+{
+	size_t b;
+	size_t j;
+	int i;
+	subtilis_arm_ss_t *ss;
+	subtilis_bitset_t *save;
+	subtilis_arm_ga_interval_t *iv;
+	subtilis_arm_subsections_t *sss = ga->sss;
+
+	for (b = 0; b < sss->count; b++) {
+		ss = &sss->sub_sections[b];
+		prv_extend_intervals(cls, &cls->live_in[b], b);
+		prv_extend_intervals(cls, &cls->live_out[b], b);
+		prv_add_weights(cls, prv_inputs(cls, ss), ga->freq[b]);
+		for (j = 0; j < ss->num_links; j++)
+			prv_add_weights(cls, prv_link_save(cls, &ss->links[j]),
+					ga->freq[b]);
+	}
+
+	save = cls->real ? &sss->real_save : &sss->int_save;
+	cls->intervals = malloc((subtilis_bitset_count(save) + 1) *
+				sizeof(*cls->intervals));
+	if (!cls->intervals) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = cls->first_virt; i <= save->max_value; i++) {
+		if ((i >= cls->regs->vr_reg_count) ||
+		    !subtilis_bitset_isset(save, i) || (cls->weight[i] == 0) ||
+		    (cls->first[i] == SIZE_MAX))
+			continue;
+		iv = &cls->intervals[cls->count++];
+		iv->reg = i;
+		iv->start = cls->first[i];
+		iv->end = cls->last[i];
+		iv->weight = cls->weight[i];
+		iv->phys = SIZE_MAX;
+	}
+}
+
+static int prv_interval_cmp(const void *a, const void *b)
+{
+	const subtilis_arm_ga_interval_t *ia = a;
+	const subtilis_arm_ga_interval_t *ib = b;
+
+	if (ia->start != ib->start)
+		return ia->start < ib->start ? -1 : 1;
+	if (ia->reg != ib->reg)
+		return ia->reg < ib->reg ? -1 : 1;
+	return 0;
+}
+
+static void prv_linear_scan(subtilis_arm_ga_class_t *cls)
+{
+	size_t i;
+	size_t j;
+	size_t n;
+	size_t used;
+	size_t free_regs;
+	size_t phys;
+	size_t victim;
+	size_t active[sizeof(size_t) * 8];
+	size_t active_count = 0;
+	subtilis_arm_ga_interval_t *cur;
+	subtilis_arm_ga_interval_t *iv = cls->intervals;
+
+	qsort(iv, cls->count, sizeof(*iv), prv_interval_cmp);
+
+	for (i = 0; i < cls->count; i++) {
+		cur = &iv[i];
+
+		n = 0;
+		used = 0;
+		for (j = 0; j < active_count; j++) {
+			if (iv[active[j]].end < cur->start)
+				continue;
+			active[n++] = active[j];
+			used |= 1 << iv[active[j]].phys;
+		}
+		active_count = n;
+
+		free_regs = cls->pool & ~used;
+		if (free_regs) {
+			for (phys = 0; !(free_regs & (1 << phys)); phys++)
+				;
+			cur->phys = phys;
+			active[active_count++] = i;
+			continue;
+		}
+
+		/*
+		 * No free registers.  Steal the register of the least
+		 * valuable active interval, if it's worth less than ours.
+		 */
+
+		victim = 0;
+		for (j = 1; j < active_count; j++)
+			if (iv[active[j]].weight < iv[active[victim]].weight)
+				victim = j;
+
+		if ((active_count == 0) ||
+		    (iv[active[victim]].weight >= cur->weight))
+			continue;
+
+		cur->phys = iv[active[victim]].phys;
+		iv[active[victim]].phys = SIZE_MAX;
+		active[victim] = i;
+	}
+}
+
+static void prv_remove_pinned(subtilis_arm_ga_t *ga,
+			      subtilis_arm_ga_class_t *cls,
+			      subtilis_bitset_t *pinned)
+{
+	size_t b;
+	size_t j;
+	subtilis_arm_ss_t *ss;
+	subtilis_arm_subsections_t *sss = ga->sss;
+
+	subtilis_bitset_sub(cls->real ? &sss->real_save : &sss->int_save,
+			    pinned);
+	for (b = 0; b < sss->count; b++) {
+		ss = &sss->sub_sections[b];
+		subtilis_bitset_sub(prv_inputs(cls, ss), pinned);
+		for (j = 0; j < ss->num_links; j++)
+			subtilis_bitset_sub(prv_link_save(cls, &ss->links[j]),
+					    pinned);
+	}
+}
+
+/*
+ * Pins the allocated registers and removes them from the sets used to
+ * generate the code that transfers registers between basic blocks.  Any
+ * call made while a pinned register is live needs to preserve it.
+ */
+
+static void prv_apply(subtilis_arm_ga_t *ga, subtilis_arm_ga_class_t *cls,
+		      subtilis_error_t *err)
+{
+	size_t i;
+	size_t j;
+	size_t b;
+	size_t ptr;
+	size_t live;
+	subtilis_bitset_t pinned;
+	subtilis_arm_ga_interval_t *iv;
+	subtilis_arm_call_site_t *site;
+	subtilis_arm_reg_class_t *regs = cls->regs;
+	subtilis_arm_section_t *arm_s = ga->ud->arm_s;
+
+	subtilis_bitset_init(&pinned);
+
+	for (i = 0; i < cls->count; i++) {
+		iv = &cls->intervals[i];
+		if (iv->phys == SIZE_MAX)
+			continue;
+		if (!regs->pinned) {
+			regs->pinned =
+			    malloc(regs->vr_reg_count * sizeof(*regs->pinned));
+			if (!regs->pinned) {
+				subtilis_error_set_oom(err);
+				goto cleanup;
+			}
+			for (j = 0; j < regs->vr_reg_count; j++)
+				regs->pinned[j] = SIZE_MAX;
+		}
+		regs->pinned[iv->reg] = iv->phys;
+		regs->reserved |= 1 << iv->phys;
+		subtilis_bitset_set(&pinned, iv->reg, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
+	if (!regs->pinned)
+		goto cleanup;
+
+	prv_remove_pinned(ga, cls, &pinned);
+
+	for (i = 0; i < arm_s->call_site_count; i++) {
+		site = &arm_s->call_sites[i];
+		ptr = site->call_site;
+		if ((ptr < ga->base) || (ptr - ga->base >= ga->len)) {
+			subtilis_error_set_assertion_failed(err);
+			goto cleanup;
+		}
+		b = ga->block_of[ptr - ga->base];
+		live = 0;
+		for (j = 0; j < cls->count; j++) {
+			iv = &cls->intervals[j];
+			if ((iv->phys != SIZE_MAX) && (iv->start <= b) &&
+			    (iv->end >= b))
+				live |= 1 << iv->phys;
+		}
+		if (cls->real)
+			site->real_regs_live |= live;
+		else
+			site->int_regs_live |= live;
+	}
+
+cleanup:
+
+	subtilis_bitset_free(&pinned);
+}
+
+static void prv_alloc_class(subtilis_arm_ga_t *ga,
+			    subtilis_arm_ga_class_t *cls,
+			    subtilis_error_t *err)
+{
+	if (cls->disabled || !cls->pool)
+		return;
+
+	prv_liveness(ga, cls, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_make_intervals(ga, cls, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_linear_scan(cls);
+	prv_apply(ga, cls, err);
+}
+
+void subtilis_arm_global_alloc(subtilis_arm_reg_ud_t *ud,
+			       subtilis_arm_subsections_t *sss,
+			       subtilis_error_t *err)
+{
+	subtilis_arm_ga_t ga;
+
+	if (sss->count == 0)
+		return;
+
+	prv_ga_init(&ga, ud, sss, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	if (!prv_scan(&ga, err))
+		goto cleanup;
+
+	prv_block_freq(&ga, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	prv_alloc_class(&ga, &ga.int_class, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	prv_alloc_class(&ga, &ga.real_class, err);
+
+cleanup:
+
+	prv_ga_free(&ga);
+}
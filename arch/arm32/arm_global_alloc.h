@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBTILIS_ARM_GLOBAL_ALLOC_H
+#define __SUBTILIS_ARM_GLOBAL_ALLOC_H
+
+#include "arm_reg_alloc.h"
+#include "arm_sub_section.h"
+
+/*
+ * Pins virtual registers that live across basic blocks to physical
+ * registers for the lifetime of the section.  Needs to be called after
+ * the basic blocks have been calculated but before they're linked.
+ * The pinned registers are removed from the save and input sets of
+ * sss so that no code is generated to transfer them between blocks.
+ */
+
+void subtilis_arm_global_alloc(subtilis_arm_reg_ud_t *ud,
+			       subtilis_arm_subsections_t *sss,
+			       subtilis_error_t *err);
+
+#endif
@@ -22,48 +22,206 @@
 #define subtilis_arm_heap_min_slot_size (1 << subtilis_arm_heap_min_slot_shift)
 
 /* clang-format on */
-#define subtilis_arm_heap_max_slot 12 /* Index of final slot */
-#define subtilis_arm_heap_max_slots (subtilis_arm_heap_max_slot + 1)
 
 /*
- * We need to ensure that there's enough heap space available to
- * have an entry in the final slot.
+ * Flags stored in the bottom bits of a block's size word.  Block sizes are
+ * always multiples of subtilis_arm_heap_min_slot_size so these bits are
+ * otherwise unused.
  */
 
-const uint32_t subtilis_arm_heap_min_size(void)
-{
-	return (1 << (subtilis_arm_heap_min_slot_shift +
-		      subtilis_arm_heap_max_slot)) +
-	       subtilis_arm_heap_max_slots * sizeof(int32_t);
-}
+#define subtilis_arm_heap_free_flag 1
+#define subtilis_arm_heap_prev_free_flag 2
+#define subtilis_arm_heap_flags                                                \
+	(subtilis_arm_heap_free_flag | subtilis_arm_heap_prev_free_flag)
 
 /*
- * Let's give ourselves 13 slots.  If the smallest slot is
- * 32 bytes, allocations in slot 11 will be 1 << 16, which is
- * 64Kb.  Any allocations larger than this will come from slot
- * 12 which will always be fragmented.  We may want to increase
- * the number of slots on more modern hardware, perhaps even
- * on the RiscPC.  I guess it needs to be configurable on a
- * per platform and perhaps per project basis.
- * The heap will start with the 13 slots and then we'll have
- * the actual heap data.  Each heap block contains an 8 byte
- * header.  This header is invisible to the callers of the
- * heap API.  So a heap block looks like this.
+ * The heap is made up of a number of slots, the count of which is
+ * configured per target via the heap_slots setting.  All but the final
+ * slot are size classes holding free lists of blocks whose sizes are
+ * powers of 2.  The smallest slot holds 32 byte blocks so, with 13 slots,
+ * slot 11 holds blocks of 1 << 16, which is 64Kb.  Blocks in these slots
+ * are never merged with their neighbours.  They're cheap to allocate and
+ * free and the majority of allocations made by BASIC programs are small.
+ *
+ * The final slot is the large block slot.  It holds a doubly linked list
+ * of free blocks of arbitrary size, which must be a multiple of 32 bytes.
+ * Allocations that don't fit in a size class are carved off the end of
+ * the first large block that's big enough to hold them.  The size classes
+ * are also refilled from this slot when they, and all the size classes
+ * above them, are empty.  When a large block is freed it's merged with any
+ * free large blocks that are adjacent to it in memory.  To make this
+ * possible, free large blocks store their size in their final word and the
+ * size words of all blocks carry two flags.
+ *
+ * subtilis_arm_heap_free_flag is set only for free large blocks.
+ * subtilis_arm_heap_prev_free_flag is set when the block that precedes
+ * the block in memory is a free large block.
+ *
+ * The flag may be stale for blocks that belong to the size classes, as
+ * these blocks are never merged, so all code that reads a block's size
+ * must mask out the flags.
+ *
+ * The heap will start with the slots and then we'll have the actual heap
+ * data, the end of which is marked by an empty block header.  Each heap
+ * block contains an 8 byte header.  This header is invisible to the
+ * callers of the heap API.  So a heap block looks like this.
  *
  *
  * | Block Size     | 0
  * | Next Block     | 4
  * | Data           | 8 to block size
+ *
+ * and a free large block looks like this.
+ *
+ * | Block Size     | 0
+ * | Next Block     | 4
+ * | Previous Block | 8
+ * | Unused         | 12 to block size - 4
+ * | Block Size     | block size - 4
+ *
+ * The previous block pointer of the first block in the large block slot
+ * points 4 bytes before the slot, so that its next pointer overlays the
+ * slot.
+ */
+
+static uint32_t prv_large_slot(subtilis_arm_section_t *arm_s)
+{
+	return arm_s->settings->heap_slots - 1;
+}
+
+static int32_t prv_max_small_size(subtilis_arm_section_t *arm_s)
+{
+	return subtilis_arm_heap_min_slot_size
+	       << (arm_s->settings->heap_slots - 2);
+}
+
+/*
+ * We need to ensure that there's enough heap space available to
+ * hold a block from the largest size class.
+ */
+
+const uint32_t subtilis_arm_heap_min_size(uint32_t slots)
+{
+	return (1 << (subtilis_arm_heap_min_slot_shift + slots - 1)) +
+	       slots * sizeof(int32_t);
+}
+
+static void prv_add_branch(subtilis_arm_section_t *arm_s,
+			   subtilis_arm_ccode_type_t ccode, size_t label,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_br_instr_t *br;
+	subtilis_arm_instr_t *instr;
+
+	instr =
+	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	br = &instr->operands.br;
+	br->ccode = ccode;
+	br->link = false;
+	br->target.label = label;
+}
+
+static void prv_add_data_reg(subtilis_arm_section_t *arm_s,
+			     subtilis_arm_instr_type_t itype,
+			     subtilis_arm_ccode_type_t ccode, bool status,
+			     subtilis_arm_reg_t dest, subtilis_arm_reg_t op1,
+			     subtilis_arm_reg_t op2, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_instr_t *instr;
+
+	instr = subtilis_arm_section_add_instr(arm_s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	datai = &instr->operands.data;
+	datai->ccode = ccode;
+	datai->status = status;
+	datai->dest = dest;
+	datai->op1 = op1;
+	datai->op2.type = SUBTILIS_ARM_OP2_REG;
+	datai->op2.op.reg = op2;
+}
+
+/*
+ * Generates dest = op2 shifted by shift, which is a register if shift_reg is
+ * true.
+ */
+
+static void prv_add_mov_shift(subtilis_arm_section_t *arm_s,
+			      subtilis_arm_ccode_type_t ccode,
+			      subtilis_arm_reg_t dest, subtilis_arm_reg_t op2,
+			      subtilis_arm_shift_type_t type, bool shift_reg,
+			      int32_t shift, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_instr_t *instr;
+
+	instr =
+	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	datai = &instr->operands.data;
+	datai->ccode = ccode;
+	datai->status = false;
+	datai->dest = dest;
+	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
+	datai->op2.op.shift.shift_reg = shift_reg;
+	datai->op2.op.shift.reg = op2;
+	datai->op2.op.shift.type = type;
+	if (shift_reg)
+		datai->op2.op.shift.shift.reg = shift;
+	else
+		datai->op2.op.shift.shift.integer = shift;
+}
+
+/*
+ * Generates a load or a store of dest from or to base + offset << shift.
  */
 
+static void prv_add_stran_reg(subtilis_arm_section_t *arm_s,
+			      subtilis_arm_instr_type_t itype,
+			      subtilis_arm_ccode_type_t ccode,
+			      subtilis_arm_reg_t dest, subtilis_arm_reg_t base,
+			      subtilis_arm_reg_t offset, int32_t shift,
+			      subtilis_error_t *err)
+{
+	subtilis_arm_stran_instr_t *stran;
+	subtilis_arm_instr_t *instr;
+
+	instr = subtilis_arm_section_add_instr(arm_s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	stran = &instr->operands.stran;
+
+	stran->ccode = ccode;
+	stran->dest = dest;
+	stran->base = base;
+	if (shift == 0) {
+		stran->offset.type = SUBTILIS_ARM_OP2_REG;
+		stran->offset.op.reg = offset;
+	} else {
+		stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
+		stran->offset.op.shift.reg = offset;
+		stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
+		stran->offset.op.shift.shift.integer = shift;
+		stran->offset.op.shift.shift_reg = false;
+	}
+	stran->pre_indexed = true;
+	stran->write_back = false;
+	stran->subtract = false;
+	stran->byte = false;
+}
+
 /*
  * The init code will be inlined into the preamble.  This is not a builtin
  * function.  There's not really much point in making it a function as it
  * will only be called once, at program startup.
  *
  * R1 is the start of the heap
- * R3 is the heap_size, which  must be a multiple of
- * subtilis_arm_heap_min_slot_size
+ * R3 is the heap_size
  *
  * This code will be inserted into the preamble where no register allocation
  * takes place so we need to use fixed registers in this code.
@@ -73,19 +231,25 @@ void subtilis_arm_heap_init(subtilis_arm_section_t *arm_s,
 			    subtilis_error_t *err)
 {
 	size_t loop_label;
-	subtilis_arm_stran_instr_t *stran;
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
+	uint32_t slots = arm_s->settings->heap_slots;
+	uint32_t large_slot;
 	const subtilis_arm_reg_t heap_start = 1;
 	const subtilis_arm_reg_t slots_counter = 2;
+	const subtilis_arm_reg_t scratch = 2;
 	const subtilis_arm_reg_t heap_size = 3;
 	const subtilis_arm_reg_t zero = 4;
+	const subtilis_arm_reg_t end_marker = 4;
+
+	if ((slots < 2) || (slots > SUBTILIS_ARM_HEAP_MAX_SLOTS)) {
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+	large_slot = slots - 1;
 
 	loop_label = arm_s->label_counter++;
 
 	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 slots_counter, subtilis_arm_heap_max_slot,
-				 err);
+				 slots_counter, large_slot, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
@@ -95,9 +259,9 @@ void subtilis_arm_heap_init(subtilis_arm_section_t *arm_s,
 		return;
 
 	/*
-	 * Loop to zero out the first subtilis_arm_heap_max_slot slots.
-	 * When the heap is first initialised there's only one block in
-	 * the final slot that holds all the data.
+	 * Loop to zero out the size classes.  When the heap is first
+	 * initialised there's only one block in the large block slot that
+	 * holds all the data.
 	 */
 
 	subtilis_arm_section_add_label(arm_s, loop_label, err);
@@ -109,55 +273,34 @@ void subtilis_arm_heap_init(subtilis_arm_section_t *arm_s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_STR, SUBTILIS_ARM_CCODE_AL,
+			  zero, heap_start, slots_counter, 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = zero;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = slots_counter;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
 	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
 				 SUBTILIS_ARM_CCODE_AL, slots_counter, 0, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GT, loop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_GT;
-	br->link = false;
-	br->target.label = loop_label;
-
 	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 heap_start, heap_start,
-				 subtilis_arm_heap_max_slots * 4, err);
+				 heap_start, heap_start, slots * 4, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
 	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, heap_size,
-				 heap_size, subtilis_arm_heap_max_slots * 4,
-				 err);
+				 heap_size, slots * 4, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
 	/*
-	 * The size of the first and only slot must be divisible by the
-	 * size of the smallest slot, currently 32 bytes.
+	 * The size of the first and only block must be divisible by the
+	 * size of the smallest slot, currently 32 bytes.  We also need to
+	 * reserve some space at the end of the heap for the end marker.
 	 */
 
 	subtilis_arm_add_data_imm(
@@ -167,78 +310,96 @@ void subtilis_arm_heap_init(subtilis_arm_section_t *arm_s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, heap_size,
+				 heap_size, subtilis_arm_heap_min_slot_size,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
 	/*
-	 * Initialise heap with on entry in the final slot.
+	 * Initialise heap with one entry in the large block slot.
 	 */
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, heap_start,
+				   heap_start, -4, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = heap_start;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_I32;
-	stran->offset.op.integer = 4;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = true;
-	stran->byte = false;
 
 	/*
 	 * Set up one and only block.  Start by storing its size
 	 */
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_ORR,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  heap_size, subtilis_arm_heap_free_flag, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
 
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = heap_size;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_I32;
-	stran->offset.op.integer = 0;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, heap_start,
+				   0, false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
 
 	/*
-	 * Zero out the next pointer.
+	 * Zero out the next pointer and point the previous pointer at the
+	 * slot.
 	 */
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, zero, heap_start, 4,
+				   false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
 
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = zero;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_I32;
-	stran->offset.op.integer = 4;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
+	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, scratch,
+				 heap_start, 8, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, heap_start,
+				   8, false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/*
+	 * Store the block's size in its last word and write the end
+	 * marker, an empty block that follows a free block.
+	 */
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, scratch, heap_start, heap_size, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, heap_size, scratch,
+				   -4, false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
+				 end_marker, subtilis_arm_heap_prev_free_flag,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, end_marker, scratch,
+				   0, false, err);
 }
 
 /*
  * Returns the slot number for allocation size value, in the register ret.
- * scratch is used as workspace and is corrupted.
+ * scratch is used as workspace and is corrupted, as is value.
  */
 
 static void prv_get_slot(subtilis_arm_section_t *arm_s,
 			 subtilis_arm_reg_t value, subtilis_arm_reg_t ret,
 			 subtilis_arm_reg_t scratch, subtilis_error_t *err)
 {
-	subtilis_arm_data_instr_t *datai;
-	subtilis_arm_instr_t *instr;
 	int32_t i;
 	int32_t masks[5] = {0, 0x2, 0xc, 0xf0, 0xff00};
 
@@ -269,19 +430,10 @@ static void prv_get_slot(subtilis_arm_section_t *arm_s,
 		return;
 
 	for (i = 4; i >= 0; --i) {
-		instr = subtilis_arm_section_add_instr(
-		    arm_s, SUBTILIS_ARM_INSTR_MOV, err);
+		prv_add_mov_shift(arm_s, SUBTILIS_ARM_CCODE_NE, value, value,
+				  SUBTILIS_ARM_SHIFT_LSR, false, 1 << i, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
-		datai = &instr->operands.data;
-		datai->ccode = SUBTILIS_ARM_CCODE_NE;
-		datai->status = false;
-		datai->dest = value;
-		datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
-		datai->op2.op.shift.shift_reg = false;
-		datai->op2.op.shift.reg = value;
-		datai->op2.op.shift.type = SUBTILIS_ARM_SHIFT_LSR;
-		datai->op2.op.shift.shift.integer = 1 << i;
 
 		subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_ORR,
 					  SUBTILIS_ARM_CCODE_NE, false, ret,
@@ -303,880 +455,424 @@ static void prv_get_slot(subtilis_arm_section_t *arm_s,
 				 subtilis_arm_heap_min_slot_shift - 1, err);
 }
 
-static void prv_slot12_alloc(subtilis_arm_section_t *arm_s, size_t good_label,
-			     size_t bad_label, size_t exact_slot_size_label,
+/*
+ * Computes the size class of a block of size bytes, which must be a
+ * multiple of subtilis_arm_heap_min_slot_size, and stores it in slot.
+ * The two smallest classes are handled without calling prv_get_slot.
+ * Branches to slot_label when done.
+ */
+
+static void prv_size_to_slot(subtilis_arm_section_t *arm_s,
+			     subtilis_arm_reg_t size, subtilis_arm_reg_t slot,
+			     subtilis_arm_reg_t scratch1,
+			     subtilis_arm_reg_t scratch2, size_t slot_label,
 			     subtilis_error_t *err)
 {
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	const subtilis_arm_reg_t ret_val = 0;
-	subtilis_arm_data_instr_t *datai;
-	const subtilis_arm_reg_t heap_start = 0;
-	const subtilis_arm_reg_t segment = 1;
-	const subtilis_arm_reg_t first_entry = 3;
-	const subtilis_arm_reg_t next_ptr = 4;
-	const subtilis_arm_reg_t block_size = 5;
-	const subtilis_arm_reg_t scratch2 = 6;
-	const subtilis_arm_reg_t split_block_size = 7;
-	const subtilis_arm_reg_t split_slot = 8;
-	const subtilis_arm_reg_t scratch3 = 9;
-	const subtilis_arm_reg_t scratch = 10;
-	const subtilis_arm_reg_t max_size_of_block = 10;
-
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, next_ptr, first_entry,
-				   4, false, err);
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, size,
+				 subtilis_arm_heap_min_slot_size * 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, scratch2, first_entry,
-				   0, false, err);
+	prv_add_mov_shift(arm_s, SUBTILIS_ARM_CCODE_LE, slot, size,
+			  SUBTILIS_ARM_SHIFT_LSR,
+			  false, subtilis_arm_heap_min_slot_shift + 1, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_SUB, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_LE, slot_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = split_block_size;
-	datai->op1 = scratch2;
-	datai->op2.type = SUBTILIS_ARM_OP2_REG;
-	datai->op2.op.reg = block_size;
 
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, next_ptr, heap_start,
-				   subtilis_arm_heap_max_slot * sizeof(int32_t),
-				   false, err);
+	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false, scratch1,
+				 size, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, split_block_size, 0,
-				 err);
+	prv_get_slot(arm_s, scratch1, slot, scratch2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_EQ, false, ret_val,
-				 first_entry, 8, err);
+	subtilis_arm_section_add_label(arm_s, slot_label, err);
+}
+
+/*
+ * Removes the free large block, block, from the large block slot.
+ */
+
+static void prv_unlink_large_block(subtilis_arm_section_t *arm_s,
+				   subtilis_arm_reg_t block,
+				   subtilis_arm_reg_t next,
+				   subtilis_arm_reg_t prev,
+				   subtilis_error_t *err)
+{
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, next, block, 4, false,
+				   err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, prev, block, 8, false,
+				   err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = good_label;
-
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false, scratch,
-				 split_block_size, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, next, prev, 4, false,
+				   err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_ADD, err);
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, next, 0, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = segment;
-	datai->op1 = first_entry;
-	datai->op2.type = SUBTILIS_ARM_OP2_REG;
-	datai->op2.op.reg = block_size;
 
-	prv_get_slot(arm_s, scratch, split_slot, scratch3, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_NE, prev, next, 8, false,
+				   err);
+}
+
+static void prv_search_slots(subtilis_arm_section_t *arm_s,
+			     size_t large_alloc_label, subtilis_error_t *err)
+{
+	const subtilis_arm_reg_t heap_start = 0;
+	const subtilis_arm_reg_t next_ptr = 1;
+	const subtilis_arm_reg_t desired_slot = 2;
+	const subtilis_arm_reg_t non_empty_slot = 3;
+	const subtilis_arm_reg_t next_slot = 4;
+
+	size_t search_slots_loop_label = arm_s->label_counter++;
+
+	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false, next_slot,
+				 desired_slot, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, split_slot,
-				 subtilis_arm_heap_max_slot, err);
+	subtilis_arm_section_add_label(arm_s, search_slots_loop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_GT, false,
-				 split_slot, subtilis_arm_heap_max_slot, err);
+	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, next_slot,
+				 next_slot, 1, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, next_slot,
+				 prv_large_slot(arm_s), err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_GE;
-	br->link = false;
-	br->target.label = exact_slot_size_label;
-
-	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, scratch3,
-				 subtilis_arm_heap_min_slot_size, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, large_alloc_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_LDR, SUBTILIS_ARM_CCODE_AL,
+			  non_empty_slot, heap_start, next_slot, 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = scratch;
-	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
-	datai->op2.op.shift.shift_reg = true;
-	datai->op2.op.shift.reg = scratch3;
-	datai->op2.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	datai->op2.op.shift.shift.reg = split_slot;
 
-	subtilis_arm_add_cmp(arm_s, SUBTILIS_ARM_INSTR_CMP,
-			     SUBTILIS_ARM_CCODE_AL, scratch, split_block_size,
-			     err);
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, non_empty_slot, 0, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, search_slots_loop_label,
+		       err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = exact_slot_size_label;
-
-	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 split_slot, split_slot, 1, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, next_ptr,
+				   non_empty_slot, 4, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = max_size_of_block;
-	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
-	datai->op2.op.shift.shift_reg = false;
-	datai->op2.op.shift.reg = max_size_of_block;
-	datai->op2.op.shift.type = SUBTILIS_ARM_SHIFT_LSR;
-	datai->op2.op.shift.shift.integer = 1;
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_STR, SUBTILIS_ARM_CCODE_AL,
+			  next_ptr, heap_start, next_slot, 2, err);
 }
 
-static void prv_split_slot12_block(subtilis_arm_section_t *arm_s,
-				   size_t split_slot12_block_label,
-				   size_t exact_slot_size_label,
-				   subtilis_error_t *err)
+/*
+ * Splits the block taken from a larger size class by prv_search_slots,
+ * placing one block into each of the empty size classes between the one
+ * we want and the one we found.
+ */
+
+static void prv_split_small_block(subtilis_arm_section_t *arm_s,
+				  size_t good_label, subtilis_error_t *err)
 {
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_data_instr_t *datai;
-	subtilis_arm_stran_instr_t *stran;
 	const subtilis_arm_reg_t heap_start = 0;
-	const subtilis_arm_reg_t segment = 1;
-	const subtilis_arm_reg_t ptr = 4;
-	const subtilis_arm_reg_t split_block_size = 7;
-	const subtilis_arm_reg_t split_slot = 8;
-	const subtilis_arm_reg_t max_size_of_block = 10;
+	const subtilis_arm_reg_t ret_val = 0;
+	const subtilis_arm_reg_t slot_number = 2;
+	const subtilis_arm_reg_t slot_ptr = 3;
+	const subtilis_arm_reg_t next_slot = 4;
+	const subtilis_arm_reg_t block_size = 5;
+	const subtilis_arm_reg_t min_slot_size = 8;
+	const subtilis_arm_reg_t zero = 9;
 
-	size_t find_next_slot_label = arm_s->label_counter++;
+	size_t split_up_block_label = arm_s->label_counter++;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
+				 min_slot_size, subtilis_arm_heap_min_slot_size,
+				 err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
 
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = ptr;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = split_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
-
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, max_size_of_block,
-				   segment, 0, false, err);
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, zero, 0,
+				 err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, ptr, segment, 4,
-				   false, err);
+	subtilis_arm_section_add_label(arm_s, split_up_block_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, next_slot,
+				 next_slot, 1, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = segment;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = split_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_ADD, err);
+	prv_add_mov_shift(arm_s, SUBTILIS_ARM_CCODE_AL, block_size,
+			  min_slot_size, SUBTILIS_ARM_SHIFT_LSL, true,
+			  next_slot, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = segment;
-	datai->op1 = segment;
-	datai->op2.type = SUBTILIS_ARM_OP2_REG;
-	datai->op2.op.reg = max_size_of_block;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_SUB, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, block_size, slot_ptr,
+				   0, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = split_block_size;
-	datai->op1 = split_block_size;
-	datai->op2.type = SUBTILIS_ARM_OP2_REG;
-	datai->op2.op.reg = max_size_of_block;
 
-	subtilis_arm_section_add_label(arm_s, find_next_slot_label, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_STR, SUBTILIS_ARM_CCODE_AL,
+			  slot_ptr, heap_start, next_slot, 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 split_slot, split_slot, 1, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, zero, slot_ptr, 4,
+				   false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, slot_ptr, slot_ptr, block_size, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = max_size_of_block;
-	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
-	datai->op2.op.shift.shift_reg = false;
-	datai->op2.op.shift.reg = max_size_of_block;
-	datai->op2.op.shift.type = SUBTILIS_ARM_SHIFT_LSR;
-	datai->op2.op.shift.shift.integer = 1;
 
 	subtilis_arm_add_cmp(arm_s, SUBTILIS_ARM_INSTR_CMP,
-			     SUBTILIS_ARM_CCODE_AL, split_block_size,
-			     max_size_of_block, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = exact_slot_size_label;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_LT;
-	br->link = false;
-	br->target.label = find_next_slot_label;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_AL;
-	br->link = false;
-	br->target.label = split_slot12_block_label;
-}
-
-static void prv_exact_slot_size(subtilis_arm_section_t *arm_s,
-				size_t good_label, subtilis_error_t *err)
-{
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_stran_instr_t *stran;
-	const subtilis_arm_reg_t ret_val = 0;
-	const subtilis_arm_reg_t heap_start = 0;
-	const subtilis_arm_reg_t split_block_start = 1;
-	const subtilis_arm_reg_t first_entry = 3;
-	const subtilis_arm_reg_t slot_start = 4;
-	const subtilis_arm_reg_t block_size = 5;
-	const subtilis_arm_reg_t split_block_size = 7;
-	const subtilis_arm_reg_t split_slot = 8;
-
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, block_size,
-				   first_entry, 0, false, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, split_block_size,
-				   split_block_start, 0, false, err);
+			     SUBTILIS_ARM_CCODE_AL, next_slot, slot_number,
+			     err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GT, split_up_block_label,
+		       err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = slot_start;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = split_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, slot_start,
-				   split_block_start, 4, false, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+				   SUBTILIS_ARM_CCODE_AL, block_size, slot_ptr,
+				   0, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = split_block_start;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = split_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
 	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, ret_val,
-				 first_entry, 8, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+				 slot_ptr, 8, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_AL;
-	br->link = false;
-	br->target.label = good_label;
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, good_label, err);
 }
 
-static void prv_big_alloc(subtilis_arm_section_t *arm_s, size_t good_label,
-			  size_t bad_label, size_t slot12_alloc_label,
-			  size_t move_block_to_start_label,
-			  subtilis_error_t *err)
+/*
+ * Allocates a block of exactly R1 bytes from the large block slot, using
+ * the first free block that's big enough.  If the block is bigger than
+ * we need, the new block is carved off its end, leaving the remainder of
+ * the free block where it is in the list.
+ */
+
+static void prv_large_alloc(subtilis_arm_section_t *arm_s, size_t good_label,
+			    size_t bad_label, subtilis_error_t *err)
 {
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_stran_instr_t *stran;
-	const subtilis_arm_reg_t requested_size = 1;
 	const subtilis_arm_reg_t heap_start = 0;
-	const subtilis_arm_reg_t last_slot = 2;
-	const subtilis_arm_reg_t first_entry = 3;
-	const subtilis_arm_reg_t size_of_block = 4;
-	const subtilis_arm_reg_t block_size = 5;
-
-	size_t big_alloc_loop_label = arm_s->label_counter++;
-
-	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, last_slot,
-				 subtilis_arm_heap_max_slot, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = first_entry;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = last_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
-
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, first_entry, 0, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = bad_label;
+	const subtilis_arm_reg_t ret_val = 0;
+	const subtilis_arm_reg_t requested_size = 1;
+	const subtilis_arm_reg_t free_block = 3;
+	const subtilis_arm_reg_t block_size = 4;
+	const subtilis_arm_reg_t remainder = 5;
+	const subtilis_arm_reg_t scratch = 6;
+	const subtilis_arm_reg_t new_block = 7;
+	const subtilis_arm_reg_t scratch2 = 8;
+
+	size_t loop_label = arm_s->label_counter++;
+	size_t found_label = arm_s->label_counter++;
+	size_t exact_label = arm_s->label_counter++;
+	size_t update_next_label = arm_s->label_counter++;
 
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, size_of_block,
-				   first_entry, 0, false, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_cmp(arm_s, SUBTILIS_ARM_INSTR_CMP,
-			     SUBTILIS_ARM_CCODE_AL, size_of_block,
-			     requested_size, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_GE, false,
-				 block_size, requested_size, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_GE;
-	br->link = false;
-	br->target.label = slot12_alloc_label;
-
-	subtilis_arm_section_add_label(arm_s, big_alloc_loop_label, err);
+				   SUBTILIS_ARM_CCODE_AL, free_block,
+				   heap_start, prv_large_slot(arm_s) * 4,
+				   false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, block_size,
-				   first_entry, 4, false, err);
+	subtilis_arm_section_add_label(arm_s, loop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
 	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, block_size, 0, err);
+				 SUBTILIS_ARM_CCODE_AL, free_block, 0, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, bad_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = bad_label;
-
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, size_of_block,
-				   block_size, 0, false, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_cmp(arm_s, SUBTILIS_ARM_INSTR_CMP,
-			     SUBTILIS_ARM_CCODE_AL, size_of_block,
-			     requested_size, err);
+				   SUBTILIS_ARM_CCODE_AL, block_size,
+				   free_block, 0, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_BIC,
+				  SUBTILIS_ARM_CCODE_AL, false, block_size,
+				  block_size, subtilis_arm_heap_flags, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_GE;
-	br->link = false;
-	br->target.label = move_block_to_start_label;
-
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 first_entry, block_size, err);
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_SUB, SUBTILIS_ARM_CCODE_AL,
+			 true, remainder, block_size, requested_size, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GE, found_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_AL;
-	br->link = false;
-	br->target.label = big_alloc_loop_label;
-}
-
-static void prv_move_block_to_start(subtilis_arm_section_t *arm_s,
-				    size_t good_label, size_t bad_label,
-				    size_t slot12_alloc_label,
-				    subtilis_error_t *err)
-{
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_stran_instr_t *stran;
-	const subtilis_arm_reg_t requested_size = 1;
-	const subtilis_arm_reg_t heap_start = 0;
-	const subtilis_arm_reg_t last_slot = 2;
-	const subtilis_arm_reg_t previous_block = 3;
-	const subtilis_arm_reg_t block_to_move = 5;
-	const subtilis_arm_reg_t next_ptr = 6;
-	const subtilis_arm_reg_t first_block = 7;
-
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, next_ptr,
-				   block_to_move, 4, false, err);
+				   SUBTILIS_ARM_CCODE_AL, free_block,
+				   free_block, 4, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, loop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
 
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = first_block;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = last_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
-
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, next_ptr,
-				   previous_block, 4, false, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, first_block,
-				   block_to_move, 4, false, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = block_to_move;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = last_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
-
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 previous_block, block_to_move, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 block_to_move, requested_size, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_AL;
-	br->link = false;
-	br->target.label = slot12_alloc_label;
-}
-
-static void prv_search_slots(subtilis_arm_section_t *arm_s, size_t good_label,
-			     size_t bad_label, subtilis_error_t *err)
-{
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_stran_instr_t *stran;
-	const subtilis_arm_reg_t heap_start = 0;
-	const subtilis_arm_reg_t next_ptr = 1;
-	const subtilis_arm_reg_t desired_slot = 2;
-	const subtilis_arm_reg_t non_empty_slot = 3;
-	const subtilis_arm_reg_t next_slot = 4;
-
-	size_t search_slots_loop_label = arm_s->label_counter++;
-
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false, next_slot,
-				 desired_slot, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_section_add_label(arm_s, search_slots_loop_label, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, next_slot,
-				 next_slot, 1, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, next_slot,
-				 subtilis_arm_heap_max_slot, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = bad_label;
+	/*
+	 * The flags are still set from the SUBS.  If the block is an exact
+	 * fit we need to remove it from the list.  Otherwise we shrink it
+	 * and carve the new block off its end.
+	 */
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
+	subtilis_arm_section_add_label(arm_s, found_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
 
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = non_empty_slot;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = next_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
-
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, non_empty_slot, 0, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, exact_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_ORR,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  remainder, subtilis_arm_heap_free_flag, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = search_slots_loop_label;
-
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, next_ptr,
-				   non_empty_slot, 4, false, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, free_block,
+				   0, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, new_block, free_block, remainder, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = next_ptr;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = next_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
-}
-
-static void prv_split_small_block(subtilis_arm_section_t *arm_s,
-				  size_t good_label, subtilis_error_t *err)
-{
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_data_instr_t *datai;
-	subtilis_arm_stran_instr_t *stran;
-	const subtilis_arm_reg_t heap_start = 0;
-	const subtilis_arm_reg_t ret_val = 0;
-	const subtilis_arm_reg_t slot_number = 2;
-	const subtilis_arm_reg_t slot_ptr = 3;
-	const subtilis_arm_reg_t next_slot = 4;
-	const subtilis_arm_reg_t block_size = 5;
-	const subtilis_arm_reg_t min_slot_size = 8;
-	const subtilis_arm_reg_t zero = 9;
 
-	size_t split_up_block_label = arm_s->label_counter++;
-
-	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 min_slot_size, subtilis_arm_heap_min_slot_size,
-				 err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, remainder, new_block,
+				   -4, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, zero, 0,
-				 err);
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_ORR,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  requested_size,
+				  subtilis_arm_heap_prev_free_flag, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_section_add_label(arm_s, split_up_block_label, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, new_block, 0,
+				   false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, next_slot,
-				 next_slot, 1, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, update_next_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = block_size;
-	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
-	datai->op2.op.shift.shift_reg = true;
-	datai->op2.op.shift.reg = min_slot_size;
-	datai->op2.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	datai->op2.op.shift.shift.reg = next_slot;
+	/*
+	 * The block before a free large block is never itself a free large
+	 * block, so there are no flags to preserve.
+	 */
 
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, block_size, slot_ptr,
-				   0, false, err);
+	subtilis_arm_section_add_label(arm_s, exact_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	prv_unlink_large_block(arm_s, free_block, scratch, scratch2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = slot_ptr;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = next_slot;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, zero, slot_ptr, 4,
-				   false, err);
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, requested_size,
+				   free_block, 0, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_ADD, err);
+	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false,
+				 new_block, free_block, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = slot_ptr;
-	datai->op1 = slot_ptr;
-	datai->op2.type = SUBTILIS_ARM_OP2_REG;
-	datai->op2.op.reg = block_size;
 
-	subtilis_arm_add_cmp(arm_s, SUBTILIS_ARM_INSTR_CMP,
-			     SUBTILIS_ARM_CCODE_AL, next_slot, slot_number,
-			     err);
+	/*
+	 * The block that follows the new block no longer follows a free
+	 * block.
+	 */
+
+	subtilis_arm_section_add_label(arm_s, update_next_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_LDR, SUBTILIS_ARM_CCODE_AL,
+			  scratch, new_block, requested_size, 0, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_GT;
-	br->link = false;
-	br->target.label = split_up_block_label;
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_BIC,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  scratch, subtilis_arm_heap_prev_free_flag,
+				  err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
 
-	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
-				   SUBTILIS_ARM_CCODE_AL, block_size, slot_ptr,
-				   0, false, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_STR, SUBTILIS_ARM_CCODE_AL,
+			  scratch, new_block, requested_size, 0, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
 	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, ret_val,
-				 slot_ptr, 8, err);
+				 new_block, 8, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	/* We fallthrough to good label here. */
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, good_label, err);
 }
 
 /*
@@ -1185,34 +881,27 @@ static void prv_split_small_block(subtilis_arm_section_t *arm_s,
  * R0 - start of heap
  * R1 - size of block to allocate
  *
- * If this function detects an error it generates a branch to bad_label.  If
- * it is successful it generates a branch to good_label.
+ * R0-R10 are corrupted.  If this function detects an error it generates a
+ * branch to bad_label.  If it is successful it generates a branch to
+ * good_label.
  */
 
 void subtilis_arm_heap_alloc(subtilis_arm_section_t *arm_s, size_t good_label,
 			     size_t bad_label, subtilis_error_t *err)
 {
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_data_instr_t *datai;
-	subtilis_arm_stran_instr_t *stran;
 	const subtilis_arm_reg_t heap_start = 0;
 	const subtilis_arm_reg_t ret_val = 0;
 	const subtilis_arm_reg_t requested_size = 1;
 	const subtilis_arm_reg_t slot_number = 2;
-	const subtilis_arm_reg_t scratch1 = 3;
 	const subtilis_arm_reg_t first_entry = 3;
+	const subtilis_arm_reg_t scratch1 = 3;
 	const subtilis_arm_reg_t next_ptr = 4;
-	const subtilis_arm_reg_t block_size = 5;
-	const subtilis_arm_reg_t scratch2 = 6;
+	const subtilis_arm_reg_t min_slot_size = 4;
 	const subtilis_arm_reg_t scratch = 10;
 
-	size_t big_alloc_label = arm_s->label_counter++;
-	size_t search_slots_label = arm_s->label_counter++;
-	size_t slot12_alloc_label = arm_s->label_counter++;
-	size_t exact_slot_size_label = arm_s->label_counter++;
-	size_t split_slot12_block_label = arm_s->label_counter++;
-	size_t move_block_to_start_label = arm_s->label_counter++;
+	size_t large_alloc_label = arm_s->label_counter++;
+	size_t refill_label = arm_s->label_counter++;
+	size_t pop_label = arm_s->label_counter++;
 
 	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
 				 requested_size, requested_size, 8, err);
@@ -1238,49 +927,29 @@ void subtilis_arm_heap_alloc(subtilis_arm_section_t *arm_s, size_t good_label,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false, scratch,
-				 requested_size, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	prv_get_slot(arm_s, scratch, slot_number, scratch1, err);
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, requested_size,
+				 prv_max_small_size(arm_s), err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, slot_number,
-				 subtilis_arm_heap_max_slot, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GT, large_alloc_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_size_to_slot(arm_s, requested_size, slot_number, scratch,
+			 scratch1, pop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_GE;
-	br->link = false;
-	br->target.label = big_alloc_label;
+	/*
+	 * Fast path.  Pop the first block off the size class's list.
+	 */
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_LDR, SUBTILIS_ARM_CCODE_AL,
+			  first_entry, heap_start, slot_number, 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = first_entry;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = slot_number;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
 	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
 				 SUBTILIS_ARM_CCODE_AL, first_entry, 0, err);
@@ -1293,152 +962,279 @@ void subtilis_arm_heap_alloc(subtilis_arm_section_t *arm_s, size_t good_label,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_STR, SUBTILIS_ARM_CCODE_NE,
+			  next_ptr, heap_start, slot_number, 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_NE;
-	stran->dest = next_ptr;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = slot_number;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
 	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_NE, false, ret_val,
 				 first_entry, 8, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_NE, good_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_NE;
-	br->link = false;
-	br->target.label = good_label;
+	/*
+	 * The size class is empty.  Try splitting a block from a larger
+	 * size class before resorting to the large block slot.
+	 */
 
-	subtilis_arm_add_stran_imm(
-	    arm_s, SUBTILIS_ARM_INSTR_LDR, SUBTILIS_ARM_CCODE_AL, first_entry,
-	    heap_start, subtilis_arm_heap_max_slot * sizeof(int32_t), false,
-	    err);
+	prv_search_slots(arm_s, refill_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, first_entry, 0, err);
+	prv_split_small_block(arm_s, good_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	/*
+	 * All the size classes we could use are empty so we carve a block
+	 * of the size class's size out of a large block.
+	 */
+
+	subtilis_arm_section_add_label(arm_s, refill_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = search_slots_label;
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
+				 min_slot_size, subtilis_arm_heap_min_slot_size,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
 
-	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 block_size, slot_number,
-				 subtilis_arm_heap_min_slot_shift, err);
+	prv_add_mov_shift(arm_s, SUBTILIS_ARM_CCODE_AL, requested_size,
+			  min_slot_size, SUBTILIS_ARM_SHIFT_LSL, true,
+			  slot_number, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, scratch2,
-				 1, err);
+	subtilis_arm_section_add_label(arm_s, large_alloc_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
+	prv_large_alloc(arm_s, good_label, bad_label, err);
+}
+
+/*
+ * Returns the large block, block, whose size, including its flags, is
+ * in size_flags to the large block slot, merging it with its neighbours
+ * if they're also free.
+ */
+
+static void prv_large_free(subtilis_arm_section_t *arm_s,
+			   subtilis_arm_reg_t heap_start,
+			   subtilis_arm_reg_t block,
+			   subtilis_arm_reg_t size_flags,
+			   subtilis_arm_reg_t block_size, subtilis_error_t *err)
+{
+	const subtilis_arm_reg_t next_block = 5;
+	const subtilis_arm_reg_t scratch = 6;
+	const subtilis_arm_reg_t scratch2 = 7;
+	const subtilis_arm_reg_t scratch3 = 8;
+	int32_t slot_offset = prv_large_slot(arm_s) * 4;
+
+	size_t no_next_label = arm_s->label_counter++;
+	size_t no_prev_label = arm_s->label_counter++;
+	size_t set_size_label = arm_s->label_counter++;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, next_block, block, block_size, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, next_block,
+				   0, false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = block_size;
-	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
-	datai->op2.op.shift.shift_reg = true;
-	datai->op2.op.shift.reg = scratch2;
-	datai->op2.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	datai->op2.op.shift.shift.reg = block_size;
 
-	subtilis_arm_section_add_label(arm_s, slot12_alloc_label, err);
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_TST,
+				 SUBTILIS_ARM_CCODE_AL, scratch,
+				 subtilis_arm_heap_free_flag, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_slot12_alloc(arm_s, good_label, bad_label, exact_slot_size_label,
-			 err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, no_next_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_section_add_label(arm_s, split_slot12_block_label, err);
+	/*
+	 * The next block is free.  Remove it from the list and absorb it.
+	 */
+
+	prv_unlink_large_block(arm_s, next_block, scratch2, scratch3, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_split_slot12_block(arm_s, split_slot12_block_label,
-			       exact_slot_size_label, err);
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_BIC,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  scratch, subtilis_arm_heap_flags, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_section_add_label(arm_s, exact_slot_size_label, err);
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, block_size, block_size, scratch, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_exact_slot_size(arm_s, good_label, err);
+	subtilis_arm_section_add_label(arm_s, no_next_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_section_add_label(arm_s, big_alloc_label, err);
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_TST,
+				 SUBTILIS_ARM_CCODE_AL, size_flags,
+				 subtilis_arm_heap_prev_free_flag, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_big_alloc(arm_s, good_label, bad_label, slot12_alloc_label,
-		      move_block_to_start_label, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, no_prev_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_section_add_label(arm_s, move_block_to_start_label, err);
+	/*
+	 * The previous block is free.  It's already on the list so we just
+	 * need to make it bigger.
+	 */
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, block, -4,
+				   false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_move_block_to_start(arm_s, good_label, bad_label,
-				slot12_alloc_label, err);
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_SUB, SUBTILIS_ARM_CCODE_AL,
+			 false, block, block, scratch, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_section_add_label(arm_s, search_slots_label, err);
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, block_size, block_size, scratch, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_search_slots(arm_s, good_label, bad_label, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, set_size_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_split_small_block(arm_s, good_label, err);
+	/*
+	 * Push the block onto the front of the list.
+	 */
+
+	subtilis_arm_section_add_label(arm_s, no_prev_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, heap_start,
+				   slot_offset, false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, block, 4,
+				   false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, scratch2,
+				 heap_start, slot_offset - 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch2, block, 8,
+				   false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, scratch, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_NE, block, scratch, 8,
+				   false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, block, heap_start,
+				   slot_offset, false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/*
+	 * Write the size of the free block to its first and last words and
+	 * let the block that follows it know that it's free.
+	 */
+
+	subtilis_arm_section_add_label(arm_s, set_size_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_ORR,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  block_size, subtilis_arm_heap_free_flag, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, block, 0,
+				   false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, next_block, block, block_size, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, block_size,
+				   next_block, -4, false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, next_block,
+				   0, false, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_ORR,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  scratch, subtilis_arm_heap_prev_free_flag,
+				  err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
+				   SUBTILIS_ARM_CCODE_AL, scratch, next_block,
+				   0, false, err);
 }
 
+/*
+ * Inline function that returns block to the heap.  heap_start and block
+ * must not be any of R3-R9, which are corrupted.
+ */
+
 void subtilis_arm_heap_free(subtilis_arm_section_t *arm_s,
 			    subtilis_arm_reg_t heap_start,
 			    subtilis_arm_reg_t block, subtilis_error_t *err)
 {
-	subtilis_arm_stran_instr_t *stran;
-	subtilis_arm_instr_t *instr;
-	const subtilis_arm_reg_t block_size = 3;
+	const subtilis_arm_reg_t size_flags = 3;
+	const subtilis_arm_reg_t block_size = 4;
 	const subtilis_arm_reg_t ptr = 4;
 	const subtilis_arm_reg_t slot_number = 8;
 	const subtilis_arm_reg_t scratch = 9;
+	const subtilis_arm_reg_t scratch2 = 5;
+
+	size_t push_label = arm_s->label_counter++;
+	size_t large_free_label = arm_s->label_counter++;
+	size_t done_label = arm_s->label_counter++;
 
 	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, block,
 				 block, 8, err);
@@ -1446,69 +1242,67 @@ void subtilis_arm_heap_free(subtilis_arm_section_t *arm_s,
 		return;
 
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
-				   SUBTILIS_ARM_CCODE_AL, block_size, block, 0,
+				   SUBTILIS_ARM_CCODE_AL, size_flags, block, 0,
 				   false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	prv_get_slot(arm_s, block_size, slot_number, scratch, err);
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_BIC,
+				  SUBTILIS_ARM_CCODE_AL, false, block_size,
+				  size_flags, subtilis_arm_heap_flags, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
 	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
-				 SUBTILIS_ARM_CCODE_AL, slot_number,
-				 subtilis_arm_heap_max_slot, err);
+				 SUBTILIS_ARM_CCODE_AL, block_size,
+				 prv_max_small_size(arm_s), err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_GT, false,
-				 slot_number, subtilis_arm_heap_max_slot, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GT, large_free_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
+	prv_size_to_slot(arm_s, block_size, slot_number, scratch2, scratch,
+			 push_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
 
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = ptr;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = slot_number;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
-
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_STR, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_LDR, SUBTILIS_ARM_CCODE_AL,
+			  ptr, heap_start, slot_number, 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
 
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = block;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = slot_number;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_STR, SUBTILIS_ARM_CCODE_AL,
+			  block, heap_start, slot_number, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
 
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_STR,
 				   SUBTILIS_ARM_CCODE_AL, ptr, block, 4, false,
 				   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, done_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, large_free_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_large_free(arm_s, heap_start, block, size_flags, block_size, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, done_label, err);
 }
 
+/*
+ * Sums the sizes of all the free blocks in all the slots.
+ */
+
 void subtilis_arm_heap_free_space(subtilis_arm_section_t *arm_s,
 				  subtilis_arm_reg_t heap_start,
 				  subtilis_arm_reg_t result,
@@ -1517,10 +1311,6 @@ void subtilis_arm_heap_free_space(subtilis_arm_section_t *arm_s,
 	size_t outer_loop_label;
 	size_t inner_loop_label;
 	size_t skip_label;
-	subtilis_arm_stran_instr_t *stran;
-	subtilis_arm_br_instr_t *br;
-	subtilis_arm_instr_t *instr;
-	subtilis_arm_data_instr_t *datai;
 	const subtilis_arm_reg_t ptr = 0;
 	const subtilis_arm_reg_t slots_counter = 1;
 	const subtilis_arm_reg_t scratch = 2;
@@ -1536,8 +1326,7 @@ void subtilis_arm_heap_free_space(subtilis_arm_section_t *arm_s,
 		return;
 
 	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false,
-				 slots_counter, subtilis_arm_heap_max_slot,
-				 err);
+				 slots_counter, prv_large_slot(arm_s), err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
@@ -1545,24 +1334,10 @@ void subtilis_arm_heap_free_space(subtilis_arm_section_t *arm_s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_LDR, err);
+	prv_add_stran_reg(arm_s, SUBTILIS_ARM_INSTR_LDR, SUBTILIS_ARM_CCODE_AL,
+			  ptr, heap_start, slots_counter, 2, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	stran = &instr->operands.stran;
-
-	stran->ccode = SUBTILIS_ARM_CCODE_AL;
-	stran->dest = ptr;
-	stran->base = heap_start;
-	stran->offset.type = SUBTILIS_ARM_OP2_SHIFTED;
-	stran->offset.op.shift.reg = slots_counter;
-	stran->offset.op.shift.type = SUBTILIS_ARM_SHIFT_LSL;
-	stran->offset.op.shift.shift.integer = 2;
-	stran->offset.op.shift.shift_reg = false;
-	stran->pre_indexed = true;
-	stran->write_back = false;
-	stran->subtract = false;
-	stran->byte = false;
 
 	subtilis_arm_section_add_label(arm_s, inner_loop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
@@ -1573,33 +1348,26 @@ void subtilis_arm_heap_free_space(subtilis_arm_section_t *arm_s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, skip_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_EQ;
-	br->link = false;
-	br->target.label = skip_label;
-
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
 				   SUBTILIS_ARM_CCODE_AL, scratch, ptr, 0,
 				   false, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_ADD, err);
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_BIC,
+				  SUBTILIS_ARM_CCODE_AL, false, scratch,
+				  scratch, subtilis_arm_heap_flags, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, SUBTILIS_ARM_CCODE_AL,
+			 false, sum, sum, scratch, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
-	datai = &instr->operands.data;
-	datai->ccode = SUBTILIS_ARM_CCODE_AL;
-	datai->status = false;
-	datai->dest = sum;
-	datai->op1 = sum;
-	datai->op2.type = SUBTILIS_ARM_OP2_REG;
-	datai->op2.op.reg = scratch;
 
 	subtilis_arm_add_stran_imm(arm_s, SUBTILIS_ARM_INSTR_LDR,
 				   SUBTILIS_ARM_CCODE_AL, ptr, ptr, 4, false,
@@ -1607,16 +1375,10 @@ void subtilis_arm_heap_free_space(subtilis_arm_section_t *arm_s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, inner_loop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_AL;
-	br->link = false;
-	br->target.label = inner_loop_label;
-
 	subtilis_arm_section_add_label(arm_s, skip_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
@@ -1626,16 +1388,10 @@ void subtilis_arm_heap_free_space(subtilis_arm_section_t *arm_s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	instr =
-	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_PL, outer_loop_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	br = &instr->operands.br;
-	br->ccode = SUBTILIS_ARM_CCODE_PL;
-	br->link = false;
-	br->target.label = outer_loop_label;
-
 	subtilis_arm_add_mov_reg(arm_s, SUBTILIS_ARM_CCODE_AL, false, result,
 				 sum, err);
 }
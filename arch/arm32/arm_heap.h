@@ -19,7 +19,15 @@
 
 #include "arm_core.h"
 
-const uint32_t subtilis_arm_heap_min_size(void);
+/*
+ * The maximum number of slots a heap can be configured with.  The number
+ * of slots used by a program is specified by the heap_slots setting.  All
+ * but the last slot are power of 2 size classes, starting at 32 bytes.
+ */
+
+#define SUBTILIS_ARM_HEAP_MAX_SLOTS 20
+
+const uint32_t subtilis_arm_heap_min_size(uint32_t slots);
 void subtilis_arm_heap_init(subtilis_arm_section_t *arm_s,
 			    subtilis_error_t *err);
 void subtilis_arm_heap_alloc(subtilis_arm_section_t *arm_s, size_t good_label,
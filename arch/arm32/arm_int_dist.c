@@ -96,7 +96,10 @@ static void prv_dist_mul_instr(void *user_data, subtilis_arm_op_t *op,
 		return;
 	}
 
-	if (instr->dest == ud->reg_num) {
+	if ((instr->dest == ud->reg_num) ||
+	    (((type == SUBTILIS_ARM_INSTR_SMULL) ||
+	      (type == SUBTILIS_ARM_INSTR_UMULL)) &&
+	     (instr->rn == ud->reg_num))) {
 		ud->last_used = -1;
 		subtilis_error_set_walker_failed(err);
 		return;
@@ -602,6 +605,21 @@ static void prv_dist_signx_instr(void *user_data, subtilis_arm_op_t *op,
 	ud->last_used++;
 }
 
+static void prv_dist_pld_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_pld_instr_t *instr,
+			       subtilis_error_t *err)
+{
+	subtilis_dist_data_t *ud = user_data;
+
+	if (instr->base == ud->reg_num) {
+		subtilis_error_set_walker_failed(err);
+		return;
+	}
+
+	ud->last_used++;
+}
+
 void subtilis_init_int_dist_walker(subtlis_arm_walker_t *walker,
 				   void *user_data)
 {
@@ -642,6 +660,7 @@ void subtilis_init_int_dist_walker(subtlis_arm_walker_t *walker,
 	walker->stran_misc_fn = NULL;
 	walker->simd_fn = NULL;
 	walker->signx_fn = prv_dist_signx_instr;
+	walker->pld_fn = prv_dist_pld_instr;
 }
 
 static void prv_used_mov_instr(void *user_data, subtilis_arm_op_t *op,
@@ -683,7 +702,10 @@ static void prv_used_mul_instr(void *user_data, subtilis_arm_op_t *op,
 {
 	subtilis_dist_data_t *ud = user_data;
 
-	if (instr->dest == ud->reg_num) {
+	if ((instr->dest == ud->reg_num) ||
+	    (((type == SUBTILIS_ARM_INSTR_SMULL) ||
+	      (type == SUBTILIS_ARM_INSTR_UMULL)) &&
+	     (instr->rn == ud->reg_num))) {
 		ud->last_used = -1;
 		subtilis_error_set_walker_failed(err);
 		return;
@@ -879,6 +901,16 @@ static void prv_used_signx_instr(void *user_data, subtilis_arm_op_t *op,
 	ud->last_used++;
 }
 
+static void prv_used_pld_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_pld_instr_t *instr,
+			       subtilis_error_t *err)
+{
+	subtilis_dist_data_t *ud = user_data;
+
+	ud->last_used++;
+}
+
 void subtilis_init_int_used_walker(subtlis_arm_walker_t *walker,
 				   void *user_data)
 {
@@ -919,4 +951,5 @@ void subtilis_init_int_used_walker(subtlis_arm_walker_t *walker,
 	walker->stran_misc_fn = NULL;
 	walker->simd_fn = NULL;
 	walker->signx_fn = prv_used_signx_instr;
+	walker->pld_fn = prv_used_pld_instr;
 }
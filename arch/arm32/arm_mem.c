@@ -621,6 +621,18 @@ void subtilis_arm_mem_memcpy(subtilis_ir_section_t *s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	/*
+	 * On ARMv6 we ask the cache to start fetching the source a couple of
+	 * blocks ahead of the LDM.  PLD never faults, so it doesn't matter if
+	 * we prefetch past the end of the buffer.
+	 */
+
+	if (arm_s->fp_if && arm_s->fp_if->armv6) {
+		subtilis_arm_add_pld(arm_s, src_reg, 64, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
 	subtilis_arm_add_mtran(arm_s, SUBTILIS_ARM_INSTR_LDM,
 			       SUBTILIS_ARM_CCODE_AL, src_reg, 255 << 2,
 			       SUBTILIS_ARM_MTRAN_IA, true, false, err);
@@ -855,6 +867,16 @@ void subtilis_arm_mem_memcmp(subtilis_ir_section_t *s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	if (arm_s->fp_if && arm_s->fp_if->armv6) {
+		subtilis_arm_add_pld(arm_s, a1_reg, 64, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		subtilis_arm_add_pld(arm_s, a2_reg, 64, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
 	subtilis_arm_add_mtran(arm_s, SUBTILIS_ARM_INSTR_LDM,
 			       SUBTILIS_ARM_CCODE_AL, a1_reg, 0x3c,
 			       SUBTILIS_ARM_MTRAN_IA, true, false, err);
@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arm_op_regs.h"
+
+static void prv_add_reg(subtilis_arm_op_regs_t *regs, subtilis_arm_reg_t reg,
+			subtilis_error_t *err)
+{
+	if (regs->count == SUBTILIS_ARM_OP_MAX_REGS) {
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+
+	regs->regs[regs->count++] = reg;
+}
+
+static void prv_add_op2(subtilis_arm_op_regs_t *regs, subtilis_arm_op2_t *op2,
+			subtilis_error_t *err)
+{
+	if (op2->type == SUBTILIS_ARM_OP2_REG) {
+		prv_add_reg(regs, op2->op.reg, err);
+	} else if (op2->type == SUBTILIS_ARM_OP2_SHIFTED) {
+		prv_add_reg(regs, op2->op.shift.reg, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		if (op2->op.shift.shift_reg)
+			prv_add_reg(regs, op2->op.shift.shift.reg, err);
+	}
+}
+
+static void prv_add_fpa_op2(subtilis_arm_op_regs_t *regs, bool immediate,
+			    subtilis_fpa_op2_t *op2, subtilis_error_t *err)
+{
+	if (!immediate)
+		prv_add_reg(regs, op2->reg, err);
+}
+
+static void prv_regs_label(void *user_data, subtilis_arm_op_t *op, size_t label,
+			   subtilis_error_t *err)
+{
+}
+
+static void prv_regs_directive(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_error_t *err)
+{
+}
+
+static void prv_regs_data_instr(void *user_data, subtilis_arm_op_t *op,
+				subtilis_arm_instr_type_t type,
+				subtilis_arm_data_instr_t *instr,
+				subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_op2(regs, &instr->op2, err);
+}
+
+static void prv_regs_mul_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_mul_instr_t *instr,
+			       subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->rm, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->rs, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->rn, err);
+}
+
+static void prv_regs_stran_instr(void *user_data, subtilis_arm_op_t *op,
+				 subtilis_arm_instr_type_t type,
+				 subtilis_arm_stran_instr_t *instr,
+				 subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->base, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_op2(regs, &instr->offset, err);
+}
+
+static void prv_regs_mtran_instr(void *user_data, subtilis_arm_op_t *op,
+				 subtilis_arm_instr_type_t type,
+				 subtilis_arm_mtran_instr_t *instr,
+				 subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->op0, err);
+}
+
+static void prv_regs_br_instr(void *user_data, subtilis_arm_op_t *op,
+			      subtilis_arm_instr_type_t type,
+			      subtilis_arm_br_instr_t *instr,
+			      subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	if (instr->indirect)
+		prv_add_reg(regs, instr->target.reg, err);
+}
+
+static void prv_regs_swi_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_swi_instr_t *instr,
+			       subtilis_error_t *err)
+{
+}
+
+static void prv_regs_ldrc_instr(void *user_data, subtilis_arm_op_t *op,
+				subtilis_arm_instr_type_t type,
+				subtilis_arm_ldrc_instr_t *instr,
+				subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+}
+
+static void prv_regs_ldrp_instr(void *user_data, subtilis_arm_op_t *op,
+				subtilis_arm_instr_type_t type,
+				subtilis_arm_ldrp_instr_t *instr,
+				subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+}
+
+static void prv_regs_adr_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_adr_instr_t *instr,
+			       subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+}
+
+static void prv_regs_flags_instr(void *user_data, subtilis_arm_op_t *op,
+				 subtilis_arm_instr_type_t type,
+				 subtilis_arm_flags_instr_t *instr,
+				 subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	if (instr->op2_reg)
+		prv_add_reg(regs, instr->op.reg, err);
+}
+
+static void prv_regs_cmov_instr(void *user_data, subtilis_arm_op_t *op,
+				subtilis_arm_instr_type_t type,
+				subtilis_arm_cmov_instr_t *instr,
+				subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op3, err);
+}
+
+static void prv_regs_fpa_data_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_fpa_data_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fpa_op2(regs, instr->immediate, &instr->op2, err);
+}
+
+static void prv_regs_fpa_stran_instr(void *user_data, subtilis_arm_op_t *op,
+				     subtilis_arm_instr_type_t type,
+				     subtilis_fpa_stran_instr_t *instr,
+				     subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->base, err);
+}
+
+static void prv_regs_fpa_tran_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_fpa_tran_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fpa_op2(regs, instr->immediate, &instr->op2, err);
+}
+
+static void prv_regs_fpa_cmp_instr(void *user_data, subtilis_arm_op_t *op,
+				   subtilis_arm_instr_type_t type,
+				   subtilis_fpa_cmp_instr_t *instr,
+				   subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fpa_op2(regs, instr->immediate, &instr->op2, err);
+}
+
+static void prv_regs_fpa_ldrc_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_fpa_ldrc_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+}
+
+static void prv_regs_fpa_cptran_instr(void *user_data, subtilis_arm_op_t *op,
+				      subtilis_arm_instr_type_t type,
+				      subtilis_fpa_cptran_instr_t *instr,
+				      subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+}
+
+static void prv_regs_vfp_stran_instr(void *user_data, subtilis_arm_op_t *op,
+				     subtilis_arm_instr_type_t type,
+				     subtilis_vfp_stran_instr_t *instr,
+				     subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->base, err);
+}
+
+static void prv_regs_vfp_copy_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_vfp_copy_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->src, err);
+}
+
+static void prv_regs_vfp_ldrc_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_vfp_ldrc_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+}
+
+static void prv_regs_vfp_tran_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_vfp_tran_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->src, err);
+}
+
+static void prv_regs_vfp_tran_dbl_instr(void *user_data, subtilis_arm_op_t *op,
+					subtilis_arm_instr_type_t type,
+					subtilis_vfp_tran_dbl_instr_t *instr,
+					subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->dest2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->src1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->src2, err);
+}
+
+static void prv_regs_vfp_cptran_instr(void *user_data, subtilis_arm_op_t *op,
+				      subtilis_arm_instr_type_t type,
+				      subtilis_vfp_cptran_instr_t *instr,
+				      subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->src, err);
+}
+
+static void prv_regs_vfp_data_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_vfp_data_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op2, err);
+}
+
+static void prv_regs_vfp_cmp_instr(void *user_data, subtilis_arm_op_t *op,
+				   subtilis_arm_instr_type_t type,
+				   subtilis_vfp_cmp_instr_t *instr,
+				   subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op2, err);
+}
+
+static void prv_regs_vfp_sqrt_instr(void *user_data, subtilis_arm_op_t *op,
+				    subtilis_arm_instr_type_t type,
+				    subtilis_vfp_sqrt_instr_t *instr,
+				    subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+}
+
+static void prv_regs_vfp_sysreg_instr(void *user_data, subtilis_arm_op_t *op,
+				      subtilis_arm_instr_type_t type,
+				      subtilis_vfp_sysreg_instr_t *instr,
+				      subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->arm_reg, err);
+}
+
+static void prv_regs_vfp_cvt_instr(void *user_data, subtilis_arm_op_t *op,
+				   subtilis_arm_instr_type_t type,
+				   subtilis_vfp_cvt_instr_t *instr,
+				   subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+}
+
+static void prv_regs_stran_misc_instr(void *user_data, subtilis_arm_op_t *op,
+				      subtilis_arm_instr_type_t type,
+				      subtilis_arm_stran_misc_instr_t *instr,
+				      subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->base, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (instr->reg_offset)
+		prv_add_reg(regs, instr->offset.reg, err);
+}
+
+static void prv_regs_simd_instr(void *user_data, subtilis_arm_op_t *op,
+				subtilis_arm_instr_type_t type,
+				subtilis_arm_reg_only_instr_t *instr,
+				subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op2, err);
+}
+
+static void prv_regs_signx_instr(void *user_data, subtilis_arm_op_t *op,
+				 subtilis_arm_instr_type_t type,
+				 subtilis_arm_signx_instr_t *instr,
+				 subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->dest, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_reg(regs, instr->op1, err);
+}
+
+static void prv_regs_pld_instr(void *user_data, subtilis_arm_op_t *op,
+			       subtilis_arm_instr_type_t type,
+			       subtilis_arm_pld_instr_t *instr,
+			       subtilis_error_t *err)
+{
+	subtilis_arm_op_regs_t *regs = user_data;
+
+	prv_add_reg(regs, instr->base, err);
+}
+
+void subtilis_init_op_regs_walker(subtlis_arm_walker_t *walker,
+				  subtilis_arm_op_regs_t *regs)
+{
+	walker->user_data = regs;
+	walker->label_fn = prv_regs_label;
+	walker->directive_fn = prv_regs_directive;
+	walker->data_fn = prv_regs_data_instr;
+	walker->mul_fn = prv_regs_mul_instr;
+	walker->cmp_fn = prv_regs_data_instr;
+	walker->mov_fn = prv_regs_data_instr;
+	walker->stran_fn = prv_regs_stran_instr;
+	walker->mtran_fn = prv_regs_mtran_instr;
+	walker->br_fn = prv_regs_br_instr;
+	walker->swi_fn = prv_regs_swi_instr;
+	walker->ldrc_fn = prv_regs_ldrc_instr;
+	walker->ldrp_fn = prv_regs_ldrp_instr;
+	walker->adr_fn = prv_regs_adr_instr;
+	walker->cmov_fn = prv_regs_cmov_instr;
+	walker->flags_fn = prv_regs_flags_instr;
+	walker->fpa_data_monadic_fn = prv_regs_fpa_data_instr;
+	walker->fpa_data_dyadic_fn = prv_regs_fpa_data_instr;
+	walker->fpa_stran_fn = prv_regs_fpa_stran_instr;
+	walker->fpa_tran_fn = prv_regs_fpa_tran_instr;
+	walker->fpa_cmp_fn = prv_regs_fpa_cmp_instr;
+	walker->fpa_ldrc_fn = prv_regs_fpa_ldrc_instr;
+	walker->fpa_cptran_fn = prv_regs_fpa_cptran_instr;
+	walker->vfp_stran_fn = prv_regs_vfp_stran_instr;
+	walker->vfp_copy_fn = prv_regs_vfp_copy_instr;
+	walker->vfp_ldrc_fn = prv_regs_vfp_ldrc_instr;
+	walker->vfp_tran_fn = prv_regs_vfp_tran_instr;
+	walker->vfp_tran_dbl_fn = prv_regs_vfp_tran_dbl_instr;
+	walker->vfp_cptran_fn = prv_regs_vfp_cptran_instr;
+	walker->vfp_data_fn = prv_regs_vfp_data_instr;
+	walker->vfp_cmp_fn = prv_regs_vfp_cmp_instr;
+	walker->vfp_sqrt_fn = prv_regs_vfp_sqrt_instr;
+	walker->vfp_sysreg_fn = prv_regs_vfp_sysreg_instr;
+	walker->vfp_cvt_fn = prv_regs_vfp_cvt_instr;
+	walker->stran_misc_fn = prv_regs_stran_misc_instr;
+	walker->simd_fn = prv_regs_simd_instr;
+	walker->signx_fn = prv_regs_signx_instr;
+	walker->pld_fn = prv_regs_pld_instr;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBTILIS_ARM_OP_REGS_H
+#define __SUBTILIS_ARM_OP_REGS_H
+
+#include "arm_walker.h"
+
+#define SUBTILIS_ARM_OP_MAX_REGS 8
+
+/*
+ * Collects the register operands explicitly named by a single
+ * instruction.  The list makes no distinction between integer and
+ * floating point registers and may contain duplicates.  Registers
+ * implicitly used by an instruction, e.g., the SWI register masks,
+ * are not included.
+ */
+
+struct subtilis_arm_op_regs_t_ {
+	subtilis_arm_reg_t regs[SUBTILIS_ARM_OP_MAX_REGS];
+	size_t count;
+};
+
+typedef struct subtilis_arm_op_regs_t_ subtilis_arm_op_regs_t;
+
+void subtilis_init_op_regs_walker(subtlis_arm_walker_t *walker,
+				  subtilis_arm_op_regs_t *regs);
+
+#endif
@@ -14,108 +14,1483 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+
 #include "arm_peephole.h"
 
 /*
- * The world's worst peephole optimizer with a window size of 1!
- * You've got to start somwhere.
+ * The peephole optimiser runs once register allocation is complete and the
+ * stack frame has been finalised.  It makes a single pass over the
+ * section, offering each instruction to the rules registered for its type.
+ * The integer rules live in the table below.  The floating point rules are
+ * supplied by the section's fp_if.
+ *
+ * Some of the rules need to know whether a register or the flags are
+ * still needed after an instruction.  These questions are answered by
+ * following the control flow forward from the instruction for a bounded
+ * number of instructions.  Anything the scan does not understand, e.g.,
+ * a call, a SWI or a return, causes the rule to be abandoned.
+ */
+
+/*
+ * Maximum number of instructions examined when searching backwards for
+ * a store to forward and forwards when checking liveness.
+ */
+
+#define SUBTILIS_ARM_PEEPHOLE_WINDOW 32
+
+/*
+ * Maximum number of unconditional branches followed when threading a
+ * branch.
+ */
+
+#define SUBTILIS_ARM_PEEPHOLE_MAX_HOPS 8
+
+/*
+ * Maximum number of LDRs or STRs combined into a single LDM or STM.
  */
 
-static size_t prv_remove_op(subtilis_arm_section_t *arm_s, size_t ptr,
-			    subtilis_arm_op_t *op)
+#define SUBTILIS_ARM_PEEPHOLE_MAX_MERGE 8
+
+/*
+ * Maximum number of instructions on either side of a conditional branch
+ * that may be converted into conditionally executed instructions.  On
+ * ARM2 a skipped instruction costs a single cycle and a taken branch
+ * costs three.
+ */
+
+#define SUBTILIS_ARM_PEEPHOLE_MAX_PREDICATED 4
+
+typedef enum {
+	SUBTILIS_ARM_PEEPHOLE_SCAN_CONTINUE,
+	SUBTILIS_ARM_PEEPHOLE_SCAN_DONE,
+	SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL,
+} subtilis_arm_peephole_scan_t;
+
+typedef subtilis_arm_peephole_scan_t (*subtilis_arm_peephole_scan_fn_t)(
+    subtilis_arm_instr_t *instr, void *data);
+
+size_t subtilis_arm_peephole_remove(subtilis_arm_section_t *arm_s, size_t ptr)
 {
-	size_t next;
-	size_t prev;
+	subtilis_arm_op_t *op = &arm_s->op_pool->ops[ptr];
+	size_t next = op->next;
+	size_t prev = op->prev;
+
+	if (ptr == arm_s->first_op)
+		prev = SIZE_MAX;
+	if (ptr == arm_s->last_op)
+		next = SIZE_MAX;
+
+	if (prev == SIZE_MAX)
+		arm_s->first_op = next;
+	else
+		arm_s->op_pool->ops[prev].next = next;
 
-	if (arm_s->first_op == arm_s->last_op) {
-		arm_s->first_op = SIZE_MAX;
-		arm_s->last_op = SIZE_MAX;
+	if (next == SIZE_MAX)
+		arm_s->last_op = prev;
+	else
+		arm_s->op_pool->ops[next].prev = prev;
+
+	arm_s->len--;
+
+	return next;
+}
+
+size_t subtilis_arm_peephole_label(subtilis_arm_peephole_t *ph, size_t label)
+{
+	if (label >= ph->max_labels)
 		return SIZE_MAX;
+	return ph->labels[label];
+}
+
+static void prv_unref_label(subtilis_arm_peephole_t *ph, size_t label)
+{
+	if ((label < ph->max_labels) && (ph->refs[label] > 0))
+		ph->refs[label]--;
+}
+
+static void prv_ref_label(subtilis_arm_peephole_t *ph, size_t label)
+{
+	if (label < ph->max_labels)
+		ph->refs[label]++;
+}
+
+/*
+ * Returns true if no instruction in the section refers to label.  Labels
+ * that are not defined in the section are assumed to be referenced.
+ */
+
+static bool prv_label_unused(subtilis_arm_peephole_t *ph, size_t label)
+{
+	return (label < ph->max_labels) && (ph->refs[label] == 0);
+}
+
+static bool prv_add_reg(uint32_t *mask, subtilis_arm_reg_t reg)
+{
+	if (reg > 15)
+		return false;
+	*mask |= 1 << reg;
+	return true;
+}
+
+static bool prv_op2_regs(subtilis_arm_op2_t *op2, uint32_t *read)
+{
+	switch (op2->type) {
+	case SUBTILIS_ARM_OP2_REG:
+		return prv_add_reg(read, op2->op.reg);
+	case SUBTILIS_ARM_OP2_SHIFTED:
+		if (op2->op.shift.shift_reg &&
+		    !prv_add_reg(read, op2->op.shift.shift.reg))
+			return false;
+		return prv_add_reg(read, op2->op.shift.reg);
+	default:
+		return true;
 	}
+}
+
+static bool prv_is_data(subtilis_arm_instr_type_t type)
+{
+	return type >= SUBTILIS_ARM_INSTR_AND && type <= SUBTILIS_ARM_INSTR_MVN;
+}
 
-	if (arm_s->first_op == ptr) {
-		arm_s->first_op = op->next;
-		return op->next;
+static bool prv_is_fp(subtilis_arm_instr_type_t type)
+{
+	return type > SUBTILIS_ARM_INSTR_INT_MAX &&
+	       type < SUBTILIS_ARM_INSTR_VFP_MAX;
+}
+
+static bool prv_has_dest(subtilis_arm_instr_type_t type)
+{
+	return type < SUBTILIS_ARM_INSTR_TST || type > SUBTILIS_ARM_INSTR_CMN;
+}
+
+static bool prv_has_op1(subtilis_arm_instr_type_t type)
+{
+	return type != SUBTILIS_ARM_INSTR_MOV && type != SUBTILIS_ARM_INSTR_MVN;
+}
+
+/*
+ * Retrieves the condition code of an instruction.  All of the FPA and VFP
+ * operand structures start with their condition code.  Returns false for
+ * instructions whose operands we don't know how to interpret.
+ */
+
+static bool prv_ccode(subtilis_arm_instr_t *instr,
+		      subtilis_arm_ccode_type_t *ccode)
+{
+	if (prv_is_data(instr->type)) {
+		*ccode = instr->operands.data.ccode;
+		return true;
 	}
 
-	if (arm_s->last_op == ptr) {
-		arm_s->last_op = op->prev;
-		return SIZE_MAX;
+	if (prv_is_fp(instr->type)) {
+		*ccode = instr->operands.fpa_data.ccode;
+		return true;
 	}
 
-	next = op->next;
-	prev = op->prev;
-	arm_s->op_pool->ops[prev].next = next;
-	arm_s->op_pool->ops[next].prev = prev;
-	return next;
+	switch (instr->type) {
+	case SUBTILIS_ARM_INSTR_MUL:
+	case SUBTILIS_ARM_INSTR_MLA:
+		*ccode = instr->operands.mul.ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_LDR:
+	case SUBTILIS_ARM_INSTR_STR:
+		*ccode = instr->operands.stran.ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_LDM:
+	case SUBTILIS_ARM_INSTR_STM:
+		*ccode = instr->operands.mtran.ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_B:
+		*ccode = instr->operands.br.ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_LDRC:
+		*ccode = instr->operands.ldrc.ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_LDRP:
+		*ccode = instr->operands.ldrp.ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_ADR:
+		*ccode = instr->operands.adr.ccode;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
 }
 
-void subtilis_arm_peephole(subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+/*
+ * Computes the masks of the integer registers read and written by instr.
+ * Returns false if the instruction is not understood, in which case the
+ * caller must assume the worst.  Registers written by conditional
+ * instructions are also marked as read as their old values may survive.
+ */
+
+static bool prv_int_regs(subtilis_arm_instr_t *instr, uint32_t *read,
+			 uint32_t *written)
 {
-	subtilis_arm_op_t *op = NULL;
-	size_t ptr;
-	subtilis_arm_instr_t *instr;
 	subtilis_arm_data_instr_t *data;
-	subtilis_fpa_data_instr_t *fpa_data;
-	subtilis_vfp_copy_instr_t *vfp_copy;
+	subtilis_arm_mul_instr_t *mul;
+	subtilis_arm_stran_instr_t *stran;
+	subtilis_arm_mtran_instr_t *mtran;
 	subtilis_fpa_stran_instr_t *fpa_stran;
 	subtilis_vfp_stran_instr_t *vfp_stran;
+	subtilis_arm_ccode_type_t ccode;
+	subtilis_arm_instr_type_t type = instr->type;
+
+	*read = 0;
+	*written = 0;
+
+	if (!prv_ccode(instr, &ccode))
+		return false;
+
+	if (prv_is_data(type)) {
+		data = &instr->operands.data;
+		if (!prv_op2_regs(&data->op2, read))
+			return false;
+		if (prv_has_op1(type) && !prv_add_reg(read, data->op1))
+			return false;
+		if (prv_has_dest(type) && !prv_add_reg(written, data->dest))
+			return false;
+		goto done;
+	}
+
+	switch (type) {
+	case SUBTILIS_ARM_INSTR_MLA:
+		if (!prv_add_reg(read, instr->operands.mul.rn))
+			return false;
+	/* fall through */
+	case SUBTILIS_ARM_INSTR_MUL:
+		mul = &instr->operands.mul;
+		if (!prv_add_reg(read, mul->rm) ||
+		    !prv_add_reg(read, mul->rs) ||
+		    !prv_add_reg(written, mul->dest))
+			return false;
+		break;
+	case SUBTILIS_ARM_INSTR_LDR:
+	case SUBTILIS_ARM_INSTR_STR:
+		stran = &instr->operands.stran;
+		if (!prv_add_reg(read, stran->base) ||
+		    !prv_op2_regs(&stran->offset, read))
+			return false;
+		if (type == SUBTILIS_ARM_INSTR_LDR) {
+			if (!prv_add_reg(written, stran->dest))
+				return false;
+		} else if (!prv_add_reg(read, stran->dest)) {
+			return false;
+		}
+		if ((stran->write_back || !stran->pre_indexed) &&
+		    !prv_add_reg(written, stran->base))
+			return false;
+		break;
+	case SUBTILIS_ARM_INSTR_LDM:
+	case SUBTILIS_ARM_INSTR_STM:
+		mtran = &instr->operands.mtran;
+		if (!prv_add_reg(read, mtran->op0))
+			return false;
+		if (type == SUBTILIS_ARM_INSTR_LDM)
+			*written |= mtran->reg_list & 0xffff;
+		else
+			*read |= mtran->reg_list & 0xffff;
+		if (mtran->write_back && !prv_add_reg(written, mtran->op0))
+			return false;
+		break;
+	case SUBTILIS_ARM_INSTR_B:
+		if (instr->operands.br.link || instr->operands.br.indirect)
+			return false;
+		break;
+	case SUBTILIS_ARM_INSTR_LDRC:
+		if (!prv_add_reg(written, instr->operands.ldrc.dest))
+			return false;
+		break;
+	case SUBTILIS_ARM_INSTR_LDRP:
+		if (!prv_add_reg(written, instr->operands.ldrp.dest))
+			return false;
+		break;
+	case SUBTILIS_ARM_INSTR_ADR:
+		if (!prv_add_reg(written, instr->operands.adr.dest))
+			return false;
+		break;
+	case SUBTILIS_FPA_INSTR_LDF:
+	case SUBTILIS_FPA_INSTR_STF:
+		fpa_stran = &instr->operands.fpa_stran;
+		if (!prv_add_reg(read, fpa_stran->base))
+			return false;
+		if ((fpa_stran->write_back || !fpa_stran->pre_indexed) &&
+		    !prv_add_reg(written, fpa_stran->base))
+			return false;
+		break;
+	case SUBTILIS_VFP_INSTR_FSTS:
+	case SUBTILIS_VFP_INSTR_FLDS:
+	case SUBTILIS_VFP_INSTR_FSTD:
+	case SUBTILIS_VFP_INSTR_FLDD:
+		vfp_stran = &instr->operands.vfp_stran;
+		if (!prv_add_reg(read, vfp_stran->base))
+			return false;
+		if ((vfp_stran->write_back || !vfp_stran->pre_indexed) &&
+		    !prv_add_reg(written, vfp_stran->base))
+			return false;
+		break;
+
+	/*
+	 * The remaining FPA and VFP instructions that transfer data
+	 * between the integer and floating point registers.
+	 */
+
+	case SUBTILIS_FPA_INSTR_FLT:
+	case SUBTILIS_FPA_INSTR_FIX:
+	case SUBTILIS_FPA_INSTR_WFS:
+	case SUBTILIS_FPA_INSTR_RFS:
+	case SUBTILIS_VFP_INSTR_FMSR:
+	case SUBTILIS_VFP_INSTR_FMRS:
+	case SUBTILIS_VFP_INSTR_FMXR:
+	case SUBTILIS_VFP_INSTR_FMRX:
+	case SUBTILIS_VFP_INSTR_FMDRR:
+	case SUBTILIS_VFP_INSTR_FMRRD:
+	case SUBTILIS_VFP_INSTR_FMSRR:
+	case SUBTILIS_VFP_INSTR_FMRRS:
+		return false;
+	default:
+		if (!prv_is_fp(type))
+			return false;
+		break;
+	}
+
+done:
+
+	if (ccode != SUBTILIS_ARM_CCODE_AL)
+		*read |= *written;
+
+	return true;
+}
+
+/*
+ * Follows the paths leading from the op at ptr, calling fn for each
+ * instruction encountered, until fn reports that it is done with every
+ * path.  Returns false if fn fails on any path, if a path leaves the
+ * section or if the search exceeds its budget.
+ */
+
+static bool prv_scan(subtilis_arm_peephole_t *ph, size_t ptr,
+		     subtilis_arm_peephole_scan_fn_t fn, void *data,
+		     size_t *budget)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_br_instr_t *br;
+	subtilis_arm_peephole_scan_t res;
+	size_t target;
 
-	ptr = arm_s->first_op;
 	while (ptr != SIZE_MAX) {
-		op = &arm_s->op_pool->ops[ptr];
+		if (*budget == 0)
+			return false;
+		(*budget)--;
 
-		if (op->type != SUBTILIS_ARM_OP_INSTR) {
+		op = &ph->arm_s->op_pool->ops[ptr];
+		if (op->type == SUBTILIS_ARM_OP_LABEL) {
 			ptr = op->next;
 			continue;
 		}
 
-		instr = &op->op.instr;
-		switch (instr->type) {
-		case SUBTILIS_ARM_INSTR_MOV:
-			data = &instr->operands.data;
-			if ((data->op2.type == SUBTILIS_ARM_OP2_REG) &&
-			    (data->op2.op.reg == data->dest) &&
-			    (data->dest != 15)) {
-				ptr = prv_remove_op(arm_s, ptr, op);
-				continue;
-			}
-			break;
-		case SUBTILIS_FPA_INSTR_MVF:
-			fpa_data = &instr->operands.fpa_data;
-			if (!fpa_data->immediate &&
-			    fpa_data->op2.reg == fpa_data->dest) {
-				ptr = prv_remove_op(arm_s, ptr, op);
-				continue;
-			}
-			break;
-		case SUBTILIS_VFP_INSTR_FCPYD:
-			vfp_copy = &instr->operands.vfp_copy;
-			if (vfp_copy->src == vfp_copy->dest) {
-				ptr = prv_remove_op(arm_s, ptr, op);
-				continue;
-			}
-			break;
-		case SUBTILIS_FPA_INSTR_LDF:
-		case SUBTILIS_FPA_INSTR_STF:
-			fpa_stran = &instr->operands.fpa_stran;
-			if (fpa_stran->ccode == SUBTILIS_ARM_CCODE_NV) {
-				ptr = prv_remove_op(arm_s, ptr, op);
-				continue;
-			}
+		if (op->type != SUBTILIS_ARM_OP_INSTR)
+			return false;
+
+		res = fn(&op->op.instr, data);
+		if (res == SUBTILIS_ARM_PEEPHOLE_SCAN_DONE)
+			return true;
+		if (res == SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL)
+			return false;
+
+		if (op->op.instr.type != SUBTILIS_ARM_INSTR_B) {
+			ptr = op->next;
+			continue;
+		}
+
+		br = &op->op.instr.operands.br;
+		if (br->link || br->indirect)
+			return false;
+		target = subtilis_arm_peephole_label(ph, br->target.label);
+		if (target == SIZE_MAX)
+			return false;
+		if (br->ccode == SUBTILIS_ARM_CCODE_AL) {
+			ptr = target;
+			continue;
+		}
+		if (!prv_scan(ph, target, fn, data, budget))
+			return false;
+		ptr = op->next;
+	}
+
+	return false;
+}
+
+static subtilis_arm_peephole_scan_t prv_reg_dead_fn(subtilis_arm_instr_t *instr,
+						    void *data)
+{
+	uint32_t read;
+	uint32_t written;
+	uint32_t mask = 1 << *((subtilis_arm_reg_t *)data);
+
+	if (!prv_int_regs(instr, &read, &written))
+		return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+
+	if ((read & mask) || (written & (1 << 15)))
+		return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+
+	if (written & mask)
+		return SUBTILIS_ARM_PEEPHOLE_SCAN_DONE;
+
+	return SUBTILIS_ARM_PEEPHOLE_SCAN_CONTINUE;
+}
+
+/*
+ * Returns true if the value held in reg when the op at ptr is
+ * reached is never read.
+ */
+
+static bool prv_reg_dead(subtilis_arm_peephole_t *ph, size_t ptr,
+			 subtilis_arm_reg_t reg)
+{
+	size_t budget = SUBTILIS_ARM_PEEPHOLE_WINDOW;
+
+	return prv_scan(ph, ptr, prv_reg_dead_fn, &reg, &budget);
+}
+
+static bool prv_nz_only(subtilis_arm_ccode_type_t ccode)
+{
+	switch (ccode) {
+	case SUBTILIS_ARM_CCODE_EQ:
+	case SUBTILIS_ARM_CCODE_NE:
+	case SUBTILIS_ARM_CCODE_MI:
+	case SUBTILIS_ARM_CCODE_PL:
+	case SUBTILIS_ARM_CCODE_AL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static subtilis_arm_peephole_scan_t prv_nz_only_fn(subtilis_arm_instr_t *instr,
+						   void *data)
+{
+	subtilis_arm_data_instr_t *d;
+	subtilis_arm_ccode_type_t ccode;
+	bool sets_flags = false;
+	subtilis_arm_instr_type_t type = instr->type;
+
+	if (!prv_ccode(instr, &ccode) || !prv_nz_only(ccode))
+		return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+
+	if (prv_is_data(type)) {
+		d = &instr->operands.data;
+		if (type == SUBTILIS_ARM_INSTR_ADC ||
+		    type == SUBTILIS_ARM_INSTR_SBC ||
+		    type == SUBTILIS_ARM_INSTR_RSC)
+			return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+		if (d->op2.type == SUBTILIS_ARM_OP2_SHIFTED &&
+		    d->op2.op.shift.type == SUBTILIS_ARM_SHIFT_RRX)
+			return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+		if (prv_has_dest(type) && d->dest == 15)
+			return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+
+		/*
+		 * The logical instructions leave V alone so they don't
+		 * terminate the scan even if they set the flags.
+		 */
+
+		switch (type) {
+		case SUBTILIS_ARM_INSTR_CMP:
+		case SUBTILIS_ARM_INSTR_CMN:
+			sets_flags = true;
 			break;
-		case SUBTILIS_VFP_INSTR_FSTD:
-		case SUBTILIS_VFP_INSTR_FLDD:
-			vfp_stran = &instr->operands.vfp_stran;
-			if (vfp_stran->ccode == SUBTILIS_ARM_CCODE_NV) {
-				ptr = prv_remove_op(arm_s, ptr, op);
-				continue;
-			}
+		case SUBTILIS_ARM_INSTR_SUB:
+		case SUBTILIS_ARM_INSTR_RSB:
+		case SUBTILIS_ARM_INSTR_ADD:
+			sets_flags = d->status;
+			break;
+		default:
+			break;
+		}
+	} else {
+		switch (type) {
+		case SUBTILIS_ARM_INSTR_LDR:
+			if (instr->operands.stran.dest == 15)
+				return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+			break;
+		case SUBTILIS_ARM_INSTR_LDM:
+			if (instr->operands.mtran.reg_list & (1 << 15))
+				return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+			break;
+		case SUBTILIS_ARM_INSTR_MUL:
+		case SUBTILIS_ARM_INSTR_MLA:
+		case SUBTILIS_ARM_INSTR_STR:
+		case SUBTILIS_ARM_INSTR_STM:
+		case SUBTILIS_ARM_INSTR_B:
+		case SUBTILIS_ARM_INSTR_LDRC:
+		case SUBTILIS_ARM_INSTR_LDRP:
+		case SUBTILIS_ARM_INSTR_ADR:
+			break;
+		case SUBTILIS_FPA_INSTR_CMF:
+		case SUBTILIS_FPA_INSTR_CNF:
+		case SUBTILIS_FPA_INSTR_CMFE:
+		case SUBTILIS_FPA_INSTR_CNFE:
+			sets_flags = true;
+			break;
+		case SUBTILIS_VFP_INSTR_FMRX:
+			sets_flags = instr->operands.vfp_sysreg.arm_reg == 15;
+			break;
+		default:
+			if (!prv_is_fp(type))
+				return SUBTILIS_ARM_PEEPHOLE_SCAN_FAIL;
+			break;
+		}
+	}
+
+	if (sets_flags && ccode == SUBTILIS_ARM_CCODE_AL)
+		return SUBTILIS_ARM_PEEPHOLE_SCAN_DONE;
+
+	return SUBTILIS_ARM_PEEPHOLE_SCAN_CONTINUE;
+}
+
+/*
+ * Returns true if the only flags read before they are next overwritten,
+ * on any path leading from the op at ptr, are N and Z.
+ */
+
+static bool prv_nz_only_live(subtilis_arm_peephole_t *ph, size_t ptr)
+{
+	size_t budget = SUBTILIS_ARM_PEEPHOLE_WINDOW;
+
+	return prv_scan(ph, ptr, prv_nz_only_fn, NULL, &budget);
+}
+
+/*
+ * Removes MOV rX, rX.
+ */
+
+static bool prv_self_mov(subtilis_arm_peephole_t *ph, size_t *ptr,
+			 subtilis_error_t *err)
+{
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+	subtilis_arm_data_instr_t *data;
+
+	data = &arm_s->op_pool->ops[*ptr].op.instr.operands.data;
+	if ((data->op2.type != SUBTILIS_ARM_OP2_REG) ||
+	    (data->op2.op.reg != data->dest) || (data->dest == 15) ||
+	    data->status)
+		return false;
+
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/*
+ * MOV rT, rS, shift #n
+ * op rD, rN, rT
+ *
+ * becomes
+ *
+ * op rD, rN, rS, shift #n
+ *
+ * providing rT is not needed afterwards and op doesn't set the flags.  If
+ * rT is the first operand of op the operands are swapped, reversing the
+ * operation if necessary.
+ */
+
+static bool prv_fold_shift(subtilis_arm_peephole_t *ph, size_t *ptr,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *next;
+	subtilis_arm_data_instr_t *mov;
+	subtilis_arm_data_instr_t *user;
+	subtilis_arm_instr_type_t utype;
+	subtilis_arm_reg_t tmp;
+	bool swap = false;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	mov = &op->op.instr.operands.data;
+	if ((mov->ccode != SUBTILIS_ARM_CCODE_AL) || mov->status ||
+	    (mov->op2.type != SUBTILIS_ARM_OP2_SHIFTED) ||
+	    mov->op2.op.shift.shift_reg ||
+	    (mov->op2.op.shift.type == SUBTILIS_ARM_SHIFT_RRX) ||
+	    (mov->dest == 15) || (op->next == SIZE_MAX))
+		return false;
+	tmp = mov->dest;
+
+	next = &arm_s->op_pool->ops[op->next];
+	if ((next->type != SUBTILIS_ARM_OP_INSTR) ||
+	    !prv_is_data(next->op.instr.type))
+		return false;
+	utype = next->op.instr.type;
+	user = &next->op.instr.operands.data;
+
+	/*
+	 * A logical instruction that sets the flags takes C from the
+	 * shifter, so folding a shift into it would change the flags.  We
+	 * leave all flag setting users, including the compares, alone.
+	 */
+
+	if (user->status || !prv_has_dest(utype) || (user->dest == 15))
+		return false;
+
+	if ((user->op2.type == SUBTILIS_ARM_OP2_REG) &&
+	    (user->op2.op.reg == tmp)) {
+		if (prv_has_op1(utype) && (user->op1 == tmp))
+			return false;
+	} else if (prv_has_op1(utype) && (user->op1 == tmp) &&
+		   (user->op2.type == SUBTILIS_ARM_OP2_REG)) {
+		switch (utype) {
+		case SUBTILIS_ARM_INSTR_AND:
+		case SUBTILIS_ARM_INSTR_EOR:
+		case SUBTILIS_ARM_INSTR_ADD:
+		case SUBTILIS_ARM_INSTR_ADC:
+		case SUBTILIS_ARM_INSTR_ORR:
+			break;
+		case SUBTILIS_ARM_INSTR_SUB:
+			utype = SUBTILIS_ARM_INSTR_RSB;
+			break;
+		case SUBTILIS_ARM_INSTR_RSB:
+			utype = SUBTILIS_ARM_INSTR_SUB;
+			break;
+		case SUBTILIS_ARM_INSTR_SBC:
+			utype = SUBTILIS_ARM_INSTR_RSC;
+			break;
+		case SUBTILIS_ARM_INSTR_RSC:
+			utype = SUBTILIS_ARM_INSTR_SBC;
+			break;
+		default:
+			return false;
+		}
+		swap = true;
+	} else {
+		return false;
+	}
+
+	/*
+	 * If the user overwrites rT we know it's dead.  Otherwise we need
+	 * to go looking.
+	 */
+
+	if ((user->dest != tmp) || (user->ccode != SUBTILIS_ARM_CCODE_AL))
+		if (!prv_reg_dead(ph, next->next, tmp))
+			return false;
+
+	next->op.instr.type = utype;
+	if (swap)
+		user->op1 = user->op2.op.reg;
+	user->op2 = mov->op2;
+
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/*
+ * Returns true if stran is a word sized, non write back, transfer with
+ * an immediate offset.  The offset is returned in offset.
+ */
+
+static bool prv_simple_stran(subtilis_arm_stran_instr_t *stran,
+			     int32_t *offset)
+{
+	if ((stran->ccode != SUBTILIS_ARM_CCODE_AL) || !stran->pre_indexed ||
+	    stran->write_back || stran->byte || (stran->base == 15) ||
+	    (stran->offset.type != SUBTILIS_ARM_OP2_I32))
+		return false;
+
+	*offset = (int32_t)stran->offset.op.integer;
+	if (stran->subtract)
+		*offset = -*offset;
+
+	return true;
+}
+
+/*
+ * STR rS, [rB, #o]
+ * ...
+ * LDR rD, [rB, #o]
+ *
+ * The load is replaced by MOV rD, rS, or removed altogether if rD is rS,
+ * providing no label intervenes and neither rS nor rB, nor the memory
+ * location, are modified in between.  This pattern is common in spill
+ * heavy code.
+ */
+
+static bool prv_forward_store(subtilis_arm_peephole_t *ph, size_t *ptr,
+			      subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *prev;
+	subtilis_arm_stran_instr_t *ldr;
+	subtilis_arm_stran_instr_t *str;
+	subtilis_arm_data_instr_t *data;
+	int32_t offset;
+	int32_t str_offset;
+	int32_t size;
+	uint32_t read;
+	uint32_t written;
+	uint32_t all_written = 0;
+	subtilis_arm_reg_t src;
+	size_t prev_ptr;
+	size_t i;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	ldr = &op->op.instr.operands.stran;
+	if (!prv_simple_stran(ldr, &offset) || (ldr->dest == 15))
+		return false;
+
+	prev_ptr = *ptr;
+	for (i = 0; i < SUBTILIS_ARM_PEEPHOLE_WINDOW; i++) {
+		if (prev_ptr == arm_s->first_op)
+			return false;
+		prev_ptr = arm_s->op_pool->ops[prev_ptr].prev;
+		prev = &arm_s->op_pool->ops[prev_ptr];
+		if (prev->type != SUBTILIS_ARM_OP_INSTR)
+			return false;
+
+		switch (prev->op.instr.type) {
+		case SUBTILIS_ARM_INSTR_STR:
+			str = &prev->op.instr.operands.stran;
+			if ((str->base != ldr->base) ||
+			    (str->ccode != SUBTILIS_ARM_CCODE_AL) ||
+			    !str->pre_indexed || str->write_back ||
+			    (str->offset.type != SUBTILIS_ARM_OP2_I32))
+				return false;
+			str_offset = (int32_t)str->offset.op.integer;
+			if (str->subtract)
+				str_offset = -str_offset;
+			if (str_offset == offset && !str->byte)
+				goto found;
+			size = str->byte ? 1 : 4;
+			if ((str_offset + size > offset) &&
+			    (str_offset < offset + 4))
+				return false;
+			continue;
+		case SUBTILIS_ARM_INSTR_B:
+			if (prev->op.instr.operands.br.ccode ==
+			    SUBTILIS_ARM_CCODE_AL)
+				return false;
 			break;
+		case SUBTILIS_ARM_INSTR_STM:
+		case SUBTILIS_FPA_INSTR_STF:
+		case SUBTILIS_VFP_INSTR_FSTS:
+		case SUBTILIS_VFP_INSTR_FSTD:
+			return false;
 		default:
 			break;
 		}
 
+		if (!prv_int_regs(&prev->op.instr, &read, &written))
+			return false;
+		all_written |= written;
+		if (all_written & (1 << ldr->base))
+			return false;
+	}
+
+	return false;
+
+found:
+
+	src = str->dest;
+	if (all_written & (1 << src))
+		return false;
+
+	if (src == ldr->dest) {
+		*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+		return true;
+	}
+
+	op->op.instr.type = SUBTILIS_ARM_INSTR_MOV;
+	data = &op->op.instr.operands.data;
+	data->ccode = SUBTILIS_ARM_CCODE_AL;
+	data->status = false;
+	data->dest = ldr->dest;
+	data->op1 = 0;
+	data->op2.type = SUBTILIS_ARM_OP2_REG;
+	data->op2.op.reg = src;
+
+	*ptr = op->next;
+	return true;
+}
+
+/*
+ * Sorts the transfers by offset, checks that the offsets are contiguous
+ * and that the registers ascend with the addresses, as required by
+ * LDM and STM.  Returns the register list.
+ */
+
+static bool prv_mergeable(subtilis_arm_reg_t *regs, int32_t *offsets,
+			  size_t count, size_t *reg_list)
+{
+	size_t i;
+	size_t j;
+	int32_t tmp_off;
+	subtilis_arm_reg_t tmp_reg;
+	subtilis_arm_reg_t sregs[SUBTILIS_ARM_PEEPHOLE_MAX_MERGE];
+	int32_t soffsets[SUBTILIS_ARM_PEEPHOLE_MAX_MERGE];
+
+	for (i = 0; i < count; i++) {
+		sregs[i] = regs[i];
+		soffsets[i] = offsets[i];
+	}
+
+	for (i = 1; i < count; i++)
+		for (j = i; j > 0 && soffsets[j - 1] > soffsets[j]; j--) {
+			tmp_off = soffsets[j];
+			soffsets[j] = soffsets[j - 1];
+			soffsets[j - 1] = tmp_off;
+			tmp_reg = sregs[j];
+			sregs[j] = sregs[j - 1];
+			sregs[j - 1] = tmp_reg;
+		}
+
+	*reg_list = 1 << sregs[0];
+	for (i = 1; i < count; i++) {
+		if ((soffsets[i] != soffsets[i - 1] + 4) ||
+		    (sregs[i] <= sregs[i - 1]))
+			return false;
+		*reg_list |= 1 << sregs[i];
+	}
+
+	return true;
+}
+
+/*
+ * Merges runs of adjacent LDRs or STRs that use the same base register
+ * and access contiguous words into a single LDM or STM.  If the run
+ * doesn't start or end at the base register a run of three or more loads
+ * can still be merged by first computing the start address into one of
+ * the destination registers.
+ */
+
+static bool prv_merge_stran(subtilis_arm_peephole_t *ph, size_t *ptr,
+			    subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_stran_instr_t *stran;
+	subtilis_arm_mtran_instr_t *mtran;
+	subtilis_arm_data_instr_t *data;
+	subtilis_arm_instr_type_t itype;
+	subtilis_arm_reg_t base;
+	subtilis_arm_mtran_type_t mtype;
+	subtilis_arm_reg_t regs[SUBTILIS_ARM_PEEPHOLE_MAX_MERGE];
+	int32_t offsets[SUBTILIS_ARM_PEEPHOLE_MAX_MERGE];
+	size_t ptrs[SUBTILIS_ARM_PEEPHOLE_MAX_MERGE];
+	int32_t offset;
+	int32_t min_offset;
+	int32_t max_offset;
+	size_t reg_list = 0;
+	size_t count = 0;
+	size_t next;
+	size_t i;
+	uint32_t encoded;
+	bool load;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	itype = op->op.instr.type;
+	load = itype == SUBTILIS_ARM_INSTR_LDR;
+	base = op->op.instr.operands.stran.base;
+
+	next = *ptr;
+	while (count < SUBTILIS_ARM_PEEPHOLE_MAX_MERGE && next != SIZE_MAX) {
+		op = &arm_s->op_pool->ops[next];
+		if ((op->type != SUBTILIS_ARM_OP_INSTR) ||
+		    (op->op.instr.type != itype))
+			break;
+		stran = &op->op.instr.operands.stran;
+		if (!prv_simple_stran(stran, &offset) ||
+		    (stran->base != base) || (stran->dest == 15) ||
+		    (load && stran->dest == base))
+			break;
+		for (i = 0; i < count; i++)
+			if ((regs[i] == stran->dest) || (offsets[i] == offset))
+				break;
+		if (i < count)
+			break;
+		regs[count] = stran->dest;
+		offsets[count] = offset;
+		ptrs[count] = next;
+		count++;
+		next = op->next;
+	}
+
+	for (; count >= 2; count--)
+		if (prv_mergeable(regs, offsets, count, &reg_list))
+			break;
+	if (count < 2)
+		return false;
+
+	min_offset = offsets[0];
+	max_offset = offsets[0];
+	for (i = 1; i < count; i++) {
+		if (offsets[i] < min_offset)
+			min_offset = offsets[i];
+		if (offsets[i] > max_offset)
+			max_offset = offsets[i];
+	}
+
+	i = 0;
+	if (min_offset == 0) {
+		mtype = SUBTILIS_ARM_MTRAN_IA;
+	} else if (min_offset == 4) {
+		mtype = SUBTILIS_ARM_MTRAN_IB;
+	} else if (max_offset == 0) {
+		mtype = SUBTILIS_ARM_MTRAN_DA;
+	} else if (max_offset == -4) {
+		mtype = SUBTILIS_ARM_MTRAN_DB;
+	} else if (load && count >= 3) {
+		/*
+		 * The lowest register in the list becomes the base.  It's
+		 * safe to load the base register in an LDM without write
+		 * back.
+		 */
+
+		if (!subtilis_arm_encode_imm(min_offset < 0 ? -min_offset
+							    : min_offset,
+					     &encoded))
+			return false;
+		op = &arm_s->op_pool->ops[ptrs[i++]];
+		op->op.instr.type = min_offset < 0 ? SUBTILIS_ARM_INSTR_SUB
+						   : SUBTILIS_ARM_INSTR_ADD;
+		data = &op->op.instr.operands.data;
+		data->ccode = SUBTILIS_ARM_CCODE_AL;
+		data->status = false;
+		data->op1 = base;
+		data->op2.type = SUBTILIS_ARM_OP2_I32;
+		data->op2.op.integer = encoded;
+		for (base = 0; !(reg_list & (1 << base)); base++)
+			;
+		data->dest = base;
+		mtype = SUBTILIS_ARM_MTRAN_IA;
+	} else {
+		return false;
+	}
+
+	op = &arm_s->op_pool->ops[ptrs[i++]];
+	op->op.instr.type =
+	    load ? SUBTILIS_ARM_INSTR_LDM : SUBTILIS_ARM_INSTR_STM;
+	mtran = &op->op.instr.operands.mtran;
+	mtran->ccode = SUBTILIS_ARM_CCODE_AL;
+	mtran->op0 = base;
+	mtran->reg_list = reg_list;
+	mtran->type = mtype;
+	mtran->write_back = false;
+	mtran->status = false;
+
+	for (; i < count; i++)
+		(void)subtilis_arm_peephole_remove(arm_s, ptrs[i]);
+
+	*ptr = arm_s->op_pool->ops[ptrs[0]].next;
+	return true;
+}
+
+/*
+ * Removes branches to the instruction that follows them and redirects
+ * branches whose targets are unconditional branches to the final
+ * destination.
+ */
+
+static bool prv_thread_branch(subtilis_arm_peephole_t *ph, size_t *ptr,
+			      subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *target;
+	subtilis_arm_br_instr_t *br;
+	subtilis_arm_br_instr_t *target_br;
+	size_t label;
+	size_t next;
+	size_t i;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	br = &op->op.instr.operands.br;
+	if (br->link || br->indirect)
+		return false;
+
+	for (next = op->next; next != SIZE_MAX;
+	     next = arm_s->op_pool->ops[next].next) {
+		target = &arm_s->op_pool->ops[next];
+		if (target->type != SUBTILIS_ARM_OP_LABEL)
+			break;
+		if (target->op.label == br->target.label) {
+			prv_unref_label(ph, br->target.label);
+			*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+			return true;
+		}
+	}
+
+	label = br->target.label;
+	for (i = 0; i < SUBTILIS_ARM_PEEPHOLE_MAX_HOPS; i++) {
+		next = subtilis_arm_peephole_label(ph, label);
+		while (next != SIZE_MAX &&
+		       arm_s->op_pool->ops[next].type == SUBTILIS_ARM_OP_LABEL)
+			next = arm_s->op_pool->ops[next].next;
+		if (next == SIZE_MAX)
+			break;
+		target = &arm_s->op_pool->ops[next];
+		if ((target->type != SUBTILIS_ARM_OP_INSTR) ||
+		    (target->op.instr.type != SUBTILIS_ARM_INSTR_B))
+			break;
+		target_br = &target->op.instr.operands.br;
+		if (target_br->link || target_br->indirect ||
+		    (target_br->ccode != SUBTILIS_ARM_CCODE_AL) ||
+		    (target_br->target.label == label))
+			break;
+		label = target_br->target.label;
+	}
+
+	if (label == br->target.label)
+		return false;
+
+	prv_unref_label(ph, br->target.label);
+	prv_ref_label(ph, label);
+	br->target.label = label;
+	*ptr = op->next;
+	return true;
+}
+
+/*
+ * op rD, ...
+ * CMP rD, #0
+ *
+ * becomes
+ *
+ * opS rD, ...
+ *
+ * providing the flags set by the comparison are only tested for equality
+ * or sign.  opS sets N and Z in exactly the same way as the CMP, but may
+ * leave C and V with different values.
+ */
+
+static bool prv_fold_cmp(subtilis_arm_peephole_t *ph, size_t *ptr,
+			 subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *prev;
+	subtilis_arm_data_instr_t *cmp;
+	subtilis_arm_data_instr_t *data;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	cmp = &op->op.instr.operands.data;
+	if ((cmp->ccode != SUBTILIS_ARM_CCODE_AL) ||
+	    (cmp->op2.type != SUBTILIS_ARM_OP2_I32) ||
+	    (cmp->op2.op.integer != 0) || (*ptr == arm_s->first_op))
+		return false;
+
+	prev = &arm_s->op_pool->ops[op->prev];
+	if (prev->type != SUBTILIS_ARM_OP_INSTR)
+		return false;
+
+	switch (prev->op.instr.type) {
+	case SUBTILIS_ARM_INSTR_AND:
+	case SUBTILIS_ARM_INSTR_EOR:
+	case SUBTILIS_ARM_INSTR_SUB:
+	case SUBTILIS_ARM_INSTR_RSB:
+	case SUBTILIS_ARM_INSTR_ADD:
+	case SUBTILIS_ARM_INSTR_ORR:
+	case SUBTILIS_ARM_INSTR_MOV:
+	case SUBTILIS_ARM_INSTR_BIC:
+	case SUBTILIS_ARM_INSTR_MVN:
+		break;
+	default:
+		return false;
+	}
+
+	data = &prev->op.instr.operands.data;
+	if ((data->ccode != SUBTILIS_ARM_CCODE_AL) || (data->dest == 15) ||
+	    (data->dest != cmp->op1))
+		return false;
+
+	if (!prv_nz_only_live(ph, op->next))
+		return false;
+
+	data->status = true;
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/*
+ * Returns true if instr can be made conditional without changing the
+ * behaviour of the code that surrounds it, i.e., it is currently executed
+ * unconditionally, it does not alter the flags or the PC and it is not a
+ * call or a SWI.
+ */
+
+static bool prv_predicable(subtilis_arm_instr_t *instr)
+{
+	subtilis_arm_instr_type_t type = instr->type;
+	subtilis_arm_data_instr_t *data;
+	subtilis_arm_ccode_type_t ccode;
+
+	if (!prv_ccode(instr, &ccode) || (ccode != SUBTILIS_ARM_CCODE_AL))
+		return false;
+
+	if (prv_is_data(type)) {
+		data = &instr->operands.data;
+		return prv_has_dest(type) && !data->status &&
+		       (data->dest != 15);
+	}
+
+	switch (type) {
+	case SUBTILIS_ARM_INSTR_MUL:
+	case SUBTILIS_ARM_INSTR_MLA:
+		return !instr->operands.mul.status;
+	case SUBTILIS_ARM_INSTR_LDR:
+	case SUBTILIS_ARM_INSTR_STR:
+		return (instr->operands.stran.dest != 15) &&
+		       (instr->operands.stran.base != 15);
+	case SUBTILIS_ARM_INSTR_LDRC:
+		return instr->operands.ldrc.dest != 15;
+	case SUBTILIS_ARM_INSTR_ADR:
+		return instr->operands.adr.dest != 15;
+	default:
+		return false;
+	}
+}
+
+static void prv_set_ccode(subtilis_arm_instr_t *instr,
+			  subtilis_arm_ccode_type_t ccode)
+{
+	if (prv_is_data(instr->type)) {
+		instr->operands.data.ccode = ccode;
+		return;
+	}
+
+	switch (instr->type) {
+	case SUBTILIS_ARM_INSTR_MUL:
+	case SUBTILIS_ARM_INSTR_MLA:
+		instr->operands.mul.ccode = ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_LDR:
+	case SUBTILIS_ARM_INSTR_STR:
+		instr->operands.stran.ccode = ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_LDRC:
+		instr->operands.ldrc.ccode = ccode;
+		break;
+	case SUBTILIS_ARM_INSTR_ADR:
+		instr->operands.adr.ccode = ccode;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Each condition code, apart from AL and NV, differs from its inverse
+ * only in the bottom bit.
+ */
+
+static subtilis_arm_ccode_type_t prv_invert_ccode(subtilis_arm_ccode_type_t cc)
+{
+	return (subtilis_arm_ccode_type_t)(cc ^ 1);
+}
+
+/*
+ * Walks forward from the op at ptr over a run of predicable instructions,
+ * and unreferenced labels, stopping at the first op that is neither.
+ * Returns the index of that op, or SIZE_MAX if the run is too long or
+ * ends the section.  The number of instructions in the run is returned
+ * in count.
+ */
+
+static size_t prv_predicable_run(subtilis_arm_peephole_t *ph, size_t ptr,
+				 size_t *count)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	*count = 0;
+	while (ptr != SIZE_MAX) {
+		op = &arm_s->op_pool->ops[ptr];
+		if (op->type == SUBTILIS_ARM_OP_LABEL) {
+			if (!prv_label_unused(ph, op->op.label))
+				return ptr;
+		} else if ((op->type != SUBTILIS_ARM_OP_INSTR) ||
+			   !prv_predicable(&op->op.instr)) {
+			return ptr;
+		} else if (++(*count) > SUBTILIS_ARM_PEEPHOLE_MAX_PREDICATED) {
+			return SIZE_MAX;
+		}
 		ptr = op->next;
 	}
+
+	return SIZE_MAX;
+}
+
+static void prv_predicate_run(subtilis_arm_peephole_t *ph, size_t ptr,
+			      size_t end, subtilis_arm_ccode_type_t ccode)
+{
+	subtilis_arm_op_t *op;
+
+	for (; ptr != end; ptr = op->next) {
+		op = &ph->arm_s->op_pool->ops[ptr];
+		if (op->type == SUBTILIS_ARM_OP_INSTR)
+			prv_set_ccode(&op->op.instr, ccode);
+	}
+}
+
+/*
+ * Bcc else
+ * then
+ * else:
+ *
+ * becomes
+ *
+ * then, executed under the inverse of cc
+ * else:
+ *
+ * and
+ *
+ * Bcc else
+ * then
+ * B end
+ * else:
+ * otherwise
+ * end:
+ *
+ * becomes
+ *
+ * then, executed under the inverse of cc
+ * otherwise, executed under cc
+ * end:
+ *
+ * providing then and otherwise are short, contain no calls, SWIs or
+ * instructions that set the flags and cannot be entered other than via
+ * the conditional branch.
+ */
+
+static bool prv_if_convert(subtilis_arm_peephole_t *ph, size_t *ptr,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *end;
+	subtilis_arm_br_instr_t *br;
+	subtilis_arm_br_instr_t *jmp;
+	size_t then_end;
+	size_t else_start;
+	size_t else_end;
+	size_t then_count;
+	size_t else_count;
+	size_t first;
+	size_t else_label;
+	subtilis_arm_ccode_type_t ccode;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	br = &op->op.instr.operands.br;
+	if (br->link || br->indirect || (br->ccode == SUBTILIS_ARM_CCODE_AL) ||
+	    (br->ccode == SUBTILIS_ARM_CCODE_NV))
+		return false;
+
+	ccode = br->ccode;
+	else_label = br->target.label;
+	first = op->next;
+	then_end = prv_predicable_run(ph, first, &then_count);
+	if (then_end == SIZE_MAX)
+		return false;
+
+	end = &arm_s->op_pool->ops[then_end];
+	if (end->type == SUBTILIS_ARM_OP_LABEL) {
+		if ((end->op.label != else_label) || (then_count == 0))
+			return false;
+		prv_predicate_run(ph, first, then_end,
+				  prv_invert_ccode(ccode));
+		prv_unref_label(ph, else_label);
+		*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+		return true;
+	}
+
+	if (end->type != SUBTILIS_ARM_OP_INSTR ||
+	    end->op.instr.type != SUBTILIS_ARM_INSTR_B)
+		return false;
+	jmp = &end->op.instr.operands.br;
+	if (jmp->link || jmp->indirect || (jmp->ccode != SUBTILIS_ARM_CCODE_AL))
+		return false;
+
+	/*
+	 * The else label must follow the unconditional branch and must
+	 * only be reachable from the conditional branch.
+	 */
+
+	else_start = end->next;
+	if ((else_start == SIZE_MAX) ||
+	    (arm_s->op_pool->ops[else_start].type != SUBTILIS_ARM_OP_LABEL) ||
+	    (arm_s->op_pool->ops[else_start].op.label != else_label) ||
+	    (subtilis_arm_peephole_label(ph, else_label) != else_start) ||
+	    (ph->refs[else_label] != 1))
+		return false;
+
+	else_end = prv_predicable_run(ph, arm_s->op_pool->ops[else_start].next,
+				      &else_count);
+	if ((else_end == SIZE_MAX) || (then_count + else_count == 0))
+		return false;
+
+	op = &arm_s->op_pool->ops[else_end];
+	if ((op->type != SUBTILIS_ARM_OP_LABEL) ||
+	    (op->op.label != jmp->target.label))
+		return false;
+
+	prv_predicate_run(ph, first, then_end, prv_invert_ccode(ccode));
+	prv_predicate_run(ph, else_start, else_end, ccode);
+	prv_unref_label(ph, jmp->target.label);
+	prv_unref_label(ph, else_label);
+	(void)subtilis_arm_peephole_remove(arm_s, then_end);
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/* clang-format off */
+static const subtilis_arm_peephole_rule_t prv_rules[] = {
+	{SUBTILIS_ARM_INSTR_MOV, prv_self_mov},
+	{SUBTILIS_ARM_INSTR_MOV, prv_fold_shift},
+	{SUBTILIS_ARM_INSTR_LDR, prv_forward_store},
+	{SUBTILIS_ARM_INSTR_LDR, prv_merge_stran},
+	{SUBTILIS_ARM_INSTR_STR, prv_merge_stran},
+	{SUBTILIS_ARM_INSTR_B, prv_thread_branch},
+	{SUBTILIS_ARM_INSTR_B, prv_if_convert},
+	{SUBTILIS_ARM_INSTR_CMP, prv_fold_cmp},
+	{SUBTILIS_ARM_INSTR_TEQ, prv_fold_cmp},
+};
+
+/* clang-format on */
+
+static bool prv_apply_rules(subtilis_arm_peephole_t *ph,
+			    const subtilis_arm_peephole_rule_t *rules,
+			    size_t count, size_t *ptr, subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_arm_instr_type_t type;
+
+	type = ph->arm_s->op_pool->ops[*ptr].op.instr.type;
+	for (i = 0; i < count; i++) {
+		if (rules[i].type != type)
+			continue;
+		if (rules[i].fn(ph, ptr, err))
+			return true;
+		if (err->type != SUBTILIS_ERROR_OK)
+			return false;
+	}
+
+	return false;
+}
+
+/*
+ * Local calls, made with BL, and jumps refer to labels in the section, as
+ * do ADRs and the loads of constants.
+ */
+
+static void prv_count_refs(subtilis_arm_peephole_t *ph,
+			   subtilis_arm_instr_t *instr)
+{
+	subtilis_arm_br_instr_t *br;
+
+	switch (instr->type) {
+	case SUBTILIS_ARM_INSTR_B:
+		br = &instr->operands.br;
+		if (!br->indirect && (!br->link || br->local))
+			prv_ref_label(ph, br->target.label);
+		break;
+	case SUBTILIS_ARM_INSTR_ADR:
+		prv_ref_label(ph, instr->operands.adr.label);
+		break;
+	case SUBTILIS_ARM_INSTR_LDRC:
+		prv_ref_label(ph, instr->operands.ldrc.label);
+		break;
+	case SUBTILIS_ARM_INSTR_LDRP:
+		prv_ref_label(ph, instr->operands.ldrp.constant_label);
+		break;
+	case SUBTILIS_FPA_INSTR_LDRC:
+		prv_ref_label(ph, instr->operands.fpa_ldrc.label);
+		break;
+	case SUBTILIS_VFP_INSTR_LDRC:
+		prv_ref_label(ph, instr->operands.vfp_ldrc.label);
+		break;
+	default:
+		break;
+	}
+}
+
+static void prv_init_labels(subtilis_arm_peephole_t *ph,
+			    subtilis_error_t *err)
+{
+	size_t i;
+	size_t ptr;
+	subtilis_arm_op_t *op;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	ph->labels = NULL;
+	ph->refs = NULL;
+	ph->max_labels = arm_s->label_counter;
+	if (ph->max_labels == 0)
+		return;
+
+	ph->labels = malloc(sizeof(*ph->labels) * ph->max_labels);
+	if (!ph->labels) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	ph->refs = calloc(ph->max_labels, sizeof(*ph->refs));
+	if (!ph->refs) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < ph->max_labels; i++)
+		ph->labels[i] = SIZE_MAX;
+
+	for (ptr = arm_s->first_op; ptr != SIZE_MAX; ptr = op->next) {
+		op = &arm_s->op_pool->ops[ptr];
+		if (op->type == SUBTILIS_ARM_OP_LABEL) {
+			if (op->op.label < ph->max_labels)
+				ph->labels[op->op.label] = ptr;
+		} else if (op->type == SUBTILIS_ARM_OP_INSTR) {
+			prv_count_refs(ph, &op->op.instr);
+		}
+	}
+}
+
+void subtilis_arm_peephole(subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	subtilis_arm_peephole_t ph;
+	size_t ptr;
+	const size_t rule_count = sizeof(prv_rules) / sizeof(prv_rules[0]);
+	const subtilis_arm_fp_if_t *fp_if = arm_s->fp_if;
+
+	ph.arm_s = arm_s;
+	prv_init_labels(&ph, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	ptr = arm_s->first_op;
+	while (ptr != SIZE_MAX) {
+		if (arm_s->op_pool->ops[ptr].type != SUBTILIS_ARM_OP_INSTR) {
+			ptr = arm_s->op_pool->ops[ptr].next;
+			continue;
+		}
+
+		if (prv_apply_rules(&ph, prv_rules, rule_count, &ptr, err))
+			continue;
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		if (fp_if && prv_apply_rules(&ph, fp_if->peephole_rules,
+					     fp_if->peephole_rule_count, &ptr,
+					     err))
+			continue;
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		ptr = arm_s->op_pool->ops[ptr].next;
+	}
+
+cleanup:
+
+	free(ph.refs);
+	free(ph.labels);
 }
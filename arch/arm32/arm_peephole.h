@@ -19,7 +19,62 @@
 
 #include "arm_core.h"
 
+/*
+ * State shared by the peephole rules while they run over a section.
+ * labels maps each label number to the index of its label op in the
+ * op pool, or SIZE_MAX if the label is not defined in the section.
+ * refs counts the instructions in the section that refer to each label.
+ * Rules that add, remove or redirect references must keep it up to date.
+ */
+
+struct subtilis_arm_peephole_t_ {
+	subtilis_arm_section_t *arm_s;
+	size_t *labels;
+	size_t *refs;
+	size_t max_labels;
+};
+
+typedef struct subtilis_arm_peephole_t_ subtilis_arm_peephole_t;
+
+/*
+ * A peephole rule is invoked for each instruction in a section whose type
+ * matches the type of the rule.  ptr holds the index of the instruction in
+ * the op pool.  Rules that rewrite the code return true and set ptr to the
+ * op at which the optimiser should continue its scan, which may be the
+ * same instruction if it is worth re-examining, or SIZE_MAX if there are no
+ * more ops.  Rules that do not match return false and leave ptr untouched.
+ *
+ * Rules run after register allocation so all registers are physical.
+ */
+
+typedef bool (*subtilis_arm_peephole_fn_t)(subtilis_arm_peephole_t *ph,
+					   size_t *ptr, subtilis_error_t *err);
+
+struct subtilis_arm_peephole_rule_t_ {
+	subtilis_arm_instr_type_t type;
+	subtilis_arm_peephole_fn_t fn;
+};
+
+/*
+ * Runs the generic integer rules followed by any rules supplied by the
+ * section's floating point interface over each instruction in arm_s.
+ */
+
 void subtilis_arm_peephole(subtilis_arm_section_t *arm_s,
 			   subtilis_error_t *err);
 
+/*
+ * Unlinks the op at ptr from arm_s and returns the index of the op that
+ * followed it, or SIZE_MAX if it was the last op in the section.
+ */
+
+size_t subtilis_arm_peephole_remove(subtilis_arm_section_t *arm_s, size_t ptr);
+
+/*
+ * Returns the index of the op that defines label, or SIZE_MAX if it is not
+ * defined in the section.
+ */
+
+size_t subtilis_arm_peephole_label(subtilis_arm_peephole_t *ph, size_t label);
+
 #endif
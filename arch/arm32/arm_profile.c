@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arm_disass.h"
+#include "arm_profile.h"
+
+#define SUBTILIS_ARM_PROFILE_MAX_NAME 256
+
+struct subtilis_arm_profile_section_t_ {
+	size_t start;
+	char *name;
+	uint64_t hits;
+	uint64_t cycles;
+};
+
+typedef struct subtilis_arm_profile_section_t_ subtilis_arm_profile_section_t;
+
+struct subtilis_arm_profile_t_ {
+	subtilis_arm_vm_t *vm;
+	subtilis_arm_profile_section_t *sections;
+	size_t num_sections;
+	size_t max_sections;
+	uint64_t hits;
+	uint64_t cycles;
+};
+
+typedef struct subtilis_arm_profile_t_ subtilis_arm_profile_t;
+
+static void prv_add_section(subtilis_arm_profile_t *prof, size_t start,
+			    const char *name, subtilis_error_t *err)
+{
+	size_t new_max;
+	subtilis_arm_profile_section_t *new_sections;
+	subtilis_arm_profile_section_t *s;
+
+	if (prof->num_sections == prof->max_sections) {
+		new_max = prof->max_sections + 16;
+		new_sections = realloc(prof->sections,
+				       new_max * sizeof(*new_sections));
+		if (!new_sections) {
+			subtilis_error_set_oom(err);
+			return;
+		}
+		prof->sections = new_sections;
+		prof->max_sections = new_max;
+	}
+
+	s = &prof->sections[prof->num_sections];
+	s->name = malloc(strlen(name) + 1);
+	if (!s->name) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+	strcpy(s->name, name);
+	s->start = start;
+	s->hits = 0;
+	s->cycles = 0;
+	prof->num_sections++;
+}
+
+/*
+ * Reads the section map, converting the addresses of the sections into
+ * word offsets into the code.  The sections are written to the map in
+ * the order in which they appear in the code, so there's no need to sort
+ * them.  Anything following the code, i.e., the constants, is not
+ * included.
+ */
+
+static void prv_read_map(subtilis_arm_profile_t *prof, const char *map_fname,
+			 subtilis_error_t *err)
+{
+	FILE *fp;
+	unsigned int address;
+	char name[SUBTILIS_ARM_PROFILE_MAX_NAME];
+	char line[SUBTILIS_ARM_PROFILE_MAX_NAME + 16];
+	size_t start;
+
+	fp = fopen(map_fname, "r");
+	if (!fp) {
+		subtilis_error_set_file_open(err, map_fname);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%x %255s", &address, name) != 2) {
+			subtilis_error_set_file_read(err);
+			goto cleanup;
+		}
+		if (!strcmp(name, "constants"))
+			break;
+		start = (address - (unsigned int)prof->vm->start_address) / 4;
+		if ((start >= prof->vm->code_size) ||
+		    (prof->num_sections > 0 &&
+		     start < prof->sections[prof->num_sections - 1].start)) {
+			subtilis_error_set_file_read(err);
+			goto cleanup;
+		}
+		prv_add_section(prof, start, name, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
+	if (ferror(fp))
+		subtilis_error_set_file_read(err);
+
+cleanup:
+
+	(void)fclose(fp);
+}
+
+static subtilis_arm_profile_section_t *
+prv_find_section(subtilis_arm_profile_t *prof, size_t pc)
+{
+	size_t lo = 0;
+	size_t hi = prof->num_sections;
+	size_t mid;
+
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (prof->sections[mid].start <= pc)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return &prof->sections[lo];
+}
+
+static void prv_print_location(subtilis_arm_profile_t *prof, size_t pc)
+{
+	subtilis_arm_profile_section_t *s = prv_find_section(prof, pc);
+
+	printf("%s+&%zx", s->name, (pc - s->start) * 4);
+}
+
+static double prv_percent(uint64_t part, uint64_t total)
+{
+	return total ? (part * 100.0) / total : 0.0;
+}
+
+static int prv_cmp_sections(const void *av, const void *bv)
+{
+	const subtilis_arm_profile_section_t *a =
+	    *(const subtilis_arm_profile_section_t *const *)av;
+	const subtilis_arm_profile_section_t *b =
+	    *(const subtilis_arm_profile_section_t *const *)bv;
+
+	if (a->cycles != b->cycles)
+		return a->cycles < b->cycles ? 1 : -1;
+	return a->start < b->start ? -1 : 1;
+}
+
+/*
+ * The sections need to remain sorted by address so that we can look up
+ * the locations of the instructions, so we sort a list of pointers to
+ * them by cycles.
+ */
+
+static void prv_report_sections(subtilis_arm_profile_t *prof,
+				subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_arm_profile_section_t *s;
+	subtilis_arm_profile_section_t **sorted;
+
+	sorted = malloc(prof->num_sections * sizeof(*sorted));
+	if (!sorted) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < prof->num_sections; i++)
+		sorted[i] = &prof->sections[i];
+
+	qsort(sorted, prof->num_sections, sizeof(*sorted), prv_cmp_sections);
+
+	printf("Sections\n\n");
+	printf("%12s %6s %12s %6s  %s\n", "Cycles", "%", "Instrs", "%",
+	       "Name");
+	for (i = 0; i < prof->num_sections; i++) {
+		s = sorted[i];
+		if (!s->hits)
+			continue;
+		printf("%12" PRIu64 " %5.1f%% %12" PRIu64 " %5.1f%%  %s\n",
+		       s->cycles, prv_percent(s->cycles, prof->cycles),
+		       s->hits, prv_percent(s->hits, prof->hits), s->name);
+	}
+
+	free(sorted);
+}
+
+/*
+ * qsort has no context pointer, so the comparison functions for the
+ * instructions and edges sort pointers to the counts instead.
+ */
+
+static int prv_cmp_counts(const void *av, const void *bv)
+{
+	const uint64_t *a = *(const uint64_t *const *)av;
+	const uint64_t *b = *(const uint64_t *const *)bv;
+
+	if (*a != *b)
+		return *a < *b ? 1 : -1;
+	return a < b ? -1 : 1;
+}
+
+static void prv_report_instrs(subtilis_arm_profile_t *prof,
+			      size_t max_entries, subtilis_error_t *err)
+{
+	size_t i;
+	size_t pc;
+	size_t count = 0;
+	subtilis_arm_vm_t *vm = prof->vm;
+	uint64_t **hot;
+	subtilis_arm_instr_t instr;
+	subtilis_error_t dis_err;
+
+	hot = malloc(vm->code_size * sizeof(*hot));
+	if (!hot) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < vm->code_size; i++)
+		if (vm->hits[i])
+			hot[count++] = &vm->hit_cycles[i];
+
+	qsort(hot, count, sizeof(*hot), prv_cmp_counts);
+	if (count > max_entries)
+		count = max_entries;
+
+	printf("\nInstructions\n\n");
+	printf("%8s %12s %6s %12s  %s\n", "Address", "Cycles", "%", "Hits",
+	       "Location");
+	for (i = 0; i < count; i++) {
+		pc = hot[i] - vm->hit_cycles;
+		printf("%8zx %12" PRIu64 " %5.1f%% %12" PRIu64 "  ",
+		       vm->start_address + pc * 4, vm->hit_cycles[pc],
+		       prv_percent(vm->hit_cycles[pc], prof->cycles),
+		       vm->hits[pc]);
+		prv_print_location(prof, pc);
+		subtilis_error_init(&dis_err);
+		subtilis_arm_disass(&instr, ((uint32_t *)vm->memory)[pc],
+				    vm->vfp, &dis_err);
+		if (dis_err.type == SUBTILIS_ERROR_OK)
+			subtilis_arm_instr_dump(&instr);
+		else
+			printf("\tDCW &%x\n", ((uint32_t *)vm->memory)[pc]);
+	}
+
+	free(hot);
+}
+
+static void prv_report_edges(subtilis_arm_profile_t *prof,
+			     size_t max_entries, subtilis_error_t *err)
+{
+	size_t i;
+	size_t count = 0;
+	subtilis_arm_vm_t *vm = prof->vm;
+	subtilis_arm_vm_edge_t *edge;
+	uint64_t **hot;
+
+	if (!vm->num_edges)
+		return;
+
+	hot = malloc(vm->num_edges * sizeof(*hot));
+	if (!hot) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < vm->max_edges; i++)
+		if (vm->edges[i].count)
+			hot[count++] = &vm->edges[i].count;
+
+	qsort(hot, count, sizeof(*hot), prv_cmp_counts);
+	if (count > max_entries)
+		count = max_entries;
+
+	printf("\nBranches\n\n");
+	printf("%12s  %s\n", "Taken", "From -> To");
+	for (i = 0; i < count; i++) {
+		edge = (subtilis_arm_vm_edge_t *)((uint8_t *)hot[i] -
+						  offsetof(
+						      subtilis_arm_vm_edge_t,
+						      count));
+		printf("%12" PRIu64 "  ", edge->count);
+		prv_print_location(prof, edge->from);
+		printf(" -> ");
+		prv_print_location(prof, edge->to);
+		printf("\n");
+	}
+
+	free(hot);
+}
+
+void subtilis_arm_profile_report(subtilis_arm_vm_t *vm, const char *map_fname,
+				 size_t max_entries, subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_arm_profile_t prof;
+	subtilis_arm_profile_section_t *s;
+	subtilis_arm_profile_section_t code;
+
+	memset(&prof, 0, sizeof(prof));
+	prof.vm = vm;
+
+	if (!vm->hits) {
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+
+	if (map_fname) {
+		prv_read_map(&prof, map_fname, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
+	/*
+	 * Anything before the first section, or everything if we have no
+	 * map, is attributed to a section called code.
+	 */
+
+	if (prof.num_sections == 0 || prof.sections[0].start > 0) {
+		prv_add_section(&prof, 0, "code", err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+		code = prof.sections[prof.num_sections - 1];
+		memmove(&prof.sections[1], &prof.sections[0],
+			(prof.num_sections - 1) * sizeof(*prof.sections));
+		prof.sections[0] = code;
+	}
+
+	for (i = 0; i < vm->code_size; i++) {
+		if (!vm->hits[i])
+			continue;
+		s = prv_find_section(&prof, i);
+		s->hits += vm->hits[i];
+		s->cycles += vm->hit_cycles[i];
+		prof.hits += vm->hits[i];
+		prof.cycles += vm->hit_cycles[i];
+	}
+
+	printf("==== PROFILE ====\n\n");
+	printf("Instructions %" PRIu64 " Cycles %" PRIu64 "\n\n", prof.hits,
+	       prof.cycles);
+
+	prv_report_sections(&prof, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	prv_report_instrs(&prof, max_entries, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	prv_report_edges(&prof, max_entries, err);
+
+cleanup:
+
+	for (i = 0; i < prof.num_sections; i++)
+		free(prof.sections[i].name);
+	free(prof.sections);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBTILIS_ARM_PROFILE_H
+#define __SUBTILIS_ARM_PROFILE_H
+
+#include "arm_vm.h"
+
+/*
+ * Prints a report of the profile gathered by a VM that was run with
+ * profiling enabled.  The report lists the time spent in each section,
+ * the max_entries instructions that took the most cycles and the
+ * max_entries most frequently taken branches.  If map_fname is not
+ * NULL, it names a section map written by subtilis_arm_encode, which is
+ * used to report addresses as offsets from the start of the procedures
+ * and functions that contain them.
+ */
+
+void subtilis_arm_profile_report(subtilis_arm_vm_t *vm, const char *map_fname,
+				 size_t max_entries, subtilis_error_t *err);
+
+#endif
@@ -18,7 +18,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arm_global_alloc.h"
 #include "arm_int_dist.h"
+#include "arm_op_regs.h"
 #include "arm_reg_alloc.h"
 #include "arm_sub_section.h"
 
@@ -82,6 +84,17 @@
  * to check if that register is mapped and if it isn't we need to spill
  * its current contents and load its own value from the stack.
  *
+ * Optionally, when the global_reg_alloc setting is enabled, a global
+ * allocator is run before the basic blocks are linked.  It computes the
+ * liveness of the virtual registers that cross basic block boundaries
+ * over the whole section, loops included, and uses a linear scan to pin
+ * the most heavily used of these registers to a small pool of physical
+ * registers for the lifetime of the section.  Pinned registers are
+ * removed from the sets of registers transferred between basic blocks,
+ * so no loads and stores are generated for them, and the physical
+ * registers they occupy are reserved, so the local allocator never hands
+ * them out.  See arm_global_alloc.c for details.
+ *
  * Allocation is done via subtilis_arm_reg_alloc_alloc.  Allocation for fixed
  * registers is simple.  We just need to spill the current value assigned to the
  * register and it's ours.  Allocating a floating register is more
@@ -443,6 +456,7 @@ static void prv_check_current_ss(subtilis_arm_reg_ud_t *ud,
 static void prv_free_regs(subtilis_arm_reg_class_t *regs)
 {
 	if (regs) {
+		free(regs->pinned);
 		free(regs->spill_points);
 		free(regs->spill_stack);
 		free(regs->spilt_regs);
@@ -516,6 +530,14 @@ static void prv_init_arm_reg_ud(subtilis_arm_reg_ud_t *ud,
 	ud->ss_terminators = NULL;
 	ud->current_ss = 0;
 	ud->max_ss = 0;
+	ud->next_use.ops = NULL;
+	ud->next_use.base = 0;
+	ud->next_use.len = 0;
+	ud->next_use.uses = NULL;
+	ud->next_use.uses_count = 0;
+	ud->next_use.uses_max = 0;
+	ud->next_use.check = arm_s->settings && arm_s->settings->check_next_use;
+	ud->next_use.mismatches = 0;
 
 	subtilis_init_int_dist_walker(&ud->int_regs->dist_walker,
 				      &ud->dist_data);
@@ -527,6 +549,420 @@ static void prv_init_arm_reg_ud(subtilis_arm_reg_ud_t *ud,
 					  &ud->dist_data);
 }
 
+/*
+ * Runs the distance walker over a single op.  Returns true if the op
+ * reads or writes reg_num, in which case delta is set to -1 for a write
+ * and to the amount the walker added to last_used before it stopped for
+ * a read.  Otherwise delta is set to the number of instructions the
+ * walker would count for the op.  Some ops, e.g., instructions from the
+ * wrong FP architecture, cause the walker to stop regardless of the
+ * register.  These are detected by passing SIZE_MAX for reg_num.
+ */
+
+bool subtilis_arm_reg_alloc_op_event(subtilis_arm_reg_ud_t *ud,
+				     subtlis_arm_walker_t *walker,
+				     subtilis_arm_op_t *op, size_t reg_num,
+				     int *delta)
+{
+	subtilis_error_t err;
+
+	subtilis_error_init(&err);
+	ud->dist_data.reg_num = reg_num;
+	ud->dist_data.last_used = 0;
+	subtilis_arm_walk_from_to(ud->arm_s, walker, op, op, &err);
+	*delta = ud->dist_data.last_used;
+
+	return err.type != SUBTILIS_ERROR_OK;
+}
+
+static subtilis_arm_next_use_t *
+prv_nearest_use(subtilis_arm_next_use_t *a, subtilis_arm_next_use_t *b)
+{
+	if (a->pos == SIZE_MAX)
+		return b;
+	if (b->pos == SIZE_MAX)
+		return a;
+	return (a->pos > b->pos) ? a : b;
+}
+
+static void prv_add_next_use(subtilis_arm_reg_ud_t *ud,
+			     subtilis_arm_next_use_op_t *nop,
+			     subtilis_arm_op_t *op, size_t reg, bool real,
+			     subtilis_arm_next_use_t *next, size_t max_regs,
+			     subtilis_arm_next_use_t *barrier,
+			     subtilis_error_t *err)
+{
+	size_t i;
+	size_t new_max;
+	int delta;
+	size_t size;
+	subtilis_arm_next_use_t *use;
+	subtilis_arm_next_use_table_t *nu = &ud->next_use;
+	subtilis_arm_reg_class_t *regs = real ? ud->real_regs : ud->int_regs;
+
+	if ((reg >= max_regs) || regs->is_fixed(reg))
+		return;
+
+	for (i = nop->first; i < nu->uses_count; i++)
+		if ((nu->uses[i].reg == reg) && (nu->uses[i].real == real))
+			return;
+
+	if (nu->uses_count == nu->uses_max) {
+		new_max = nu->uses_max + SUBTILIS_CONFIG_PROGRAM_GRAN;
+		use = realloc(nu->uses, new_max * sizeof(*use));
+		if (!use) {
+			subtilis_error_set_oom(err);
+			return;
+		}
+		nu->uses = use;
+		nu->uses_max = new_max;
+	}
+
+	/*
+	 * The entry records the next use of the register after the
+	 * op, so it must be read before we take the op's own use of
+	 * the register into account.
+	 */
+
+	use = &nu->uses[nu->uses_count++];
+	*use = *prv_nearest_use(&next[reg], barrier);
+	use->reg = reg;
+	use->real = real;
+
+	if (subtilis_arm_reg_alloc_op_event(ud, &regs->dist_walker, op, reg,
+					    &delta)) {
+		size = real ? nop->real_size : nop->int_size;
+		next[reg].pos = nop->pos;
+		next[reg].size = size;
+		next[reg].delta = delta;
+	}
+}
+
+static void prv_add_next_uses(subtilis_arm_reg_ud_t *ud,
+			      subtilis_arm_next_use_op_t *nop,
+			      subtilis_arm_op_t *op,
+			      subtilis_arm_op_regs_t *op_regs,
+			      subtilis_arm_next_use_t *int_next,
+			      subtilis_arm_next_use_t *real_next,
+			      size_t max_regs,
+			      subtilis_arm_next_use_t *int_barrier,
+			      subtilis_arm_next_use_t *real_barrier,
+			      subtilis_error_t *err)
+{
+	size_t i;
+	size_t reg;
+
+	/*
+	 * The op regs walker doesn't know whether a register is an
+	 * integer or a floating point register so we add each register
+	 * to both classes.  The distance walker will discard the
+	 * register if it's not used by the op in that class.
+	 */
+
+	for (i = 0; i < op_regs->count; i++) {
+		reg = op_regs->regs[i];
+		prv_add_next_use(ud, nop, op, reg, false, int_next, max_regs,
+				 int_barrier, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		prv_add_next_use(ud, nop, op, reg, true, real_next, max_regs,
+				 real_barrier, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+}
+
+/*
+ * Returns an array containing the pool indices of the section's ops in
+ * the order in which they appear in the section.
+ */
+
+static size_t *prv_init_next_use_ops(subtilis_arm_reg_ud_t *ud,
+				     size_t *count, subtilis_error_t *err)
+{
+	size_t i;
+	size_t ptr;
+	size_t *order;
+	size_t min_ptr = SIZE_MAX;
+	size_t max_ptr = 0;
+	subtilis_arm_section_t *arm_s = ud->arm_s;
+	subtilis_arm_next_use_table_t *nu = &ud->next_use;
+
+	order = malloc(arm_s->len * sizeof(*order));
+	if (!order) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+
+	/*
+	 * The op pool is shared between all the sections of a program
+	 * so we only allocate enough entries to cover the range of ops
+	 * used by this section.
+	 */
+
+	i = 0;
+	ptr = arm_s->first_op;
+	while (ptr != SIZE_MAX) {
+		if (i == arm_s->len) {
+			subtilis_error_set_assertion_failed(err);
+			goto on_error;
+		}
+		order[i++] = ptr;
+		if (ptr < min_ptr)
+			min_ptr = ptr;
+		if (ptr > max_ptr)
+			max_ptr = ptr;
+		if (ptr == arm_s->last_op)
+			break;
+		ptr = arm_s->op_pool->ops[ptr].next;
+	}
+	*count = i;
+
+	nu->base = min_ptr;
+	nu->len = max_ptr - min_ptr + 1;
+	nu->ops = malloc(nu->len * sizeof(*nu->ops));
+	if (!nu->ops) {
+		subtilis_error_set_oom(err);
+		goto on_error;
+	}
+
+	for (i = 0; i < nu->len; i++) {
+		nu->ops[i].pos = SIZE_MAX;
+		nu->ops[i].count = 0;
+	}
+
+	return order;
+
+on_error:
+
+	free(order);
+
+	return NULL;
+}
+
+static subtilis_arm_next_use_t *prv_new_next_uses(size_t max_regs,
+						  subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_arm_next_use_t *next;
+
+	next = malloc((max_regs + 1) * sizeof(*next));
+	if (!next) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+
+	for (i = 0; i <= max_regs; i++)
+		next[i].pos = SIZE_MAX;
+
+	return next;
+}
+
+/*
+ * Computes the next use tables for the section in a single backwards
+ * pass.  This needs to be done after the basic blocks have been linked
+ * as linking adds new instructions to the section.  No instructions are
+ * added to the section during allocation, as the spill code is inserted
+ * afterwards, so the tables remain valid until allocation has completed.
+ */
+
+static void prv_compute_next_use(subtilis_arm_reg_ud_t *ud,
+				 subtilis_error_t *err)
+{
+	size_t ptr;
+	size_t pos;
+	size_t count = 0;
+	size_t *order;
+	size_t max_int_regs;
+	size_t max_real_regs;
+	size_t max_regs;
+	int int_delta;
+	int real_delta;
+	subtilis_arm_op_t *op;
+	subtilis_arm_next_use_op_t *nop;
+	subtilis_arm_op_regs_t op_regs;
+	subtlis_arm_walker_t regs_walker;
+	subtilis_arm_next_use_t int_barrier;
+	subtilis_arm_next_use_t real_barrier;
+	bool int_barrier_op;
+	bool real_barrier_op;
+	size_t int_size = 0;
+	size_t real_size = 0;
+	subtilis_arm_next_use_t *int_next = NULL;
+	subtilis_arm_next_use_t *real_next = NULL;
+	subtilis_arm_section_t *arm_s = ud->arm_s;
+
+	if (arm_s->last_op == SIZE_MAX)
+		return;
+
+	order = prv_init_next_use_ops(ud, &count, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/*
+	 * Single precision VFP registers are numbered independently of
+	 * the double precision registers, so we can't rely on
+	 * max_real_regs to bound the floating point register numbers.
+	 */
+
+	subtilis_arm_section_max_regs(arm_s, &max_int_regs, &max_real_regs);
+	if (max_real_regs > max_int_regs)
+		max_regs = max_real_regs;
+	else
+		max_regs = max_int_regs;
+
+	int_next = prv_new_next_uses(max_regs, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	real_next = prv_new_next_uses(max_regs, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	int_barrier.pos = SIZE_MAX;
+	real_barrier.pos = SIZE_MAX;
+	subtilis_init_op_regs_walker(&regs_walker, &op_regs);
+
+	for (pos = 0; pos < count; pos++) {
+		ptr = order[count - pos - 1];
+		op = &arm_s->op_pool->ops[ptr];
+		nop = &ud->next_use.ops[ptr - ud->next_use.base];
+		nop->pos = pos;
+
+		int_barrier_op = subtilis_arm_reg_alloc_op_event(
+		    ud, &ud->int_regs->dist_walker, op, SIZE_MAX, &int_delta);
+		if (!int_barrier_op)
+			int_size += int_delta;
+		real_barrier_op = subtilis_arm_reg_alloc_op_event(
+		    ud, &ud->real_regs->dist_walker, op, SIZE_MAX, &real_delta);
+		if (!real_barrier_op)
+			real_size += real_delta;
+		nop->int_size = int_size;
+		nop->real_size = real_size;
+
+		op_regs.count = 0;
+		subtilis_arm_walk_from_to(arm_s, &regs_walker, op, op, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		nop->first = ud->next_use.uses_count;
+		prv_add_next_uses(ud, nop, op, &op_regs, int_next, real_next,
+				  max_regs, &int_barrier, &real_barrier, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+		nop->count = ud->next_use.uses_count - nop->first;
+
+		if (int_barrier_op) {
+			int_barrier.pos = nop->pos;
+			int_barrier.size = int_size;
+			int_barrier.delta = int_delta;
+		}
+
+		if (real_barrier_op) {
+			real_barrier.pos = nop->pos;
+			real_barrier.size = real_size;
+			real_barrier.delta = real_delta;
+		}
+	}
+
+cleanup:
+
+	free(real_next);
+	free(int_next);
+	free(order);
+}
+
+static subtilis_arm_next_use_op_t *
+prv_next_use_op(subtilis_arm_reg_ud_t *ud, subtilis_arm_op_t *op)
+{
+	size_t ptr;
+	subtilis_arm_next_use_op_t *nop;
+	subtilis_arm_next_use_table_t *nu = &ud->next_use;
+
+	ptr = op - ud->arm_s->op_pool->ops;
+	if ((ptr < nu->base) || (ptr - nu->base >= nu->len))
+		return NULL;
+
+	nop = &nu->ops[ptr - nu->base];
+	if (nop->pos == SIZE_MAX)
+		return NULL;
+
+	return nop;
+}
+
+/*
+ * Looks up the distance of the next use of a virtual register after op
+ * in the next use tables.  The result is identical to the result that
+ * would be obtained by walking from op to the terminator of the current
+ * sub-section.  Returns false if the distance cannot be determined from
+ * the tables, in which case the caller needs to walk.
+ */
+
+static bool prv_lookup_next_use(subtilis_arm_reg_ud_t *ud, size_t reg_num,
+				bool real, subtilis_arm_op_t *op,
+				subtilis_arm_op_t *to, int *dist)
+{
+	size_t i;
+	size_t size;
+	subtilis_arm_next_use_t *use = NULL;
+	subtilis_arm_next_use_op_t *nop;
+	subtilis_arm_next_use_op_t *next_nop;
+	subtilis_arm_next_use_op_t *to_nop;
+	subtilis_arm_next_use_table_t *nu = &ud->next_use;
+
+	if (!nu->ops)
+		return false;
+
+	nop = prv_next_use_op(ud, op);
+	if (!nop)
+		return false;
+
+	for (i = nop->first; i < nop->first + nop->count; i++) {
+		if ((nu->uses[i].reg == reg_num) &&
+		    (nu->uses[i].real == real)) {
+			use = &nu->uses[i];
+			break;
+		}
+	}
+	if (!use)
+		return false;
+
+	if (use->pos == SIZE_MAX) {
+		*dist = -1;
+		return true;
+	}
+
+	next_nop = prv_next_use_op(ud, &ud->arm_s->op_pool->ops[op->next]);
+	if (!next_nop)
+		return false;
+
+	/*
+	 * The walk would stop at the terminator if the terminator lies
+	 * between op and the next use.
+	 */
+
+	if (to) {
+		to_nop = prv_next_use_op(ud, to);
+		if (!to_nop)
+			return false;
+		if ((next_nop->pos >= to_nop->pos) &&
+		    (use->pos < to_nop->pos)) {
+			*dist = -1;
+			return true;
+		}
+	}
+
+	if (use->delta == -1) {
+		*dist = -1;
+		return true;
+	}
+
+	size = real ? next_nop->real_size : next_nop->int_size;
+	*dist = (int)(ud->instr_count + 1 + (size - use->size)) + use->delta;
+
+	return true;
+}
+
 int subtilis_arm_reg_alloc_calculate_dist(subtilis_arm_reg_ud_t *ud,
 					  size_t reg_num, subtilis_arm_op_t *op,
 					  subtlis_arm_walker_t *walker,
@@ -534,13 +970,17 @@ int subtilis_arm_reg_alloc_calculate_dist(subtilis_arm_reg_ud_t *ud,
 {
 	subtilis_error_t err;
 	subtilis_arm_op_t *to;
+	subtilis_arm_op_t *from;
+	int dist;
+	int walk_dist;
+	bool looked_up = false;
 
 	subtilis_error_init(&err);
 
 	if (op->next == SIZE_MAX)
 		return -1;
 
-	op = &ud->arm_s->op_pool->ops[op->next];
+	from = &ud->arm_s->op_pool->ops[op->next];
 
 	/*
 	 * If we're calculating the distance for a virtual register
@@ -555,14 +995,28 @@ int subtilis_arm_reg_alloc_calculate_dist(subtilis_arm_reg_ud_t *ud,
 		to = ud->ss_terminators[ud->current_ss];
 	else
 		to = NULL;
+
+	if (!regs->is_fixed(reg_num) &&
+	    prv_lookup_next_use(ud, reg_num, regs == ud->real_regs, op, to,
+				&dist)) {
+		if (!ud->next_use.check)
+			return dist;
+		looked_up = true;
+	}
+
 	ud->dist_data.reg_num = reg_num;
 	ud->dist_data.last_used = ud->instr_count + 1;
 
-	subtilis_arm_walk_from_to(ud->arm_s, walker, op, to, &err);
+	subtilis_arm_walk_from_to(ud->arm_s, walker, from, to, &err);
 	if (err.type != SUBTILIS_ERROR_OK)
-		return ud->dist_data.last_used;
+		walk_dist = ud->dist_data.last_used;
 	else
-		return -1;
+		walk_dist = -1;
+
+	if (looked_up && (walk_dist != dist))
+		ud->next_use.mismatches++;
+
+	return walk_dist;
 }
 
 static void prv_free_arm_reg_ud(subtilis_arm_reg_ud_t *ud)
@@ -573,6 +1027,8 @@ static void prv_free_arm_reg_ud(subtilis_arm_reg_ud_t *ud)
 	prv_free_regs(ud->real_regs);
 	prv_free_regs(ud->int_regs);
 	free(ud->ss_terminators);
+	free(ud->next_use.uses);
+	free(ud->next_use.ops);
 }
 
 static size_t prv_virt_to_phys(subtilis_arm_reg_class_t *regs,
@@ -625,6 +1081,7 @@ static void prv_insert_spill_code_store(subtilis_arm_section_t *arm_s,
 
 		for (i = 0; i < int_regs->max_regs; i++)
 			if ((int_regs->phys_to_virt[i] == INT_MAX) &&
+			    !(int_regs->reserved & (1 << i)) &&
 			    (int_regs != regs || i != reg))
 				break;
 
@@ -771,6 +1228,12 @@ static void prv_spill_reg(subtilis_arm_reg_ud_t *ud, subtilis_arm_op_t *current,
 			    err);
 }
 
+static bool prv_is_pinned(subtilis_arm_reg_class_t *regs, size_t reg)
+{
+	return regs->pinned && (reg < regs->vr_reg_count) &&
+	       (regs->pinned[reg] != SIZE_MAX);
+}
+
 static void prv_allocate_fixed(subtilis_arm_reg_ud_t *ud,
 			       subtilis_arm_op_t *current,
 			       subtilis_arm_reg_class_t *int_regs,
@@ -808,6 +1271,7 @@ prv_allocate_floating(subtilis_arm_reg_ud_t *ud, subtilis_arm_op_t *current,
 
 	for (i = regs->max_regs - 1; i >= 0; i--)
 		if ((regs->phys_to_virt[i] == INT_MAX) &&
+		    !(regs->reserved & (1 << i)) &&
 		    (restricted == SIZE_MAX || restricted != i))
 			break;
 
@@ -818,6 +1282,7 @@ prv_allocate_floating(subtilis_arm_reg_ud_t *ud, subtilis_arm_op_t *current,
 
 		for (i = 0; i < regs->max_regs; i++)
 			if ((regs->next[i] > max_next) &&
+			    !(regs->reserved & (1 << i)) &&
 			    (restricted == SIZE_MAX || restricted != i)) {
 				max_next = regs->next[i];
 				next = i;
@@ -847,6 +1312,16 @@ void subtilis_arm_reg_alloc_alloc(subtilis_arm_reg_ud_t *ud,
 	size_t assigned;
 	size_t virt_num = *reg;
 
+	/*
+	 * Pinned registers are owned by the global allocator.  They're never
+	 * spilled so there's nothing to record in phys_to_virt.
+	 */
+
+	if (prv_is_pinned(regs, *reg)) {
+		*reg = regs->pinned[*reg];
+		return;
+	}
+
 	if (regs->is_fixed(*reg)) {
 		if (*reg >= regs->max_regs)
 			return;
@@ -867,7 +1342,10 @@ void subtilis_arm_reg_alloc_alloc(subtilis_arm_reg_ud_t *ud,
 	regs->phys_to_virt[*reg] = virt_num;
 }
 
-/* Returns true if register is of fixed use, e.g., R13. */
+/*
+ * Returns true if register is of fixed use, e.g., R13, or is pinned to a
+ * physical register by the global allocator.
+ */
 
 bool subtilis_arm_reg_alloc_ensure(subtilis_arm_reg_ud_t *ud,
 				   subtilis_arm_op_t *current,
@@ -879,6 +1357,11 @@ bool subtilis_arm_reg_alloc_ensure(subtilis_arm_reg_ud_t *ud,
 	size_t assigned;
 	subtilis_arm_reg_t target_reg;
 
+	if (prv_is_pinned(regs, *reg)) {
+		*reg = regs->pinned[*reg];
+		return true;
+	}
+
 	if (regs->is_fixed(*reg)) {
 		/*
 		 * Register has fixed use and is unavailable to user's code
@@ -997,6 +1480,11 @@ static void prv_allocate_dest_restricted(subtilis_arm_reg_ud_t *ud,
 	    (vreg_dest >= SUBTILIS_ARM_REG_MAX_INT_REGS))
 		return;
 
+	if (prv_is_pinned(ud->int_regs, vreg_dest)) {
+		*dest = ud->int_regs->pinned[vreg_dest];
+		return;
+	}
+
 	subtilis_arm_reg_alloc_alloc(ud, op, ud->int_regs, ud->int_regs, dest,
 				     restricted, err);
 	if (err->type != SUBTILIS_ERROR_OK)
@@ -1024,6 +1512,11 @@ void subtilis_arm_reg_alloc_alloc_fp_dest(subtilis_arm_reg_ud_t *ud,
 	int dist_dest;
 	size_t vreg_dest = *dest;
 
+	if (prv_is_pinned(ud->real_regs, vreg_dest)) {
+		*dest = ud->real_regs->pinned[vreg_dest];
+		return;
+	}
+
 	subtilis_arm_reg_alloc_alloc(ud, op, ud->int_regs, ud->real_regs, dest,
 				     SIZE_MAX, err);
 	if (err->type != SUBTILIS_ERROR_OK)
@@ -1161,13 +1654,34 @@ static void prv_alloc_mul_instr(void *user_data, subtilis_arm_op_t *op,
 			ud->int_regs->phys_to_virt[instr->rs] = INT_MAX;
 	}
 
-	prv_allocate_dest_restricted(ud, op, &instr->dest, instr->rm, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
+	/*
+	 * The ARMv6 long multiplies don't restrict rm, but RdHi and RdLo,
+	 * stored in dest and rn, must be different.
+	 */
 
-	if (instr->dest == instr->rm) {
-		subtilis_error_set_assertion_failed(err);
-		return;
+	if ((type == SUBTILIS_ARM_INSTR_SMULL) ||
+	    (type == SUBTILIS_ARM_INSTR_UMULL)) {
+		subtilis_arm_reg_alloc_alloc_dest(ud, op, &instr->dest, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		prv_allocate_dest_restricted(ud, op, &instr->rn, instr->dest,
+					     err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		if (instr->dest == instr->rn) {
+			subtilis_error_set_assertion_failed(err);
+			return;
+		}
+	} else {
+		prv_allocate_dest_restricted(ud, op, &instr->dest, instr->rm,
+					     err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		if (instr->dest == instr->rm) {
+			subtilis_error_set_assertion_failed(err);
+			return;
+		}
 	}
 
 	if (!fixed_reg_rm)
@@ -1185,7 +1699,7 @@ static void prv_alloc_stran_instr(void *user_data, subtilis_arm_op_t *op,
 {
 	int dist_dest;
 	int dist_op2;
-	size_t vreg_dest;
+	size_t vreg_dest = 0;
 	size_t vreg_base;
 	bool fixed_reg_base;
 	bool fixed_reg_dest = false;
@@ -1558,6 +2072,34 @@ static void prv_alloc_signx_instr(void *user_data, subtilis_arm_op_t *op,
 	ud->instr_count++;
 }
 
+static void prv_alloc_pld_instr(void *user_data, subtilis_arm_op_t *op,
+				subtilis_arm_instr_type_t type,
+				subtilis_arm_pld_instr_t *instr,
+				subtilis_error_t *err)
+{
+	size_t vreg_base;
+	bool fixed_reg_base;
+	int dist_base;
+	subtilis_arm_reg_ud_t *ud = user_data;
+
+	vreg_base = instr->base;
+	fixed_reg_base = subtilis_arm_reg_alloc_ensure(
+	    ud, op, ud->int_regs, ud->int_regs, &instr->base, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (!fixed_reg_base) {
+		dist_base = subtilis_arm_reg_alloc_calculate_dist(
+		    ud, vreg_base, op, &ud->int_regs->dist_walker,
+		    ud->int_regs);
+		if (dist_base == -1)
+			ud->int_regs->phys_to_virt[instr->base] = INT_MAX;
+		ud->int_regs->next[instr->base] = dist_base;
+	}
+
+	ud->instr_count++;
+}
+
 static void prv_sub_section_int_links(subtilis_arm_reg_ud_t *ud,
 				      subtilis_bitset_t *int_save,
 				      subtilis_arm_ccode_type_t ccode,
@@ -1589,6 +2131,7 @@ static void prv_sub_section_int_links(subtilis_arm_reg_ud_t *ud,
 		}
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
+		ud->arm_s->spill_count++;
 	}
 }
 
@@ -1624,6 +2167,7 @@ static void prv_sub_section_real_links(subtilis_arm_reg_ud_t *ud,
 		}
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
+		ud->arm_s->spill_count++;
 	}
 }
 
@@ -1813,6 +2357,7 @@ static void prv_init_sub_section(subtilis_arm_reg_ud_t *ud,
 			    SUBTILIS_ARM_CCODE_AL, i, 11, offset, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
+		ud->arm_s->spill_count++;
 	}
 
 	for (i = 0; i <= ss->real_inputs.max_value; i++) {
@@ -1834,6 +2379,7 @@ static void prv_init_sub_section(subtilis_arm_reg_ud_t *ud,
 			    SUBTILIS_ARM_CCODE_AL, i, 11, offset, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
+		ud->arm_s->spill_count++;
 	}
 }
 
@@ -1851,6 +2397,12 @@ static void prv_link_basic_blocks(subtilis_arm_reg_ud_t *ud,
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	if (ud->arm_s->settings && ud->arm_s->settings->global_reg_alloc) {
+		subtilis_arm_global_alloc(ud, &sss, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
 	ud->max_ss = sss.count;
 	ud->ss_terminators = calloc(sss.count, sizeof(*ud->ss_terminators));
 	if (!ud->ss_terminators) {
@@ -1910,6 +2462,10 @@ size_t subtilis_arm_reg_alloc(subtilis_arm_section_t *arm_s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return 0;
 
+	prv_compute_next_use(&ud, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
 	walker.user_data = &ud;
 	walker.label_fn = prv_alloc_label;
 	walker.directive_fn = prv_alloc_directive;
@@ -1929,12 +2485,18 @@ size_t subtilis_arm_reg_alloc(subtilis_arm_section_t *arm_s,
 	walker.stran_misc_fn = NULL;
 	walker.simd_fn = NULL;
 	walker.signx_fn = prv_alloc_signx_instr;
+	walker.pld_fn = prv_alloc_pld_instr;
 	arm_s->fp_if->init_real_alloc_fn(&walker, &ud);
 
 	subtilis_arm_walk(arm_s, &walker, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	if (ud.next_use.mismatches > 0) {
+		subtilis_error_set_assertion_failed(err);
+		goto cleanup;
+	}
+
 	/*
 	 * See the description of the stack layout above to understand
 	 * this code.  The register allocators assume they are sole
@@ -1991,6 +2553,8 @@ size_t subtilis_arm_reg_alloc(subtilis_arm_section_t *arm_s,
 		goto cleanup;
 
 	arm_s->reg_counter = 16;
+	arm_s->spill_count += ud.int_regs->spill_points_count +
+			      ud.real_regs->spill_points_count;
 
 	retval = (ud.int_regs->spill_max * sizeof(int32_t)) +
 		 (ud.real_regs->spill_max * sizeof(double)) +
@@ -2279,6 +2843,7 @@ static void prv_compute_regs_used(subtilis_arm_section_t *arm_s,
 	mtran = &op->op.instr.operands.mtran;
 
 	*int_regs_used = regs_used_before.int_regs & regs_used_after.int_regs;
+	*int_regs_used |= call_site->int_regs_live;
 	*int_regs_used |= mtran->reg_list;
 
 	if (br->link_type == SUBTILIS_ARM_BR_LINK_INT)
@@ -2295,6 +2860,7 @@ static void prv_compute_regs_used(subtilis_arm_section_t *arm_s,
 
 	*real_regs_used =
 	    regs_used_before.real_regs & regs_used_after.real_regs;
+	*real_regs_used |= call_site->real_regs_live;
 
 	if (br->link_type == SUBTILIS_ARM_BR_LINK_REAL)
 		*real_regs_used &= ~((size_t)1);
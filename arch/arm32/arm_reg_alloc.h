@@ -99,10 +99,68 @@ struct subtilis_arm_reg_class_t_ {
 	size_t spill_points_max;
 	subtlis_arm_walker_t dist_walker;
 	subtlis_arm_walker_t used_walker;
+
+	/*
+	 * Virtual registers pinned to a physical register for the lifetime
+	 * of the section by the global allocator.  pinned is NULL if no
+	 * registers are pinned, otherwise it maps each virtual register to
+	 * its physical register, or SIZE_MAX.  reserved is a mask of the
+	 * physical registers that are unavailable to the local allocator.
+	 */
+
+	size_t *pinned;
+	size_t reserved;
 };
 
 typedef struct subtilis_arm_reg_class_t_ subtilis_arm_reg_class_t;
 
+/*
+ * The next use tables record, for each virtual register operand of each
+ * instruction in a section, the next instruction that reads or writes
+ * that register.  They're computed in a single backwards pass over the
+ * section before allocation begins and allow
+ * subtilis_arm_reg_alloc_calculate_dist to avoid walking the section
+ * each time it needs to compute a distance.  Positions are counted
+ * backwards from the end of the section and sizes hold the number of ops
+ * between an op and the end of the section that would be counted by the
+ * distance walkers.  If check is set every distance obtained from the
+ * tables is compared with the distance obtained by walking the section
+ * and any differences are counted in mismatches.
+ */
+
+struct subtilis_arm_next_use_t_ {
+	size_t reg;
+	bool real;
+	size_t pos;
+	size_t size;
+	int delta;
+};
+
+typedef struct subtilis_arm_next_use_t_ subtilis_arm_next_use_t;
+
+struct subtilis_arm_next_use_op_t_ {
+	size_t pos;
+	size_t int_size;
+	size_t real_size;
+	size_t first;
+	size_t count;
+};
+
+typedef struct subtilis_arm_next_use_op_t_ subtilis_arm_next_use_op_t;
+
+struct subtilis_arm_next_use_table_t_ {
+	subtilis_arm_next_use_op_t *ops;
+	size_t base;
+	size_t len;
+	subtilis_arm_next_use_t *uses;
+	size_t uses_count;
+	size_t uses_max;
+	bool check;
+	size_t mismatches;
+};
+
+typedef struct subtilis_arm_next_use_table_t_ subtilis_arm_next_use_table_t;
+
 struct subtilis_arm_reg_ud_t_ {
 	size_t basic_block_spill;
 	subtilis_arm_reg_class_t *int_regs;
@@ -113,6 +171,7 @@ struct subtilis_arm_reg_ud_t_ {
 	subtilis_arm_op_t **ss_terminators;
 	size_t current_ss;
 	size_t max_ss;
+	subtilis_arm_next_use_table_t next_use;
 };
 
 typedef struct subtilis_arm_reg_ud_t_ subtilis_arm_reg_ud_t;
@@ -167,6 +226,10 @@ void subtilis_arm_reg_alloc_alloc_fp_dest(subtilis_arm_reg_ud_t *ud,
 					  subtilis_arm_reg_t *dest,
 					  subtilis_error_t *err);
 
+bool subtilis_arm_reg_alloc_op_event(subtilis_arm_reg_ud_t *ud,
+				     subtlis_arm_walker_t *walker,
+				     subtilis_arm_op_t *op, size_t reg_num,
+				     int *delta);
 int subtilis_arm_reg_alloc_calculate_dist(subtilis_arm_reg_ud_t *ud,
 					  size_t reg_num, subtilis_arm_op_t *op,
 					  subtlis_arm_walker_t *walker,
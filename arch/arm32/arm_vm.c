@@ -51,6 +51,21 @@ subtilis_arm_vm_t *subtilis_arm_vm_new(uint8_t *code, size_t code_size,
 	arm_vm->code_size = code_size / 4;
 	arm_vm->mem_size = mem_size;
 
+	if (arm_vm->code_size > 0) {
+		arm_vm->decoded =
+		    malloc(sizeof(*arm_vm->decoded) * arm_vm->code_size);
+		if (!arm_vm->decoded) {
+			subtilis_error_set_oom(err);
+			goto fail;
+		}
+		arm_vm->decoded_valid = calloc(
+		    arm_vm->code_size, sizeof(*arm_vm->decoded_valid));
+		if (!arm_vm->decoded_valid) {
+			subtilis_error_set_oom(err);
+			goto fail;
+		}
+	}
+
 	arm_vm->reverse_fpa_consts = !vfp && (*lower_word) == 0;
 	arm_vm->start_address = start_address;
 	arm_vm->vfp = vfp;
@@ -79,6 +94,19 @@ fail:
 	return NULL;
 }
 
+static void prv_free_blocks(subtilis_arm_vm_t *arm_vm)
+{
+	size_t i;
+
+	if (!arm_vm->blocks)
+		return;
+
+	for (i = 0; i < arm_vm->code_size; i++) {
+		free(arm_vm->blocks[i]);
+		arm_vm->blocks[i] = NULL;
+	}
+}
+
 static void prv_set_error(subtilis_arm_vm_t *arm_vm, int32_t error_code)
 {
 	*((uint32_t *)&arm_vm->memory[arm_vm->mem_size - 4]) = error_code;
@@ -97,10 +125,43 @@ void subtilis_arm_vm_delete(subtilis_arm_vm_t *vm)
 		if (vm->files[i])
 			fclose(vm->files[i]);
 
+	prv_free_blocks(vm);
+	free(vm->edges);
+	free(vm->hit_cycles);
+	free(vm->hits);
+	free(vm->blocks);
+	free(vm->decoded_valid);
+	free(vm->decoded);
 	free(vm->memory);
 	free(vm);
 }
 
+/*
+ * Must be called whenever the VM writes to its own memory so that any
+ * cached decodings of the words being overwritten are discarded.  addr is
+ * an offset into arm_vm->memory.
+ */
+
+static void prv_invalidate_code(subtilis_arm_vm_t *arm_vm, size_t addr,
+				size_t len)
+{
+	size_t i;
+	size_t end;
+
+	if (len == 0 || addr >= arm_vm->code_size * 4)
+		return;
+
+	end = (addr + len + 3) / 4;
+	if (end > arm_vm->code_size)
+		end = arm_vm->code_size;
+
+	for (i = addr / 4; i < end; i++)
+		arm_vm->decoded_valid[i] = false;
+
+	if (arm_vm->blocks)
+		arm_vm->code_written = true;
+}
+
 static size_t prv_calc_pc(subtilis_arm_vm_t *vm)
 {
 	return (size_t)(((vm->regs[15] - vm->start_address) - 8) / 4);
@@ -208,6 +269,10 @@ static int32_t prv_eval_op2(subtilis_arm_vm_t *arm_vm, bool status,
 				subtilis_error_set_assertion_failed(err);
 				return 0;
 			}
+			if (shift == 32) {
+				reg = 0;
+				break;
+			}
 			neg = reg < 0;
 			reg = reg >> shift;
 			if (neg && reg < 0)
@@ -221,6 +286,10 @@ static int32_t prv_eval_op2(subtilis_arm_vm_t *arm_vm, bool status,
 				return 0;
 			}
 			neg = reg < 0;
+			if (shift == 32) {
+				reg = neg ? -1 : 0;
+				break;
+			}
 			reg = reg >> shift;
 			if (neg && reg > 0)
 				reg |= ~(((uint32_t)0xffffffff) >> shift);
@@ -881,7 +950,7 @@ static void prv_process_mvn(subtilis_arm_vm_t *arm_vm,
 		return;
 
 	if (op->status) {
-		prv_set_and_flags(arm_vm, op2);
+		prv_set_and_flags(arm_vm, ~op2);
 		if (op->op2.type == SUBTILIS_ARM_OP2_SHIFTED) {
 			op2_old = arm_vm->regs[op->op2.op.shift.reg];
 			prv_set_shift_flags(arm_vm, op2_old, -op2,
@@ -918,6 +987,34 @@ static void prv_process_mla(subtilis_arm_vm_t *arm_vm,
 	arm_vm->regs[15] += 4;
 }
 
+static void prv_process_mull(subtilis_arm_vm_t *arm_vm,
+			     subtilis_arm_instr_type_t type,
+			     subtilis_arm_mul_instr_t *op,
+			     subtilis_error_t *err)
+{
+	uint64_t product;
+
+	if (!prv_match_ccode(arm_vm, op->ccode)) {
+		arm_vm->regs[15] += 4;
+		return;
+	}
+
+	if (type == SUBTILIS_ARM_INSTR_SMULL)
+		product = (uint64_t)((int64_t)arm_vm->regs[op->rm] *
+				     (int64_t)arm_vm->regs[op->rs]);
+	else
+		product = (uint64_t)(uint32_t)arm_vm->regs[op->rm] *
+			  (uint32_t)arm_vm->regs[op->rs];
+
+	arm_vm->regs[op->rn] = (int32_t)(uint32_t)product;
+	arm_vm->regs[op->dest] = (int32_t)(uint32_t)(product >> 32);
+	if (op->status) {
+		arm_vm->negative_flag = (product >> 63) != 0;
+		arm_vm->zero_flag = product == 0;
+	}
+	arm_vm->regs[15] += 4;
+}
+
 static void prv_process_ldr(subtilis_arm_vm_t *arm_vm,
 			    subtilis_arm_stran_instr_t *op,
 			    subtilis_error_t *err)
@@ -953,6 +1050,7 @@ static void prv_process_str(subtilis_arm_vm_t *arm_vm,
 	addr = prv_compute_stran_addr(arm_vm, op, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
+	prv_invalidate_code(arm_vm, addr, op->byte ? 1 : 4);
 	if (op->byte)
 		*((uint8_t *)&arm_vm->memory[addr]) =
 		    arm_vm->regs[op->dest] & 255;
@@ -1021,6 +1119,7 @@ static void prv_process_stran_misc_str(subtilis_arm_vm_t *arm_vm,
 		subtilis_error_set_assertion_failed(err);
 		break;
 	case SUBTILIS_ARM_STRAN_MISC_H:
+		prv_invalidate_code(arm_vm, addr, 2);
 		*((uint16_t *)&arm_vm->memory[addr]) =
 		    (uint16_t)arm_vm->regs[op->dest];
 		break;
@@ -1029,6 +1128,7 @@ static void prv_process_stran_misc_str(subtilis_arm_vm_t *arm_vm,
 			subtilis_error_set_assertion_failed(err);
 			return;
 		}
+		prv_invalidate_code(arm_vm, addr, 8);
 		*((uint32_t *)&arm_vm->memory[addr]) = arm_vm->regs[op->dest];
 		*((uint32_t *)&arm_vm->memory[addr + 4]) =
 		    arm_vm->regs[op->dest + 1];
@@ -1143,6 +1243,7 @@ static void prv_get_hash(subtilis_arm_vm_t *arm_vm, subtilis_error_t *err)
 	}
 
 	ptr = arm_vm->regs[2] - arm_vm->start_address;
+	prv_invalidate_code(arm_vm, ptr, arm_vm->regs[3]);
 
 	do {
 		bytes_read += fread(&arm_vm->memory[ptr], 1, arm_vm->regs[3],
@@ -1325,6 +1426,42 @@ static void prv_oscli(subtilis_arm_vm_t *arm_vm, int32_t code,
 		prv_set_error(arm_vm, ret);
 }
 
+/*
+ * OS_WriteC, OS_WriteI and OS_WriteN all send their bytes to the VDU
+ * driver.  We don't emulate the VDU control sequences so we only output
+ * printable characters, line feeds and carriage returns.
+ */
+
+static bool prv_vdu_printable(uint8_t c)
+{
+	return c == 10 || c == 13 || (c >= 32 && c <= 127);
+}
+
+/*
+ * OS_WriteN needs to filter its bytes in the same way as OS_WriteC and
+ * OS_WriteI.  This matters for VDU statements, which are written with
+ * OS_WriteN if they contain more than one byte and with OS_WriteI or
+ * OS_WriteC otherwise.
+ */
+
+static void prv_write_n(subtilis_buffer_t *b, const uint8_t *addr, size_t len,
+			subtilis_error_t *err)
+{
+	size_t i;
+	size_t start = 0;
+
+	for (i = 0; i < len; i++) {
+		if (prv_vdu_printable(addr[i]))
+			continue;
+		subtilis_buffer_append(b, &addr[start], i - start, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		start = i + 1;
+	}
+
+	subtilis_buffer_append(b, &addr[start], len - start, err);
+}
+
 static void prv_process_swi(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
 			    subtilis_arm_swi_instr_t *op, subtilis_error_t *err)
 {
@@ -1372,6 +1509,7 @@ static void prv_process_swi(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
 		    prv_get_vm_address(arm_vm, arm_vm->regs[1], buf_len, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
+		prv_invalidate_code(arm_vm, addr - arm_vm->memory, buf_len);
 		memcpy(addr, buf, buf_len);
 		arm_vm->regs[0] = arm_vm->regs[1];
 		arm_vm->regs[1] += buf_len;
@@ -1382,8 +1520,7 @@ static void prv_process_swi(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
 		/* OS_WriteCh  */
 		buf[0] = arm_vm->regs[0] & 0xff;
 		buf[1] = 0;
-		if (buf[0] == 10 || buf[0] == 13 ||
-		    (buf[0] >= 32 && buf[0] <= 127)) {
+		if (prv_vdu_printable(buf[0])) {
 			subtilis_buffer_append_string(b, buf, err);
 			if (err->type != SUBTILIS_ERROR_OK)
 				return;
@@ -1407,7 +1544,7 @@ static void prv_process_swi(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
 					  arm_vm->regs[1], err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
-		subtilis_buffer_append(b, addr, arm_vm->regs[1], err);
+		prv_write_n(b, addr, arm_vm->regs[1], err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
 		break;
@@ -1440,6 +1577,7 @@ static void prv_process_swi(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
 		/* OS_Word  */
 		if (arm_vm->regs[0] == 1) {
 			ptr = arm_vm->regs[1] - arm_vm->start_address;
+			prv_invalidate_code(arm_vm, ptr, 4);
 			*((int32_t *)&arm_vm->memory[ptr]) =
 			    subtilis_get_i32_time();
 		}
@@ -1477,7 +1615,9 @@ static void prv_process_swi(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
 	default:
 		code = op->code;
 		code &= ~((size_t)0x20000);
-		if (code >= (256 + 32) && code < 512) {
+		/* OS_WriteI */
+		if (code >= 256 && code < 512 &&
+		    prv_vdu_printable(code - 256)) {
 			buf[0] = code - 256;
 			buf[1] = 0;
 			subtilis_buffer_append_string(b, buf, err);
@@ -1502,6 +1642,7 @@ static size_t prv_write_multiple_reg(subtilis_arm_vm_t *arm_vm,
 		subtilis_error_set_assertion_failed(err);
 		return -1;
 	}
+	prv_invalidate_code(arm_vm, addr, 4);
 	*((int32_t *)&arm_vm->memory[addr]) = arm_vm->regs[i];
 	return addr + after;
 }
@@ -1754,6 +1895,7 @@ static void prv_process_fpa_stf(subtilis_arm_vm_t *arm_vm,
 	addr = prv_compute_fpa_stran_addr(arm_vm, op, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
+	prv_invalidate_code(arm_vm, addr, op->size);
 	if (op->size == 4) {
 		*((float *)&arm_vm->memory[addr]) =
 		    arm_vm->fregs[op->dest].val.real32;
@@ -2396,6 +2538,7 @@ static void prv_process_vfp_stf(subtilis_arm_vm_t *arm_vm,
 	addr = prv_compute_vfp_stran_addr(arm_vm, op, size, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
+	prv_invalidate_code(arm_vm, addr, size);
 	if (size == 4) {
 		*((float *)&arm_vm->memory[addr]) = arm_vm->vpfregs.f[op->dest];
 	} else if (size == 8) {
@@ -3932,611 +4075,1455 @@ static void prv_process_sxth(subtilis_arm_vm_t *arm_vm,
 	arm_vm->regs[15] += 4;
 }
 
-void subtilis_arm_vm_run(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
-			 subtilis_error_t *err)
+static void prv_process_uxtb(subtilis_arm_vm_t *arm_vm,
+			     subtilis_arm_signx_instr_t *op,
+			     subtilis_error_t *err)
 {
-	size_t pc;
-	subtilis_arm_instr_t instr;
+	if (!prv_match_ccode(arm_vm, op->ccode)) {
+		arm_vm->regs[15] += 4;
+		return;
+	}
 
-	arm_vm->fpa_status = 0;
-	arm_vm->quit = false;
-	arm_vm->negative_flag = false;
-	arm_vm->zero_flag = false;
-	arm_vm->carry_flag = false;
-	arm_vm->overflow_flag = false;
-	arm_vm->fpscr = 0;
+	arm_vm->regs[op->dest] =
+	    prv_signx_rotate(arm_vm->regs[op->op1], op->rotate) & 0xff;
+	arm_vm->regs[15] += 4;
+}
 
-	arm_vm->regs[15] = arm_vm->start_address + 8;
+static void prv_process_uxtb16(subtilis_arm_vm_t *arm_vm,
+			       subtilis_arm_signx_instr_t *op,
+			       subtilis_error_t *err)
+{
+	if (!prv_match_ccode(arm_vm, op->ccode)) {
+		arm_vm->regs[15] += 4;
+		return;
+	}
 
-	pc = prv_calc_pc(arm_vm);
-	while (!arm_vm->quit && pc < arm_vm->code_size) {
-		subtilis_arm_disass(&instr, ((uint32_t *)arm_vm->memory)[pc],
-				    arm_vm->vfp, err);
-		if (err->type != SUBTILIS_ERROR_OK)
-			return;
-		switch (instr.type) {
-		case SUBTILIS_ARM_INSTR_AND:
-			prv_process_and(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_EOR:
-			prv_process_eor(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_SUB:
-			prv_process_sub(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_RSB:
-			prv_process_rsb(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_ADD:
-			prv_process_add(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_ADC:
-			prv_process_adc(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_CMP:
-			prv_process_cmp(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_CMN:
-			prv_process_cmn(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_TST:
-			prv_process_tst(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_TEQ:
-			prv_process_teq(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_ORR:
-			prv_process_orr(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_MOV:
-			prv_process_mov(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_BIC:
-			prv_process_bic(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_MVN:
-			prv_process_mvn(arm_vm, &instr.operands.data, err);
-			break;
-		case SUBTILIS_ARM_INSTR_MUL:
-			prv_process_mul(arm_vm, &instr.operands.mul, err);
-			break;
-		case SUBTILIS_ARM_INSTR_MLA:
-			prv_process_mla(arm_vm, &instr.operands.mul, err);
-			break;
-		case SUBTILIS_ARM_INSTR_LDR:
-			prv_process_ldr(arm_vm, &instr.operands.stran, err);
-			break;
-		case SUBTILIS_ARM_INSTR_STR:
-			prv_process_str(arm_vm, &instr.operands.stran, err);
-			break;
-		case SUBTILIS_ARM_INSTR_B:
-			prv_process_b(arm_vm, &instr.operands.br, err);
-			break;
-		case SUBTILIS_ARM_INSTR_SWI:
-			prv_process_swi(arm_vm, b, &instr.operands.swi, err);
-			break;
-		case SUBTILIS_ARM_INSTR_STM:
-			prv_process_stm(arm_vm, &instr.operands.mtran, err);
-			break;
-		case SUBTILIS_ARM_INSTR_LDM:
-			prv_process_ldm(arm_vm, &instr.operands.mtran, err);
-			break;
-		case SUBTILIS_ARM_INSTR_MSR:
-			prv_process_msr(arm_vm, &instr.operands.flags, err);
-			break;
-		case SUBTILIS_ARM_INSTR_MRS:
-			prv_process_mrs(arm_vm, &instr.operands.flags, err);
-			break;
-		case SUBTILIS_FPA_INSTR_LDF:
-			prv_process_fpa_ldf(arm_vm, &instr.operands.fpa_stran,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_STF:
-			prv_process_fpa_stf(arm_vm, &instr.operands.fpa_stran,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_MVF:
-			prv_process_fpa_mvf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_MNF:
-			prv_process_fpa_mnf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_ADF:
-			prv_process_fpa_adf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_MUF:
-			prv_process_fpa_muf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_SUF:
-			prv_process_fpa_suf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_RSF:
-			prv_process_fpa_rsf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_DVF:
-			prv_process_fpa_dvf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_RDF:
-			prv_process_fpa_rdf(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_FLT:
-			prv_process_fpa_flt(arm_vm, &instr.operands.fpa_tran,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_FIX:
-			prv_process_fpa_fix(arm_vm, &instr.operands.fpa_tran,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_CMF:
-			prv_process_fpa_cmf(arm_vm, &instr.operands.fpa_cmp,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_CNF:
-			prv_process_fpa_cnf(arm_vm, &instr.operands.fpa_cmp,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_SIN:
-			prv_process_fpa_sin(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_COS:
-			prv_process_fpa_cos(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_TAN:
-			prv_process_fpa_tan(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_ASN:
-			prv_process_fpa_asn(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_ACS:
-			prv_process_fpa_acs(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_ATN:
-			prv_process_fpa_atn(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_SQT:
-			prv_process_fpa_sqr(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_LOG:
-			prv_process_fpa_log(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_LGN:
-			prv_process_fpa_ln(arm_vm, &instr.operands.fpa_data,
-					   err);
-			break;
-		case SUBTILIS_FPA_INSTR_EXP:
-			prv_process_fpa_exp(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_ABS:
-			prv_process_fpa_abs(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_WFS:
-			prv_process_fpa_wfs(arm_vm, &instr.operands.fpa_cptran,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_RFS:
-			prv_process_fpa_rfs(arm_vm, &instr.operands.fpa_cptran,
-					    err);
-			break;
-		case SUBTILIS_FPA_INSTR_POW:
-			prv_process_fpa_pow(arm_vm, &instr.operands.fpa_data,
-					    err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSTS:
-			prv_process_vfp_stf(arm_vm, &instr.operands.vfp_stran,
-					    4, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FLDS:
-			prv_process_vfp_ldf(arm_vm, &instr.operands.vfp_stran,
-					    4, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSTD:
-			prv_process_vfp_stf(arm_vm, &instr.operands.vfp_stran,
-					    8, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FLDD:
-			prv_process_vfp_ldf(arm_vm, &instr.operands.vfp_stran,
-					    8, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCPYS:
-			prv_process_vfp_copy(arm_vm, &instr.operands.vfp_copy,
-					     prv_process_vfp_fcpys, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCPYD:
-			prv_process_vfp_copy(arm_vm, &instr.operands.vfp_copy,
-					     prv_process_vfp_fcpyd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNEGS:
-			prv_process_vfp_copy(arm_vm, &instr.operands.vfp_copy,
-					     prv_process_vfp_fnegs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNEGD:
-			prv_process_vfp_copy(arm_vm, &instr.operands.vfp_copy,
-					     prv_process_vfp_fnegd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FABSS:
-			prv_process_vfp_copy(arm_vm, &instr.operands.vfp_copy,
-					     prv_process_vfp_fabss, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FABSD:
-			prv_process_vfp_copy(arm_vm, &instr.operands.vfp_copy,
-					     prv_process_vfp_fabsd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSITOD:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_fsitod, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSITOS:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_fsitos, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOSIS:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftosis, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOSID:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftosid, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOUIS:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftouis, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOUID:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftouid, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOSIZS:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftosizs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOSIZD:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftosizd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOUIZS:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftouizs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FTOUIZD:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_ftouizd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FUITOD:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_fuitod, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FUITOS:
-			prv_process_vfp_tran(arm_vm, &instr.operands.vfp_tran,
-					     prv_process_vfp_fuitos, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMSR:
-			prv_process_vfp_fmsr(arm_vm, &instr.operands.vfp_cptran,
-					     err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMRS:
-			prv_process_vfp_fmrs(arm_vm, &instr.operands.vfp_cptran,
-					     err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMACS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fmacs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMACD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fmacd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNMACS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fnmacs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNMACD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fnmacd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMSCS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fmscs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMSCD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fmscd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNMSCS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fnmscs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNMSCD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fnmscd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMULS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fmuls, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMULD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fmuld, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNMULS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fnmuls, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FNMULD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fnmuld, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FADDS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fadds, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FADDD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_faddd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSUBS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fsubs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSUBD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fsubd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FDIVS:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fdivs, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FDIVD:
-			prv_process_vfp_data(arm_vm, &instr.operands.vfp_data,
-					     prv_process_vfp_fdivd, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCMPS:
-		case SUBTILIS_VFP_INSTR_FCMPES:
-			prv_process_vfp_cmp_gen(arm_vm, false, false,
-						&instr.operands.vfp_cmp, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCMPD:
-		case SUBTILIS_VFP_INSTR_FCMPED:
-			prv_process_vfp_cmp_gen(arm_vm, true, false,
-						&instr.operands.vfp_cmp, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCMPZS:
-		case SUBTILIS_VFP_INSTR_FCMPEZS:
-			prv_process_vfp_cmp_gen(arm_vm, false, true,
-						&instr.operands.vfp_cmp, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCMPZD:
-		case SUBTILIS_VFP_INSTR_FCMPEZD:
-			prv_process_vfp_cmp_gen(arm_vm, true, true,
-						&instr.operands.vfp_cmp, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSQRTD:
-			prv_process_vfp_sqrt(arm_vm, true,
-					     &instr.operands.vfp_sqrt, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FSQRTS:
-			prv_process_vfp_sqrt(arm_vm, false,
-					     &instr.operands.vfp_sqrt, err);
+	arm_vm->regs[op->dest] =
+	    prv_signx_rotate(arm_vm->regs[op->op1], op->rotate) & 0x00ff00ff;
+	arm_vm->regs[15] += 4;
+}
 
-			break;
-		case SUBTILIS_VFP_INSTR_FMXR:
-			prv_process_vfp_fmxr(arm_vm, &instr.operands.vfp_sysreg,
-					     err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMRX:
-			prv_process_vfp_fmrx(arm_vm, &instr.operands.vfp_sysreg,
-					     err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMDRR:
-			prv_process_vfp_fmdrr(
-			    arm_vm, &instr.operands.vfp_tran_dbl, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMRRD:
-			prv_process_vfp_fmrrd(
-			    arm_vm, &instr.operands.vfp_tran_dbl, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMSRR:
-			prv_process_vfp_fmsrr(
-			    arm_vm, &instr.operands.vfp_tran_dbl, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FMRRS:
-			prv_process_vfp_fmrrs(
-			    arm_vm, &instr.operands.vfp_tran_dbl, err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCVTDS:
-			prv_process_vfp_fcvtds(arm_vm, &instr.operands.vfp_cvt,
-					       err);
-			break;
-		case SUBTILIS_VFP_INSTR_FCVTSD:
-			prv_process_vfp_fcvtsd(arm_vm, &instr.operands.vfp_cvt,
-					       err);
-			break;
-		case SUBTILIS_ARM_STRAN_MISC_LDR:
-			prv_process_stran_misc_ldr(
-			    arm_vm, &instr.operands.stran_misc, err);
-			break;
-		case SUBTILIS_ARM_STRAN_MISC_STR:
-			prv_process_stran_misc_str(
-			    arm_vm, &instr.operands.stran_misc, err);
-			break;
-		case SUBTILIS_ARM_SIMD_QADD16:
-			prv_process_qadd16(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_QADD8:
-			prv_process_qadd8(arm_vm, &instr.operands.reg_only,
-					  err);
-			break;
-		case SUBTILIS_ARM_SIMD_QADDSUBX:
-			prv_process_qaddsubx(arm_vm, &instr.operands.reg_only,
-					     err);
-			break;
-		case SUBTILIS_ARM_SIMD_QSUB16:
-			prv_process_qsub16(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_QSUB8:
-			prv_process_qsub8(arm_vm, &instr.operands.reg_only,
-					  err);
-			break;
-		case SUBTILIS_ARM_SIMD_QSUBADDX:
-			prv_process_qsubaddx(arm_vm, &instr.operands.reg_only,
-					     err);
-			break;
-		case SUBTILIS_ARM_SIMD_SADD16:
-			prv_process_sadd16(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_SADD8:
-			prv_process_sadd8(arm_vm, &instr.operands.reg_only,
-					  err);
-			break;
-		case SUBTILIS_ARM_SIMD_SADDSUBX:
-			prv_process_saddsubx(arm_vm, &instr.operands.reg_only,
-					     err);
-			break;
-		case SUBTILIS_ARM_SIMD_SSUB16:
-			prv_process_ssub16(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_SSUB8:
-			prv_process_ssub8(arm_vm, &instr.operands.reg_only,
-					  err);
-			break;
-		case SUBTILIS_ARM_SIMD_SSUBADDX:
-			prv_process_ssubaddx(arm_vm, &instr.operands.reg_only,
-					     err);
-			break;
-		case SUBTILIS_ARM_SIMD_SHADD16:
-			prv_process_shadd16(arm_vm, &instr.operands.reg_only,
-					    err);
-			break;
-		case SUBTILIS_ARM_SIMD_SHADD8:
-			prv_process_shadd8(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_SHADDSUBX:
-			prv_process_shaddsubx(arm_vm, &instr.operands.reg_only,
-					      err);
-			break;
-		case SUBTILIS_ARM_SIMD_SHSUB16:
-			prv_process_shsub16(arm_vm, &instr.operands.reg_only,
-					    err);
-			break;
-		case SUBTILIS_ARM_SIMD_SHSUB8:
-			prv_process_shsub8(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_SHSUBADDX:
-			prv_process_shsubaddx(arm_vm, &instr.operands.reg_only,
-					      err);
-			break;
-		case SUBTILIS_ARM_SIMD_UADD16:
-			prv_process_uadd16(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_UADD8:
-			prv_process_uadd8(arm_vm, &instr.operands.reg_only,
-					  err);
-			break;
-		case SUBTILIS_ARM_SIMD_UADDSUBX:
-			prv_process_uaddsubx(arm_vm, &instr.operands.reg_only,
-					     err);
-			break;
-		case SUBTILIS_ARM_SIMD_USUB16:
-			prv_process_usub16(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_USUB8:
-			prv_process_usub8(arm_vm, &instr.operands.reg_only,
-					  err);
-			break;
-		case SUBTILIS_ARM_SIMD_USUBADDX:
-			prv_process_usubaddx(arm_vm, &instr.operands.reg_only,
-					     err);
-			break;
-		case SUBTILIS_ARM_SIMD_UHADD16:
-			prv_process_uhadd16(arm_vm, &instr.operands.reg_only,
-					    err);
-			break;
-		case SUBTILIS_ARM_SIMD_UHADD8:
-			prv_process_uhadd8(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_UHADDSUBX:
-			prv_process_uhaddsubx(arm_vm, &instr.operands.reg_only,
-					      err);
-			break;
-		case SUBTILIS_ARM_SIMD_UHSUB16:
-			prv_process_uhsub16(arm_vm, &instr.operands.reg_only,
-					    err);
-			break;
-		case SUBTILIS_ARM_SIMD_UHSUB8:
-			prv_process_uhsub8(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_UHSUBADDX:
-			prv_process_uhsubaddx(arm_vm, &instr.operands.reg_only,
-					      err);
-			break;
-		case SUBTILIS_ARM_SIMD_UQADD16:
-			prv_process_uqadd16(arm_vm, &instr.operands.reg_only,
-					    err);
-			break;
-		case SUBTILIS_ARM_SIMD_UQADD8:
-			prv_process_uqadd8(arm_vm, &instr.operands.reg_only,
+static void prv_process_uxth(subtilis_arm_vm_t *arm_vm,
+			     subtilis_arm_signx_instr_t *op,
+			     subtilis_error_t *err)
+{
+	if (!prv_match_ccode(arm_vm, op->ccode)) {
+		arm_vm->regs[15] += 4;
+		return;
+	}
+
+	arm_vm->regs[op->dest] =
+	    prv_signx_rotate(arm_vm->regs[op->op1], op->rotate) & 0xffff;
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_process_rev(subtilis_arm_vm_t *arm_vm,
+			    subtilis_arm_signx_instr_t *op,
+			    subtilis_error_t *err)
+{
+	uint32_t num = (uint32_t)arm_vm->regs[op->op1];
+
+	if (!prv_match_ccode(arm_vm, op->ccode)) {
+		arm_vm->regs[15] += 4;
+		return;
+	}
+
+	num = (num >> 24) | ((num >> 8) & 0xff00) | ((num << 8) & 0xff0000) |
+	      (num << 24);
+	arm_vm->regs[op->dest] = (int32_t)num;
+	arm_vm->regs[15] += 4;
+}
+
+/*
+ * PLD is only a hint and there's no cache to preload, so it just
+ * advances the PC.
+ */
+
+static void prv_process_pld(subtilis_arm_vm_t *arm_vm,
+			    subtilis_arm_pld_instr_t *op, subtilis_error_t *err)
+{
+	arm_vm->regs[15] += 4;
+}
+
+static subtilis_arm_instr_t *prv_decode(subtilis_arm_vm_t *arm_vm, size_t pc,
+				       subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr = &arm_vm->decoded[pc];
+
+	if (arm_vm->decoded_valid[pc])
+		return instr;
+
+	subtilis_arm_disass(instr, ((uint32_t *)arm_vm->memory)[pc],
+			    arm_vm->vfp, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return NULL;
+	arm_vm->decoded_valid[pc] = true;
+
+	return instr;
+}
+
+static void prv_execute(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+			subtilis_arm_instr_t *instr, subtilis_error_t *err)
+{
+	switch (instr->type) {
+	case SUBTILIS_ARM_INSTR_AND:
+		prv_process_and(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_EOR:
+		prv_process_eor(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_SUB:
+		prv_process_sub(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_RSB:
+		prv_process_rsb(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_ADD:
+		prv_process_add(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_ADC:
+		prv_process_adc(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_CMP:
+		prv_process_cmp(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_CMN:
+		prv_process_cmn(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_TST:
+		prv_process_tst(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_TEQ:
+		prv_process_teq(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_ORR:
+		prv_process_orr(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_MOV:
+		prv_process_mov(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_BIC:
+		prv_process_bic(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_MVN:
+		prv_process_mvn(arm_vm, &instr->operands.data, err);
+		break;
+	case SUBTILIS_ARM_INSTR_MUL:
+		prv_process_mul(arm_vm, &instr->operands.mul, err);
+		break;
+	case SUBTILIS_ARM_INSTR_MLA:
+		prv_process_mla(arm_vm, &instr->operands.mul, err);
+		break;
+	case SUBTILIS_ARM_INSTR_LDR:
+		prv_process_ldr(arm_vm, &instr->operands.stran, err);
+		break;
+	case SUBTILIS_ARM_INSTR_STR:
+		prv_process_str(arm_vm, &instr->operands.stran, err);
+		break;
+	case SUBTILIS_ARM_INSTR_B:
+		prv_process_b(arm_vm, &instr->operands.br, err);
+		break;
+	case SUBTILIS_ARM_INSTR_SWI:
+		prv_process_swi(arm_vm, b, &instr->operands.swi, err);
+		break;
+	case SUBTILIS_ARM_INSTR_STM:
+		prv_process_stm(arm_vm, &instr->operands.mtran, err);
+		break;
+	case SUBTILIS_ARM_INSTR_LDM:
+		prv_process_ldm(arm_vm, &instr->operands.mtran, err);
+		break;
+	case SUBTILIS_ARM_INSTR_MSR:
+		prv_process_msr(arm_vm, &instr->operands.flags, err);
+		break;
+	case SUBTILIS_ARM_INSTR_MRS:
+		prv_process_mrs(arm_vm, &instr->operands.flags, err);
+		break;
+	case SUBTILIS_FPA_INSTR_LDF:
+		prv_process_fpa_ldf(arm_vm, &instr->operands.fpa_stran, err);
+		break;
+	case SUBTILIS_FPA_INSTR_STF:
+		prv_process_fpa_stf(arm_vm, &instr->operands.fpa_stran, err);
+		break;
+	case SUBTILIS_FPA_INSTR_MVF:
+		prv_process_fpa_mvf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_MNF:
+		prv_process_fpa_mnf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_ADF:
+		prv_process_fpa_adf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_MUF:
+		prv_process_fpa_muf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_SUF:
+		prv_process_fpa_suf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_RSF:
+		prv_process_fpa_rsf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_DVF:
+		prv_process_fpa_dvf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_RDF:
+		prv_process_fpa_rdf(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_FLT:
+		prv_process_fpa_flt(arm_vm, &instr->operands.fpa_tran, err);
+		break;
+	case SUBTILIS_FPA_INSTR_FIX:
+		prv_process_fpa_fix(arm_vm, &instr->operands.fpa_tran, err);
+		break;
+	case SUBTILIS_FPA_INSTR_CMF:
+		prv_process_fpa_cmf(arm_vm, &instr->operands.fpa_cmp, err);
+		break;
+	case SUBTILIS_FPA_INSTR_CNF:
+		prv_process_fpa_cnf(arm_vm, &instr->operands.fpa_cmp, err);
+		break;
+	case SUBTILIS_FPA_INSTR_SIN:
+		prv_process_fpa_sin(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_COS:
+		prv_process_fpa_cos(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_TAN:
+		prv_process_fpa_tan(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_ASN:
+		prv_process_fpa_asn(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_ACS:
+		prv_process_fpa_acs(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_ATN:
+		prv_process_fpa_atn(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_SQT:
+		prv_process_fpa_sqr(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_LOG:
+		prv_process_fpa_log(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_LGN:
+		prv_process_fpa_ln(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_EXP:
+		prv_process_fpa_exp(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_ABS:
+		prv_process_fpa_abs(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_FPA_INSTR_WFS:
+		prv_process_fpa_wfs(arm_vm, &instr->operands.fpa_cptran, err);
+		break;
+	case SUBTILIS_FPA_INSTR_RFS:
+		prv_process_fpa_rfs(arm_vm, &instr->operands.fpa_cptran, err);
+		break;
+	case SUBTILIS_FPA_INSTR_POW:
+		prv_process_fpa_pow(arm_vm, &instr->operands.fpa_data, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSTS:
+		prv_process_vfp_stf(arm_vm, &instr->operands.vfp_stran, 4, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FLDS:
+		prv_process_vfp_ldf(arm_vm, &instr->operands.vfp_stran, 4, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSTD:
+		prv_process_vfp_stf(arm_vm, &instr->operands.vfp_stran, 8, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FLDD:
+		prv_process_vfp_ldf(arm_vm, &instr->operands.vfp_stran, 8, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCPYS:
+		prv_process_vfp_copy(arm_vm, &instr->operands.vfp_copy,
+				     prv_process_vfp_fcpys, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCPYD:
+		prv_process_vfp_copy(arm_vm, &instr->operands.vfp_copy,
+				     prv_process_vfp_fcpyd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNEGS:
+		prv_process_vfp_copy(arm_vm, &instr->operands.vfp_copy,
+				     prv_process_vfp_fnegs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNEGD:
+		prv_process_vfp_copy(arm_vm, &instr->operands.vfp_copy,
+				     prv_process_vfp_fnegd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FABSS:
+		prv_process_vfp_copy(arm_vm, &instr->operands.vfp_copy,
+				     prv_process_vfp_fabss, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FABSD:
+		prv_process_vfp_copy(arm_vm, &instr->operands.vfp_copy,
+				     prv_process_vfp_fabsd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSITOD:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_fsitod, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSITOS:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_fsitos, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOSIS:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftosis, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOSID:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftosid, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOUIS:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftouis, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOUID:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftouid, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOSIZS:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftosizs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOSIZD:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftosizd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOUIZS:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftouizs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FTOUIZD:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_ftouizd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FUITOD:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_fuitod, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FUITOS:
+		prv_process_vfp_tran(arm_vm, &instr->operands.vfp_tran,
+				     prv_process_vfp_fuitos, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMSR:
+		prv_process_vfp_fmsr(arm_vm, &instr->operands.vfp_cptran, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMRS:
+		prv_process_vfp_fmrs(arm_vm, &instr->operands.vfp_cptran, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMACS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fmacs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMACD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fmacd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNMACS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fnmacs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNMACD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fnmacd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMSCS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fmscs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMSCD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fmscd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNMSCS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fnmscs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNMSCD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fnmscd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMULS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fmuls, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMULD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fmuld, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNMULS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fnmuls, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FNMULD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fnmuld, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FADDS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fadds, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FADDD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_faddd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSUBS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fsubs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSUBD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fsubd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FDIVS:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fdivs, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FDIVD:
+		prv_process_vfp_data(arm_vm, &instr->operands.vfp_data,
+				     prv_process_vfp_fdivd, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCMPS:
+	case SUBTILIS_VFP_INSTR_FCMPES:
+		prv_process_vfp_cmp_gen(arm_vm, false, false,
+					&instr->operands.vfp_cmp, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCMPD:
+	case SUBTILIS_VFP_INSTR_FCMPED:
+		prv_process_vfp_cmp_gen(arm_vm, true, false,
+					&instr->operands.vfp_cmp, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCMPZS:
+	case SUBTILIS_VFP_INSTR_FCMPEZS:
+		prv_process_vfp_cmp_gen(arm_vm, false, true,
+					&instr->operands.vfp_cmp, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCMPZD:
+	case SUBTILIS_VFP_INSTR_FCMPEZD:
+		prv_process_vfp_cmp_gen(arm_vm, true, true,
+					&instr->operands.vfp_cmp, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSQRTD:
+		prv_process_vfp_sqrt(arm_vm, true, &instr->operands.vfp_sqrt,
+				     err);
+		break;
+	case SUBTILIS_VFP_INSTR_FSQRTS:
+		prv_process_vfp_sqrt(arm_vm, false, &instr->operands.vfp_sqrt,
+				     err);
+
+		break;
+	case SUBTILIS_VFP_INSTR_FMXR:
+		prv_process_vfp_fmxr(arm_vm, &instr->operands.vfp_sysreg, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMRX:
+		prv_process_vfp_fmrx(arm_vm, &instr->operands.vfp_sysreg, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMDRR:
+		prv_process_vfp_fmdrr(arm_vm, &instr->operands.vfp_tran_dbl,
+				      err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMRRD:
+		prv_process_vfp_fmrrd(arm_vm, &instr->operands.vfp_tran_dbl,
+				      err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMSRR:
+		prv_process_vfp_fmsrr(arm_vm, &instr->operands.vfp_tran_dbl,
+				      err);
+		break;
+	case SUBTILIS_VFP_INSTR_FMRRS:
+		prv_process_vfp_fmrrs(arm_vm, &instr->operands.vfp_tran_dbl,
+				      err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCVTDS:
+		prv_process_vfp_fcvtds(arm_vm, &instr->operands.vfp_cvt, err);
+		break;
+	case SUBTILIS_VFP_INSTR_FCVTSD:
+		prv_process_vfp_fcvtsd(arm_vm, &instr->operands.vfp_cvt, err);
+		break;
+	case SUBTILIS_ARM_STRAN_MISC_LDR:
+		prv_process_stran_misc_ldr(arm_vm, &instr->operands.stran_misc,
 					   err);
-			break;
+		break;
+	case SUBTILIS_ARM_STRAN_MISC_STR:
+		prv_process_stran_misc_str(arm_vm, &instr->operands.stran_misc,
+					   err);
+		break;
+	case SUBTILIS_ARM_SIMD_QADD16:
+		prv_process_qadd16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_QADD8:
+		prv_process_qadd8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_QADDSUBX:
+		prv_process_qaddsubx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_QSUB16:
+		prv_process_qsub16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_QSUB8:
+		prv_process_qsub8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_QSUBADDX:
+		prv_process_qsubaddx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SADD16:
+		prv_process_sadd16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SADD8:
+		prv_process_sadd8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SADDSUBX:
+		prv_process_saddsubx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SSUB16:
+		prv_process_ssub16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SSUB8:
+		prv_process_ssub8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SSUBADDX:
+		prv_process_ssubaddx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SHADD16:
+		prv_process_shadd16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SHADD8:
+		prv_process_shadd8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SHADDSUBX:
+		prv_process_shaddsubx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SHSUB16:
+		prv_process_shsub16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SHSUB8:
+		prv_process_shsub8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_SHSUBADDX:
+		prv_process_shsubaddx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UADD16:
+		prv_process_uadd16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UADD8:
+		prv_process_uadd8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UADDSUBX:
+		prv_process_uaddsubx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_USUB16:
+		prv_process_usub16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_USUB8:
+		prv_process_usub8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_USUBADDX:
+		prv_process_usubaddx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UHADD16:
+		prv_process_uhadd16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UHADD8:
+		prv_process_uhadd8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UHADDSUBX:
+		prv_process_uhaddsubx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UHSUB16:
+		prv_process_uhsub16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UHSUB8:
+		prv_process_uhsub8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UHSUBADDX:
+		prv_process_uhsubaddx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UQADD16:
+		prv_process_uqadd16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UQADD8:
+		prv_process_uqadd8(arm_vm, &instr->operands.reg_only, err);
+		break;
+
+	case SUBTILIS_ARM_SIMD_UQADDSUBX:
+		prv_process_uqaddsubx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UQSUB16:
+		prv_process_uqsub16(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UQSUB8:
+		prv_process_uqsub8(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_SIMD_UQSUBADDX:
+		prv_process_uqsubaddx(arm_vm, &instr->operands.reg_only, err);
+		break;
+	case SUBTILIS_ARM_INSTR_SXTB:
+		prv_process_sxtb(arm_vm, &instr->operands.signx, err);
+		break;
+	case SUBTILIS_ARM_INSTR_SXTB16:
+		prv_process_sxtb16(arm_vm, &instr->operands.signx, err);
+		break;
+	case SUBTILIS_ARM_INSTR_SXTH:
+		prv_process_sxth(arm_vm, &instr->operands.signx, err);
+		break;
+	case SUBTILIS_ARM_INSTR_UXTB:
+		prv_process_uxtb(arm_vm, &instr->operands.signx, err);
+		break;
+	case SUBTILIS_ARM_INSTR_UXTB16:
+		prv_process_uxtb16(arm_vm, &instr->operands.signx, err);
+		break;
+	case SUBTILIS_ARM_INSTR_UXTH:
+		prv_process_uxth(arm_vm, &instr->operands.signx, err);
+		break;
+	case SUBTILIS_ARM_INSTR_REV:
+		prv_process_rev(arm_vm, &instr->operands.signx, err);
+		break;
+	case SUBTILIS_ARM_INSTR_SMULL:
+	case SUBTILIS_ARM_INSTR_UMULL:
+		prv_process_mull(arm_vm, instr->type, &instr->operands.mul,
+				 err);
+		break;
+	case SUBTILIS_ARM_INSTR_PLD:
+		prv_process_pld(arm_vm, &instr->operands.pld, err);
+		break;
+	default:
+		printf("instr type %d\n", instr->type);
+		subtilis_error_set_assertion_failed(err);
+	}
+}
+
+/*
+ * Threaded code.
+ *
+ * A block is a straight line sequence of instructions that ends with a
+ * branch, a SWI or any other instruction that may write to the PC.  Each
+ * instruction in the block is represented by a handler and a private copy
+ * of its decoded operands.  Instructions that are never executed, i.e.,
+ * those with the NV condition code, are replaced by a handler that simply
+ * advances the PC.  Unconditional data processing instructions with
+ * simple operands are given specialised handlers that skip the condition
+ * code check and have their immediate values pre-decoded.  Finally, flag
+ * computations whose results are overwritten by a later instruction in
+ * the same block before they can be read are dropped.
+ */
+
+typedef struct subtilis_arm_vm_tc_op_t_ subtilis_arm_vm_tc_op_t;
+
+typedef void (*subtilis_arm_vm_handler_t)(subtilis_arm_vm_t *arm_vm,
+					  subtilis_buffer_t *b,
+					  subtilis_arm_vm_tc_op_t *op,
+					  subtilis_error_t *err);
+
+struct subtilis_arm_vm_tc_op_t_ {
+	subtilis_arm_vm_handler_t handler;
+	subtilis_arm_instr_t instr;
+	int32_t op2;
+	bool nop;
+};
+
+struct subtilis_arm_vm_block_t_ {
+	size_t len;
+	subtilis_arm_vm_tc_op_t ops[1];
+};
+
+static void prv_tc_generic(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+			   subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	prv_execute(arm_vm, b, &op->instr, err);
+}
+
+static void prv_tc_nop(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	arm_vm->regs[15] += 4;
+}
+
+static int32_t prv_tc_op2(subtilis_arm_vm_t *arm_vm,
+			  subtilis_arm_vm_tc_op_t *op)
+{
+	subtilis_arm_op2_t *op2 = &op->instr.operands.data.op2;
+
+	if (op2->type == SUBTILIS_ARM_OP2_REG)
+		return arm_vm->regs[op2->op.reg];
+	return op->op2;
+}
+
+static void prv_tc_mov(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+
+	arm_vm->regs[datai->dest] = prv_tc_op2(arm_vm, op);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_mvn(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+
+	arm_vm->regs[datai->dest] = ~prv_tc_op2(arm_vm, op);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_add(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+	uint32_t op1 = (uint32_t)arm_vm->regs[datai->op1];
+	uint32_t op2 = (uint32_t)prv_tc_op2(arm_vm, op);
+
+	arm_vm->regs[datai->dest] = (int32_t)(op1 + op2);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_sub(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+	uint32_t op1 = (uint32_t)arm_vm->regs[datai->op1];
+	uint32_t op2 = (uint32_t)prv_tc_op2(arm_vm, op);
+
+	arm_vm->regs[datai->dest] = (int32_t)(op1 - op2);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_rsb(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+	uint32_t op1 = (uint32_t)arm_vm->regs[datai->op1];
+	uint32_t op2 = (uint32_t)prv_tc_op2(arm_vm, op);
+
+	arm_vm->regs[datai->dest] = (int32_t)(op2 - op1);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_and(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+
+	arm_vm->regs[datai->dest] =
+	    arm_vm->regs[datai->op1] & prv_tc_op2(arm_vm, op);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_orr(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+
+	arm_vm->regs[datai->dest] =
+	    arm_vm->regs[datai->op1] | prv_tc_op2(arm_vm, op);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_eor(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+
+	arm_vm->regs[datai->dest] =
+	    arm_vm->regs[datai->op1] ^ prv_tc_op2(arm_vm, op);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_bic(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
+
+	arm_vm->regs[datai->dest] =
+	    arm_vm->regs[datai->op1] & ~prv_tc_op2(arm_vm, op);
+	arm_vm->regs[15] += 4;
+}
+
+static void prv_tc_cmp(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+		       subtilis_arm_vm_tc_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai = &op->instr.operands.data;
 
-		case SUBTILIS_ARM_SIMD_UQADDSUBX:
-			prv_process_uqaddsubx(arm_vm, &instr.operands.reg_only,
-					      err);
-			break;
-		case SUBTILIS_ARM_SIMD_UQSUB16:
-			prv_process_uqsub16(arm_vm, &instr.operands.reg_only,
-					    err);
-			break;
-		case SUBTILIS_ARM_SIMD_UQSUB8:
-			prv_process_uqsub8(arm_vm, &instr.operands.reg_only,
-					   err);
-			break;
-		case SUBTILIS_ARM_SIMD_UQSUBADDX:
-			prv_process_uqsubaddx(arm_vm, &instr.operands.reg_only,
-					      err);
+	prv_set_status_flags(arm_vm, arm_vm->regs[datai->op1],
+			     prv_tc_op2(arm_vm, op));
+	arm_vm->regs[15] += 4;
+}
+
+static bool prv_tc_is_data(subtilis_arm_instr_type_t type)
+{
+	return type <= SUBTILIS_ARM_INSTR_MVN;
+}
+
+static bool prv_tc_is_compare(subtilis_arm_instr_type_t type)
+{
+	return (type >= SUBTILIS_ARM_INSTR_TST) &&
+	       (type <= SUBTILIS_ARM_INSTR_CMN);
+}
+
+/*
+ * Returns true if the instruction may alter the flow of control, in which
+ * case it must be the last instruction in its block.
+ */
+
+static bool prv_tc_ends_block(subtilis_arm_instr_t *instr)
+{
+	switch (instr->type) {
+	case SUBTILIS_ARM_INSTR_B:
+	case SUBTILIS_ARM_INSTR_SWI:
+	case SUBTILIS_ARM_INSTR_MSR:
+		return true;
+	case SUBTILIS_ARM_INSTR_LDR:
+		return instr->operands.stran.dest == 15;
+	case SUBTILIS_ARM_INSTR_LDM:
+		return (instr->operands.mtran.reg_list & (1 << 15)) != 0;
+	case SUBTILIS_ARM_INSTR_MUL:
+	case SUBTILIS_ARM_INSTR_MLA:
+		return instr->operands.mul.dest == 15;
+	case SUBTILIS_ARM_INSTR_SMULL:
+	case SUBTILIS_ARM_INSTR_UMULL:
+		return (instr->operands.mul.dest == 15) ||
+		       (instr->operands.mul.rn == 15);
+	case SUBTILIS_ARM_INSTR_MRS:
+		return instr->operands.flags.op.reg == 15;
+	case SUBTILIS_ARM_STRAN_MISC_LDR:
+		return instr->operands.stran_misc.dest >= 14;
+	default:
+		break;
+	}
+
+	if (prv_tc_is_data(instr->type) && !prv_tc_is_compare(instr->type))
+		return instr->operands.data.dest == 15;
+
+	return false;
+}
+
+/*
+ * Walks the block backwards tracking whether the flags are live, i.e.,
+ * whether they may be read before they are next overwritten.  The flags
+ * are assumed to be live at the end of the block.  Only unconditional
+ * data processing instructions are analysed.  Every other instruction is
+ * conservatively assumed to read the flags, apart from the few that are
+ * known not to touch them at all.
+ */
+
+static void prv_tc_remove_dead_flags(subtilis_arm_vm_block_t *block)
+{
+	size_t i;
+	bool reads;
+	bool all_flags;
+	subtilis_arm_vm_tc_op_t *op;
+	subtilis_arm_data_instr_t *datai;
+	bool live = true;
+
+	for (i = block->len; i > 0; i--) {
+		op = &block->ops[i - 1];
+		if (op->nop)
+			continue;
+		switch (op->instr.type) {
+		case SUBTILIS_ARM_INSTR_MUL:
+		case SUBTILIS_ARM_INSTR_MLA:
+		case SUBTILIS_ARM_INSTR_SMULL:
+		case SUBTILIS_ARM_INSTR_UMULL:
+			if (op->instr.operands.mul.ccode !=
+			    SUBTILIS_ARM_CCODE_AL)
+				live = true;
+			continue;
+		case SUBTILIS_ARM_INSTR_LDR:
+		case SUBTILIS_ARM_INSTR_STR:
+			if (op->instr.operands.stran.ccode !=
+			    SUBTILIS_ARM_CCODE_AL)
+				live = true;
+			continue;
+		default:
 			break;
-		case SUBTILIS_ARM_INSTR_SXTB:
-			prv_process_sxtb(arm_vm, &instr.operands.signx, err);
+		}
+		if (!prv_tc_is_data(op->instr.type)) {
+			live = true;
+			continue;
+		}
+		datai = &op->instr.operands.data;
+		if (datai->ccode != SUBTILIS_ARM_CCODE_AL) {
+			live = true;
+			continue;
+		}
+		reads = (op->instr.type == SUBTILIS_ARM_INSTR_ADC) ||
+			((datai->op2.type == SUBTILIS_ARM_OP2_SHIFTED) &&
+			 (datai->op2.op.shift.type == SUBTILIS_ARM_SHIFT_RRX));
+		if (!datai->status) {
+			live = live || reads;
+			continue;
+		}
+		if (!live) {
+			if (prv_tc_is_compare(op->instr.type))
+				op->nop = true;
+			else
+				datai->status = false;
+			live = reads;
+			continue;
+		}
+
+		/*
+		 * The logical operations only update some of the flags, so
+		 * the flags set by earlier instructions may still be read.
+		 */
+
+		switch (op->instr.type) {
+		case SUBTILIS_ARM_INSTR_SUB:
+		case SUBTILIS_ARM_INSTR_RSB:
+		case SUBTILIS_ARM_INSTR_ADD:
+		case SUBTILIS_ARM_INSTR_ADC:
+		case SUBTILIS_ARM_INSTR_CMP:
+		case SUBTILIS_ARM_INSTR_CMN:
+			all_flags = true;
 			break;
-		case SUBTILIS_ARM_INSTR_SXTB16:
-			prv_process_sxtb16(arm_vm, &instr.operands.signx, err);
+		default:
+			all_flags = false;
 			break;
-		case SUBTILIS_ARM_INSTR_SXTH:
-			prv_process_sxth(arm_vm, &instr.operands.signx, err);
+		}
+		if (all_flags)
+			live = reads;
+	}
+}
+
+static subtilis_arm_vm_handler_t
+prv_tc_data_handler(subtilis_arm_instr_type_t type)
+{
+	switch (type) {
+	case SUBTILIS_ARM_INSTR_MOV:
+		return prv_tc_mov;
+	case SUBTILIS_ARM_INSTR_MVN:
+		return prv_tc_mvn;
+	case SUBTILIS_ARM_INSTR_ADD:
+		return prv_tc_add;
+	case SUBTILIS_ARM_INSTR_SUB:
+		return prv_tc_sub;
+	case SUBTILIS_ARM_INSTR_RSB:
+		return prv_tc_rsb;
+	case SUBTILIS_ARM_INSTR_AND:
+		return prv_tc_and;
+	case SUBTILIS_ARM_INSTR_ORR:
+		return prv_tc_orr;
+	case SUBTILIS_ARM_INSTR_EOR:
+		return prv_tc_eor;
+	case SUBTILIS_ARM_INSTR_BIC:
+		return prv_tc_bic;
+	case SUBTILIS_ARM_INSTR_CMP:
+		return prv_tc_cmp;
+	default:
+		return NULL;
+	}
+}
+
+static void prv_tc_select_handler(subtilis_arm_vm_tc_op_t *op)
+{
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_vm_handler_t handler;
+
+	op->handler = prv_tc_generic;
+	if (op->nop) {
+		op->handler = prv_tc_nop;
+		return;
+	}
+
+	if (!prv_tc_is_data(op->instr.type))
+		return;
+
+	datai = &op->instr.operands.data;
+	if ((datai->ccode != SUBTILIS_ARM_CCODE_AL) ||
+	    (datai->op2.type == SUBTILIS_ARM_OP2_SHIFTED))
+		return;
+
+	if (op->instr.type == SUBTILIS_ARM_INSTR_CMP) {
+		if (!datai->status)
+			return;
+	} else if (datai->status || (datai->dest == 15)) {
+		return;
+	}
+
+	handler = prv_tc_data_handler(op->instr.type);
+	if (!handler)
+		return;
+
+	if (datai->op2.type == SUBTILIS_ARM_OP2_I32)
+		op->op2 = prv_decode_imm(datai->op2.op.integer);
+	op->handler = handler;
+}
+
+static bool prv_tc_never(subtilis_arm_instr_t *instr)
+{
+	subtilis_arm_ccode_type_t ccode;
+
+	if (prv_tc_is_data(instr->type))
+		ccode = instr->operands.data.ccode;
+	else if (instr->type == SUBTILIS_ARM_INSTR_LDR ||
+		 instr->type == SUBTILIS_ARM_INSTR_STR)
+		ccode = instr->operands.stran.ccode;
+	else if (instr->type == SUBTILIS_ARM_INSTR_MUL ||
+		 instr->type == SUBTILIS_ARM_INSTR_MLA ||
+		 instr->type == SUBTILIS_ARM_INSTR_SMULL ||
+		 instr->type == SUBTILIS_ARM_INSTR_UMULL)
+		ccode = instr->operands.mul.ccode;
+	else
+		return false;
+
+	return ccode == SUBTILIS_ARM_CCODE_NV;
+}
+
+static subtilis_arm_vm_block_t *prv_tc_translate(subtilis_arm_vm_t *arm_vm,
+						 size_t pc,
+						 subtilis_error_t *err)
+{
+	size_t end;
+	size_t i;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_vm_block_t *block;
+	subtilis_error_t decode_err;
+
+	/*
+	 * The first instruction must decode.  If it doesn't, we report the
+	 * error in the same way the interpreter would.  Later instructions
+	 * may be data, in which case the block stops just before them.
+	 */
+
+	instr = prv_decode(arm_vm, pc, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return NULL;
+
+	for (end = pc + 1; !prv_tc_ends_block(instr) && end < arm_vm->code_size;
+	     end++) {
+		subtilis_error_init(&decode_err);
+		instr = prv_decode(arm_vm, end, &decode_err);
+		if (decode_err.type != SUBTILIS_ERROR_OK)
 			break;
-		default:
-			printf("instr type %d\n", instr.type);
-			subtilis_error_set_assertion_failed(err);
+	}
+
+	block = malloc(sizeof(*block) +
+		       sizeof(subtilis_arm_vm_tc_op_t) * (end - pc - 1));
+	if (!block) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+
+	block->len = end - pc;
+	for (i = 0; i < block->len; i++) {
+		block->ops[i].instr = arm_vm->decoded[pc + i];
+		block->ops[i].op2 = 0;
+		block->ops[i].nop = prv_tc_never(&block->ops[i].instr);
+	}
+
+	prv_tc_remove_dead_flags(block);
+
+	for (i = 0; i < block->len; i++)
+		prv_tc_select_handler(&block->ops[i]);
+
+	return block;
+}
+
+static void prv_run_threaded(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+			     subtilis_error_t *err)
+{
+	size_t pc;
+	size_t i;
+	subtilis_arm_vm_block_t *block;
+	subtilis_arm_vm_tc_op_t *op;
+
+	if (!arm_vm->blocks) {
+		arm_vm->blocks =
+		    calloc(arm_vm->code_size, sizeof(*arm_vm->blocks));
+		if (!arm_vm->blocks) {
+			subtilis_error_set_oom(err);
+			return;
 		}
+	}
+
+	pc = prv_calc_pc(arm_vm);
+	while (!arm_vm->quit && pc < arm_vm->code_size) {
+		block = arm_vm->blocks[pc];
+		if (!block) {
+			block = prv_tc_translate(arm_vm, pc, err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				return;
+			arm_vm->blocks[pc] = block;
+		}
+
+		for (i = 0; i < block->len; i++) {
+			op = &block->ops[i];
+			op->handler(arm_vm, b, op, err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				return;
+			if (arm_vm->code_written)
+				break;
+		}
+
+		if (arm_vm->code_written) {
+			prv_free_blocks(arm_vm);
+			arm_vm->code_written = false;
+		}
+
+		pc = prv_calc_pc(arm_vm);
+	}
+}
+
+/*
+ * The number of processor clock ticks taken by each type of cycle.  On
+ * the ARM2 an N cycle takes twice as long as an S cycle, as MEMC needs
+ * to open a new DRAM page.  The ARM3 runs from its cache so all cycles
+ * take a single tick, apart from memory writes which are written through
+ * to the 8Mhz memory system, costing several extra ticks each.  Cache
+ * misses are not modelled.
+ */
+
+struct subtilis_arm_vm_timings_t_ {
+	uint32_t s;
+	uint32_t n;
+	uint32_t i;
+	uint32_t write;
+};
+
+typedef struct subtilis_arm_vm_timings_t_ subtilis_arm_vm_timings_t;
+
+static const subtilis_arm_vm_timings_t prv_timings[] = {
+	{0, 0, 0, 0}, /* SUBTILIS_ARM_VM_TIMING_NONE */
+	{1, 2, 1, 0}, /* SUBTILIS_ARM_VM_TIMING_ARM2 */
+	{1, 1, 1, 5}, /* SUBTILIS_ARM_VM_TIMING_ARM3 */
+};
+
+static void prv_charge(subtilis_arm_vm_t *arm_vm, uint32_t s, uint32_t n,
+		       uint32_t i, uint32_t writes)
+{
+	const subtilis_arm_vm_timings_t *t = &prv_timings[arm_vm->timing];
+
+	arm_vm->s_cycles += s;
+	arm_vm->n_cycles += n;
+	arm_vm->i_cycles += i;
+	arm_vm->cycles += s * t->s + n * t->n + i * t->i + writes * t->write;
+}
+
+/*
+ * The ARM2 and ARM3 have no floating point hardware, so FPA instructions
+ * trap into the floating point emulator.  These are rough estimates of
+ * the number of S cycles the emulator takes to execute each instruction,
+ * including the cost of the undefined instruction trap.
+ */
+
+static uint32_t prv_fpe_cost(subtilis_arm_instr_type_t type)
+{
+	switch (type) {
+	case SUBTILIS_FPA_INSTR_LDF:
+	case SUBTILIS_FPA_INSTR_STF:
+	case SUBTILIS_FPA_INSTR_LDRC:
+	case SUBTILIS_FPA_INSTR_WFS:
+	case SUBTILIS_FPA_INSTR_RFS:
+		return 60;
+	case SUBTILIS_FPA_INSTR_MVF:
+	case SUBTILIS_FPA_INSTR_MNF:
+	case SUBTILIS_FPA_INSTR_ABS:
+		return 70;
+	case SUBTILIS_FPA_INSTR_RND:
+	case SUBTILIS_FPA_INSTR_URD:
+	case SUBTILIS_FPA_INSTR_NRM:
+		return 100;
+	case SUBTILIS_FPA_INSTR_FLT:
+	case SUBTILIS_FPA_INSTR_FIX:
+	case SUBTILIS_FPA_INSTR_CMF:
+	case SUBTILIS_FPA_INSTR_CNF:
+	case SUBTILIS_FPA_INSTR_CMFE:
+	case SUBTILIS_FPA_INSTR_CNFE:
+		return 120;
+	case SUBTILIS_FPA_INSTR_ADF:
+	case SUBTILIS_FPA_INSTR_SUF:
+	case SUBTILIS_FPA_INSTR_RSF:
+		return 150;
+	case SUBTILIS_FPA_INSTR_MUF:
+	case SUBTILIS_FPA_INSTR_FML:
+		return 200;
+	case SUBTILIS_FPA_INSTR_DVF:
+	case SUBTILIS_FPA_INSTR_RDF:
+	case SUBTILIS_FPA_INSTR_FDV:
+	case SUBTILIS_FPA_INSTR_FRD:
+	case SUBTILIS_FPA_INSTR_RMF:
+		return 450;
+	case SUBTILIS_FPA_INSTR_SQT:
+		return 700;
+	default:
+		/*
+		 * The transcendental functions.
+		 */
+		return 3000;
+	}
+}
+
+/*
+ * The ARM2 multiplier uses Booth's algorithm, retiring 2 bits of Rs per
+ * internal cycle and terminating early once the remaining bits of Rs are
+ * all zero.
+ */
+
+static uint32_t prv_booth_cycles(uint32_t rs)
+{
+	uint32_t m = 1;
+
+	rs >>= 2;
+	while (rs && m < 16) {
+		m++;
+		rs >>= 2;
+	}
+
+	return m;
+}
+
+static uint32_t prv_count_regs(size_t reg_list)
+{
+	uint32_t count = 0;
+
+	for (; reg_list; reg_list >>= 1)
+		count += reg_list & 1;
+
+	return count;
+}
+
+static uint32_t prv_timing_rs(subtilis_arm_vm_t *arm_vm,
+			      subtilis_arm_instr_t *instr)
+{
+	if ((instr->type != SUBTILIS_ARM_INSTR_MUL) &&
+	    (instr->type != SUBTILIS_ARM_INSTR_MLA))
+		return 0;
+
+	return (uint32_t)arm_vm->regs[instr->operands.mul.rs];
+}
+
+/*
+ * Charges the cycles taken by an instruction that has just been executed.
+ * executed indicates whether the instruction's condition passed, rs holds
+ * the value of the Rs register of a multiply before it was executed and
+ * old_pc is the address of the instruction.  Any instruction that causes
+ * the PC to change, other than by advancing to the next instruction,
+ * incurs an extra S and N cycle to refill the pipeline.
+ */
+
+static void prv_time_instr(subtilis_arm_vm_t *arm_vm,
+			   subtilis_arm_instr_t *instr, bool executed,
+			   uint32_t rs, size_t old_pc)
+{
+	uint32_t regs;
+	subtilis_arm_data_instr_t *datai;
+
+	if (!executed) {
+		prv_charge(arm_vm, 1, 0, 0, 0);
+		return;
+	}
+
+	switch (instr->type) {
+	case SUBTILIS_ARM_INSTR_AND:
+	case SUBTILIS_ARM_INSTR_EOR:
+	case SUBTILIS_ARM_INSTR_SUB:
+	case SUBTILIS_ARM_INSTR_RSB:
+	case SUBTILIS_ARM_INSTR_ADD:
+	case SUBTILIS_ARM_INSTR_ADC:
+	case SUBTILIS_ARM_INSTR_SBC:
+	case SUBTILIS_ARM_INSTR_RSC:
+	case SUBTILIS_ARM_INSTR_TST:
+	case SUBTILIS_ARM_INSTR_TEQ:
+	case SUBTILIS_ARM_INSTR_CMP:
+	case SUBTILIS_ARM_INSTR_CMN:
+	case SUBTILIS_ARM_INSTR_ORR:
+	case SUBTILIS_ARM_INSTR_MOV:
+	case SUBTILIS_ARM_INSTR_BIC:
+	case SUBTILIS_ARM_INSTR_MVN:
+		datai = &instr->operands.data;
+		if ((datai->op2.type == SUBTILIS_ARM_OP2_SHIFTED) &&
+		    datai->op2.op.shift.shift_reg)
+			prv_charge(arm_vm, 1, 0, 1, 0);
+		else
+			prv_charge(arm_vm, 1, 0, 0, 0);
+		break;
+	case SUBTILIS_ARM_INSTR_MUL:
+	case SUBTILIS_ARM_INSTR_MLA:
+		prv_charge(arm_vm, 1, 0, prv_booth_cycles(rs), 0);
+		break;
+	case SUBTILIS_ARM_INSTR_LDR:
+		prv_charge(arm_vm, 1, 1, 1, 0);
+		break;
+	case SUBTILIS_ARM_INSTR_STR:
+		prv_charge(arm_vm, 0, 2, 0, 1);
+		break;
+	case SUBTILIS_ARM_INSTR_LDM:
+		regs = prv_count_regs(instr->operands.mtran.reg_list);
+		prv_charge(arm_vm, regs, 1, 1, 0);
+		break;
+	case SUBTILIS_ARM_INSTR_STM:
+		regs = prv_count_regs(instr->operands.mtran.reg_list);
+		prv_charge(arm_vm, regs - 1, 2, 0, regs);
+		break;
+	case SUBTILIS_ARM_INSTR_B:
+		prv_charge(arm_vm, 1, 0, 0, 0);
+		break;
+	case SUBTILIS_ARM_INSTR_SWI:
+		/*
+		 * The cost of the trap into the OS.  The time spent in the
+		 * SWI handler itself is not modelled.
+		 */
+		prv_charge(arm_vm, 2, 1, 0, 0);
+		break;
+	default:
+		if ((instr->type > SUBTILIS_ARM_INSTR_INT_MAX) &&
+		    (instr->type < SUBTILIS_ARM_INSTR_FPA_MAX))
+			prv_charge(arm_vm, prv_fpe_cost(instr->type), 0, 0, 0);
+		else
+			prv_charge(arm_vm, 1, 0, 0, 0);
+		break;
+	}
+
+	if (prv_calc_pc(arm_vm) != old_pc + 1)
+		prv_charge(arm_vm, 1, 1, 0, 0);
+}
+
+static void prv_profile_init(subtilis_arm_vm_t *arm_vm, subtilis_error_t *err)
+{
+	free(arm_vm->hits);
+	free(arm_vm->hit_cycles);
+	free(arm_vm->edges);
+	arm_vm->edges = NULL;
+	arm_vm->num_edges = 0;
+	arm_vm->max_edges = 0;
+
+	arm_vm->hits = calloc(arm_vm->code_size, sizeof(*arm_vm->hits));
+	arm_vm->hit_cycles =
+	    calloc(arm_vm->code_size, sizeof(*arm_vm->hit_cycles));
+	if (!arm_vm->hits || !arm_vm->hit_cycles)
+		subtilis_error_set_oom(err);
+}
+
+static subtilis_arm_vm_edge_t *prv_find_edge(subtilis_arm_vm_edge_t *edges,
+					     size_t max_edges, size_t from,
+					     size_t to)
+{
+	size_t i = ((from * 2654435761u) ^ to) & (max_edges - 1);
+
+	while (edges[i].count &&
+	       ((edges[i].from != from) || (edges[i].to != to)))
+		i = (i + 1) & (max_edges - 1);
+
+	return &edges[i];
+}
+
+static void prv_grow_edges(subtilis_arm_vm_t *arm_vm, subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_arm_vm_edge_t *edge;
+	subtilis_arm_vm_edge_t *edges;
+	size_t max_edges = arm_vm->max_edges ? arm_vm->max_edges * 2 : 256;
+
+	edges = calloc(max_edges, sizeof(*edges));
+	if (!edges) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < arm_vm->max_edges; i++) {
+		if (!arm_vm->edges[i].count)
+			continue;
+		edge = prv_find_edge(edges, max_edges, arm_vm->edges[i].from,
+				     arm_vm->edges[i].to);
+		*edge = arm_vm->edges[i];
+	}
+
+	free(arm_vm->edges);
+	arm_vm->edges = edges;
+	arm_vm->max_edges = max_edges;
+}
+
+static void prv_profile_instr(subtilis_arm_vm_t *arm_vm, size_t pc,
+			      uint64_t cycles, subtilis_error_t *err)
+{
+	subtilis_arm_vm_edge_t *edge;
+	size_t new_pc = prv_calc_pc(arm_vm);
+
+	arm_vm->hits[pc]++;
+	arm_vm->hit_cycles[pc] += cycles;
+
+	if ((new_pc == pc + 1) || arm_vm->quit)
+		return;
+
+	if (arm_vm->num_edges * 2 >= arm_vm->max_edges) {
+		prv_grow_edges(arm_vm, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	edge = prv_find_edge(arm_vm->edges, arm_vm->max_edges, pc, new_pc);
+	if (!edge->count) {
+		edge->from = pc;
+		edge->to = new_pc;
+		arm_vm->num_edges++;
+	}
+	edge->count++;
+}
+
+void subtilis_arm_vm_run(subtilis_arm_vm_t *arm_vm, subtilis_buffer_t *b,
+			 subtilis_error_t *err)
+{
+	size_t pc;
+	subtilis_arm_instr_t *instr;
+	bool timed;
+	subtilis_arm_ccode_type_t ccode;
+	bool executed = true;
+	uint32_t rs = 0;
+	uint64_t cycles;
+
+	arm_vm->fpa_status = 0;
+	arm_vm->quit = false;
+	arm_vm->negative_flag = false;
+	arm_vm->zero_flag = false;
+	arm_vm->carry_flag = false;
+	arm_vm->overflow_flag = false;
+	arm_vm->fpscr = 0;
+
+	arm_vm->regs[15] = arm_vm->start_address + 8;
+
+	arm_vm->s_cycles = 0;
+	arm_vm->n_cycles = 0;
+	arm_vm->i_cycles = 0;
+	arm_vm->cycles = 0;
+
+	if (arm_vm->profile) {
+		if (arm_vm->timing == SUBTILIS_ARM_VM_TIMING_NONE)
+			arm_vm->timing = SUBTILIS_ARM_VM_TIMING_ARM2;
+		prv_profile_init(arm_vm, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	timed = arm_vm->timing != SUBTILIS_ARM_VM_TIMING_NONE;
+	if (arm_vm->threaded && !timed) {
+		prv_run_threaded(arm_vm, b, err);
+		return;
+	}
 
+	pc = prv_calc_pc(arm_vm);
+	while (!arm_vm->quit && pc < arm_vm->code_size) {
+		instr = prv_decode(arm_vm, pc, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		if (timed) {
+			ccode = ((uint32_t *)arm_vm->memory)[pc] >> 28;
+			executed = prv_match_ccode(arm_vm, ccode);
+			rs = prv_timing_rs(arm_vm, instr);
+		}
+		prv_execute(arm_vm, b, instr, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
+		if (timed) {
+			cycles = arm_vm->cycles;
+			prv_time_instr(arm_vm, instr, executed, rs, pc);
+			if (arm_vm->profile) {
+				prv_profile_instr(arm_vm, pc,
+						  arm_vm->cycles - cycles, err);
+				if (err->type != SUBTILIS_ERROR_OK)
+					return;
+			}
+		}
 
 		/*
 		 *		subtilis_arm_disass_dump(
@@ -41,6 +41,22 @@ union subtilis_arm_vm_vfpregs_t_ {
 
 typedef union subtilis_arm_vm_vfpregs_t_ subtilis_arm_vm_vfpregs_t;
 
+typedef struct subtilis_arm_vm_block_t_ subtilis_arm_vm_block_t;
+
+struct subtilis_arm_vm_edge_t_ {
+	size_t from;
+	size_t to;
+	uint64_t count;
+};
+
+typedef struct subtilis_arm_vm_edge_t_ subtilis_arm_vm_edge_t;
+
+typedef enum {
+	SUBTILIS_ARM_VM_TIMING_NONE,
+	SUBTILIS_ARM_VM_TIMING_ARM2,
+	SUBTILIS_ARM_VM_TIMING_ARM3,
+} subtilis_arm_vm_timing_t;
+
 struct subtilis_arm_vm_t_ {
 	int32_t regs[16];
 	subtilis_arm_vm_freg_t fregs[8];
@@ -62,6 +78,63 @@ struct subtilis_arm_vm_t_ {
 	int32_t start_address;
 	uint32_t fpscr;
 	bool vfp;
+
+	/*
+	 * Cache of decoded instructions, one entry per word of the code
+	 * area.  Entries are decoded lazily the first time the instruction
+	 * they describe is executed and are invalidated whenever the
+	 * word they were decoded from is written to.
+	 */
+
+	subtilis_arm_instr_t *decoded;
+	bool *decoded_valid;
+
+	/*
+	 * If threaded is set before subtilis_arm_vm_run is called, straight
+	 * line runs of instructions are translated into blocks of handlers
+	 * with pre-resolved operands, which are cached in blocks, indexed by
+	 * the word at which they start.  code_written is set whenever the
+	 * program writes to the code area, causing the cached blocks to be
+	 * discarded once the current instruction has completed.
+	 */
+
+	bool threaded;
+	subtilis_arm_vm_block_t **blocks;
+	bool code_written;
+
+	/*
+	 * If timing is set to a processor before subtilis_arm_vm_run is
+	 * called, each instruction executed is charged the sequential (S),
+	 * non-sequential (N) and internal (I) cycles it would take on that
+	 * processor.  FPA instructions are charged a rough estimate of the
+	 * time taken by the floating point emulator.  cycles holds the total
+	 * number of processor clock ticks.  The timing model is only
+	 * implemented by the interpreter, so threaded is ignored when timing
+	 * is enabled.
+	 */
+
+	subtilis_arm_vm_timing_t timing;
+	uint64_t s_cycles;
+	uint64_t n_cycles;
+	uint64_t i_cycles;
+	uint64_t cycles;
+
+	/*
+	 * If profile is set before subtilis_arm_vm_run is called, the number
+	 * of times each instruction is executed and the clock ticks it
+	 * takes are recorded in hits and hit_cycles, indexed by word.  Each
+	 * taken branch, or other non-sequential change to the PC, is
+	 * counted in edges, a hash table of max_edges entries indexed by
+	 * the words at which the edge starts and ends.  Profiling uses
+	 * the timing model, defaulting to the ARM2 if timing is not set.
+	 */
+
+	bool profile;
+	uint64_t *hits;
+	uint64_t *hit_cycles;
+	subtilis_arm_vm_edge_t *edges;
+	size_t num_edges;
+	size_t max_edges;
 	// clang-format off
 	FILE *files[SUBTILIS_ARM_VM_MAX_FILES];
 
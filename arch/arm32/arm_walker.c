@@ -346,6 +346,20 @@ static void prv_call_signx_fn(subtlis_arm_walker_t *walker, void *user_data,
 			 &instr->operands.signx, err);
 }
 
+static void prv_call_pld_fn(subtlis_arm_walker_t *walker, void *user_data,
+			    subtilis_arm_op_t *op, subtilis_error_t *err)
+{
+	subtilis_arm_instr_t *instr = &op->op.instr;
+
+	if (!walker->pld_fn) {
+		subtilis_error_set_assertion_failed(err);
+		return;
+	}
+
+	walker->pld_fn(walker->user_data, op, instr->type, &instr->operands.pld,
+		       err);
+}
+
 typedef void (*subtilis_walker_fn_t)(subtlis_arm_walker_t *walker,
 				     void *user_data, subtilis_arm_op_t *op,
 				     subtilis_error_t *err);
@@ -525,6 +539,13 @@ static const subtilis_walker_fn_t walker_table[] = {
 	prv_call_signx_fn,		// SUBTILIS_ARM_INSTR_SXTB,
 	prv_call_signx_fn,		// SUBTILIS_ARM_INSTR_SXTB16,
 	prv_call_signx_fn,		// SUBTILIS_ARM_INSTR_SXTH,
+	prv_call_signx_fn,		// SUBTILIS_ARM_INSTR_UXTB,
+	prv_call_signx_fn,		// SUBTILIS_ARM_INSTR_UXTB16,
+	prv_call_signx_fn,		// SUBTILIS_ARM_INSTR_UXTH,
+	prv_call_signx_fn,		// SUBTILIS_ARM_INSTR_REV,
+	prv_call_mul_fn,		// SUBTILIS_ARM_INSTR_SMULL,
+	prv_call_mul_fn,		// SUBTILIS_ARM_INSTR_UMULL,
+	prv_call_pld_fn,		// SUBTILIS_ARM_INSTR_PLD,
 };
 
 /* clang-format on */
@@ -158,6 +158,9 @@ struct subtlis_arm_walker_t_ {
 			 subtilis_arm_instr_type_t type,
 			 subtilis_arm_signx_instr_t *instr,
 			 subtilis_error_t *err);
+	void (*pld_fn)(void *user_data, subtilis_arm_op_t *op,
+		       subtilis_arm_instr_type_t type,
+		       subtilis_arm_pld_instr_t *instr, subtilis_error_t *err);
 };
 
 void subtilis_arm_walk(subtilis_arm_section_t *arm_s,
@@ -220,6 +220,7 @@ static const subtilis_arm_ass_mnemomic_t o_mnem[] = {
 };
 
 static const subtilis_arm_ass_mnemomic_t p_mnem[] = {
+	{ "PLD", SUBTILIS_ARM_INSTR_PLD, NULL, },
 	{ "POL", SUBTILIS_FPA_INSTR_POL, NULL, },
 	{ "POW", SUBTILIS_FPA_INSTR_POW, NULL, },
 };
@@ -235,6 +236,7 @@ static const subtilis_arm_ass_mnemomic_t q_mnem[] = {
 
 static const subtilis_arm_ass_mnemomic_t r_mnem[] = {
 	{ "RDF", SUBTILIS_FPA_INSTR_RDF, NULL, },
+	{ "REV", SUBTILIS_ARM_INSTR_REV, NULL, },
 	{ "RFS", SUBTILIS_FPA_INSTR_RFS, NULL, },
 	{ "RMF", SUBTILIS_FPA_INSTR_RMF, NULL, },
 	{ "RND", SUBTILIS_FPA_INSTR_RND, NULL, },
@@ -256,6 +258,7 @@ static const subtilis_arm_ass_mnemomic_t s_mnem[] = {
 	{ "SHSUB8", SUBTILIS_ARM_SIMD_SHSUB8, NULL, },
 	{ "SHSUBADDX", SUBTILIS_ARM_SIMD_SHSUBADDX, NULL, },
 	{ "SIN", SUBTILIS_FPA_INSTR_SIN, NULL, },
+	{ "SMULL", SUBTILIS_ARM_INSTR_SMULL, NULL, },
 	{ "SQT", SUBTILIS_FPA_INSTR_SQT, NULL, },
 	{ "SSUB16", SUBTILIS_ARM_SIMD_SSUB16, NULL, },
 	{ "SSUB8", SUBTILIS_ARM_SIMD_SSUB8, NULL, },
@@ -287,6 +290,7 @@ static const subtilis_arm_ass_mnemomic_t u_mnem[] = {
 	{ "UHSUB16", SUBTILIS_ARM_SIMD_UHSUB16, NULL, },
 	{ "UHSUB8", SUBTILIS_ARM_SIMD_UHSUB8, NULL, },
 	{ "UHSUBADDX", SUBTILIS_ARM_SIMD_UHSUBADDX, NULL, },
+	{ "UMULL", SUBTILIS_ARM_INSTR_UMULL, NULL, },
 	{ "UQADD16", SUBTILIS_ARM_SIMD_UQADD16, NULL, },
 	{ "UQADD8", SUBTILIS_ARM_SIMD_UQADD8, NULL, },
 	{ "UQADDSUBX", SUBTILIS_ARM_SIMD_UQADDSUBX, NULL, },
@@ -297,6 +301,9 @@ static const subtilis_arm_ass_mnemomic_t u_mnem[] = {
 	{ "USUB16", SUBTILIS_ARM_SIMD_USUB16, NULL, },
 	{ "USUB8", SUBTILIS_ARM_SIMD_USUB8, NULL, },
 	{ "USUBADDX", SUBTILIS_ARM_SIMD_USUBADDX, NULL, },
+	{ "UXTB", SUBTILIS_ARM_INSTR_UXTB, NULL, },
+	{ "UXTB16", SUBTILIS_ARM_INSTR_UXTB16, NULL, },
+	{ "UXTH", SUBTILIS_ARM_INSTR_UXTH, NULL, },
 };
 
 static const subtilis_arm_ass_mnemomic_t w_mnem[] = {
@@ -883,6 +890,64 @@ static void prv_parse_arm_mul(subtilis_arm_ass_context_t *c,
 	mul->status = status;
 }
 
+static void prv_parse_arm_mull(subtilis_arm_ass_context_t *c,
+			       subtilis_arm_instr_type_t itype,
+			       subtilis_arm_ccode_type_t ccode, bool status,
+			       subtilis_error_t *err)
+{
+	subtilis_arm_reg_t regs[4];
+	const char *tbuf;
+	subtilis_arm_instr_t *instr;
+	subtilis_arm_mul_instr_t *mul;
+	size_t i;
+	char buffer[32];
+
+	for (i = 0; i < 4; i++) {
+		if (i > 0) {
+			tbuf = subtilis_token_get_text(c->t);
+			if ((c->t->type != SUBTILIS_TOKEN_OPERATOR) ||
+			    (strcmp(tbuf, ","))) {
+				subtilis_error_set_expected(err, ",", tbuf,
+							    c->l->stream->name,
+							    c->l->line);
+				return;
+			}
+		}
+
+		regs[i] = prv_get_reg(c, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		if (regs[i] == 15) {
+			sprintf(buffer, "R%zu", regs[i]);
+			subtilis_error_set_ass_bad_reg(
+			    err, buffer, c->l->stream->name, c->l->line);
+			return;
+		}
+	}
+
+	/* RdLo and RdHi must differ. */
+
+	if (regs[0] == regs[1]) {
+		sprintf(buffer, "R%zu", regs[1]);
+		subtilis_error_set_ass_bad_reg(err, buffer, c->l->stream->name,
+					       c->l->line);
+		return;
+	}
+
+	instr = subtilis_arm_section_add_instr(c->arm_s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	mul = &instr->operands.mul;
+	mul->ccode = ccode;
+	mul->rn = regs[0];
+	mul->dest = regs[1];
+	mul->rm = regs[2];
+	mul->rs = regs[3];
+	mul->status = status;
+}
+
 static void prv_parse_arm_2_arg(subtilis_arm_ass_context_t *c,
 				subtilis_arm_instr_type_t itype,
 				subtilis_arm_ccode_type_t ccode, bool status,
@@ -1932,8 +1997,11 @@ static void prv_parse_signx(subtilis_arm_ass_context_t *c,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	/* REV does not support a rotation. */
+
 	tbuf = subtilis_token_get_text(c->t);
-	if ((c->t->type == SUBTILIS_TOKEN_OPERATOR) && !strcmp(tbuf, ",")) {
+	if ((itype != SUBTILIS_ARM_INSTR_REV) &&
+	    (c->t->type == SUBTILIS_TOKEN_OPERATOR) && !strcmp(tbuf, ",")) {
 		subtilis_lexer_get(c->l, c->t, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
@@ -1984,6 +2052,82 @@ cleanup:
 	subtilis_arm_exp_val_free(val);
 }
 
+static void prv_parse_pld(subtilis_arm_ass_context_t *c,
+			  subtilis_arm_ccode_type_t ccode,
+			  subtilis_error_t *err)
+{
+	subtilis_arm_reg_t base;
+	const char *tbuf;
+	subtilis_arm_exp_val_t *val = NULL;
+	int32_t offset = 0;
+	bool subtract = false;
+
+	/* PLD cannot be executed conditionally. */
+
+	if (ccode != SUBTILIS_ARM_CCODE_AL) {
+		subtilis_error_set_not_supported(
+		    err, "conditional PLD", c->l->stream->name, c->l->line);
+		return;
+	}
+
+	subtilis_lexer_get(c->l, c->t, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	tbuf = subtilis_token_get_text(c->t);
+	if ((c->t->type != SUBTILIS_TOKEN_OPERATOR) || (strcmp(tbuf, "["))) {
+		subtilis_error_set_expected(err, "[", tbuf, c->l->stream->name,
+					    c->l->line);
+		return;
+	}
+
+	base = prv_get_reg(c, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	tbuf = subtilis_token_get_text(c->t);
+	if ((c->t->type == SUBTILIS_TOKEN_OPERATOR) && !strcmp(tbuf, ",")) {
+		subtilis_lexer_get(c->l, c->t, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		val = prv_get_offset(c, &subtract, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		if (val->type != SUBTILIS_ARM_EXP_TYPE_INT) {
+			subtilis_error_set_expected(
+			    err, "integer", subtilis_arm_exp_type_name(val),
+			    c->l->stream->name, c->l->line);
+			goto cleanup;
+		}
+
+		offset = subtract ? -val->val.integer : val->val.integer;
+		if ((offset > 4095) || (offset < -4095)) {
+			subtilis_error_set_ass_bad_offset(
+			    err, offset, c->l->stream->name, c->l->line);
+			goto cleanup;
+		}
+		tbuf = subtilis_token_get_text(c->t);
+	}
+
+	if ((c->t->type != SUBTILIS_TOKEN_OPERATOR) || (strcmp(tbuf, "]"))) {
+		subtilis_error_set_expected(err, "]", tbuf, c->l->stream->name,
+					    c->l->line);
+		goto cleanup;
+	}
+
+	subtilis_arm_add_pld(c->arm_s, base, offset, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	subtilis_lexer_get(c->l, c->t, err);
+
+cleanup:
+
+	subtilis_arm_exp_val_free(val);
+}
+
 static void prv_parse_instruction(subtilis_arm_ass_context_t *c,
 				  const char *name,
 				  subtilis_arm_instr_type_t itype,
@@ -2016,6 +2160,10 @@ static void prv_parse_instruction(subtilis_arm_ass_context_t *c,
 	case SUBTILIS_ARM_INSTR_MLA:
 		prv_parse_arm_mul(c, itype, ccode, modifiers->status, err);
 		break;
+	case SUBTILIS_ARM_INSTR_SMULL:
+	case SUBTILIS_ARM_INSTR_UMULL:
+		prv_parse_arm_mull(c, itype, ccode, modifiers->status, err);
+		break;
 	case SUBTILIS_ARM_INSTR_TST:
 	case SUBTILIS_ARM_INSTR_TEQ:
 	case SUBTILIS_ARM_INSTR_CMP:
@@ -2089,8 +2237,15 @@ static void prv_parse_instruction(subtilis_arm_ass_context_t *c,
 	case SUBTILIS_ARM_INSTR_SXTB:
 	case SUBTILIS_ARM_INSTR_SXTB16:
 	case SUBTILIS_ARM_INSTR_SXTH:
+	case SUBTILIS_ARM_INSTR_UXTB:
+	case SUBTILIS_ARM_INSTR_UXTB16:
+	case SUBTILIS_ARM_INSTR_UXTH:
+	case SUBTILIS_ARM_INSTR_REV:
 		prv_parse_signx(c, itype, ccode, err);
 		break;
+	case SUBTILIS_ARM_INSTR_PLD:
+		prv_parse_pld(c, ccode, err);
+		break;
 	default:
 		subtilis_error_set_not_supported(err, name, c->l->stream->name,
 						 c->l->line);
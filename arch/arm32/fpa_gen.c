@@ -20,6 +20,7 @@
 #include "../../common/error_codes.h"
 #include "arm_core.h"
 #include "arm_gen.h"
+#include "arm_peephole.h"
 #include "fpa_alloc.h"
 #include "fpa_gen.h"
 
@@ -985,6 +986,113 @@ void subtilis_fpa_mov_reg(subtilis_arm_section_t *arm_s,
 			     SUBTILIS_FPA_ROUNDING_NEAREST, dest, src, err);
 }
 
+/*
+ * Removes MVF fX, fX.
+ */
+
+static bool prv_peephole_self_mvf(subtilis_arm_peephole_t *ph, size_t *ptr,
+				  subtilis_error_t *err)
+{
+	subtilis_fpa_data_instr_t *fpa_data;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	fpa_data = &arm_s->op_pool->ops[*ptr].op.instr.operands.fpa_data;
+	if (fpa_data->immediate || fpa_data->op2.reg != fpa_data->dest)
+		return false;
+
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/*
+ * Removes the LDFs and STFs disabled by subtilis_fpa_preserve_update.
+ */
+
+static bool prv_peephole_nv_stran(subtilis_arm_peephole_t *ph, size_t *ptr,
+				  subtilis_error_t *err)
+{
+	subtilis_fpa_stran_instr_t *fpa_stran;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	fpa_stran = &arm_s->op_pool->ops[*ptr].op.instr.operands.fpa_stran;
+	if (fpa_stran->ccode != SUBTILIS_ARM_CCODE_NV)
+		return false;
+
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/*
+ * STF fS, [rB, #o]
+ * LDF fD, [rB, #o]
+ *
+ * The LDF becomes MVF fD, fS or is removed if fD is fS.
+ */
+
+static bool prv_peephole_forward_stf(subtilis_arm_peephole_t *ph, size_t *ptr,
+				     subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *prev;
+	subtilis_fpa_stran_instr_t *ldf;
+	subtilis_fpa_stran_instr_t *stf;
+	subtilis_fpa_data_instr_t *mvf;
+	subtilis_arm_reg_t dest;
+	subtilis_arm_reg_t src;
+	size_t size;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	ldf = &op->op.instr.operands.fpa_stran;
+	if ((ldf->ccode != SUBTILIS_ARM_CCODE_AL) || !ldf->pre_indexed ||
+	    ldf->write_back || (ldf->base == 15) || (*ptr == arm_s->first_op))
+		return false;
+
+	prev = &arm_s->op_pool->ops[op->prev];
+	if ((prev->type != SUBTILIS_ARM_OP_INSTR) ||
+	    (prev->op.instr.type != SUBTILIS_FPA_INSTR_STF))
+		return false;
+
+	stf = &prev->op.instr.operands.fpa_stran;
+	if ((stf->ccode != SUBTILIS_ARM_CCODE_AL) || !stf->pre_indexed ||
+	    stf->write_back || (stf->base != ldf->base) ||
+	    (stf->offset != ldf->offset) || (stf->subtract != ldf->subtract) ||
+	    (stf->size != ldf->size))
+		return false;
+
+	if (stf->dest == ldf->dest) {
+		*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+		return true;
+	}
+
+	dest = ldf->dest;
+	src = stf->dest;
+	size = ldf->size;
+
+	op->op.instr.type = SUBTILIS_FPA_INSTR_MVF;
+	mvf = &op->op.instr.operands.fpa_data;
+	mvf->ccode = SUBTILIS_ARM_CCODE_AL;
+	mvf->rounding = SUBTILIS_FPA_ROUNDING_NEAREST;
+	mvf->size = size;
+	mvf->dest = dest;
+	mvf->op1 = 0;
+	mvf->immediate = false;
+	mvf->op2.reg = src;
+
+	*ptr = op->next;
+	return true;
+}
+
+/* clang-format off */
+static const subtilis_arm_peephole_rule_t prv_peephole_rules[] = {
+	{SUBTILIS_FPA_INSTR_MVF, prv_peephole_self_mvf},
+	{SUBTILIS_FPA_INSTR_LDF, prv_peephole_nv_stran},
+	{SUBTILIS_FPA_INSTR_STF, prv_peephole_nv_stran},
+	{SUBTILIS_FPA_INSTR_LDF, prv_peephole_forward_stf},
+};
+
+/* clang-format on */
+
 void subtilis_arm_fpa_if_init(subtilis_arm_fp_if_t *fp_if)
 {
 	double dummy_float = 1.0;
@@ -1010,4 +1118,8 @@ void subtilis_arm_fpa_if_init(subtilis_arm_fp_if_t *fp_if)
 	fp_if->init_dist_walker_fn = subtilis_init_fpa_dist_walker;
 	fp_if->init_used_walker_fn = subtilis_init_fpa_used_walker;
 	fp_if->init_real_alloc_fn = subtilis_fpa_alloc_init_walker;
+	fp_if->armv6 = false;
+	fp_if->peephole_rules = prv_peephole_rules;
+	fp_if->peephole_rule_count =
+	    sizeof(prv_peephole_rules) / sizeof(prv_peephole_rules[0]);
 }
@@ -19,6 +19,7 @@
 #include "../../common/error_codes.h"
 #include "arm_core.h"
 #include "arm_gen.h"
+#include "arm_peephole.h"
 #include "arm_vfp_dist.h"
 #include "vfp_alloc.h"
 #include "vfp_gen.h"
@@ -1115,6 +1116,108 @@ bool subtilis_vfp_is_fixed(size_t reg)
 	return reg < SUBTILIS_ARM_REG_MAX_VFP_DBL_REGS;
 }
 
+/*
+ * Removes FCPYD dX, dX.
+ */
+
+static bool prv_peephole_self_fcpyd(subtilis_arm_peephole_t *ph, size_t *ptr,
+				    subtilis_error_t *err)
+{
+	subtilis_vfp_copy_instr_t *vfp_copy;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	vfp_copy = &arm_s->op_pool->ops[*ptr].op.instr.operands.vfp_copy;
+	if (vfp_copy->src != vfp_copy->dest)
+		return false;
+
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/*
+ * Removes the FLDDs and FSTDs disabled by subtilis_vfp_preserve_update.
+ */
+
+static bool prv_peephole_nv_stran(subtilis_arm_peephole_t *ph, size_t *ptr,
+				  subtilis_error_t *err)
+{
+	subtilis_vfp_stran_instr_t *vfp_stran;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	vfp_stran = &arm_s->op_pool->ops[*ptr].op.instr.operands.vfp_stran;
+	if (vfp_stran->ccode != SUBTILIS_ARM_CCODE_NV)
+		return false;
+
+	*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+	return true;
+}
+
+/*
+ * FSTD dS, [rB, #o]
+ * FLDD dD, [rB, #o]
+ *
+ * The FLDD becomes FCPYD dD, dS or is removed if dD is dS.
+ */
+
+static bool prv_peephole_forward_fstd(subtilis_arm_peephole_t *ph,
+				      size_t *ptr, subtilis_error_t *err)
+{
+	subtilis_arm_op_t *op;
+	subtilis_arm_op_t *prev;
+	subtilis_vfp_stran_instr_t *fldd;
+	subtilis_vfp_stran_instr_t *fstd;
+	subtilis_vfp_copy_instr_t *fcpyd;
+	subtilis_arm_reg_t dest;
+	subtilis_arm_reg_t src;
+	subtilis_arm_section_t *arm_s = ph->arm_s;
+
+	op = &arm_s->op_pool->ops[*ptr];
+	fldd = &op->op.instr.operands.vfp_stran;
+	if ((fldd->ccode != SUBTILIS_ARM_CCODE_AL) || !fldd->pre_indexed ||
+	    fldd->write_back || (fldd->base == 15) ||
+	    (*ptr == arm_s->first_op))
+		return false;
+
+	prev = &arm_s->op_pool->ops[op->prev];
+	if ((prev->type != SUBTILIS_ARM_OP_INSTR) ||
+	    (prev->op.instr.type != SUBTILIS_VFP_INSTR_FSTD))
+		return false;
+
+	fstd = &prev->op.instr.operands.vfp_stran;
+	if ((fstd->ccode != SUBTILIS_ARM_CCODE_AL) || !fstd->pre_indexed ||
+	    fstd->write_back || (fstd->base != fldd->base) ||
+	    (fstd->offset != fldd->offset) ||
+	    (fstd->subtract != fldd->subtract))
+		return false;
+
+	if (fstd->dest == fldd->dest) {
+		*ptr = subtilis_arm_peephole_remove(arm_s, *ptr);
+		return true;
+	}
+
+	dest = fldd->dest;
+	src = fstd->dest;
+
+	op->op.instr.type = SUBTILIS_VFP_INSTR_FCPYD;
+	fcpyd = &op->op.instr.operands.vfp_copy;
+	fcpyd->ccode = SUBTILIS_ARM_CCODE_AL;
+	fcpyd->dest = dest;
+	fcpyd->src = src;
+
+	*ptr = op->next;
+	return true;
+}
+
+/* clang-format off */
+static const subtilis_arm_peephole_rule_t prv_peephole_rules[] = {
+	{SUBTILIS_VFP_INSTR_FCPYD, prv_peephole_self_fcpyd},
+	{SUBTILIS_VFP_INSTR_FSTD, prv_peephole_nv_stran},
+	{SUBTILIS_VFP_INSTR_FLDD, prv_peephole_nv_stran},
+	{SUBTILIS_VFP_INSTR_FLDD, prv_peephole_forward_fstd},
+};
+
+/* clang-format on */
+
 void subtilis_arm_vfp_if_init(subtilis_arm_fp_if_t *fp_if)
 {
 	fp_if->max_regs =
@@ -1137,4 +1240,8 @@ void subtilis_arm_vfp_if_init(subtilis_arm_fp_if_t *fp_if)
 	fp_if->init_dist_walker_fn = subtilis_init_vfp_dist_walker;
 	fp_if->init_used_walker_fn = subtilis_init_vfp_used_walker;
 	fp_if->init_real_alloc_fn = subtilis_vfp_alloc_init_walker;
+	fp_if->armv6 = true;
+	fp_if->peephole_rules = prv_peephole_rules;
+	fp_if->peephole_rule_count =
+	    sizeof(prv_peephole_rules) / sizeof(prv_peephole_rules[0]);
 }
@@ -0,0 +1,1956 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include "../../common/error_codes.h"
+#include "arm_gen.h"
+#include "vfp_math.h"
+
+/*
+ * The routines in this file are based on the range reduction schemes and
+ * minimax polynomials used by fdlibm.  Each builtin is self contained.
+ * Code that's shared between the builtins, e.g., the exponential step of
+ * POW, is generated into each builtin that needs it so the builtins never
+ * call each other.  The builtins don't allocate registers.  They're free
+ * to use R0-R11 and D0-D15 as the caller preserves any registers it needs.
+ *
+ * The accurate routines are within a few ulps of the correctly rounded
+ * result, with the exception of POW, whose error grows with the size of
+ * y * LN(x) and can reach about 40 ulps for results close to the limits
+ * of the double range.  The fast routines use lower degree polynomials
+ * and have a relative error of about 1e-9.  LOG and LN always use the
+ * accurate polynomials so that LOG(1000) is exactly 3.
+ */
+
+static const double prv_sin_acc[] = {
+    -1.66666666666666324348e-01, 8.33333333332248946124e-03,
+    -1.98412698298579493134e-04, 2.75573137070700676789e-06,
+    -2.50507602534068634195e-08, 1.58969099521155010221e-10,
+};
+
+static const double prv_cos_acc[] = {
+    4.16666666666666019037e-02, -1.38888888888741095749e-03,
+    2.48015872894767294178e-05, -2.75573143513906633035e-07,
+    2.08757232129817482790e-09, -1.13596475577881948265e-11,
+};
+
+static const double prv_atan_acc[] = {
+    3.33333333333329318027e-01, -1.99999999998764832476e-01,
+    1.42857142725034663711e-01, -1.11111104054623557880e-01,
+    9.09088713343650656196e-02, -7.69187620504482999495e-02,
+    6.66107313738753120669e-02, -5.83357013379057348645e-02,
+    4.97687799461593236017e-02, -3.65315727442169155270e-02,
+    1.62858201153657823623e-02,
+};
+
+static const double prv_exp_acc[] = {
+    1.66666666666666019037e-01, -2.77777777770155933842e-03,
+    6.61375632143793436117e-05, -1.65339022054652515390e-06,
+    4.13813679705723846039e-08,
+};
+
+static const double prv_log_acc[] = {
+    6.666666666666735130e-01, 3.999999999940941908e-01,
+    2.857142874366239149e-01, 2.222219843214978396e-01,
+    1.818357216161805012e-01, 1.531383769920937332e-01,
+    1.479819860511658591e-01,
+};
+
+static const double prv_sin_fast[] = {
+    -0x15555554cbac77p-55,
+    0x111110896efbb2p-59,
+    -0x1a00f9e2cae774p-65,
+    0x16cd878c3b46a7p-71,
+};
+
+static const double prv_cos_fast[] = {
+    -0x1ffffffd0c5e81p-54,
+    0x155553e1053a42p-57,
+    -0x16c087e80f1e27p-62,
+    0x199342e0ee5069p-68,
+};
+
+static const double prv_atan_fast[] = {
+    3.3333328366e-01,  -1.9999158382e-01, 1.4253635705e-01,
+    -1.0648017377e-01, 6.1687607318e-02,
+};
+
+static const double prv_exp_fast[] = {
+    0xaaaa8fp-26,
+    -0xb55215p-32,
+};
+
+#define SUBTILIS_VFP_MATH_COEFFS(c) c, sizeof(c) / sizeof(c[0])
+
+/* pi / 2 split into three parts for the reduction of SIN, COS and TAN. */
+
+static const double prv_pio2_1 = 1.57079632673412561417e+00;
+static const double prv_pio2_2 = 6.07710050630396597660e-11;
+static const double prv_pio2_2t = 2.02226624879595063154e-21;
+static const double prv_invpio2 = 6.36619772367581382433e-01;
+
+static const double prv_pio2_hi = 1.57079632679489655800e+00;
+static const double prv_pio2_lo = 6.12323399573676603587e-17;
+static const double prv_pio6 = 5.23598775598298815659e-01;
+static const double prv_pi_hi = 3.14159265358979311600e+00;
+static const double prv_pi_lo = 1.22464679914735317722e-16;
+static const double prv_tan_pio12 = 0.2679491924311227;
+static const double prv_sqrt3 = 1.73205080756887719318e+00;
+
+static const double prv_ln2_hi = 6.93147180369123816490e-01;
+static const double prv_ln2_lo = 1.90821492927058770002e-10;
+static const double prv_invln2 = 1.44269504088896338700e+00;
+static const double prv_ivln10 = 4.34294481903251816668e-01;
+static const double prv_log10_2hi = 3.01029995663611771306e-01;
+static const double prv_log10_2lo = 3.69423907715893078616e-13;
+
+/*
+ * Arguments to EXP, or the product y * LN(x) computed by POW, are clamped
+ * to this range before being reduced.  This ensures that the integer
+ * part of the reduced argument fits in an int and that the result
+ * overflows or underflows correctly.
+ */
+
+static const double prv_exp_limit = 1400.0;
+
+/* Used to split a double into two halves with 26 significant bits. */
+
+static const double prv_split = 134217729.0;
+
+static void prv_add_branch(subtilis_arm_section_t *arm_s,
+			   subtilis_arm_ccode_type_t ccode, size_t label,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_br_instr_t *br;
+	subtilis_arm_instr_t *instr;
+
+	instr =
+	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_B, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	br = &instr->operands.br;
+	br->ccode = ccode;
+	br->link = false;
+	br->link_type = SUBTILIS_ARM_BR_LINK_VOID;
+	br->target.label = label;
+}
+
+static void prv_add_data_reg(subtilis_arm_section_t *arm_s,
+			     subtilis_arm_instr_type_t itype,
+			     subtilis_arm_reg_t dest, subtilis_arm_reg_t op1,
+			     subtilis_arm_reg_t op2, subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_instr_t *instr;
+
+	instr = subtilis_arm_section_add_instr(arm_s, itype, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	datai = &instr->operands.data;
+	datai->ccode = SUBTILIS_ARM_CCODE_AL;
+	datai->status = false;
+	datai->dest = dest;
+	datai->op1 = op1;
+	datai->op2.type = SUBTILIS_ARM_OP2_REG;
+	datai->op2.op.reg = op2;
+}
+
+static void prv_add_mov_shift(subtilis_arm_section_t *arm_s,
+			      subtilis_arm_reg_t dest, subtilis_arm_reg_t op2,
+			      subtilis_arm_shift_type_t type, int32_t shift,
+			      subtilis_error_t *err)
+{
+	subtilis_arm_data_instr_t *datai;
+	subtilis_arm_instr_t *instr;
+
+	instr =
+	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_MOV, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	datai = &instr->operands.data;
+	datai->ccode = SUBTILIS_ARM_CCODE_AL;
+	datai->status = false;
+	datai->dest = dest;
+	datai->op1 = 0;
+	datai->op2.type = SUBTILIS_ARM_OP2_SHIFTED;
+	datai->op2.op.shift.shift_reg = false;
+	datai->op2.op.shift.reg = op2;
+	datai->op2.op.shift.type = type;
+	datai->op2.op.shift.shift.integer = shift;
+}
+
+static void prv_add_ret(subtilis_arm_section_t *arm_s,
+			subtilis_arm_ccode_type_t ccode, subtilis_error_t *err)
+{
+	subtilis_arm_add_mov_reg(arm_s, ccode, false, 15, 14, err);
+}
+
+/*
+ * Compares two doubles, or a double and 0 if op2 is negative, and copies
+ * the resulting flags into the CPSR.
+ */
+
+static void prv_add_cmp(subtilis_arm_section_t *arm_s, subtilis_arm_reg_t op1,
+			int op2, subtilis_error_t *err)
+{
+	if (op2 < 0)
+		subtilis_vfp_add_cmpz(arm_s, SUBTILIS_VFP_INSTR_FCMPZD,
+				      SUBTILIS_ARM_CCODE_AL, op1, err);
+	else
+		subtilis_vfp_add_cmp(arm_s, SUBTILIS_VFP_INSTR_FCMPD,
+				     SUBTILIS_ARM_CCODE_AL, op1, op2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_sysreg(arm_s, SUBTILIS_VFP_INSTR_FMRX,
+				SUBTILIS_ARM_CCODE_AL,
+				SUBTILIS_VFP_SYSREG_FPSCR, 15, err);
+}
+
+static void prv_add_ldc(subtilis_arm_section_t *arm_s,
+			subtilis_arm_ccode_type_t ccode,
+			subtilis_arm_reg_t dest, double val,
+			subtilis_error_t *err)
+{
+	subtilis_vfp_add_copy_imm(arm_s, ccode, dest, val, err);
+}
+
+static void prv_add_data(subtilis_arm_section_t *arm_s,
+			 subtilis_arm_instr_type_t itype,
+			 subtilis_arm_ccode_type_t ccode,
+			 subtilis_arm_reg_t dest, subtilis_arm_reg_t op1,
+			 subtilis_arm_reg_t op2, subtilis_error_t *err)
+{
+	subtilis_vfp_add_data(arm_s, itype, ccode, dest, op1, op2, err);
+}
+
+#define prv_add_fmuld(s, d, a, b, err)                                         \
+	prv_add_data(s, SUBTILIS_VFP_INSTR_FMULD, SUBTILIS_ARM_CCODE_AL, d, a, \
+		     b, err)
+#define prv_add_faddd(s, d, a, b, err)                                         \
+	prv_add_data(s, SUBTILIS_VFP_INSTR_FADDD, SUBTILIS_ARM_CCODE_AL, d, a, \
+		     b, err)
+#define prv_add_fsubd(s, d, a, b, err)                                         \
+	prv_add_data(s, SUBTILIS_VFP_INSTR_FSUBD, SUBTILIS_ARM_CCODE_AL, d, a, \
+		     b, err)
+#define prv_add_fmacd(s, d, a, b, err)                                         \
+	prv_add_data(s, SUBTILIS_VFP_INSTR_FMACD, SUBTILIS_ARM_CCODE_AL, d, a, \
+		     b, err)
+#define prv_add_fnmacd(s, d, a, b, err)                                        \
+	prv_add_data(s, SUBTILIS_VFP_INSTR_FNMACD, SUBTILIS_ARM_CCODE_AL, d,   \
+		     a, b, err)
+
+/*
+ * Rounds the double in src to the nearest integer, storing the integer
+ * in the ARM register dest and the rounded value as a double in
+ * rounded.  FPSCR is set to round to nearest by the preamble.
+ */
+
+static void prv_add_round(subtilis_arm_section_t *arm_s,
+			  subtilis_arm_reg_t dest, subtilis_arm_reg_t rounded,
+			  subtilis_arm_reg_t src, subtilis_arm_reg_t tmp,
+			  subtilis_error_t *err)
+{
+	subtilis_vfp_add_tran(arm_s, SUBTILIS_VFP_INSTR_FTOSID,
+			      SUBTILIS_ARM_CCODE_AL, true, tmp, src, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_cptran(arm_s, SUBTILIS_VFP_INSTR_FMRS,
+				SUBTILIS_ARM_CCODE_AL, true, dest, tmp, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_tran(arm_s, SUBTILIS_VFP_INSTR_FSITOD,
+			      SUBTILIS_ARM_CCODE_AL, true, rounded, tmp, err);
+}
+
+static void prv_add_to_double(subtilis_arm_section_t *arm_s,
+			      subtilis_arm_reg_t dest, subtilis_arm_reg_t src,
+			      subtilis_arm_reg_t tmp, subtilis_error_t *err)
+{
+	subtilis_vfp_add_cptran(arm_s, SUBTILIS_VFP_INSTR_FMSR,
+				SUBTILIS_ARM_CCODE_AL, true, tmp, src, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_tran(arm_s, SUBTILIS_VFP_INSTR_FSITOD,
+			      SUBTILIS_ARM_CCODE_AL, true, dest, tmp, err);
+}
+
+/*
+ * Evaluates the polynomial c[0] + c[1] * z + ... + c[n-1] * z^(n-1)
+ * using Horner's method.  The registers a and b are used to hold the
+ * intermediate results and the function returns the one that holds the
+ * result.
+ */
+
+static subtilis_arm_reg_t prv_add_poly(subtilis_arm_section_t *arm_s,
+				       subtilis_arm_reg_t z, const double *c,
+				       size_t n, subtilis_arm_reg_t a,
+				       subtilis_arm_reg_t b,
+				       subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_arm_reg_t tmp;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, a, c[n - 1], err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return a;
+
+	for (i = n - 1; i > 0; i--) {
+		prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, b, c[i - 1], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return a;
+
+		prv_add_fmacd(arm_s, b, a, z, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return a;
+
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	return a;
+}
+
+static bool prv_fast(subtilis_arm_section_t *arm_s)
+{
+	return arm_s->settings->trans_tier == SUBTILIS_TRANS_TIER_FAST;
+}
+
+/*
+ * Reduces the argument of SIN, COS or TAN, in D0, to the range
+ * [-pi/4, pi/4].  The reduced argument is left in D0 and the number of
+ * multiples of pi/2 that were subtracted from the argument is left in R0.
+ * The precision of the reduction degrades gradually for arguments
+ * larger than about 1e6 and the results are meaningless for arguments
+ * larger than 2^31 * pi / 2.
+ */
+
+static void prv_trig_reduce(subtilis_arm_section_t *arm_s,
+			    subtilis_error_t *err)
+{
+	size_t i;
+	const double parts[] = {prv_pio2_1, prv_pio2_2, prv_pio2_2t};
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, prv_invpio2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 2, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_round(arm_s, 0, 2, 2, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	for (i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+		prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, parts[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fnmacd(arm_s, 0, 2, 1, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+}
+
+/*
+ * Computes sin(r), where r is in D0 and z = r * r is in D5, leaving the
+ * result in dest.  Uses D6-D8.
+ */
+
+static void prv_ksin(subtilis_arm_section_t *arm_s, subtilis_arm_reg_t dest,
+		     subtilis_error_t *err)
+{
+	subtilis_arm_reg_t p;
+
+	if (prv_fast(arm_s))
+		p = prv_add_poly(arm_s, 5,
+				 SUBTILIS_VFP_MATH_COEFFS(prv_sin_fast), 6, 7,
+				 err);
+	else
+		p = prv_add_poly(arm_s, 5,
+				 SUBTILIS_VFP_MATH_COEFFS(prv_sin_acc), 6, 7,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 8, 0, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (dest != 0) {
+		subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+				      SUBTILIS_VFP_INSTR_FCPYD, dest, 0, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	prv_add_fmacd(arm_s, dest, 8, p, err);
+}
+
+/*
+ * Computes cos(r), where z = r * r is in D5, leaving the result in dest.
+ * Uses D6-D11.
+ */
+
+static void prv_kcos(subtilis_arm_section_t *arm_s, subtilis_arm_reg_t dest,
+		     subtilis_error_t *err)
+{
+	subtilis_arm_reg_t p;
+
+	if (prv_fast(arm_s)) {
+		p = prv_add_poly(arm_s, 5,
+				 SUBTILIS_VFP_MATH_COEFFS(prv_cos_fast), 6, 7,
+				 err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, dest, 1.0, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fmacd(arm_s, dest, 5, p, err);
+		return;
+	}
+
+	/*
+	 * cos(r) = 1 - z / 2 + z * z * p(z).  1 - z / 2 is computed as
+	 * w + ((1 - w) - z / 2) to avoid losing precision.
+	 */
+
+	p = prv_add_poly(arm_s, 5, SUBTILIS_VFP_MATH_COEFFS(prv_cos_acc), 6, 7,
+			 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 8, 5, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 9, 0.5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 9, 5, 9, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 10, 1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 11, 10, 9, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 10, 10, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 10, 10, 9, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 10, 8, p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, dest, 11, 10, err);
+}
+
+/*
+ * SIN and COS are identical apart from the quadrant.  COS(x) is
+ * computed as SIN(x + pi/2).
+ */
+
+static void prv_sin_cos(subtilis_arm_section_t *arm_s, bool cos,
+			subtilis_error_t *err)
+{
+	size_t cos_label = arm_s->label_counter++;
+	size_t done_label = arm_s->label_counter++;
+
+	prv_trig_reduce(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (cos) {
+		subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 0,
+					 0, 1, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	prv_add_fmuld(arm_s, 5, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_TST,
+				 SUBTILIS_ARM_CCODE_AL, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_NE, cos_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_ksin(arm_s, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, done_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, cos_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_kcos(arm_s, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, done_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_TST,
+				 SUBTILIS_ARM_CCODE_AL, 0, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_NE,
+			      SUBTILIS_VFP_INSTR_FNEGD, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+void subtilis_vfp_math_sin(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_sin_cos(arm_s, false, err);
+}
+
+void subtilis_vfp_math_cos(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_sin_cos(arm_s, true, err);
+}
+
+void subtilis_vfp_math_tan(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_trig_reduce(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 5, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_ksin(arm_s, 12, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_kcos(arm_s, 13, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/*
+	 * In odd quadrants tan(x) = -cos(r) / sin(r).  r cannot be 0 in
+	 * an odd quadrant so there's no danger of dividing by 0.
+	 */
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_TST,
+				 SUBTILIS_ARM_CCODE_AL, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FDIVD, SUBTILIS_ARM_CCODE_EQ, 0,
+		     12, 13, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FDIVD, SUBTILIS_ARM_CCODE_NE, 0,
+		     13, 12, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_NE,
+			      SUBTILIS_VFP_INSTR_FNEGD, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+/*
+ * Computes atan(n / d), where n is in D0 and d is in D1, and n and d are
+ * both >= 0 and not both 0, leaving the result in D0.  The quotient is
+ * inverted if it's greater than 1, and quotients greater than
+ * tan(pi / 12) are further reduced using
+ * atan(t) = pi / 6 + atan((t * sqrt(3) - 1) / (t + sqrt(3))), leaving an
+ * argument in the range [-tan(pi / 12), tan(pi / 12)].  Uses R1 and
+ * D2-D11.
+ */
+
+static void prv_atan2p(subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	subtilis_arm_reg_t p;
+
+	prv_add_cmp(arm_s, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FDIVD, SUBTILIS_ARM_CCODE_GT, 2,
+		     1, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FDIVD, SUBTILIS_ARM_CCODE_LE, 2,
+		     0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_GT, false, 1, 1,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_LE, false, 1, 0,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 3, prv_tan_pio12, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 2, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 4, prv_sqrt3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 5, 1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FMULD, SUBTILIS_ARM_CCODE_GT, 6,
+		     2, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FSUBD, SUBTILIS_ARM_CCODE_GT, 6,
+		     6, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FADDD, SUBTILIS_ARM_CCODE_GT, 7,
+		     2, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FDIVD, SUBTILIS_ARM_CCODE_GT, 2,
+		     6, 7, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* atan(t) = t - t * z * p(z), where z = t * t. */
+
+	prv_add_fmuld(arm_s, 8, 2, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (prv_fast(arm_s))
+		p = prv_add_poly(arm_s, 8,
+				 SUBTILIS_VFP_MATH_COEFFS(prv_atan_fast), 9,
+				 10, err);
+	else
+		p = prv_add_poly(arm_s, 8,
+				 SUBTILIS_VFP_MATH_COEFFS(prv_atan_acc), 9, 10,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 11, 2, 8, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fnmacd(arm_s, 2, 11, p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* The flags still hold the result of the comparison with tan(pi/12) */
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 3, prv_pio6, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FADDD, SUBTILIS_ARM_CCODE_GT, 2,
+		     2, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* If we inverted the quotient the result is pi / 2 - atan(d / n) */
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 1, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 3, prv_pio2_lo, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FSUBD, SUBTILIS_ARM_CCODE_NE, 2,
+		     2, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 3, prv_pio2_hi, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FSUBD, SUBTILIS_ARM_CCODE_NE, 2,
+		     3, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FCPYD, 0, 2, err);
+}
+
+/*
+ * Stores the sign of D0 in bit 31 of R3 and replaces D0 with its
+ * absolute value.
+ */
+
+static void prv_save_sign(subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	subtilis_vfp_add_tran_dbl(arm_s, SUBTILIS_VFP_INSTR_FMRRD,
+				  SUBTILIS_ARM_CCODE_AL, 2, 3, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FABSD, 0, 0, err);
+}
+
+static void prv_test_sign(subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_TST,
+				 SUBTILIS_ARM_CCODE_AL, 3, (int32_t)0x80000000,
+				 err);
+}
+
+/*
+ * Computes sqrt((1 - a) * (1 + a)), i.e., sqrt(1 - a * a), where a is
+ * in src, leaving the result in dest.  Uses D2-D4.
+ */
+
+static void prv_add_cos_asin(subtilis_arm_section_t *arm_s,
+			     subtilis_arm_reg_t dest, subtilis_arm_reg_t src,
+			     subtilis_error_t *err)
+{
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 2, 1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 3, 2, src, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 4, 2, src, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 3, 3, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_sqrt(arm_s, SUBTILIS_VFP_INSTR_FSQRTD,
+			      SUBTILIS_ARM_CCODE_AL, dest, 3, err);
+}
+
+void subtilis_vfp_math_atn(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_save_sign(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, 1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_atan2p(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_test_sign(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_NE,
+			      SUBTILIS_VFP_INSTR_FNEGD, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+/* asin(x) = atan(x / sqrt(1 - x * x)) */
+
+void subtilis_vfp_math_asn(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_save_sign(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cos_asin(arm_s, 1, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_atan2p(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_test_sign(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_NE,
+			      SUBTILIS_VFP_INSTR_FNEGD, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+/* acos(x) = atan(sqrt(1 - x * x) / x), reflected about pi / 2 if x < 0 */
+
+void subtilis_vfp_math_acs(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_save_sign(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FCPYD, 1, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cos_asin(arm_s, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_atan2p(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_test_sign(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 3, prv_pi_lo, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FSUBD, SUBTILIS_ARM_CCODE_NE, 0,
+		     0, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 3, prv_pi_hi, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FSUBD, SUBTILIS_ARM_CCODE_NE, 0,
+		     3, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+/*
+ * Clamps D0 to [-prv_exp_limit, prv_exp_limit].  If lo is not 0, lo is
+ * set to 0 when D0 is clamped.  Uses D1.
+ */
+
+static void prv_exp_clamp(subtilis_arm_section_t *arm_s,
+			  subtilis_arm_reg_t lo, subtilis_error_t *err)
+{
+	size_t i;
+	const double limits[] = {prv_exp_limit, -prv_exp_limit};
+	const subtilis_arm_ccode_type_t ccodes[] = {SUBTILIS_ARM_CCODE_GT,
+						    SUBTILIS_ARM_CCODE_LT};
+
+	for (i = 0; i < 2; i++) {
+		prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, limits[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_cmp(arm_s, 0, 1, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		subtilis_vfp_add_copy(arm_s, ccodes[i],
+				      SUBTILIS_VFP_INSTR_FCPYD, 0, 1, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		if (lo == 0)
+			continue;
+
+		prv_add_ldc(arm_s, ccodes[i], lo, 0.0, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+}
+
+/*
+ * Reduces the argument to exp, in D0, to k * ln(2) + hi - lo, where
+ * |hi - lo| <= ln(2) / 2, leaving hi in D0, lo in D4 and k in R0.  If
+ * tail is not 0 it holds a small correction to D0 that's subtracted from
+ * lo.  Uses D1-D3.
+ */
+
+static void prv_exp_reduce(subtilis_arm_section_t *arm_s,
+			   subtilis_arm_reg_t tail, subtilis_error_t *err)
+{
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, prv_invln2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 2, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_round(arm_s, 0, 2, 2, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, prv_ln2_hi, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fnmacd(arm_s, 0, 2, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, prv_ln2_lo, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 4, 2, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (tail != 0)
+		prv_add_fsubd(arm_s, 4, 4, tail, err);
+}
+
+/*
+ * Computes 2^k * exp(hi - lo), where hi, lo and k are the outputs of
+ * prv_exp_reduce, leaving the result in D0.  exp(r) is computed as
+ * 1 + r + r * c / (2 - c), where c = r - r^2 * p(r^2).  The scaling by
+ * 2^k is split into two multiplications so that results that are
+ * subnormal or that overflow are handled correctly.  Uses R1-R4 and
+ * D1-D9.
+ */
+
+static void prv_exp_kernel(subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_reg_t p;
+	size_t i;
+
+	prv_add_fsubd(arm_s, 5, 0, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 6, 5, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (prv_fast(arm_s))
+		p = prv_add_poly(arm_s, 6,
+				 SUBTILIS_VFP_MATH_COEFFS(prv_exp_fast), 8, 9,
+				 err);
+	else
+		p = prv_add_poly(arm_s, 6,
+				 SUBTILIS_VFP_MATH_COEFFS(prv_exp_acc), 8, 9,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FCPYD, 7, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fnmacd(arm_s, 7, 6, p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* y = 1 - ((lo - (r * c) / (2 - c)) - hi) */
+
+	prv_add_fmuld(arm_s, 8, 5, 7, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 9, 2.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 9, 9, 7, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FDIVD, SUBTILIS_ARM_CCODE_AL, 8,
+		     8, 9, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 8, 4, 8, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 8, 8, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 9, 1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 0, 9, 8, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/*
+	 * R1 = k / 2, R2 = k - R1.  Both are in the range [-1010, 1010] so
+	 * 2^R1 and 2^R2 are normal doubles that we can construct directly.
+	 */
+
+	prv_add_mov_shift(arm_s, 1, 0, SUBTILIS_ARM_SHIFT_ASR, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_SUB, 2, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 3, 0,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 4,
+				 0x3ff00000, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	for (i = 1; i <= 2; i++) {
+		prv_add_mov_shift(arm_s, i, i, SUBTILIS_ARM_SHIFT_LSL, 20,
+				  err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, i, i, 4, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		subtilis_vfp_add_tran_dbl(arm_s, SUBTILIS_VFP_INSTR_FMDRR,
+					  SUBTILIS_ARM_CCODE_AL, i, 0, 3, i,
+					  err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fmuld(arm_s, 0, 0, i, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+}
+
+void subtilis_vfp_math_exp(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_exp_clamp(arm_s, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_exp_reduce(arm_s, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_exp_kernel(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+/*
+ * Splits the positive double in D0 into its exponent and mantissa.  On
+ * exit the unbiased exponent is in R2, the low word of the mantissa is in
+ * R0 and the high 20 bits of the mantissa are in R1.  Subnormal numbers
+ * are normalised.  If D0 is infinite or a NaN we branch to inf_label.
+ * Uses R3, R4 and D1.
+ */
+
+static void prv_log_decompose(subtilis_arm_section_t *arm_s,
+			      size_t inf_label, subtilis_error_t *err)
+{
+	subtilis_vfp_add_tran_dbl(arm_s, SUBTILIS_VFP_INSTR_FMRRD,
+				  SUBTILIS_ARM_CCODE_AL, 0, 1, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 4, 0,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 1, 0x100000, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_LT, 1, 0x1p54, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FMULD, SUBTILIS_ARM_CCODE_LT, 0,
+		     0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_tran_dbl(arm_s, SUBTILIS_VFP_INSTR_FMRRD,
+				  SUBTILIS_ARM_CCODE_LT, 0, 1, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mvn_imm(arm_s, SUBTILIS_ARM_CCODE_LT, false, 4, 53,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_mov_shift(arm_s, 2, 1, SUBTILIS_ARM_SHIFT_LSR, 20, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 3, 2, 1,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 3, 0x800, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, inf_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 3, 1023,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_SUB, 2, 2, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, 2, 2, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_mov_shift(arm_s, 1, 1, SUBTILIS_ARM_SHIFT_LSL, 12, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_mov_shift(arm_s, 1, 1, SUBTILIS_ARM_SHIFT_LSR, 12, err);
+}
+
+/*
+ * Takes the mantissa produced by prv_log_decompose and builds a double
+ * m in D0 such that sqrt(2) / 2 <= m < sqrt(2).  R5 is set to 1 if the
+ * mantissa needed to be halved to bring it into this range and 0
+ * otherwise.  Uses R6.
+ */
+
+static void prv_log_normalise(subtilis_arm_section_t *arm_s,
+			      subtilis_error_t *err)
+{
+	/*
+	 * 0x95f64 + 0x6a09e, the high bits of the mantissa of sqrt(2),
+	 * overflows into bit 20.
+	 */
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 5,
+				 0x95f64, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, 5, 1, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_AND,
+				  SUBTILIS_ARM_CCODE_AL, false, 5, 5, 0x100000,
+				  err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 6,
+				 0x3ff00000, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_EOR, 6, 6, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ORR, 1, 1, 6, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_tran_dbl(arm_s, SUBTILIS_VFP_INSTR_FMDRR,
+				  SUBTILIS_ARM_CCODE_AL, 0, 0, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_mov_shift(arm_s, 5, 5, SUBTILIS_ARM_SHIFT_LSR, 20, err);
+}
+
+/*
+ * Computes the parts of ln(m), where m is in D0, that are needed by LN,
+ * LOG and POW.  On exit f = m - 1 is in D2, s = f / (2 + f) is in D4,
+ * hfsq = f * f / 2 is in D9 and s * (hfsq + R) is in D10, where
+ * R = s^2 * p(s^2).  ln(m) = f - (hfsq - D10).  Uses D1-D10.
+ */
+
+static void prv_log_kernel(subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err)
+{
+	subtilis_arm_reg_t p;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 1, 1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 2, 0, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 4, 2.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 4, 4, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data(arm_s, SUBTILIS_VFP_INSTR_FDIVD, SUBTILIS_ARM_CCODE_AL, 4,
+		     2, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 5, 4, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	p = prv_add_poly(arm_s, 5, SUBTILIS_VFP_MATH_COEFFS(prv_log_acc), 6, 7,
+			 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 8, 5, p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 9, 0.5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 9, 9, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 9, 9, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 10, 9, 8, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 10, 4, 10, err);
+}
+
+/* Computes ln(m) from the outputs of prv_log_kernel, leaving it in D10. */
+
+static void prv_log_lnm(subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	prv_add_fsubd(arm_s, 10, 9, 10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 10, 2, 10, err);
+}
+
+/*
+ * Generates the code common to LN and LOG.  Arguments <= 0 generate
+ * an error.  Infinities and NaNs are returned unmodified.
+ */
+
+static void prv_log_start(subtilis_ir_section_t *s,
+			  subtilis_arm_section_t *arm_s, size_t ret_label,
+			  subtilis_error_t *err)
+{
+	size_t error_label = arm_s->label_counter++;
+	size_t ok_label = arm_s->label_counter++;
+
+	prv_add_cmp(arm_s, 0, -1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GT, ok_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, error_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_gen_sete(arm_s, s, SUBTILIS_ARM_CCODE_AL, 0,
+			      SUBTILIS_ERROR_CODE_LOG_RANGE, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, ret_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, ok_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_log_decompose(arm_s, ret_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_log_normalise(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_log_kernel(arm_s, err);
+}
+
+/*
+ * ln(x) = k * ln2_hi - ((hfsq - (s * (hfsq + R) + k * ln2_lo)) - f),
+ * where x = 2^k * m.
+ */
+
+void subtilis_vfp_math_ln(subtilis_ir_section_t *s,
+			  subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	size_t ret_label = arm_s->label_counter++;
+
+	prv_log_start(s, arm_s, ret_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, 2, 2, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_to_double(arm_s, 3, 2, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ln2_lo, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 10, 3, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 10, 9, 10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 10, 10, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ln2_hi, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 11, 3, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 0, 11, 10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+/*
+ * log10(x) = k * log10(2) + ln(m) / ln(10), where x = 2^k * m and
+ * 1 <= m < 2 if k >= 0 and 0.5 <= m < 1 otherwise.  ln(m) itself needs
+ * to be computed with m normalised to [sqrt(2) / 2, sqrt(2)), but k is
+ * taken before this normalisation so that log10(10^n) is exactly n.
+ * Taking m from [0.5, 1) when k is negative, as fdlibm does, stops the
+ * two terms cancelling for x just below 1.
+ */
+
+void subtilis_vfp_math_log(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	size_t ret_label = arm_s->label_counter++;
+
+	prv_log_start(s, arm_s, ret_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_log_lnm(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* if (k < 0) { k = k + 1; j = j - 1; } */
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 2, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_add_imm(arm_s, SUBTILIS_ARM_CCODE_LT, false, 2, 2, 1,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_sub_imm(arm_s, SUBTILIS_ARM_CCODE_LT, false, 5, 5, 1,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* ln(m) = j * ln2_hi + (j * ln2_lo + lnm), where j is in R5 */
+
+	prv_add_to_double(arm_s, 3, 5, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ln2_lo, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 10, 3, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ln2_hi, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 11, 3, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 10, 11, 10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* k * log10_2hi + (k * log10_2lo + ivln10 * ln(m)) */
+
+	prv_add_to_double(arm_s, 3, 2, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ivln10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 10, 10, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_log10_2lo, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 10, 3, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_log10_2hi, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 11, 3, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 0, 11, 10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+}
+
+/*
+ * Computes the exact product of D12 and D13 as the unevaluated sum of
+ * D0 and D5 using Dekker's algorithm.  Uses D1-D4 and D15.
+ */
+
+static void prv_two_prod(subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	size_t i;
+	const subtilis_arm_reg_t src[] = {12, 13};
+	const subtilis_arm_reg_t hi[] = {1, 3};
+	const subtilis_arm_reg_t lo[] = {2, 4};
+
+	prv_add_fmuld(arm_s, 0, 12, 13, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 15, prv_split, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	for (i = 0; i < 2; i++) {
+		prv_add_fmuld(arm_s, hi[i], 15, src[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fsubd(arm_s, lo[i], hi[i], src[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fsubd(arm_s, hi[i], hi[i], lo[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fsubd(arm_s, lo[i], src[i], hi[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	prv_add_fmuld(arm_s, 5, 1, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 5, 5, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 5, 1, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 5, 2, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 5, 2, 4, err);
+}
+
+/*
+ * Computes y * ln(x), where y is in D12 and ln(x) is given by the
+ * outputs of prv_log_kernel and k in D3, as the sum of D0 and D5.  The
+ * accurate version computes ln(x) as a double-double, lh + ll, and
+ * multiplies it by y exactly, so that exp(y * ln(x)) does not lose
+ * precision when y * ln(x) is large.
+ */
+
+static void prv_pow_mul_log(subtilis_arm_section_t *arm_s,
+			    subtilis_error_t *err)
+{
+	prv_log_lnm(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (prv_fast(arm_s)) {
+		prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ln2_lo, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fmacd(arm_s, 10, 3, 11, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ln2_hi, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fmuld(arm_s, 11, 3, 11, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_faddd(arm_s, 10, 11, 10, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_fmuld(arm_s, 0, 12, 10, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+
+		prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 5, 0.0, err);
+		return;
+	}
+
+	/*
+	 * lh = k * ln2_hi + lnm
+	 * ll = ((k * ln2_hi - lh) + lnm) + k * ln2_lo
+	 */
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 11, prv_ln2_hi, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 11, 3, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 13, 11, 10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 14, 11, 13, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 14, 14, 10, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 15, prv_ln2_lo, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 14, 3, 15, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* w + wl = y * lh + y * ll, renormalised. */
+
+	prv_two_prod(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmacd(arm_s, 5, 12, 14, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 6, 0, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 7, 6, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 5, 5, 7, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FCPYD, 0, 6, err);
+}
+
+/*
+ * Checks whether y, in D12, is an integer and if so whether it's odd,
+ * when x is negative.  If y is not an integer the result is a NaN.  If
+ * it's odd, R8 is set to 1 so that the result is negated.  Every double
+ * >= 2^52 is an integer and every double >= 2^53 is even.
+ */
+
+static void prv_pow_neg(subtilis_arm_section_t *arm_s, size_t main_label,
+			subtilis_error_t *err)
+{
+	size_t int_label = arm_s->label_counter++;
+	size_t done_label = arm_s->label_counter++;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 2, 0x1p52, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FABSD, 3, 12, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 3, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GE, int_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 4, 3, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 4, 4, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 4, 3, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_NE, 0, -1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_sqrt(arm_s, SUBTILIS_VFP_INSTR_FSQRTD,
+			      SUBTILIS_ARM_CCODE_NE, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_NE, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, int_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 5, 0x1p53, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 3, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_GE, done_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_AL, 4, 0.5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fmuld(arm_s, 4, 3, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_faddd(arm_s, 6, 4, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_fsubd(arm_s, 6, 6, 2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 6, 4, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_NE, false, 8, 1,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, done_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FNEGD, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, main_label, err);
+}
+
+/*
+ * x^y = exp(y * ln(x)).  x is in D0 and y in D1.  y is moved to D12
+ * where it's out of the way of the log and exp code.
+ */
+
+void subtilis_vfp_math_pow(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s, subtilis_error_t *err)
+{
+	size_t main_label = arm_s->label_counter++;
+	size_t neg_label = arm_s->label_counter++;
+	size_t zero_label = arm_s->label_counter++;
+	size_t inf_label = arm_s->label_counter++;
+	size_t ret_label = arm_s->label_counter++;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_AL,
+			      SUBTILIS_VFP_INSTR_FCPYD, 12, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 12, -1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_EQ, 0, 1.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_EQ, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_mov_imm(arm_s, SUBTILIS_ARM_CCODE_AL, false, 8, 0,
+				 err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 0, -1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_LT, neg_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_EQ, zero_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, main_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_log_decompose(arm_s, inf_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_log_normalise(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_data_reg(arm_s, SUBTILIS_ARM_INSTR_ADD, 2, 2, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_log_kernel(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_to_double(arm_s, 3, 2, 11, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_pow_mul_log(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_exp_clamp(arm_s, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_exp_reduce(arm_s, 5, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_exp_kernel(arm_s, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, ret_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_add_cmp_imm(arm_s, SUBTILIS_ARM_INSTR_CMP,
+				 SUBTILIS_ARM_CCODE_AL, 8, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_vfp_add_copy(arm_s, SUBTILIS_ARM_CCODE_NE,
+			      SUBTILIS_VFP_INSTR_FNEGD, 0, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_arm_section_add_label(arm_s, neg_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_pow_neg(arm_s, main_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/* 0^y is 0 if y > 0 and infinity if y < 0. */
+
+	subtilis_arm_section_add_label(arm_s, zero_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 12, -1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_LT, 0, INFINITY, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ret(arm_s, SUBTILIS_ARM_CCODE_AL, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	/*
+	 * inf^y is inf if y > 0 and 0 if y < 0.  NaN^y is NaN.  The sign
+	 * still needs to be applied if x was negative.
+	 */
+
+	subtilis_arm_section_add_label(arm_s, inf_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_cmp(arm_s, 12, -1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_ldc(arm_s, SUBTILIS_ARM_CCODE_LT, 0, 0.0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_add_branch(arm_s, SUBTILIS_ARM_CCODE_AL, ret_label, err);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBTILIS_VFP_MATH_H
+#define __SUBTILIS_VFP_MATH_H
+
+#include "../../common/ir.h"
+#include "arm_core.h"
+
+/*
+ * Generate the builtins that implement the transcendental functions for
+ * VFP backends, which have no hardware support for them.  The arguments
+ * are passed in D0 and D1 and the result is returned in D0.  The
+ * accuracy of all the routines other than LOG and LN is selected by the
+ * trans_tier setting.
+ */
+
+void subtilis_vfp_math_sin(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_cos(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_tan(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_asn(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_acs(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_atn(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_log(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_ln(subtilis_ir_section_t *s,
+			  subtilis_arm_section_t *arm_s,
+			  subtilis_error_t *err);
+void subtilis_vfp_math_exp(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+void subtilis_vfp_math_pow(subtilis_ir_section_t *s,
+			   subtilis_arm_section_t *arm_s,
+			   subtilis_error_t *err);
+
+#endif
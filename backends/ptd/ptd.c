@@ -178,6 +178,7 @@ const subtilis_ir_rule_raw_t ptd_rules[] = {
 	 {"addii32 *, *, *", subtilis_arm_gen_addii32},
 	 {"mulii32 *, *, *", subtilis_arm_gen_mulii32},
 	 {"muli32 *, *, *", subtilis_arm_gen_muli32},
+	 {"mulhi32 *, *, *", subtilis_arm_gen_mulhi32},
 	 {"subii32 *, *, *", subtilis_arm_gen_subii32},
 	 {"rsubii32 *, *, *", subtilis_arm_gen_rsubii32},
 	 {"addi32 *, *, *", subtilis_arm_gen_addi32},
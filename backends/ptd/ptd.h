@@ -36,6 +36,10 @@ void *subtilis_ptd_asm_parse(subtilis_lexer_t *l, subtilis_token_t *t,
 
 #define SUBTILIS_PTD_PROGRAM_START 0xF000
 
+/* Size classes from 32 bytes to 64KB. */
+
+#define SUBTILIS_PTD_HEAP_SLOTS 13
+
 #define SUBTILIS_PTD_CAPS 0
 
 void subtilis_ptd_arm_on(subtilis_ir_section_t *s, size_t start,
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -22,6 +24,8 @@
 #include "../../arch/arm32/arm_keywords.h"
 #include "../../arch/arm32/arm_vm.h"
 #include "../../arch/arm32/vfp_gen.h"
+#include "../../common/buffer.h"
+#include "../../common/ir_opt.h"
 #include "../../frontend/parser_test.h"
 #include "../../test_cases/bad_test_cases.h"
 #include "../../test_cases/test_cases.h"
@@ -29,10 +33,54 @@
 #include "../riscos_common/riscos_arm.h"
 #include "ptd_test.h"
 
+/*
+ * Options for, and statistics about, a single program compiled and run
+ * by prv_test_example.  A NULL run compiles the program with the
+ * default options and discards the statistics.
+ *
+ * spills is the number of spill loads and stores generated by the
+ * register allocator and ir_ops is the number of IR ops handed to the
+ * backend.
+ */
+
+typedef struct subtilis_ptd_test_run_t_ subtilis_ptd_test_run_t;
+
+struct subtilis_ptd_test_run_t_ {
+	bool global_reg_alloc;
+	uint32_t opt_level;
+	subtilis_trans_tier_t trans_tier;
+	size_t spills;
+	size_t ir_ops;
+};
+
+static size_t prv_count_spills(subtilis_arm_prog_t *arm_p)
+{
+	size_t i;
+	size_t spills = 0;
+
+	for (i = 0; i < arm_p->num_sections; i++)
+		spills += arm_p->sections[i]->spill_count;
+
+	return spills;
+}
+
+static size_t prv_count_ir_ops(subtilis_ir_prog_t *p)
+{
+	size_t i;
+	size_t ops = 0;
+
+	for (i = 0; i < p->num_sections; i++)
+		ops += p->sections[i]->len;
+
+	return ops;
+}
+
 static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 			    subtilis_error_type_t expected_err,
-			    const char *expected, bool mem_leaks_ok)
+			    const char *expected, bool mem_leaks_ok,
+			    void *data)
 {
+	subtilis_ptd_test_run_t *run = data;
 	subtilis_error_t err;
 	subtilis_buffer_t b;
 	size_t code_size;
@@ -52,6 +100,13 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 		goto cleanup;
 
 	p->backend.backend_data = pool;
+	p->settings.heap_slots = SUBTILIS_PTD_HEAP_SLOTS;
+	p->settings.check_next_use = true;
+	if (run) {
+		p->settings.global_reg_alloc = run->global_reg_alloc;
+		p->settings.opt_level = run->opt_level;
+		p->settings.trans_tier = run->trans_tier;
+	}
 
 	subtilis_parse(p, &err);
 	if (err.type != SUBTILIS_ERROR_OK) {
@@ -60,6 +115,13 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 		goto cleanup;
 	}
 
+	subtilis_ir_opt_prog(p->prog, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	if (run)
+		run->ir_ops = prv_count_ir_ops(p->prog);
+
 	//	subtilis_ir_prog_dump(p->prog);
 	subtilis_arm_vfp_if_init(&fp_if);
 
@@ -69,6 +131,9 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	if (run)
+		run->spills = prv_count_spills(arm_p);
+
 	//	subtilis_arm_prog_dump(arm_p);
 
 	code = subtilis_arm_encode_buf(arm_p, &code_size, &err);
@@ -138,6 +203,13 @@ static int prv_test_ptd_examples(void)
 	int pass;
 	const subtilis_test_case_t *test;
 	subtilis_backend_t backend;
+	subtilis_ptd_test_run_t run;
+	subtilis_ptd_test_run_t global_run;
+	subtilis_ptd_test_run_t opt_run;
+	size_t local_spills = 0;
+	size_t global_spills = 0;
+	size_t ir_ops = 0;
+	size_t opt_ir_ops = 0;
 	int ret = 0;
 
 	backend.caps = SUBTILIS_PTD_CAPS;
@@ -151,26 +223,53 @@ static int prv_test_ptd_examples(void)
 		test = &test_cases[i];
 
 		switch (i) {
-		case SUBTILIS_TEST_CASE_ID_SIN_COS:
 		case SUBTILIS_TEST_CASE_ID_POINT_TINT:
-		case SUBTILIS_TEST_CASE_ID_TRIG:
-		case SUBTILIS_TEST_CASE_ID_LOG:
-		case SUBTILIS_TEST_CASE_ID_ERROR_LOGRANGE:
-		case SUBTILIS_TEST_CASE_ID_POW:
-		case SUBTILIS_TEST_CASE_ID_STR_EXP:
 			continue;
 		default:
 			break;
 		}
 
 		printf("ptd_%s", test->name);
-		pass = parser_test_wrapper(
-		    test->source, &backend, prv_test_example,
+		memset(&run, 0, sizeof(run));
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, &run,
 		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
 		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
 		ret |= pass;
+		local_spills += run.spills;
+		ir_ops += run.ir_ops;
+
+		printf("ptd_global_%s", test->name);
+		memset(&global_run, 0, sizeof(global_run));
+		global_run.global_reg_alloc = true;
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, &global_run,
+		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
+		ret |= pass;
+		global_spills += global_run.spills;
+
+		printf("ptd_opt_%s", test->name);
+		memset(&opt_run, 0, sizeof(opt_run));
+		opt_run.opt_level = 2;
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, &opt_run,
+		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
+		ret |= pass;
+		opt_ir_ops += opt_run.ir_ops;
 	}
 
+	pass = global_spills > local_spills;
+	printf("ptd_static_spills (local %zu global %zu): [%s]\n",
+	       local_spills, global_spills, pass ? "FAIL" : "OK");
+	ret |= pass;
+
+	pass = opt_ir_ops >= ir_ops;
+	printf("ptd_ir_opt (ops %zu optimised %zu): [%s]\n", ir_ops,
+	       opt_ir_ops, pass ? "FAIL" : "OK");
+	ret |= pass;
+
 	return ret;
 }
 
@@ -297,15 +396,15 @@ static const subtilis_test_case_t riscos_vfp_test_cases[] = {
 	"[\n"
 	"	LDR R1, [R0, 4]\n"
 	"	FMRRD R2, R3, D0\n"
-	"	STR R2, [R0]!\n"
-	"	STR R3, [R0]\n"
+	"	STR R2, [R1]\n"
+	"	STR R3, [R1, 4]\n"
 	"	MOV PC, R14\n"
 	"]\n"
 	"def FNIntsToDnl(a%(1))\n"
 	"[\n"
 	"  LDR R1, [R0, 4]\n"
-	"  LDR R2, [R0]!\n"
-	"  LDR R3, [R0]\n"
+	"  LDR R2, [R1]\n"
+	"  LDR R3, [R1, 4]\n"
 	"  FMDRR D0, R2, R3\n"
 	"  MOV PC, R14\n"
 	"]\n",
@@ -886,6 +985,68 @@ static const subtilis_test_case_t riscos_vfp_test_cases[] = {
 	"]\n",
 	"-1\n1FFFF\nFFFF0001\n-32768\n-128\n-1\n1FFFF\n",
 	},
+	{"armv6",
+	"print FNUxtB%(&1234ff)\n"
+	"print FNUxtH%(&1238001)\n"
+	"print ~FNUxtB16%(&12345678)\n"
+	"print ~FNRev%(&11223344)\n"
+	"print FNSMulHi%(-2, 3)\n"
+	"print FNUMulHi%(-2, 3)\n"
+	"print FNSMulHi%(&10000, &30000)\n"
+	"print FNSMulLo%(-2, 3)\n"
+	"print FNPld%(42)\n"
+	"\n"
+	"def FNUxtB%(a%)\n"
+	"[\n"
+	"	UXTB R0, R0\n"
+	"	MOV PC, R14\n"
+	"]\n"
+	"\n"
+	"def FNUxtH%(a%)\n"
+	"[\n"
+	"	UXTH R0, R0\n"
+	"	MOV PC, R14\n"
+	"]\n"
+	"\n"
+	"def FNUxtB16%(a%)\n"
+	"[\n"
+	"	UXTB16 R0, R0\n"
+	"	MOV PC, R14\n"
+	"]\n"
+	"\n"
+	"def FNRev%(a%)\n"
+	"[\n"
+	"	REV R0, R0\n"
+	"	MOV PC, R14\n"
+	"]\n"
+	"\n"
+	"def FNSMulHi%(a%, b%)\n"
+	"[\n"
+	"	SMULL R2, R0, R0, R1\n"
+	"	MOV PC, R14\n"
+	"]\n"
+	"\n"
+	"def FNUMulHi%(a%, b%)\n"
+	"[\n"
+	"	UMULL R2, R0, R0, R1\n"
+	"	MOV PC, R14\n"
+	"]\n"
+	"\n"
+	"def FNSMulLo%(a%, b%)\n"
+	"[\n"
+	"	SMULL R0, R2, R0, R1\n"
+	"	MOV PC, R14\n"
+	"]\n"
+	"\n"
+	"def FNPld%(a%)\n"
+	"[\n"
+	"	PLD [R0]\n"
+	"	PLD [R0, 32]\n"
+	"	PLD [R0, -4]\n"
+	"	MOV PC, R14\n"
+	"]\n",
+	"255\n32769\n340078\n44332211\n-1\n2\n3\n-6\n42\n",
+	},
 };
 
 /* clang-format on */
@@ -910,8 +1071,8 @@ static int prv_test_riscos_vfp_examples(void)
 	     i++) {
 		test = &riscos_vfp_test_cases[i];
 		printf("ptd_%s", test->name);
-		pass = parser_test_wrapper(
-		    test->source, &backend, prv_test_example,
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, NULL,
 		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
 		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
 		ret |= pass;
@@ -920,12 +1081,311 @@ static int prv_test_riscos_vfp_examples(void)
 	return ret;
 }
 
+/*
+ * BASIC has no exponent notation so reals are written out in full, with
+ * enough digits for atof to recover the exact double.
+ */
+
+static void prv_append_real(subtilis_buffer_t *b, double v,
+			    subtilis_error_t *err)
+{
+	char num[256];
+	int prec = 17;
+
+	if (v != 0.0)
+		prec -= (int)floor(log10(fabs(v))) + 1;
+	if (prec < 1)
+		prec = 1;
+	snprintf(num, sizeof(num), "%.*f", prec, v);
+	subtilis_buffer_append_string(b, num, err);
+}
+
+static void prv_append_check(subtilis_buffer_t *b, const char *fn, double x,
+			     double y, double expected, subtilis_error_t *err)
+{
+	subtilis_buffer_append_string(b, "x = ", err);
+	prv_append_real(b, x, err);
+	subtilis_buffer_append_string(b, "\ny = ", err);
+	prv_append_real(b, y, err);
+	subtilis_buffer_append_string(b, "\nPROCC(", err);
+	subtilis_buffer_append_string(b, fn, err);
+	subtilis_buffer_append_string(b, ", ", err);
+	prv_append_real(b, expected, err);
+	subtilis_buffer_append_string(b, ")\n", err);
+}
+
+static void prv_append_array(subtilis_buffer_t *b, const char *name,
+			     const double *vals, size_t n,
+			     subtilis_error_t *err)
+{
+	size_t i;
+	char dim[192];
+
+	snprintf(dim, sizeof(dim), "DIM %s(%zu)\n%s() = ", name, n - 1, name);
+	subtilis_buffer_append_string(b, dim, err);
+	for (i = 0; i < n; i++) {
+		if (i > 0)
+			subtilis_buffer_append_string(b, ", ", err);
+		prv_append_real(b, vals[i], err);
+	}
+	subtilis_buffer_append_string(b, "\n", err);
+}
+
+/*
+ * Appends a loop to loops that checks fn for the n arguments in xs, and
+ * ys if fn is ^, against the results in es.  The arguments and results
+ * are stored in arrays, whose names start with id, that are declared in
+ * b.  BASIC doesn't allow globals to be declared after a procedure call
+ * so the loops need to be appended to the program after all the arrays.
+ */
+
+static void prv_append_sweep(subtilis_buffer_t *b, subtilis_buffer_t *loops,
+			     const char *id, const char *fn, const double *xs,
+			     const double *ys, const double *es, size_t n,
+			     subtilis_error_t *err)
+{
+	char name[64];
+	char loop[256];
+
+	snprintf(name, sizeof(name), "%sx", id);
+	prv_append_array(b, name, xs, n, err);
+	if (ys) {
+		snprintf(name, sizeof(name), "%sy", id);
+		prv_append_array(b, name, ys, n, err);
+	}
+	snprintf(name, sizeof(name), "%se", id);
+	prv_append_array(b, name, es, n, err);
+
+	snprintf(loop, sizeof(loop), "FOR i%% = 0 TO %zu\n  x = %sx(i%%)\n",
+		 n - 1, id);
+	subtilis_buffer_append_string(loops, loop, err);
+	if (ys) {
+		snprintf(loop, sizeof(loop), "  y = %sy(i%%)\n", id);
+		subtilis_buffer_append_string(loops, loop, err);
+	}
+	snprintf(loop, sizeof(loop), "  PROCC(%s, %se(i%%))\nNEXT\n", fn, id);
+	subtilis_buffer_append_string(loops, loop, err);
+}
+
+/*
+ * A sweep checks a transcendental function at PRV_TRANS_GRID points
+ * spread evenly over [lo, hi], or spread evenly over the exponents of
+ * [lo, hi] if geometric is set, and at the points in edges, which hold
+ * arguments that need large reductions or lie close to the edges of the
+ * function's domain or of the ranges used by its reduction.  The lexer
+ * limits numbers to 255 characters, and reals are written out in full,
+ * so the arguments and results are kept within [1e-200, 1e200].
+ */
+
+#define PRV_TRANS_GRID 240
+#define PRV_TRANS_EDGES 16
+
+typedef struct subtilis_ptd_trans_sweep_t_ subtilis_ptd_trans_sweep_t;
+
+struct subtilis_ptd_trans_sweep_t_ {
+	const char *id;
+	const char *fn;
+	double (*ref)(double);
+	double lo;
+	double hi;
+	bool geometric;
+	double edges[PRV_TRANS_EDGES];
+};
+
+static const subtilis_ptd_trans_sweep_t prv_trans_sweeps[] = {
+	{"ts", "SIN(x)", sin, -10.0, 10.0, false,
+	 {-1000000.5, -333333.3, -54321.25, -12345.678, -4096.3, -355.0,
+	  -100.1, -1e-10, 1e-10, 22.0, 100.1, 355.0, 1000.5, 12345.678,
+	  333333.3, 1000000.5}},
+	{"tc", "COS(x)", cos, -10.0, 10.0, false,
+	 {-1000000.5, -333333.3, -54321.25, -12345.678, -4096.3, -355.0,
+	  -100.1, -1e-10, 1e-10, 22.0, 100.1, 355.0, 1000.5, 12345.678,
+	  333333.3, 1000000.5}},
+	{"tt", "TAN(x)", tan, -10.0, 10.0, false,
+	 {-1000000.5, -333333.3, -54321.25, -12345.678, -4096.3, -355.0,
+	  -100.1, -1e-10, 1e-10, 22.0, 100.1, 355.0, 1000.5, 12345.678,
+	  333333.3, 1000000.5}},
+	{"ta", "ATN(x)", atan, -50.0, 50.0, false,
+	 {-1e200, -1e10, -1.7320508075688772, -1.0, -0.2679491924311227,
+	  -1e-10, 1e-200, 1e-10, 0.2679491924311227, 0.5, 1.0,
+	  1.7320508075688772, 2.0, 3.0, 1e10, 1e200}},
+	{"tas", "ASN(x)", asin, -1.0, 1.0, false,
+	 {-1.0, -0.9999999999999999, -0.9999999990686774, -0.9999,
+	  -0.5000000000000001, -0.5, -0.4999999999999999, -1e-10, 1e-10,
+	  0.4999999999999999, 0.5, 0.5000000000000001, 0.9999,
+	  0.9999999990686774, 0.9999999999999999, 1.0}},
+	{"tac", "ACS(x)", acos, -1.0, 1.0, false,
+	 {-1.0, -0.9999999999999999, -0.9999999990686774, -0.9999,
+	  -0.5000000000000001, -0.5, -0.4999999999999999, -1e-10, 1e-10,
+	  0.4999999999999999, 0.5, 0.5000000000000001, 0.9999,
+	  0.9999999990686774, 0.9999999999999999, 1.0}},
+	{"te", "EXP(x)", exp, -450.0, 450.0, false,
+	 {-450.0, -10.0, -1.0, -0.5, -0.34657359027997264, -1e-10, -5e-17,
+	  5e-17, 1e-10, 0.34657359027997264, 0.5, 0.6931471805599453, 1.0,
+	  2.0, 10.0, 450.0}},
+	{"tl", "LN(x)", log, 0x1p-600, 0x1p600, true,
+	 {1e-200, 2.5e-200, 1e-100, 0.1, 0.5, 0.9999,
+	  0.9999999990686774, 0.9999999999999998, 1.0000000000000002,
+	  1.0000000009313226, 1.0001, 2.0, 10.0, 1000.0, 1e100, 1e200}},
+	{"tg", "LOG(x)", log10, 0x1p-600, 0x1p600, true,
+	 {1e-200, 2.5e-200, 1e-100, 0.1, 0.5, 0.9999,
+	  0.9999999990686774, 0.9999999999999998, 1.0000000000000002,
+	  1.0000000009313226, 1.0001, 2.0, 10.0, 1000.0, 1e100, 1e200}},
+};
+
+static void prv_append_trans_sweep(subtilis_buffer_t *b,
+				   subtilis_buffer_t *loops,
+				   const subtilis_ptd_trans_sweep_t *sweep,
+				   subtilis_error_t *err)
+{
+	size_t i;
+	double t;
+	double xs[PRV_TRANS_GRID + PRV_TRANS_EDGES];
+	double es[PRV_TRANS_GRID + PRV_TRANS_EDGES];
+
+	for (i = 0; i < PRV_TRANS_GRID; i++) {
+		t = (i + 0.5) / PRV_TRANS_GRID;
+		if (sweep->geometric)
+			xs[i] = exp2(log2(sweep->lo) +
+				     t * (log2(sweep->hi) - log2(sweep->lo)));
+		else
+			xs[i] = sweep->lo + t * (sweep->hi - sweep->lo);
+	}
+
+	for (i = 0; i < PRV_TRANS_EDGES; i++)
+		xs[PRV_TRANS_GRID + i] = sweep->edges[i];
+
+	for (i = 0; i < PRV_TRANS_GRID + PRV_TRANS_EDGES; i++)
+		es[i] = sweep->ref(xs[i]);
+
+	prv_append_sweep(b, loops, sweep->id, sweep->fn, xs, NULL, es,
+			 PRV_TRANS_GRID + PRV_TRANS_EDGES, err);
+}
+
+/*
+ * Checks x ^ y over a grid of bases in [0.05, 20] and exponents in
+ * [-30, 30].  The exponents are visited in a different order to the
+ * bases so that each base is paired with an unrelated exponent.
+ */
+
+static void prv_append_pow_sweep(subtilis_buffer_t *b,
+				 subtilis_buffer_t *loops,
+				 subtilis_error_t *err)
+{
+	size_t i;
+	double xs[PRV_TRANS_GRID];
+	double ys[PRV_TRANS_GRID];
+	double es[PRV_TRANS_GRID];
+
+	for (i = 0; i < PRV_TRANS_GRID; i++) {
+		xs[i] = 0.05 + (i + 0.5) * (20.0 - 0.05) / PRV_TRANS_GRID;
+		ys[i] = (i * 97) % PRV_TRANS_GRID + 0.5;
+		ys[i] = -30.0 + ys[i] * 60.0 / PRV_TRANS_GRID;
+		es[i] = pow(xs[i], ys[i]);
+	}
+
+	prv_append_sweep(b, loops, "tp", "x ^ y", xs, ys, es, PRV_TRANS_GRID,
+			 err);
+}
+
+/*
+ * Compares the results of the transcendental builtins, which the PTD
+ * backend generates itself, against the C library over a dense sweep of
+ * arguments for each function.  The program prints the expected value of
+ * each result whose relative error exceeds tol and then the number of
+ * failures.
+ */
+
+static int prv_test_trans(const char *name, double tol,
+			  subtilis_trans_tier_t trans_tier)
+{
+	subtilis_ptd_test_run_t run;
+	subtilis_error_t err;
+	subtilis_buffer_t b;
+	subtilis_buffer_t loops;
+	subtilis_backend_t backend;
+	char tol_str[64];
+	size_t i;
+	int pass = 1;
+	const double pow_args[][2] = {
+	    {2.5, 3.7},	     {10.0, -2.5},   {0.3, 17.2},   {7.0, 0.5},
+	    {-2.0, 3.0},     {-1.5, -4.0},   {123.4, 0.33}, {1.0001, 10000.0},
+	    {0.5, -100.0},   {3.0, 250.0},   {0.9, -800.0}, {1e-5, 12.5},
+	};
+
+	subtilis_error_init(&err);
+	subtilis_buffer_init(&b, 4096);
+	subtilis_buffer_init(&loops, 4096);
+
+	snprintf(tol_str, sizeof(tol_str),
+		 "t = %.20f\nf%% = 0\nx = 0.0\ny = 0.0\n", tol);
+	subtilis_buffer_append_string(&b, tol_str, &err);
+
+	for (i = 0; i < sizeof(prv_trans_sweeps) / sizeof(prv_trans_sweeps[0]);
+	     i++)
+		prv_append_trans_sweep(&b, &loops, &prv_trans_sweeps[i],
+				       &err);
+
+	prv_append_pow_sweep(&b, &loops, &err);
+
+	for (i = 0; i < sizeof(pow_args) / sizeof(pow_args[0]); i++)
+		prv_append_check(&loops, "x ^ y", pow_args[i][0],
+				 pow_args[i][1],
+				 pow(pow_args[i][0], pow_args[i][1]), &err);
+
+	subtilis_buffer_append_buffer(&b, &loops, &err);
+
+	subtilis_buffer_append_string(&b,
+				      "PRINT f%\n"
+				      "DEF PROCC(r, e)\n"
+				      "d := r - e\n"
+				      "IF d < 0.0 THEN LET d = -d ENDIF\n"
+				      "m := e\n"
+				      "IF m < 0.0 THEN LET m = -m ENDIF\n"
+				      "IF d > t * m THEN\n"
+				      "  PRINT e\n"
+				      "  f% += 1\n"
+				      "ENDIF\n"
+				      "ENDPROC\n",
+				      &err);
+	subtilis_buffer_zero_terminate(&b, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stdout, &err, true);
+		goto cleanup;
+	}
+
+	backend.caps = SUBTILIS_PTD_CAPS;
+	backend.sys_trans = subtilis_ptd_sys_trans;
+	backend.sys_check = subtilis_ptd_sys_check;
+	backend.backend_data = NULL;
+	backend.asm_parse = subtilis_ptd_asm_parse;
+	backend.asm_free = subtilis_riscos_asm_free;
+
+	printf("ptd_%s", name);
+	memset(&run, 0, sizeof(run));
+	run.trans_tier = trans_tier;
+	pass = parser_test_wrapper_data(
+	    subtilis_buffer_get_string(&b), &backend, prv_test_example, &run,
+	    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+	    SUBTILIS_ERROR_OK, "0\n", false);
+
+cleanup:
+
+	subtilis_buffer_free(&loops);
+	subtilis_buffer_free(&b);
+
+	return pass;
+}
+
 int ptd_test(void)
 {
 	int ret = 0;
 
 	ret |= prv_test_ptd_examples();
 	ret |= prv_test_riscos_vfp_examples();
+	ret |= prv_test_trans("trans_accurate", 1e-13,
+			      SUBTILIS_TRANS_TIER_ACCURATE);
+	ret |= prv_test_trans("trans_fast", 1e-8, SUBTILIS_TRANS_TIER_FAST);
 
 	return ret;
 }
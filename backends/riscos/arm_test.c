@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -22,6 +23,7 @@
 #include "../../arch/arm32/arm_keywords.h"
 #include "../../arch/arm32/arm_vm.h"
 #include "../../arch/arm32/fpa_gen.h"
+#include "../../common/ir_opt.h"
 #include "../../frontend/parser_test.h"
 #include "../../test_cases/bad_test_cases.h"
 #include "../../test_cases/test_cases.h"
@@ -119,6 +121,27 @@ static const subtilis_test_case_t riscos_arm_test_cases[] = {
 	 "*             Hello World!             *\n"
 	 "****************************************\n"
 	},
+	{"assembler_self_modify",
+	 "PRINT FNPatch%\n"
+	 "def FNPatch%\n"
+	 "[\n"
+	 "    MOV R2, 0\n"
+	 "    ADR R1, patch\n"
+	 "    ADR R3, new_instr\n"
+	 "    LDR R3, [R3]\n"
+	 "patch:\n"
+	 "    MOV R0, 1\n"
+	 "    ADD R2, R2, R0\n"
+	 "    STR R3, [R1]\n"
+	 "    CMP R2, 4\n"
+	 "    BLT patch\n"
+	 "    MOV R0, R2\n"
+	 "    MOV PC, R14\n"
+	 "new_instr:\n"
+	 "    MOV R0, 2\n"
+	 "]\n",
+	 "5\n"
+	},
 	{"assembler_adr",
 	"PROCprint\n"
 	"def PROCprint\n"
@@ -477,6 +500,21 @@ static const subtilis_test_case_t riscos_arm_test_cases[] = {
 	  "]\n",
 	  "8\n",
 	},
+	{ "assembler_op2_shift_32",
+	  "PRINT FNAsr32%(-8)\n"
+	  "PRINT FNLsr32%(-8)\n"
+	  "def FNAsr32%(a%)\n"
+	  "[\n"
+	  "  MOV R0, R0, ASR 32\n"
+	  "  MOV PC, R14\n"
+	  "]\n"
+	  "def FNLsr32%(a%)\n"
+	  "[\n"
+	  "  MOV R0, R0, LSR 32\n"
+	  "  MOV PC, R14\n"
+	  "]\n",
+	  "-1\n0\n",
+	},
 };
 
 static const subtilis_test_case_t riscos_fpa_test_cases[] = {
@@ -985,10 +1023,150 @@ static const subtilis_bad_test_case_t riscos_arm_bad_test_cases[] = {
 
 /* clang-format on */
 
+/*
+ * Options for, and statistics about, a single program compiled and run
+ * by prv_test_example.  A NULL run compiles the program with the
+ * default options and discards the statistics.
+ *
+ * spills is the number of spill loads and stores generated by the
+ * register allocator, ir_ops is the number of IR ops handed to the
+ * backend and cycles is the number of ARM2 clock ticks taken to run the
+ * program.  If check_parallel is set the program's code is also
+ * generated in parallel and compared to the serially generated code.
+ * If output is not NULL the program's output is appended to it.  In
+ * this case expected may be NULL, and the output is not checked.
+ */
+
+typedef struct subtilis_arm_test_run_t_ subtilis_arm_test_run_t;
+
+struct subtilis_arm_test_run_t_ {
+	bool global_reg_alloc;
+	uint32_t opt_level;
+	bool check_parallel;
+	subtilis_buffer_t *output;
+	size_t spills;
+	size_t ir_ops;
+	uint64_t cycles;
+};
+
+static size_t prv_count_spills(subtilis_arm_prog_t *arm_p)
+{
+	size_t i;
+	size_t spills = 0;
+
+	for (i = 0; i < arm_p->num_sections; i++)
+		spills += arm_p->sections[i]->spill_count;
+
+	return spills;
+}
+
+static size_t prv_count_ir_ops(subtilis_ir_prog_t *p)
+{
+	size_t i;
+	size_t ops = 0;
+
+	for (i = 0; i < p->num_sections; i++)
+		ops += p->sections[i]->len;
+
+	return ops;
+}
+
+/*
+ * Checks that the cycles attributed to the individual instructions by the
+ * profiler add up to the total number of cycles taken by the program.
+ */
+
+static bool prv_check_profile(subtilis_arm_vm_t *vm)
+{
+	size_t i;
+	uint64_t cycles = 0;
+
+	for (i = 0; i < vm->code_size; i++)
+		cycles += vm->hit_cycles[i];
+
+	return cycles == vm->cycles;
+}
+
+static uint8_t *prv_generate_code(subtilis_parser_t *p,
+				  subtilis_arm_op_pool_t *pool,
+				  size_t *code_size, subtilis_error_t *err)
+{
+	subtilis_arm_fp_if_t fp_if;
+	subtilis_arm_prog_t *arm_p;
+	uint8_t *code;
+
+	subtilis_arm_fpa_if_init(&fp_if);
+
+	arm_p = subtilis_riscos_generate(
+	    pool, p->prog, riscos_arm2_rules, riscos_arm2_rules_count,
+	    p->st->max_allocated, &fp_if, SUBTILIS_RISCOS_ARM2_PROGRAM_START,
+	    err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return NULL;
+
+	code = subtilis_arm_encode_buf(arm_p, code_size, err);
+	subtilis_arm_prog_delete(arm_p);
+
+	return code;
+}
+
+/*
+ * Checks that generating the code for a program's sections in parallel
+ * produces exactly the same binary, code, as generating them one at a
+ * time.
+ */
+
+static bool prv_check_parallel(subtilis_parser_t *p, const uint8_t *code,
+			       size_t code_size, subtilis_error_t *err)
+{
+	size_t i;
+	size_t parallel_size;
+	bool retval = false;
+	subtilis_arm_op_pool_t *pool;
+	uint8_t *parallel = NULL;
+
+	/*
+	 * Inline assembly is handed over to the ARM program when it's
+	 * generated, so we can only generate programs that contain it once.
+	 */
+
+	for (i = 0; i < p->prog->num_sections; i++)
+		if (p->prog->sections[i]->section_type ==
+		    SUBTILIS_IR_SECTION_ASM)
+			return true;
+
+	pool = subtilis_arm_op_pool_new(err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return false;
+
+	p->settings.jobs = 4;
+	parallel = prv_generate_code(p, pool, &parallel_size, err);
+	p->settings.jobs = 1;
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	if ((code_size != parallel_size) ||
+	    memcmp(code, parallel, code_size)) {
+		printf("parallel code generation produced different code\n");
+		goto cleanup;
+	}
+
+	retval = true;
+
+cleanup:
+
+	free(parallel);
+	subtilis_arm_op_pool_delete(pool);
+
+	return retval;
+}
+
 static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 			    subtilis_error_type_t expected_err,
-			    const char *expected, bool mem_leaks_ok)
+			    const char *expected, bool mem_leaks_ok,
+			    void *data)
 {
+	subtilis_arm_test_run_t *run = data;
 	subtilis_error_t err;
 	subtilis_buffer_t b;
 	size_t code_size;
@@ -1008,6 +1186,12 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 		goto cleanup;
 
 	p->backend.backend_data = pool;
+	p->settings.heap_slots = SUBTILIS_RISCOS_ARM2_HEAP_SLOTS;
+	p->settings.check_next_use = true;
+	if (run) {
+		p->settings.global_reg_alloc = run->global_reg_alloc;
+		p->settings.opt_level = run->opt_level;
+	}
 
 	subtilis_parse(p, &err);
 	if (err.type != SUBTILIS_ERROR_OK) {
@@ -1016,6 +1200,13 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 		goto cleanup;
 	}
 
+	subtilis_ir_opt_prog(p->prog, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	if (run)
+		run->ir_ops = prv_count_ir_ops(p->prog);
+
 	//	subtilis_ir_prog_dump(p->prog);
 	subtilis_arm_fpa_if_init(&fp_if);
 
@@ -1026,6 +1217,9 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	if (run)
+		run->spills = prv_count_spills(arm_p);
+
 	//	subtilis_arm_prog_dump(arm_p);
 
 	code = subtilis_arm_encode_buf(arm_p, &code_size, &err);
@@ -1035,6 +1229,10 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 		goto cleanup;
 	}
 
+	if (run && run->check_parallel &&
+	    !prv_check_parallel(p, code, code_size, &err))
+		goto cleanup;
+
 	/* Insert heap start */
 
 	if (code_size < 8) {
@@ -1053,6 +1251,8 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	vm->timing = SUBTILIS_ARM_VM_TIMING_ARM2;
+	vm->profile = true;
 	subtilis_arm_vm_run(vm, &b, &err);
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
@@ -1061,13 +1261,58 @@ static int prv_test_example(subtilis_lexer_t *l, subtilis_parser_t *p,
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	if (strcmp(subtilis_buffer_get_string(&b), expected)) {
+	if (expected && strcmp(subtilis_buffer_get_string(&b), expected)) {
 		printf("%s expected got %s\n", expected,
 		       subtilis_buffer_get_string(&b));
 		retval = 1;
 		goto cleanup;
 	}
 
+	if (!prv_check_profile(vm)) {
+		printf("profiled cycles do not match total cycles\n");
+		retval = 1;
+		goto cleanup;
+	}
+
+	if (run)
+		run->cycles = vm->cycles;
+
+	if (run && run->output) {
+		subtilis_buffer_append_buffer(run->output, &b, &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
+	/*
+	 * Run the program a second time in a new VM that uses threaded code
+	 * and check that it produces the same output as the interpreter.
+	 */
+
+	subtilis_arm_vm_delete(vm);
+	subtilis_buffer_reset(&b);
+
+	vm = subtilis_arm_vm_new(code, code_size, 512 * 1024,
+				 SUBTILIS_RISCOS_ARM2_PROGRAM_START, false, 2,
+				 argv, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	vm->threaded = true;
+	subtilis_arm_vm_run(vm, &b, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	subtilis_buffer_zero_terminate(&b, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	if (expected && strcmp(subtilis_buffer_get_string(&b), expected)) {
+		printf("%s expected got %s (threaded)\n", expected,
+		       subtilis_buffer_get_string(&b));
+		retval = 1;
+		goto cleanup;
+	}
+
 	retval = 0;
 
 cleanup:
@@ -1089,12 +1334,310 @@ cleanup:
 	return retval;
 }
 
+/*
+ * An allocation heavy program that fills an array with strings of
+ * mixed sizes, frees every other string and then measures how much of
+ * the free heap can be allocated as a single block.  It prints the
+ * highest fragmentation, as a percentage of HEAPFREE, seen over eight
+ * rounds.
+ */
+
+static const char prv_heap_bench_source[] =
+	"dim s$(127)\n"
+	"seed% := 42\n"
+	"peak% := 0\n"
+	"for round% := 1 to 8\n"
+	"  for i% := 0 to 127\n"
+	"    seed% = (seed% * 1103515245 + 12345) and &7fffffff\n"
+	"    n% := 1 + (seed% >> 8) mod 255\n"
+	"    if (seed% and 15) = 0 then\n"
+	"      n% = n% * 16\n"
+	"    endif\n"
+	"    s$(i%) = string$(n%, \"x\")\n"
+	"  next\n"
+	"  for i% := round% mod 2 to 127 step 2\n"
+	"    s$(i%) = \"\"\n"
+	"  next\n"
+	"  f% := FNFrag%\n"
+	"  if f% > peak% then\n"
+	"    peak% = f%\n"
+	"  endif\n"
+	"next\n"
+	"print peak%\n"
+	"def FNFrag%\n"
+	"  local free%\n"
+	"  local lo%\n"
+	"  local hi%\n"
+	"  local mid%\n"
+	"  free% = heapfree\n"
+	"  hi% = free%\n"
+	"  while lo% < hi%\n"
+	"    mid% = (lo% + hi% + 1) div 2\n"
+	"    if FNFits%(mid%) then\n"
+	"      lo% = mid%\n"
+	"    else\n"
+	"      hi% = mid% - 1\n"
+	"    endif\n"
+	"  endwhile\n"
+	"<-100 - (lo% * 100) div free%\n"
+	"def FNFits%(n%)\n"
+	"  onerror\n"
+	"    <- false\n"
+	"  enderror\n"
+	"  local dim a&(n% - 1)\n"
+	"<- true\n";
+
+/*
+ * Runs the heap benchmark under the VM and reports the peak
+ * fragmentation.  The large block free list coalesces neighbouring
+ * free blocks so we expect the largest free block to be a substantial
+ * fraction of the free heap even after heavy churn.
+ */
+
+static int prv_test_heap_bench(void)
+{
+	int pass;
+	subtilis_backend_t backend;
+	subtilis_buffer_t b;
+	subtilis_arm_test_run_t run;
+	char *end;
+	const char *output;
+	int frag = 100;
+	int ret = 0;
+
+	backend.caps = SUBTILIS_RISCOS_ARM_CAPS;
+	backend.sys_trans = subtilis_riscos_arm2_sys_trans;
+	backend.sys_check = subtilis_riscos_arm2_sys_check;
+	backend.backend_data = NULL;
+	backend.asm_parse = subtilis_riscos_arm2_asm_parse;
+	backend.asm_free = subtilis_riscos_asm_free;
+
+	subtilis_buffer_init(&b, 64);
+	memset(&run, 0, sizeof(run));
+	run.output = &b;
+
+	printf("arm_heap_bench");
+	ret = parser_test_wrapper_data(
+	    prv_heap_bench_source, &backend, prv_test_example, &run,
+	    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+	    SUBTILIS_ERROR_OK, NULL, false);
+
+	if (subtilis_buffer_get_size(&b) > 0) {
+		output = subtilis_buffer_get_string(&b);
+		frag = (int)strtol(output, &end, 10);
+		if ((end == output) || strcmp(end, "\n")) {
+			printf("unexpected output %s\n", output);
+			ret = 1;
+		}
+	}
+
+	pass = frag > 25;
+	printf("arm_heap_frag (peak %d%%): [%s]\n", frag, pass ? "FAIL" : "OK");
+	ret |= pass;
+
+	subtilis_buffer_free(&b);
+
+	return ret;
+}
+
+/*
+ * Short hand assembled sequences with the number of S, N and I cycles
+ * they take and the clock ticks they take on the ARM2 and the ARM3.
+ */
+
+typedef struct subtilis_arm_timing_test_t_ subtilis_arm_timing_test_t;
+
+struct subtilis_arm_timing_test_t_ {
+	const char *name;
+	const uint32_t *code;
+	size_t count;
+	uint64_t s;
+	uint64_t n;
+	uint64_t i;
+	uint64_t arm2;
+	uint64_t arm3;
+};
+
+/*
+ * Booth's algorithm terminates after 2, 1 and 16 internal cycles for
+ * Rs values of 5, 0 and 0x80000000.
+ */
+
+static const uint32_t prv_timing_mul[] = {
+	0xe3a00003, /* MOV R0, #3 */
+	0xe3a01005, /* MOV R1, #5 */
+	0xe0020190, /* MUL R2, R0, R1 */
+	0xe3a01000, /* MOV R1, #0 */
+	0xe0020190, /* MUL R2, R0, R1 */
+	0xe3a01102, /* MOV R1, #&80000000 */
+	0xe0020190, /* MUL R2, R0, R1 */
+};
+
+static const uint32_t prv_timing_stran[] = {
+	0xe3a00902, /* MOV R0, #&8000 */
+	0xe3a01005, /* MOV R1, #5 */
+	0xe5801100, /* STR R1, [R0, #256] */
+	0xe5902100, /* LDR R2, [R0, #256] */
+};
+
+static const uint32_t prv_timing_mtran[] = {
+	0xe3a00a09, /* MOV R0, #&9000 */
+	0xe880000e, /* STMIA R0, {R1-R3} */
+	0xe890000e, /* LDMIA R0, {R1-R3} */
+};
+
+static const uint32_t prv_timing_branch[] = {
+	0xe3500000, /* CMP R0, #0 */
+	0x1a000000, /* BNE skip */
+	0xea000000, /* B skip */
+	0xe3a01001, /* MOV R1, #1 */
+	0xe3a02002, /* .skip MOV R2, #2 */
+};
+
+static const uint32_t prv_timing_pc[] = {
+	0xe1a0f00f, /* MOV PC, PC */
+	0xe3a01001, /* MOV R1, #1 */
+	0xe3a02002, /* MOV R2, #2 */
+};
+
+static const subtilis_arm_timing_test_t prv_timing_tests[] = {
+	{"mul", prv_timing_mul, sizeof(prv_timing_mul) / sizeof(uint32_t),
+	 7, 0, 19, 26, 26},
+	{"stran", prv_timing_stran, sizeof(prv_timing_stran) / sizeof(uint32_t),
+	 3, 3, 1, 10, 12},
+	{"mtran", prv_timing_mtran, sizeof(prv_timing_mtran) / sizeof(uint32_t),
+	 6, 3, 1, 13, 25},
+	{"branch", prv_timing_branch,
+	 sizeof(prv_timing_branch) / sizeof(uint32_t), 5, 1, 0, 7, 6},
+	{"pc", prv_timing_pc, sizeof(prv_timing_pc) / sizeof(uint32_t), 3, 1,
+	 0, 5, 4},
+};
+
+static int prv_check_timing(const subtilis_arm_timing_test_t *test,
+			    subtilis_arm_vm_timing_t timing)
+{
+	subtilis_error_t err;
+	subtilis_buffer_t b;
+	uint64_t expected;
+	int retval = 1;
+	subtilis_arm_vm_t *vm = NULL;
+	char *argv[2] = {"./runro", "unit_test"};
+
+	subtilis_error_init(&err);
+	subtilis_buffer_init(&b, 64);
+
+	expected = (timing == SUBTILIS_ARM_VM_TIMING_ARM2) ? test->arm2
+							   : test->arm3;
+
+	vm = subtilis_arm_vm_new((uint8_t *)test->code,
+				 test->count * sizeof(uint32_t), 512 * 1024,
+				 SUBTILIS_RISCOS_ARM2_PROGRAM_START, false, 2,
+				 argv, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	vm->timing = timing;
+	subtilis_arm_vm_run(vm, &b, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	if ((vm->s_cycles != test->s) || (vm->n_cycles != test->n) ||
+	    (vm->i_cycles != test->i) || (vm->cycles != expected)) {
+		printf("\n%s: expected %" PRIu64 "S %" PRIu64 "N %" PRIu64
+		       "I %" PRIu64 " got %" PRIu64 "S %" PRIu64 "N %" PRIu64
+		       "I %" PRIu64 "\n",
+		       test->name, test->s, test->n, test->i, expected,
+		       vm->s_cycles, vm->n_cycles, vm->i_cycles, vm->cycles);
+		goto cleanup;
+	}
+
+	retval = 0;
+
+cleanup:
+
+	if (err.type != SUBTILIS_ERROR_OK)
+		subtilis_error_fprintf(stdout, &err, true);
+
+	subtilis_arm_vm_delete(vm);
+	subtilis_buffer_free(&b);
+
+	return retval;
+}
+
+static int prv_test_timing(void)
+{
+	size_t i;
+	const subtilis_arm_timing_test_t *test;
+	int pass;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(prv_timing_tests) / sizeof(prv_timing_tests[0]);
+	     i++) {
+		test = &prv_timing_tests[i];
+		pass = prv_check_timing(test, SUBTILIS_ARM_VM_TIMING_ARM2);
+		printf("arm_timing_arm2_%s: [%s]\n", test->name,
+		       pass ? "FAIL" : "OK");
+		ret |= pass;
+		pass = prv_check_timing(test, SUBTILIS_ARM_VM_TIMING_ARM3);
+		printf("arm_timing_arm3_%s: [%s]\n", test->name,
+		       pass ? "FAIL" : "OK");
+		ret |= pass;
+	}
+
+	return ret;
+}
+
+/*
+ * At -O1 copy propagation turns the byte conversions in PROCa into a
+ * signx8to32 whose source and destination are the same register.
+ */
+
+static const char prv_signx_alias_source[] =
+	"PROCa(200)\n"
+	"PROCa(-3)\n"
+	"DEF PROCa(x%)\n"
+	"  LOCAL c&\n"
+	"  c& = x%\n"
+	"  x% = c&\n"
+	"  PRINT x%\n"
+	"ENDPROC\n";
+
+static int prv_test_signx_alias(void)
+{
+	subtilis_backend_t backend;
+	subtilis_arm_test_run_t run;
+
+	backend.caps = SUBTILIS_RISCOS_ARM_CAPS;
+	backend.sys_trans = subtilis_riscos_arm2_sys_trans;
+	backend.sys_check = subtilis_riscos_arm2_sys_check;
+	backend.backend_data = NULL;
+	backend.asm_parse = subtilis_riscos_arm2_asm_parse;
+	backend.asm_free = subtilis_riscos_asm_free;
+
+	memset(&run, 0, sizeof(run));
+	run.opt_level = 1;
+
+	printf("arm_opt1_signx_alias");
+	return parser_test_wrapper_data(
+	    prv_signx_alias_source, &backend, prv_test_example, &run,
+	    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+	    SUBTILIS_ERROR_OK, "-56\n-3\n", false);
+}
+
 static int prv_test_examples(void)
 {
 	size_t i;
 	int pass;
 	const subtilis_test_case_t *test;
 	subtilis_backend_t backend;
+	subtilis_arm_test_run_t run;
+	subtilis_arm_test_run_t global_run;
+	subtilis_arm_test_run_t opt_run;
+	size_t local_spills = 0;
+	size_t global_spills = 0;
+	size_t ir_ops = 0;
+	size_t opt_ir_ops = 0;
+	uint64_t cycles = 0;
 	int ret = 0;
 
 	backend.caps = SUBTILIS_RISCOS_ARM_CAPS;
@@ -1107,13 +1650,216 @@ static int prv_test_examples(void)
 	for (i = 0; i < SUBTILIS_TEST_CASE_ID_MAX; i++) {
 		test = &test_cases[i];
 		printf("arm_%s", test->name);
-		pass = parser_test_wrapper(
-		    test->source, &backend, prv_test_example,
+		memset(&run, 0, sizeof(run));
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, &run,
+		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
+		ret |= pass;
+		local_spills += run.spills;
+		ir_ops += run.ir_ops;
+		cycles += run.cycles;
+
+		printf("arm_global_%s", test->name);
+		memset(&global_run, 0, sizeof(global_run));
+		global_run.global_reg_alloc = true;
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, &global_run,
+		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
+		ret |= pass;
+		global_spills += global_run.spills;
+
+		printf("arm_opt_%s", test->name);
+		memset(&opt_run, 0, sizeof(opt_run));
+		opt_run.opt_level = 2;
+		opt_run.check_parallel = true;
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, &opt_run,
 		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
 		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
 		ret |= pass;
+		opt_ir_ops += opt_run.ir_ops;
+	}
+
+	/*
+	 * The global allocator should never increase the number of spills
+	 * across the test suite as a whole.
+	 */
+
+	pass = global_spills > local_spills;
+	printf("arm_static_spills (local %zu global %zu): [%s]\n",
+	       local_spills, global_spills, pass ? "FAIL" : "OK");
+	ret |= pass;
+
+	pass = opt_ir_ops >= ir_ops;
+	printf("arm_ir_opt (ops %zu optimised %zu): [%s]\n", ir_ops,
+	       opt_ir_ops, pass ? "FAIL" : "OK");
+	ret |= pass;
+
+	/*
+	 * The number of ARM2 clock ticks needed to run the test suite.  This
+	 * is deterministic and can be used to track the effect of changes to
+	 * the code generator.
+	 */
+
+	pass = cycles == 0;
+	printf("arm_cycles (arm2 %" PRIu64 "): [%s]\n", cycles,
+	       pass ? "FAIL" : "OK");
+	ret |= pass;
+
+	return ret;
+}
+
+/*
+ * The ARM2 rule table indexed by the type of each rule's first op, and
+ * the same rules chained together in a single list, which
+ * subtilis_ir_match_rule scans linearly, in priority order.
+ */
+
+typedef struct subtilis_arm_test_dispatch_t_ subtilis_arm_test_dispatch_t;
+
+struct subtilis_arm_test_dispatch_t_ {
+	subtilis_ir_rules_t indexed;
+	subtilis_ir_rules_t linear;
+};
+
+/*
+ * Checks that, for each op of each section of the program, the rule
+ * selected through the dispatch index is the rule that the linear scan
+ * selects.
+ */
+
+static int prv_check_dispatch(subtilis_lexer_t *l, subtilis_parser_t *p,
+			      subtilis_error_type_t expected_err,
+			      const char *expected, bool mem_leaks_ok,
+			      void *data)
+{
+	size_t i;
+	size_t pc;
+	size_t rule;
+	size_t linear_rule;
+	subtilis_ir_section_t *s;
+	subtilis_ir_op_t *op;
+	subtilis_error_t err;
+	subtilis_arm_test_dispatch_t *d = data;
+
+	subtilis_error_init(&err);
+
+	p->settings.heap_slots = SUBTILIS_RISCOS_ARM2_HEAP_SLOTS;
+
+	subtilis_parse(p, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	subtilis_ir_opt_prog(p->prog, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	for (i = 0; i < p->prog->num_sections; i++) {
+		s = p->prog->sections[i];
+		if (s->section_type == SUBTILIS_IR_SECTION_ASM)
+			continue;
+		for (pc = 0; pc < s->len;) {
+			op = s->ops[pc];
+			if ((op->type == SUBTILIS_OP_INSTR) &&
+			    (op->op.instr.type == SUBTILIS_OP_INSTR_NOP)) {
+				pc++;
+				continue;
+			}
+			rule = subtilis_ir_match_rule(s, &d->indexed, pc, &err);
+			if (err.type != SUBTILIS_ERROR_OK)
+				goto fail;
+			linear_rule =
+			    subtilis_ir_match_rule(s, &d->linear, pc, &err);
+			if (err.type != SUBTILIS_ERROR_OK)
+				goto fail;
+			if ((rule != linear_rule) || (rule == SIZE_MAX)) {
+				printf("\nsection %zu pc %zu: rule %zu, linear "
+				       "scan rule %zu\n",
+				       i, pc, rule, linear_rule);
+				return 1;
+			}
+			pc += d->indexed.rules[rule].matches_count;
+		}
+	}
+
+	return 0;
+
+fail:
+
+	subtilis_error_fprintf(stdout, &err, true);
+
+	return 1;
+}
+
+static int prv_test_dispatch(void)
+{
+	size_t i;
+	size_t key;
+	int pass;
+	const subtilis_test_case_t *test;
+	subtilis_backend_t backend;
+	subtilis_error_t err;
+	subtilis_arm_test_dispatch_t d;
+	subtilis_ir_rule_t *parsed = NULL;
+	subtilis_ir_rule_t *linear = NULL;
+	int ret = 1;
+
+	subtilis_error_init(&err);
+
+	backend.caps = SUBTILIS_RISCOS_ARM_CAPS;
+	backend.sys_trans = subtilis_riscos_arm2_sys_trans;
+	backend.sys_check = subtilis_riscos_arm2_sys_check;
+	backend.backend_data = NULL;
+	backend.asm_parse = subtilis_riscos_arm2_asm_parse;
+	backend.asm_free = subtilis_riscos_asm_free;
+
+	parsed = malloc(sizeof(*parsed) * riscos_arm2_rules_count);
+	linear = malloc(sizeof(*linear) * riscos_arm2_rules_count);
+	if (!parsed || !linear) {
+		subtilis_error_set_oom(&err);
+		goto cleanup;
+	}
+
+	subtilis_ir_parse_rules(riscos_arm2_rules, parsed,
+				riscos_arm2_rules_count, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	subtilis_ir_rules_init(&d.indexed, parsed, riscos_arm2_rules_count);
+
+	for (i = 0; i < riscos_arm2_rules_count; i++) {
+		linear[i] = parsed[i];
+		linear[i].next =
+		    (i + 1 < riscos_arm2_rules_count) ? i + 1 : SIZE_MAX;
+	}
+	d.linear.rules = linear;
+	d.linear.count = riscos_arm2_rules_count;
+	for (key = 0; key < SUBTILIS_IR_MATCH_KEYS; key++)
+		d.linear.first[key] = 0;
+
+	ret = 0;
+	for (i = 0; i < SUBTILIS_TEST_CASE_ID_MAX; i++) {
+		test = &test_cases[i];
+		printf("arm_dispatch_%s", test->name);
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_check_dispatch, &d,
+		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
+		    SUBTILIS_ERROR_OK, NULL, test->mem_leaks_ok);
+		ret |= pass;
 	}
 
+cleanup:
+
+	if (err.type != SUBTILIS_ERROR_OK) {
+		printf("arm_dispatch: [FAIL]\n");
+		subtilis_error_fprintf(stdout, &err, true);
+	}
+
+	free(linear);
+	free(parsed);
+
 	return ret;
 }
 
@@ -1137,8 +1883,8 @@ static int prv_test_riscos_arm_examples(void)
 	     i++) {
 		test = &riscos_arm_test_cases[i];
 		printf("arm_%s", test->name);
-		pass = parser_test_wrapper(
-		    test->source, &backend, prv_test_example,
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, NULL,
 		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
 		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
 		ret |= pass;
@@ -1167,8 +1913,8 @@ static int prv_test_riscos_fpa_examples(void)
 	     i++) {
 		test = &riscos_fpa_test_cases[i];
 		printf("arm_%s", test->name);
-		pass = parser_test_wrapper(
-		    test->source, &backend, prv_test_example,
+		pass = parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, NULL,
 		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
 		    SUBTILIS_ERROR_OK, test->result, test->mem_leaks_ok);
 		ret |= pass;
@@ -1196,8 +1942,8 @@ static int prv_test_bad_cases(void)
 	     i++) {
 		test = &riscos_arm_bad_test_cases[i];
 		printf("arm_bad_%s", test->name);
-		retval |= parser_test_wrapper(
-		    test->source, &backend, prv_test_example,
+		retval |= parser_test_wrapper_data(
+		    test->source, &backend, prv_test_example, NULL,
 		    subtilis_arm_keywords_list, SUBTILIS_ARM_KEYWORD_TOKENS,
 		    test->err, "", false);
 	}
@@ -1916,6 +2662,10 @@ int arm_test(void)
 	res |= prv_test_riscos_arm_examples();
 	res |= prv_test_riscos_fpa_examples();
 	res |= prv_test_bad_cases();
+	res |= prv_test_heap_bench();
+	res |= prv_test_signx_alias();
+	res |= prv_test_timing();
+	res |= prv_test_dispatch();
 
 	return res;
 }
@@ -44,8 +44,16 @@ void subtilis_riscos_tcol_tint(subtilis_ir_section_t *s, size_t start,
 
 #define SUBTILIS_RISCOS_ARM2_PROGRAM_START 0x8000
 
+/*
+ * Size classes from 32 bytes to 32KB.  Memory is tight on machines
+ * running RiscOS so we don't want too much of it tied up in the
+ * size classes.
+ */
+
+#define SUBTILIS_RISCOS_ARM2_HEAP_SLOTS 12
+
 #define SUBTILIS_RISCOS_ARM_CAPS                                               \
 	(SUBTILIS_BACKEND_HAVE_I32_TO_DEC | SUBTILIS_BACKEND_REVERSE_DOUBLES | \
-	 SUBTILIS_BACKEND_HAVE_TINT)
+	 SUBTILIS_BACKEND_HAVE_TINT | SUBTILIS_BACKEND_HAVE_TRANS)
 
 #endif
@@ -17,6 +17,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef SUBTILIS_CONFIG_THREADS
+#include <pthread.h>
+#endif
+
 #include "../../arch/arm32/arm2_div.h"
 #include "../../arch/arm32/arm_gen.h"
 #include "../../arch/arm32/arm_heap.h"
@@ -25,6 +29,7 @@
 #include "../../arch/arm32/arm_reg_alloc.h"
 #include "../../arch/arm32/arm_sub_section.h"
 #include "../../arch/arm32/assembler.h"
+#include "../../arch/arm32/vfp_math.h"
 #include "../../common/error_codes.h"
 #include "riscos_arm.h"
 
@@ -230,7 +235,8 @@ static void prv_add_preamble(subtilis_arm_section_t *arm_s, size_t globals,
 	subtilis_arm_instr_t *instr;
 	subtilis_arm_br_instr_t *br;
 	const uint32_t stack_size = 8192;
-	const uint32_t min_heap_size = subtilis_arm_heap_min_size();
+	const uint32_t min_heap_size =
+	    subtilis_arm_heap_min_size(arm_s->settings->heap_slots);
 
 	/* globals needs to be divisible by 4. */
 
@@ -434,6 +440,36 @@ static void prv_add_builtin(subtilis_ir_section_t *s,
 	case SUBTILIS_BUILTINS_MEMSETI64:
 		subtilis_arm_mem_memseti64(s, arm_s, err);
 		break;
+	case SUBTILIS_BUILTINS_SIN:
+		subtilis_vfp_math_sin(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_COS:
+		subtilis_vfp_math_cos(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_TAN:
+		subtilis_vfp_math_tan(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_ASN:
+		subtilis_vfp_math_asn(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_ACS:
+		subtilis_vfp_math_acs(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_ATN:
+		subtilis_vfp_math_atn(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_LOG:
+		subtilis_vfp_math_log(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_LN:
+		subtilis_vfp_math_ln(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_EXP:
+		subtilis_vfp_math_exp(s, arm_s, err);
+		break;
+	case SUBTILIS_BUILTINS_POW:
+		subtilis_vfp_math_pow(s, arm_s, err);
+		break;
 	default:
 		subtilis_error_set_assertion_failed(err);
 	}
@@ -456,7 +492,7 @@ cleanup:
 
 static void prv_add_section(subtilis_ir_section_t *s,
 			    subtilis_arm_section_t *arm_s,
-			    subtilis_ir_rule_t *parsed, size_t rule_count,
+			    const subtilis_ir_rules_t *rules,
 			    subtilis_error_t *err)
 {
 	size_t spill_regs;
@@ -491,7 +527,7 @@ static void prv_add_section(subtilis_ir_section_t *s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_ir_match(s, parsed, rule_count, arm_s, err);
+	subtilis_ir_match(s, rules, arm_s, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
@@ -527,6 +563,231 @@ static void prv_add_section(subtilis_ir_section_t *s,
 	subtilis_arm_peephole(arm_s, err);
 }
 
+/*
+ * Describes the lowering of a single IR section to an ARM section.  When
+ * sections are lowered in parallel, each thread allocates the ops of the
+ * sections it lowers from its own op pool.  The ops of a section occupy
+ * the entries start to end - 1 of that pool.
+ */
+
+struct subtilis_riscos_job_t_ {
+	subtilis_ir_section_t *s;
+	subtilis_arm_section_t *arm_s;
+	bool main;
+	subtilis_arm_op_pool_t *pool;
+	size_t start;
+	size_t end;
+	subtilis_error_t err;
+};
+
+typedef struct subtilis_riscos_job_t_ subtilis_riscos_job_t;
+
+static void prv_run_job(subtilis_riscos_job_t *job,
+			const subtilis_ir_rules_t *rules, size_t globals)
+{
+	if (job->main) {
+		prv_add_preamble(job->arm_s, globals, &job->err);
+		if (job->err.type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	if (job->s->section_type == SUBTILIS_IR_SECTION_BACKEND_BUILTIN)
+		prv_add_builtin(job->s, job->arm_s, &job->err);
+	else
+		prv_add_section(job->s, job->arm_s, rules, &job->err);
+}
+
+#ifdef SUBTILIS_CONFIG_THREADS
+
+struct subtilis_riscos_queue_t_ {
+	pthread_mutex_t lock;
+	subtilis_riscos_job_t *jobs;
+	size_t job_count;
+	size_t next;
+	bool failed;
+	const subtilis_ir_rules_t *rules;
+	size_t globals;
+};
+
+typedef struct subtilis_riscos_queue_t_ subtilis_riscos_queue_t;
+
+struct subtilis_riscos_worker_t_ {
+	pthread_t thread;
+	bool started;
+	subtilis_riscos_queue_t *queue;
+	subtilis_arm_op_pool_t *pool;
+};
+
+typedef struct subtilis_riscos_worker_t_ subtilis_riscos_worker_t;
+
+static subtilis_riscos_job_t *prv_next_job(subtilis_riscos_queue_t *queue)
+{
+	subtilis_riscos_job_t *job = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+	while (!queue->failed && queue->next < queue->job_count) {
+		job = &queue->jobs[queue->next++];
+		if (job->s)
+			break;
+		job = NULL;
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	return job;
+}
+
+static void *prv_worker(void *data)
+{
+	subtilis_riscos_job_t *job;
+	subtilis_riscos_worker_t *w = data;
+	subtilis_riscos_queue_t *queue = w->queue;
+
+	while ((job = prv_next_job(queue)) != NULL) {
+		job->pool = w->pool;
+		job->start = w->pool->len;
+		job->arm_s->op_pool = w->pool;
+		prv_run_job(job, queue->rules, queue->globals);
+		job->end = w->pool->len;
+		if (job->err.type != SUBTILIS_ERROR_OK) {
+			pthread_mutex_lock(&queue->lock);
+			queue->failed = true;
+			pthread_mutex_unlock(&queue->lock);
+		}
+	}
+
+	return NULL;
+}
+
+static void prv_worker_init(subtilis_riscos_worker_t *w,
+			    subtilis_riscos_queue_t *queue,
+			    subtilis_error_t *err)
+{
+	w->queue = queue;
+	w->pool = subtilis_arm_op_pool_new(err);
+}
+
+/*
+ * The calling thread acts as the first worker.  If we fail to create
+ * any of the other threads the sections are lowered by the threads we
+ * do manage to create.  Once all the sections have been lowered their
+ * ops are moved into the program's op pool in section order, so the
+ * contents of the pool don't depend on which thread lowered which
+ * section.
+ */
+
+static void prv_generate_parallel(subtilis_arm_prog_t *arm_p,
+				  subtilis_riscos_job_t *jobs,
+				  size_t job_count,
+				  const subtilis_ir_rules_t *rules,
+				  size_t globals, size_t threads,
+				  subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_riscos_queue_t queue;
+	subtilis_riscos_worker_t *workers;
+
+	workers = calloc(threads, sizeof(*workers));
+	if (!workers) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	if (pthread_mutex_init(&queue.lock, NULL)) {
+		subtilis_error_set_assertion_failed(err);
+		goto cleanup;
+	}
+
+	queue.jobs = jobs;
+	queue.job_count = job_count;
+	queue.next = 0;
+	queue.failed = false;
+	queue.rules = rules;
+	queue.globals = globals;
+
+	for (i = 0; i < threads; i++) {
+		prv_worker_init(&workers[i], &queue, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup_lock;
+	}
+
+	for (i = 1; i < threads; i++)
+		workers[i].started = !pthread_create(
+		    &workers[i].thread, NULL, prv_worker, &workers[i]);
+
+	(void)prv_worker(&workers[0]);
+
+	for (i = 1; i < threads; i++)
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+
+	for (i = 0; i < job_count; i++) {
+		if (!jobs[i].pool)
+			continue;
+		subtilis_arm_section_move_ops(jobs[i].arm_s, arm_p->op_pool,
+					      jobs[i].start, jobs[i].end, err);
+		if (err->type != SUBTILIS_ERROR_OK) {
+			for (; i < job_count; i++) {
+				if (!jobs[i].pool)
+					continue;
+				jobs[i].arm_s->first_op = SIZE_MAX;
+				jobs[i].arm_s->last_op = SIZE_MAX;
+				jobs[i].arm_s->len = 0;
+				jobs[i].arm_s->op_pool = arm_p->op_pool;
+			}
+			goto cleanup_lock;
+		}
+	}
+
+cleanup_lock:
+
+	pthread_mutex_destroy(&queue.lock);
+
+cleanup:
+
+	for (i = 0; i < threads; i++)
+		subtilis_arm_op_pool_delete(workers[i].pool);
+	free(workers);
+}
+
+#endif
+
+static void prv_generate_jobs(subtilis_arm_prog_t *arm_p,
+			      subtilis_riscos_job_t *jobs, size_t job_count,
+			      const subtilis_ir_rules_t *rules, size_t globals,
+			      subtilis_error_t *err)
+{
+	size_t i;
+
+#ifdef SUBTILIS_CONFIG_THREADS
+	size_t threads = arm_p->settings->jobs;
+
+	if (threads > job_count)
+		threads = job_count;
+	if (threads > 1) {
+		prv_generate_parallel(arm_p, jobs, job_count, rules, globals,
+				      threads, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		for (i = 0; i < job_count; i++)
+			if (jobs[i].err.type != SUBTILIS_ERROR_OK) {
+				*err = jobs[i].err;
+				return;
+			}
+		return;
+	}
+#endif
+
+	for (i = 0; i < job_count; i++) {
+		if (!jobs[i].s)
+			continue;
+		prv_run_job(&jobs[i], rules, globals);
+		if (jobs[i].err.type != SUBTILIS_ERROR_OK) {
+			*err = jobs[i].err;
+			return;
+		}
+	}
+}
+
 /* clang-format off */
 subtilis_arm_prog_t *
 subtilis_riscos_generate(
@@ -538,9 +799,11 @@ subtilis_riscos_generate(
 /* clang-format on */
 {
 	subtilis_ir_rule_t *parsed;
+	subtilis_ir_rules_t rules;
 	subtilis_arm_prog_t *arm_p = NULL;
 	subtilis_arm_section_t *arm_s;
 	subtilis_ir_section_t *s;
+	subtilis_riscos_job_t *jobs = NULL;
 	size_t i;
 
 	parsed = malloc(sizeof(*parsed) * rule_count);
@@ -553,26 +816,21 @@ subtilis_riscos_generate(
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	subtilis_ir_rules_init(&rules, parsed, rule_count);
+
 	arm_p = subtilis_arm_prog_new(p->num_sections + 2, op_pool,
 				      p->string_pool, p->constant_pool,
 				      p->settings, fp_if, start_address, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	s = p->sections[0];
-	arm_s = subtilis_arm_prog_section_new(arm_p, s->type, s->reg_counter,
-					      s->freg_counter, s->label_counter,
-					      s->locals, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		goto cleanup;
-	prv_add_preamble(arm_s, globals, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		goto cleanup;
-	prv_add_section(s, arm_s, parsed, rule_count, err);
-	if (err->type != SUBTILIS_ERROR_OK)
+	jobs = calloc(p->num_sections, sizeof(*jobs));
+	if (!jobs) {
+		subtilis_error_set_oom(err);
 		goto cleanup;
+	}
 
-	for (i = 1; i < p->num_sections; i++) {
+	for (i = 0; i < p->num_sections; i++) {
 		s = p->sections[i];
 		if (s->section_type == SUBTILIS_IR_SECTION_ASM) {
 			arm_s = (subtilis_arm_section_t *)s->asm_code;
@@ -593,14 +851,17 @@ subtilis_riscos_generate(
 		    s->label_counter, s->locals, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			goto cleanup;
-		if (s->section_type == SUBTILIS_IR_SECTION_BACKEND_BUILTIN)
-			prv_add_builtin(s, arm_s, err);
-		else
-			prv_add_section(s, arm_s, parsed, rule_count, err);
-		if (err->type != SUBTILIS_ERROR_OK)
-			goto cleanup;
+		jobs[i].s = s;
+		jobs[i].arm_s = arm_s;
+		jobs[i].main = i == 0;
+		subtilis_error_init(&jobs[i].err);
 	}
 
+	prv_generate_jobs(arm_p, jobs, p->num_sections, &rules, globals, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	free(jobs);
 	free(parsed);
 	parsed = NULL;
 
@@ -616,6 +877,7 @@ cleanup:
 		subtilis_arm_prog_dump(arm_p);
 
 	subtilis_arm_prog_delete(arm_p);
+	free(jobs);
 	free(parsed);
 
 	return NULL;
@@ -1922,6 +2184,16 @@ void subtilis_riscos_arm_block_free_space(subtilis_ir_section_t *s,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	/*
+	 * The heap stores some flags in the bottom bits of the block size.
+	 */
+
+	subtilis_arm_add_data_imm(arm_s, SUBTILIS_ARM_INSTR_BIC,
+				  SUBTILIS_ARM_CCODE_AL, false, total, total, 3,
+				  err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
 	instr =
 	    subtilis_arm_section_add_instr(arm_s, SUBTILIS_ARM_INSTR_SUB, err);
 	if (err->type != SUBTILIS_ERROR_OK)
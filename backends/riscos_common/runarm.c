@@ -14,10 +14,13 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <locale.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "../../arch/arm32/arm_disass.h"
+#include "../../arch/arm32/arm_profile.h"
 #include "../../arch/arm32/arm_vm.h"
 #include "../../common/buffer.h"
 
@@ -62,9 +65,43 @@ int runarm_main(int argc, char **argv, uint32_t start_address, bool vfp)
 	size_t code_len;
 	subtilis_arm_vm_t *vm = NULL;
 	FILE *f = NULL;
+	bool threaded = false;
+	subtilis_arm_vm_timing_t timing = SUBTILIS_ARM_VM_TIMING_NONE;
+	bool profile = false;
+	const char *map_fname = NULL;
+
+	while (argc > 1) {
+		if (!strcmp(argv[1], "-t")) {
+			threaded = true;
+		} else if (argc > 2 && !strcmp(argv[1], "-c")) {
+			if (!strcmp(argv[2], "arm2")) {
+				timing = SUBTILIS_ARM_VM_TIMING_ARM2;
+			} else if (!strcmp(argv[2], "arm3")) {
+				timing = SUBTILIS_ARM_VM_TIMING_ARM3;
+			} else {
+				fprintf(stderr, "Unknown processor %s\n",
+					argv[2]);
+				return 1;
+			}
+			argc--;
+			argv++;
+		} else if (!strcmp(argv[1], "-p")) {
+			profile = true;
+		} else if (argc > 2 && !strcmp(argv[1], "-m")) {
+			map_fname = argv[2];
+			argc--;
+			argv++;
+		} else {
+			break;
+		}
+		argc--;
+		argv++;
+	}
 
 	if (argc < 2) {
-		fprintf(stderr, "Usage: runro/runptd file\n");
+		fprintf(stderr,
+			"Usage: runro/runptd [-t] [-c arm2|arm3] [-p] "
+			"[-m map] file\n");
 		return 1;
 	}
 
@@ -96,6 +133,9 @@ int runarm_main(int argc, char **argv, uint32_t start_address, bool vfp)
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	vm->threaded = threaded;
+	vm->timing = timing;
+	vm->profile = profile;
 	subtilis_arm_vm_run(vm, &out_b, &err);
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
@@ -108,6 +148,20 @@ int runarm_main(int argc, char **argv, uint32_t start_address, bool vfp)
 
 	printf("%s\n", subtilis_buffer_get_string(&out_b));
 
+	if (vm->timing != SUBTILIS_ARM_VM_TIMING_NONE) {
+		printf("==== CYCLES ====\n\n");
+		printf("S %" PRIu64 " N %" PRIu64 " I %" PRIu64 "\n",
+		       vm->s_cycles, vm->n_cycles, vm->i_cycles);
+		printf("Total %" PRIu64 "\n", vm->cycles);
+	}
+
+	if (profile) {
+		printf("\n");
+		subtilis_arm_profile_report(vm, map_fname, 20, &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
 	retval = 0;
 
 cleanup:
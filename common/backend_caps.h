@@ -26,10 +26,11 @@
 #define SUBTILIS_BACKEND_HAVE_ALLOC 16
 #define SUBTILIS_BACKEND_REVERSE_DOUBLES 32
 #define SUBTILIS_BACKEND_HAVE_TINT 64
+#define SUBTILIS_BACKEND_HAVE_TRANS 128
 
 #define SUBTILIS_BACKEND_INTER_CAPS                                            \
 	(SUBTILIS_BACKEND_HAVE_DIV | SUBTILIS_BACKEND_HAVE_ALLOC |             \
-	 SUBTILIS_BACKEND_HAVE_TINT)
+	 SUBTILIS_BACKEND_HAVE_TINT | SUBTILIS_BACKEND_HAVE_TRANS)
 typedef uint32_t subtilis_backend_caps_t;
 
 #endif
@@ -45,6 +45,26 @@ const subtilis_builtin_t subtilis_builtin_list[] = {
 	 { {SUBTILIS_TYPE_INTEGER}, {SUBTILIS_TYPE_INTEGER},
 	   {SUBTILIS_TYPE_INTEGER},
 	   {SUBTILIS_TYPE_INTEGER} }, false },
+	{"_sin", SUBTILIS_BUILTINS_SIN, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, false },
+	{"_cos", SUBTILIS_BUILTINS_COS, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, false },
+	{"_tan", SUBTILIS_BUILTINS_TAN, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, false },
+	{"_asn", SUBTILIS_BUILTINS_ASN, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, false },
+	{"_acs", SUBTILIS_BUILTINS_ACS, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, false },
+	{"_atn", SUBTILIS_BUILTINS_ATN, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, false },
+	{"_log", SUBTILIS_BUILTINS_LOG, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, true },
+	{"_ln", SUBTILIS_BUILTINS_LN, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, true },
+	{"_exp", SUBTILIS_BUILTINS_EXP, { SUBTILIS_TYPE_REAL }, 1,
+	 { {SUBTILIS_TYPE_REAL} }, false },
+	{"_pow", SUBTILIS_BUILTINS_POW, { SUBTILIS_TYPE_REAL }, 2,
+	 { {SUBTILIS_TYPE_REAL}, {SUBTILIS_TYPE_REAL} }, false },
 };
 
 /* clang-format on */
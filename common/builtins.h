@@ -31,6 +31,16 @@ typedef enum {
 	SUBTILIS_BUILTINS_ALLOC,
 	SUBTILIS_BUILTINS_DEREF,
 	SUBTILIS_BUILTINS_MEMSETI64,
+	SUBTILIS_BUILTINS_SIN,
+	SUBTILIS_BUILTINS_COS,
+	SUBTILIS_BUILTINS_TAN,
+	SUBTILIS_BUILTINS_ASN,
+	SUBTILIS_BUILTINS_ACS,
+	SUBTILIS_BUILTINS_ATN,
+	SUBTILIS_BUILTINS_LOG,
+	SUBTILIS_BUILTINS_LN,
+	SUBTILIS_BUILTINS_EXP,
+	SUBTILIS_BUILTINS_POW,
 	SUBTILIS_BUILTINS_MAX
 } subtilis_builtin_type_t;
 
@@ -79,4 +79,33 @@
 #define SUBTILIS_CONFIG_POINTER_SIZE sizeof(int32_t)
 #endif
 
+#ifndef SUBTILIS_CONFIG_ESCAPE_SHORT_LOOP
+#define SUBTILIS_CONFIG_ESCAPE_SHORT_LOOP 256
+#endif
+
+#ifndef SUBTILIS_CONFIG_ESCAPE_BUDGET
+#define SUBTILIS_CONFIG_ESCAPE_BUDGET 64
+#endif
+
+#ifndef SUBTILIS_CONFIG_INLINE_MAX_OPS
+#define SUBTILIS_CONFIG_INLINE_MAX_OPS 32
+#endif
+
+#ifndef SUBTILIS_CONFIG_INLINE_BUDGET
+#define SUBTILIS_CONFIG_INLINE_BUDGET 2048
+#endif
+
+/*
+ * The maximum number of strings concatenated by a single allocation.
+ * Longer chains of additions are split into several concatenations.
+ */
+
+#ifndef SUBTILIS_CONFIG_CONCAT_MAX
+#define SUBTILIS_CONFIG_CONCAT_MAX 16
+#endif
+
+#ifndef SUBTILIS_CONFIG_HEAP_SLOTS
+#define SUBTILIS_CONFIG_HEAP_SLOTS 13
+#endif
+
 #endif
@@ -29,6 +29,7 @@ subtilis_constant_pool_t *subtilis_constant_pool_new(subtilis_error_t *err)
 		return NULL;
 	}
 	pool->ref = 1;
+	subtilis_pool_index_init(&pool->index);
 	return pool;
 }
 
@@ -54,6 +55,7 @@ void subtilis_constant_pool_delete(subtilis_constant_pool_t *pool)
 	for (i = 0; i < pool->size; i++)
 		free(pool->data[i].data);
 	free(pool->data);
+	subtilis_pool_index_free(&pool->index);
 	free(pool);
 }
 
@@ -82,23 +84,36 @@ next:
 	}
 }
 
+static bool prv_constant_equal(const void *pool, size_t index,
+			       const void *key)
+{
+	const subtilis_constant_pool_t *cp = pool;
+	const subtilis_constant_data_t *a = &cp->data[index];
+	const subtilis_constant_data_t *b = key;
+
+	return (a->dbl == b->dbl) && (a->data_size == b->data_size) &&
+	       !memcmp(a->data, b->data, a->data_size);
+}
+
 size_t subtilis_constant_pool_add(subtilis_constant_pool_t *pool, uint8_t *data,
 				  size_t data_size, bool dbl,
 				  subtilis_error_t *err)
 {
 	size_t i;
+	size_t hash;
 	size_t new_max_size;
 	subtilis_constant_data_t *new_data;
+	subtilis_constant_data_t key;
 
-	for (i = 0; i < pool->size; i++) {
-		if (dbl != pool->data[i].dbl)
-			continue;
-		if (data_size != pool->data[i].data_size)
-			continue;
-		if (!memcmp(data, pool->data[i].data, data_size)) {
-			free(data);
-			return i;
-		}
+	key.data = data;
+	key.data_size = data_size;
+	key.dbl = dbl;
+
+	hash = subtilis_pool_index_hash(data, data_size);
+	if (subtilis_pool_index_find(&pool->index, hash, prv_constant_equal,
+				     pool, &key, &i)) {
+		free(data);
+		return i;
 	}
 
 	if (pool->size == pool->max_size) {
@@ -113,6 +128,11 @@ size_t subtilis_constant_pool_add(subtilis_constant_pool_t *pool, uint8_t *data,
 		pool->data = new_data;
 	}
 
+	i = pool->size;
+	subtilis_pool_index_add(&pool->index, hash, i, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return SIZE_MAX;
+
 	pool->data[pool->size].data = data;
 	pool->data[pool->size].dbl = dbl;
 	pool->data[pool->size++].data_size = data_size;
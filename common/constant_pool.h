@@ -18,6 +18,7 @@
 #define __SUBTILIS_CONSTANT_POOL_H
 
 #include "error.h"
+#include "pool_index.h"
 #include "type.h"
 
 struct subtilis_constant_data_t_ {
@@ -33,6 +34,7 @@ struct subtilis_constant_pool_t_ {
 	size_t max_size;
 	subtilis_constant_data_t *data;
 	size_t ref;
+	subtilis_pool_index_t index;
 };
 
 typedef struct subtilis_constant_pool_t_ subtilis_constant_pool_t;
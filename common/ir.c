@@ -214,6 +214,7 @@ static const subtilis_ir_op_desc_t op_desc[] = {
 	{ "oscli", SUBTILIS_OP_CLASS_REG },
 	{ "getprocaddr", SUBTILIS_OP_CLASS_REG_I32 },
 	{ "osargs", SUBTILIS_OP_CLASS_REG },
+	{ "mulhi32", SUBTILIS_OP_CLASS_REG_REG_REG },
 };
 
 /*
@@ -368,6 +369,37 @@ static void prv_ensure_error_buffer(subtilis_ir_section_t *s,
 	s->error_ops = new_ops;
 }
 
+static uint32_t prv_operand_mask(subtilis_op_instr_type_t type,
+				 subtilis_ir_operand_class_t cls)
+{
+	size_t i;
+	const subtilis_ir_class_info_t *details;
+	uint32_t mask = 0;
+
+	details = &class_details[op_desc[type].cls];
+	for (i = 0; i < details->op_count; i++)
+		if (details->classes[i] == cls)
+			mask |= 1 << i;
+
+	return mask;
+}
+
+uint32_t subtilis_ir_instr_reg_operands(subtilis_op_instr_type_t type)
+{
+	return prv_operand_mask(type, SUBTILIS_IR_OPERAND_REGISTER) |
+	       prv_operand_mask(type, SUBTILIS_IR_OPERAND_FREGISTER);
+}
+
+uint32_t subtilis_ir_instr_freg_operands(subtilis_op_instr_type_t type)
+{
+	return prv_operand_mask(type, SUBTILIS_IR_OPERAND_FREGISTER);
+}
+
+uint32_t subtilis_ir_instr_label_operands(subtilis_op_instr_type_t type)
+{
+	return prv_operand_mask(type, SUBTILIS_IR_OPERAND_LABEL);
+}
+
 static bool prv_is_call(subtilis_ir_op_t *op)
 {
 	return (op->type == SUBTILIS_OP_CALL) ||
@@ -412,6 +444,7 @@ static void prv_ir_section_delete(subtilis_ir_section_t *s)
 	}
 	free(s->error_ops);
 	subtilis_handler_list_free(s->handler_list);
+	free(s->scratch_ops);
 
 	if (s->asm_free_fn)
 		s->asm_free_fn(s->asm_code);
@@ -437,6 +470,57 @@ void subtilis_ir_merge_errors(subtilis_ir_section_t *s, subtilis_error_t *err)
 	s->error_ops = NULL;
 }
 
+size_t subtilis_ir_section_add_scratch(subtilis_ir_section_t *s, size_t size,
+				       subtilis_error_t *err)
+{
+	subtilis_ir_op_t **new_ops;
+	size_t new_max;
+	size_t reg;
+	subtilis_ir_operand_t op1;
+	subtilis_ir_operand_t op2;
+
+	if (s->scratch_ops_len == s->max_scratch_ops) {
+		new_max = s->max_scratch_ops + 8;
+		new_ops = realloc(s->scratch_ops, new_max * sizeof(*new_ops));
+		if (!new_ops) {
+			subtilis_error_set_oom(err);
+			return SIZE_MAX;
+		}
+		s->scratch_ops = new_ops;
+		s->max_scratch_ops = new_max;
+	}
+
+	/*
+	 * The offset is patched by subtilis_ir_section_set_scratch.
+	 */
+
+	op1.reg = SUBTILIS_IR_REG_LOCAL;
+	op2.integer = 0;
+	reg = subtilis_ir_section_add_instr(s, SUBTILIS_OP_INSTR_ADDI_I32, op1,
+					    op2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return SIZE_MAX;
+
+	if (s->in_error_handler)
+		s->scratch_ops[s->scratch_ops_len++] =
+		    s->error_ops[s->error_len - 1];
+	else
+		s->scratch_ops[s->scratch_ops_len++] = s->ops[s->len - 1];
+
+	if (size > s->scratch_size)
+		s->scratch_size = size;
+
+	return reg;
+}
+
+void subtilis_ir_section_set_scratch(subtilis_ir_section_t *s, int32_t loc)
+{
+	size_t i;
+
+	for (i = 0; i < s->scratch_ops_len; i++)
+		s->scratch_ops[i]->op.instr.operands[2].integer = loc;
+}
+
 size_t subtilis_ir_section_add_instr(subtilis_ir_section_t *s,
 				     subtilis_op_instr_type_t type,
 				     subtilis_ir_operand_t op1,
@@ -1527,13 +1611,29 @@ static const char *prv_parse_match(const char *rule,
 	return prv_parse_operands(rule, match, err);
 }
 
+static size_t prv_match_key(const subtilis_ir_op_match_t *match)
+{
+	if (match->type == SUBTILIS_OP_INSTR)
+		return (size_t)match->op.instr.type;
+	return SUBTILIS_IR_MATCH_INSTR_KEYS + (size_t)match->type;
+}
+
+static size_t prv_op_key(const subtilis_ir_op_t *op)
+{
+	if (op->type == SUBTILIS_OP_INSTR)
+		return (size_t)op->op.instr.type;
+	return SUBTILIS_IR_MATCH_INSTR_KEYS + (size_t)op->type;
+}
+
 void subtilis_ir_parse_rules(const subtilis_ir_rule_raw_t *raw,
 			     subtilis_ir_rule_t *parsed, size_t count,
 			     subtilis_error_t *err)
 {
 	size_t i;
 	size_t j;
+	size_t key;
 	const char *rule;
+	size_t last[SUBTILIS_IR_MATCH_KEYS];
 
 	for (i = 0; i < count; i++) {
 		rule = raw[i].text;
@@ -1550,9 +1650,40 @@ void subtilis_ir_parse_rules(const subtilis_ir_rule_raw_t *raw,
 		}
 		parsed[i].action = raw[i].action;
 		parsed[i].matches_count = j;
+		parsed[i].next = SIZE_MAX;
+	}
+
+	for (i = 0; i < SUBTILIS_IR_MATCH_KEYS; i++)
+		last[i] = SIZE_MAX;
+
+	for (i = 0; i < count; i++) {
+		key = prv_match_key(&parsed[i].matches[0]);
+		if (last[key] != SIZE_MAX)
+			parsed[last[key]].next = i;
+		last[key] = i;
 	}
 }
 
+void subtilis_ir_rules_init(subtilis_ir_rules_t *table,
+			    const subtilis_ir_rule_t *parsed, size_t count)
+{
+	size_t i;
+
+	table->rules = parsed;
+	table->count = count;
+
+	for (i = 0; i < SUBTILIS_IR_MATCH_KEYS; i++)
+		table->first[i] = SIZE_MAX;
+
+	/*
+	 * Walk the rules backwards so that the head of each chain is the
+	 * highest priority rule for its key.
+	 */
+
+	for (i = count; i > 0; i--)
+		table->first[prv_match_key(&parsed[i - 1].matches[0])] = i - 1;
+}
+
 #define MAX_MATCH_WILDCARDS 16
 
 struct subtilis_ir_match_pair_t_ {
@@ -1649,13 +1780,14 @@ static bool prv_process_floating_freg(subtilis_ir_match_state_t *state,
 	return state->fregs[i].value == instr_reg;
 }
 
-static bool prv_match_op(subtilis_ir_op_t *op, subtilis_ir_op_match_t *match,
+static bool prv_match_op(subtilis_ir_op_t *op,
+			 const subtilis_ir_op_match_t *match,
 			 subtilis_ir_match_state_t *state,
 			 subtilis_error_t *err)
 {
 	size_t j;
 	subtilis_ir_inst_t *instr;
-	subtilis_ir_inst_match_t *match_instr;
+	const subtilis_ir_inst_match_t *match_instr;
 	const subtilis_ir_class_info_t *details;
 
 	if (op->type != match->type)
@@ -1731,15 +1863,46 @@ static bool prv_match_op(subtilis_ir_op_t *op, subtilis_ir_op_match_t *match,
 	return true;
 }
 
-void subtilis_ir_match(subtilis_ir_section_t *s, subtilis_ir_rule_t *rules,
-		       size_t rule_count, void *user_data,
-		       subtilis_error_t *err)
+size_t subtilis_ir_match_rule(subtilis_ir_section_t *s,
+			      const subtilis_ir_rules_t *table, size_t pc,
+			      subtilis_error_t *err)
 {
-	size_t pc;
 	size_t i;
 	size_t j;
 	subtilis_ir_match_state_t state;
 	subtilis_ir_op_t *op;
+	const subtilis_ir_rule_t *rules = table->rules;
+
+	op = s->ops[pc];
+	for (i = table->first[prv_op_key(op)]; i != SIZE_MAX;
+	     i = rules[i].next) {
+		state.regs_count = 0;
+		state.fregs_count = 0;
+		state.labels_count = 0;
+		for (j = 0; j < rules[i].matches_count && pc + j < s->len;
+		     j++) {
+			op = s->ops[pc + j];
+			if (!prv_match_op(op, &rules[i].matches[j], &state,
+					  err))
+				break;
+		}
+		if (err->type != SUBTILIS_ERROR_OK)
+			return SIZE_MAX;
+		if (j == rules[i].matches_count)
+			return i;
+	}
+
+	return SIZE_MAX;
+}
+
+void subtilis_ir_match(subtilis_ir_section_t *s,
+		       const subtilis_ir_rules_t *table, void *user_data,
+		       subtilis_error_t *err)
+{
+	size_t pc;
+	size_t i;
+	subtilis_ir_op_t *op;
+	const subtilis_ir_rule_t *rules = table->rules;
 
 	if (s->in_error_handler) {
 		subtilis_error_set_assertion_failed(err);
@@ -1753,31 +1916,16 @@ void subtilis_ir_match(subtilis_ir_section_t *s, subtilis_ir_rule_t *rules,
 			pc++;
 			continue;
 		}
-		for (i = 0; i < rule_count; i++) {
-			state.regs_count = 0;
-			state.fregs_count = 0;
-			state.labels_count = 0;
-			for (j = 0;
-			     j < rules[i].matches_count && pc + j < s->len;
-			     j++) {
-				op = s->ops[pc + j];
-				if (!prv_match_op(op, &rules[i].matches[j],
-						  &state, err))
-					break;
-			}
-			if (err->type != SUBTILIS_ERROR_OK)
-				return;
-			if (j == rules[i].matches_count) {
-				rules[i].action(s, pc, user_data, err);
-				if (err->type != SUBTILIS_ERROR_OK)
-					return;
-				pc += j;
-				break;
-			}
-		}
-		if (i == rule_count) {
+		i = subtilis_ir_match_rule(s, table, pc, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		if (i == SIZE_MAX) {
 			subtilis_error_set_assertion_failed(err);
 			return;
 		}
+		rules[i].action(s, pc, user_data, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		pc += rules[i].matches_count;
 	}
 }
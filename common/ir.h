@@ -1800,6 +1800,19 @@ typedef enum {
 	 */
 
 	SUBTILIS_OP_INSTR_OS_ARGS,
+
+	/*
+	 * mulhi32 r0, r1, r2
+	 *
+	 * Multiplies two 32 bit signed integers stored in registers storing
+	 * the most significant 32 bits of the 64 bit result in a third
+	 * register.
+	 *
+	 * r0 = (r1 * r2) >> 32
+	 */
+
+	SUBTILIS_OP_INSTR_MULH_I32,
+	SUBTILIS_OP_INSTR_MAX,
 } subtilis_op_instr_type_t;
 
 typedef enum {
@@ -1946,6 +1959,17 @@ struct subtilis_ir_section_t_ {
 	void *asm_code;
 	subtilis_backend_asm_free_t asm_free_fn;
 	bool proc_called;
+
+	/*
+	 * The ops that compute the address of the section's scratch
+	 * buffer, and the size of the largest buffer requested.  The
+	 * buffer isn't allocated until the whole section has been parsed.
+	 */
+
+	subtilis_ir_op_t **scratch_ops;
+	size_t scratch_ops_len;
+	size_t max_scratch_ops;
+	size_t scratch_size;
 };
 
 typedef struct subtilis_ir_section_t_ subtilis_ir_section_t;
@@ -2000,10 +2024,25 @@ typedef void (*subtilis_ir_action_t)(subtilis_ir_section_t *s, size_t start,
 
 #define SUBTILIS_IR_MAX_MATCHES 5
 
+/*
+ * Rules are dispatched on the type of their first op.  Instructions are
+ * keyed on their subtilis_op_instr_type_t and all other ops on their
+ * subtilis_op_type_t, offset by the number of instruction types.
+ */
+
+#define SUBTILIS_IR_MATCH_INSTR_KEYS SUBTILIS_OP_INSTR_MAX
+#define SUBTILIS_IR_MATCH_KEYS (SUBTILIS_IR_MATCH_INSTR_KEYS + SUBTILIS_OP_MAX)
+
+/*
+ * next is the index of the next rule, in priority order, whose first op has
+ * the same key as this rule.  It is set to SIZE_MAX for the last such rule.
+ */
+
 struct subtilis_ir_rule_t_ {
 	subtilis_ir_op_match_t matches[SUBTILIS_IR_MAX_MATCHES];
 	size_t matches_count;
 	subtilis_ir_action_t action;
+	size_t next;
 };
 
 typedef struct subtilis_ir_rule_t_ subtilis_ir_rule_t;
@@ -2015,6 +2054,22 @@ struct subtilis_ir_rule_raw_t_ {
 
 typedef struct subtilis_ir_rule_raw_t_ subtilis_ir_rule_raw_t;
 
+/*
+ * A table of parsed rules.  first[key] is the index of the highest
+ * priority rule whose first op has the given key, or SIZE_MAX if no rule
+ * starts with an op of that key.  The table is built once, when the rules
+ * are parsed, and is not modified by subtilis_ir_match, so it can be
+ * shared by multiple threads.
+ */
+
+struct subtilis_ir_rules_t_ {
+	const subtilis_ir_rule_t *rules;
+	size_t count;
+	size_t first[SUBTILIS_IR_MATCH_KEYS];
+};
+
+typedef struct subtilis_ir_rules_t_ subtilis_ir_rules_t;
+
 void subtilis_handler_list_free(subtilis_handler_list_t *list);
 subtilis_handler_list_t *
 subtilis_handler_list_truncate(subtilis_handler_list_t *list, size_t level);
@@ -2084,11 +2139,45 @@ void subtilis_ir_section_add_instr4(subtilis_ir_section_t *s,
 				    subtilis_ir_operand_t op2,
 				    subtilis_ir_operand_t op3,
 				    subtilis_error_t *err);
+/*
+ * Returns a mask with bit n set if the nth operand of an instruction of the
+ * given type is a register.  No distinction is made between integer and
+ * floating point registers.
+ */
+
+uint32_t subtilis_ir_instr_reg_operands(subtilis_op_instr_type_t type);
+
+/*
+ * As above but only floating point register operands are included in the
+ * mask.
+ */
+
+uint32_t subtilis_ir_instr_freg_operands(subtilis_op_instr_type_t type);
+
+/*
+ * Returns a mask with bit n set if the nth operand of an instruction of the
+ * given type is a label.
+ */
+
+uint32_t subtilis_ir_instr_label_operands(subtilis_op_instr_type_t type);
 void subtilis_ir_section_dump(subtilis_ir_section_t *s);
 size_t subtilis_ir_section_new_label(subtilis_ir_section_t *s);
 void subtilis_ir_section_add_label(subtilis_ir_section_t *s, size_t l,
 				   subtilis_error_t *err);
 void subtilis_ir_merge_errors(subtilis_ir_section_t *s, subtilis_error_t *err);
+
+/*
+ * Returns a register that points to a buffer of at least size bytes on
+ * the stack.  All the calls made for a section share the same buffer,
+ * so it's only valid until the next call.  The buffer's offset from
+ * SUBTILIS_IR_REG_LOCAL isn't known until it's passed to
+ * subtilis_ir_section_set_scratch, which must be called once the
+ * section has been parsed.
+ */
+
+size_t subtilis_ir_section_add_scratch(subtilis_ir_section_t *s, size_t size,
+				       subtilis_error_t *err);
+void subtilis_ir_section_set_scratch(subtilis_ir_section_t *s, int32_t loc);
 /* Ownership of args passes to thes functions */
 void subtilis_ir_section_add_call(subtilis_ir_section_t *s, size_t arg_count,
 				  subtilis_ir_arg_t *args,
@@ -2126,11 +2215,36 @@ void subtilis_ir_section_add_sys_call(subtilis_ir_section_t *s, size_t call_id,
 				      uint32_t in_mask, uint32_t out_mask,
 				      size_t flags_reg, bool flags_local,
 				      subtilis_error_t *err);
+/*
+ * Parses count raw rules into parsed, chaining together rules that start
+ * with the same op so that subtilis_ir_match only needs to try the rules
+ * that can possibly match the op at the current pc.  Rule priority is
+ * preserved.
+ */
+
 void subtilis_ir_parse_rules(const subtilis_ir_rule_raw_t *raw,
 			     subtilis_ir_rule_t *parsed, size_t count,
 			     subtilis_error_t *err);
-void subtilis_ir_match(subtilis_ir_section_t *s, subtilis_ir_rule_t *rules,
-		       size_t rule_count, void *user_data,
+
+/*
+ * Initialises table so that it indexes the count rules parsed by
+ * subtilis_ir_parse_rules.  The rules are not copied and must outlive
+ * the table.
+ */
+
+void subtilis_ir_rules_init(subtilis_ir_rules_t *table,
+			    const subtilis_ir_rule_t *parsed, size_t count);
+
+/*
+ * Returns the index of the highest priority rule in table that matches
+ * the ops of s starting at pc, or SIZE_MAX if no rule matches.
+ */
+
+size_t subtilis_ir_match_rule(subtilis_ir_section_t *s,
+			      const subtilis_ir_rules_t *table, size_t pc,
+			      subtilis_error_t *err);
+void subtilis_ir_match(subtilis_ir_section_t *s,
+		       const subtilis_ir_rules_t *table, void *user_data,
 		       subtilis_error_t *err);
 
 #endif
@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "ir_inline.h"
+
+/*
+ * A call to a procedure or function
+ *
+ * r12 = call 2 (r9)
+ *
+ * is replaced by a copy of the callee's body in which the callee's
+ * parameters are initialised from the arguments, and the callee's
+ * registers and labels are shifted past those already used by the caller.
+ * The callee's return instructions become a copy of the return value into
+ * the call's destination register followed by a jump to a label placed
+ * after the inlined body.
+ *
+ * mov r30, r9
+ * ...
+ * mov r12, r32
+ * label_20
+ *
+ * Only leaf sections without error handlers are inlined.  The only
+ * error handling code such a section can contain is the code generated
+ * for its array accesses, which is copied along with the rest of its
+ * body.  This code sets the error flag and jumps to the callee's end
+ * label, so the check of the error flag the caller makes after each call
+ * continues to work.
+ */
+
+struct subtilis_ir_inline_t_ {
+	subtilis_ir_op_t **ops;
+	bool *fresh;
+	size_t len;
+	size_t reg_base;
+	size_t freg_base;
+	size_t label_base;
+	size_t cont;
+};
+
+typedef struct subtilis_ir_inline_t_ subtilis_ir_inline_t;
+
+static bool prv_is_scalar(const subtilis_type_t *type)
+{
+	return (type->type == SUBTILIS_TYPE_INTEGER) ||
+	       (type->type == SUBTILIS_TYPE_BYTE) ||
+	       (type->type == SUBTILIS_TYPE_REAL);
+}
+
+static bool prv_is_ret(subtilis_ir_op_t *op)
+{
+	if (op->type != SUBTILIS_OP_INSTR)
+		return false;
+
+	switch (op->op.instr.type) {
+	case SUBTILIS_OP_INSTR_RET:
+	case SUBTILIS_OP_INSTR_RET_I32:
+	case SUBTILIS_OP_INSTR_RETI_I32:
+	case SUBTILIS_OP_INSTR_RET_REAL:
+	case SUBTILIS_OP_INSTR_RETI_REAL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool prv_is_nop(subtilis_ir_op_t *op)
+{
+	return (op->type == SUBTILIS_OP_INSTR) &&
+	       (op->op.instr.type == SUBTILIS_OP_INSTR_NOP);
+}
+
+/*
+ * The error handler code of a section is placed at handler_offset, after
+ * the section's return instruction.  The only code that can follow it in
+ * a section without an error handler is the code that reports bad array
+ * indices.
+ */
+
+static bool prv_handler_free(subtilis_ir_section_t *s)
+{
+	subtilis_ir_op_t *op;
+
+	if (s->handler_offset == s->len)
+		return true;
+
+	if (s->handler_offset > s->len)
+		return false;
+
+	op = s->ops[s->handler_offset];
+	return (op->type == SUBTILIS_OP_LABEL) &&
+	       (op->op.label == s->array_access);
+}
+
+/*
+ * Inlined code shares the caller's stack frame, so it must not access
+ * the local or stack registers.  Only leaf sections are inlined, so we
+ * don't need to worry about recursion.
+ */
+
+static bool prv_op_can_inline(subtilis_ir_op_t *op)
+{
+	size_t i;
+	uint32_t mask;
+	subtilis_ir_inst_t *instr;
+
+	if (op->type == SUBTILIS_OP_LABEL)
+		return true;
+
+	if (op->type != SUBTILIS_OP_INSTR)
+		return false;
+
+	instr = &op->op.instr;
+	mask = subtilis_ir_instr_reg_operands(instr->type) &
+	       ~subtilis_ir_instr_freg_operands(instr->type);
+	for (i = 0; i < SUBTILIS_IR_MAX_OP_ARGS; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+		if ((instr->operands[i].reg == SUBTILIS_IR_REG_LOCAL) ||
+		    (instr->operands[i].reg == SUBTILIS_IR_REG_STACK))
+			return false;
+	}
+
+	return true;
+}
+
+static bool prv_can_inline(subtilis_ir_section_t *s)
+{
+	size_t i;
+	const subtilis_type_fn_t *fn;
+
+	if (!s || (s->section_type != SUBTILIS_IR_SECTION_IR))
+		return false;
+
+	if ((s->len > SUBTILIS_CONFIG_INLINE_MAX_OPS) || (s->locals > 0) ||
+	    (s->cleanup_stack != SIZE_MAX))
+		return false;
+
+	fn = &s->type->type.params.fn;
+	if ((fn->ret_val->type != SUBTILIS_TYPE_VOID) &&
+	    !prv_is_scalar(fn->ret_val))
+		return false;
+
+	for (i = 0; i < fn->num_params; i++)
+		if (!prv_is_scalar(fn->params[i]))
+			return false;
+
+	if (!prv_handler_free(s))
+		return false;
+
+	for (i = 0; i < s->len; i++)
+		if (!prv_op_can_inline(s->ops[i]))
+			return false;
+
+	return true;
+}
+
+static subtilis_ir_section_t *prv_callee(subtilis_ir_prog_t *p,
+					 subtilis_ir_op_t *op,
+					 const bool *inlinable)
+{
+	size_t id;
+
+	if ((op->type != SUBTILIS_OP_CALL) &&
+	    (op->type != SUBTILIS_OP_CALLI32) &&
+	    (op->type != SUBTILIS_OP_CALLREAL))
+		return NULL;
+
+	id = op->op.call.proc_id;
+	if ((id >= p->num_sections) || !inlinable[id])
+		return NULL;
+
+	return p->sections[id];
+}
+
+/*
+ * Returns an upper bound on the number of ops needed to inline callee
+ * at the call site call.
+ */
+
+static size_t prv_inline_len(subtilis_ir_section_t *callee,
+			     subtilis_ir_op_t *call)
+{
+	size_t i;
+	size_t len = call->op.call.arg_count + 1;
+
+	for (i = 0; i < callee->len; i++) {
+		if (prv_is_nop(callee->ops[i]))
+			continue;
+		len += prv_is_ret(callee->ops[i]) ? 2 : 1;
+	}
+
+	return len;
+}
+
+static size_t prv_map_reg(subtilis_ir_inline_t *in, size_t reg)
+{
+	if (reg < SUBTILIS_IR_REG_TEMP_START)
+		return reg;
+	return reg - SUBTILIS_IR_REG_TEMP_START + in->reg_base;
+}
+
+static void prv_renumber(subtilis_ir_inline_t *in, subtilis_ir_op_t *op)
+{
+	size_t i;
+	uint32_t regs;
+	uint32_t fregs;
+	uint32_t labels;
+	subtilis_ir_inst_t *instr;
+
+	if (op->type == SUBTILIS_OP_LABEL) {
+		op->op.label += in->label_base;
+		return;
+	}
+
+	instr = &op->op.instr;
+	regs = subtilis_ir_instr_reg_operands(instr->type);
+	fregs = subtilis_ir_instr_freg_operands(instr->type);
+	labels = subtilis_ir_instr_label_operands(instr->type);
+	for (i = 0; i < SUBTILIS_IR_MAX_OP_ARGS; i++) {
+		if (labels & (1 << i))
+			instr->operands[i].label += in->label_base;
+		else if (fregs & (1 << i))
+			instr->operands[i].reg += in->freg_base;
+		else if (regs & (1 << i))
+			instr->operands[i].reg =
+			    prv_map_reg(in, instr->operands[i].reg);
+	}
+}
+
+static subtilis_ir_op_t *prv_new_op(subtilis_ir_inline_t *in,
+				    subtilis_error_t *err)
+{
+	subtilis_ir_op_t *op;
+
+	op = calloc(1, sizeof(*op));
+	if (!op) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+
+	in->fresh[in->len] = true;
+	in->ops[in->len++] = op;
+
+	return op;
+}
+
+static void prv_add_instr(subtilis_ir_inline_t *in,
+			  subtilis_op_instr_type_t type,
+			  subtilis_ir_operand_t op0, subtilis_ir_operand_t op1,
+			  subtilis_error_t *err)
+{
+	subtilis_ir_op_t *op;
+
+	op = prv_new_op(in, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	op->type = SUBTILIS_OP_INSTR;
+	op->op.instr.type = type;
+	op->op.instr.operands[0] = op0;
+	op->op.instr.operands[1] = op1;
+}
+
+static void prv_add_jmp(subtilis_ir_inline_t *in, subtilis_error_t *err)
+{
+	subtilis_ir_operand_t cont;
+	subtilis_ir_operand_t unused;
+
+	cont.label = in->cont;
+	unused.reg = 0;
+	prv_add_instr(in, SUBTILIS_OP_INSTR_JMP, cont, unused, err);
+}
+
+/*
+ * Copies the return value of the callee, if any, into the destination
+ * register of the call and jumps to the end of the inlined code.  The
+ * jump is omitted if the return is the last op of the callee.
+ */
+
+static void prv_inline_ret(subtilis_ir_inline_t *in, subtilis_ir_op_t *call,
+			   subtilis_ir_inst_t *ret, bool last,
+			   subtilis_error_t *err)
+{
+	subtilis_ir_operand_t dest;
+	subtilis_ir_operand_t src;
+	subtilis_op_instr_type_t type = SUBTILIS_OP_INSTR_NOP;
+
+	dest.reg = call->op.call.reg;
+	src = ret->operands[0];
+
+	if (call->type == SUBTILIS_OP_CALLI32) {
+		if (ret->type == SUBTILIS_OP_INSTR_RET_I32) {
+			type = SUBTILIS_OP_INSTR_MOV;
+			src.reg = prv_map_reg(in, src.reg);
+		} else if (ret->type == SUBTILIS_OP_INSTR_RETI_I32) {
+			type = SUBTILIS_OP_INSTR_MOVI_I32;
+		}
+	} else if (call->type == SUBTILIS_OP_CALLREAL) {
+		if (ret->type == SUBTILIS_OP_INSTR_RET_REAL) {
+			type = SUBTILIS_OP_INSTR_MOVFP;
+			src.reg += in->freg_base;
+		} else if (ret->type == SUBTILIS_OP_INSTR_RETI_REAL) {
+			type = SUBTILIS_OP_INSTR_MOVI_REAL;
+		}
+	}
+
+	if (type != SUBTILIS_OP_INSTR_NOP) {
+		prv_add_instr(in, type, dest, src, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	if (!last)
+		prv_add_jmp(in, err);
+}
+
+static void prv_inline_call(subtilis_ir_inline_t *in, subtilis_ir_section_t *s,
+			    subtilis_ir_section_t *callee,
+			    subtilis_ir_op_t *call, subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_ir_op_t *op;
+	subtilis_ir_operand_t dest;
+	subtilis_ir_operand_t src;
+	subtilis_ir_arg_t *arg;
+	size_t int_args = 0;
+	size_t real_args = 0;
+
+	in->reg_base = s->reg_counter;
+	s->reg_counter += callee->reg_counter - SUBTILIS_IR_REG_TEMP_START;
+	in->freg_base = s->freg_counter;
+	s->freg_counter += callee->freg_counter;
+	in->label_base = s->label_counter;
+	s->label_counter += callee->label_counter;
+	in->cont = s->label_counter++;
+
+	/*
+	 * Integer parameters are passed in the registers following
+	 * SUBTILIS_IR_REG_TEMP_START and floating point parameters in the
+	 * first floating point registers, in the order they appear in the
+	 * parameter list.
+	 */
+
+	for (i = 0; i < call->op.call.arg_count; i++) {
+		arg = &call->op.call.args[i];
+		src.reg = arg->reg;
+		if (arg->type == SUBTILIS_IR_REG_TYPE_REAL) {
+			dest.reg = in->freg_base + real_args++;
+			prv_add_instr(in, SUBTILIS_OP_INSTR_MOVFP, dest, src,
+				      err);
+		} else {
+			dest.reg = prv_map_reg(
+			    in, SUBTILIS_IR_REG_TEMP_START + int_args++);
+			prv_add_instr(in, SUBTILIS_OP_INSTR_MOV, dest, src,
+				      err);
+		}
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	for (i = 0; i < callee->len; i++) {
+		if (prv_is_nop(callee->ops[i]))
+			continue;
+
+		if (prv_is_ret(callee->ops[i])) {
+			prv_inline_ret(in, call, &callee->ops[i]->op.instr,
+				       i + 1 == callee->len, err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				return;
+			continue;
+		}
+
+		op = prv_new_op(in, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		*op = *callee->ops[i];
+		prv_renumber(in, op);
+	}
+
+	op = prv_new_op(in, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	op->type = SUBTILIS_OP_LABEL;
+	op->op.label = in->cont;
+}
+
+static void prv_inline_section(subtilis_ir_prog_t *p, subtilis_ir_section_t *s,
+			       const bool *inlinable, size_t *budget,
+			       subtilis_error_t *err)
+{
+	size_t i;
+	size_t len;
+	size_t max_len;
+	subtilis_ir_op_t *op;
+	subtilis_ir_inline_t in;
+	subtilis_ir_section_t **callees;
+	bool found = false;
+
+	callees = calloc(s->len, sizeof(*callees));
+	if (!callees) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	max_len = 0;
+	for (i = 0; i < s->len; i++) {
+		op = s->ops[i];
+		callees[i] = prv_callee(p, op, inlinable);
+		if (callees[i]) {
+			len = prv_inline_len(callees[i], op);
+			if (len - 1 <= *budget) {
+				*budget -= len - 1;
+				max_len += len;
+				found = true;
+				continue;
+			}
+			callees[i] = NULL;
+		}
+		max_len++;
+	}
+
+	if (!found)
+		goto cleanup;
+
+	memset(&in, 0, sizeof(in));
+	in.ops = malloc(max_len * sizeof(*in.ops));
+	in.fresh = calloc(max_len, sizeof(*in.fresh));
+	if (!in.ops || !in.fresh) {
+		subtilis_error_set_oom(err);
+		goto cleanup_ops;
+	}
+
+	for (i = 0; i < s->len; i++) {
+		if (!callees[i]) {
+			in.ops[in.len++] = s->ops[i];
+			continue;
+		}
+		prv_inline_call(&in, s, callees[i], s->ops[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup_ops;
+	}
+
+	for (i = 0; i < s->len; i++) {
+		if (!callees[i])
+			continue;
+		free(s->ops[i]->op.call.args);
+		free(s->ops[i]);
+	}
+
+	free(s->ops);
+	s->ops = in.ops;
+	s->len = in.len;
+	s->max_len = max_len;
+	in.ops = NULL;
+
+cleanup_ops:
+
+	if (in.ops)
+		for (i = 0; i < in.len; i++)
+			if (in.fresh[i])
+				free(in.ops[i]);
+	free(in.fresh);
+	free(in.ops);
+
+cleanup:
+
+	free(callees);
+}
+
+void subtilis_ir_inline_prog(subtilis_ir_prog_t *p, subtilis_error_t *err)
+{
+	size_t i;
+	bool *inlinable;
+	size_t budget = SUBTILIS_CONFIG_INLINE_BUDGET;
+
+	if (p->num_sections == 0)
+		return;
+
+	inlinable = malloc(p->num_sections * sizeof(*inlinable));
+	if (!inlinable) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < p->num_sections; i++)
+		inlinable[i] = prv_can_inline(p->sections[i]);
+
+	for (i = 0; i < p->num_sections && budget > 0; i++) {
+		if (!p->sections[i] ||
+		    (p->sections[i]->section_type != SUBTILIS_IR_SECTION_IR))
+			continue;
+		prv_inline_section(p, p->sections[i], inlinable, &budget, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			break;
+	}
+
+	free(inlinable);
+}
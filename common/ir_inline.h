@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBTILIS_IR_INLINE_H
+#define __SUBTILIS_IR_INLINE_H
+
+#include "ir.h"
+
+/*
+ * Copies the bodies of small procedures and functions into the sections
+ * that call them, replacing the calls.  Only leaf sections that have no
+ * error handlers, no stack frame and that take and return scalar values
+ * are inlined.  The callee's registers and labels are renumbered so that
+ * they don't clash with those of the caller.
+ *
+ * A section is only considered if it contains no more than
+ * SUBTILIS_CONFIG_INLINE_MAX_OPS ops, and inlining stops once
+ * SUBTILIS_CONFIG_INLINE_BUDGET ops have been added to the program.
+ * The callee sections are left in the program as they may still be
+ * called indirectly or from call sites that were not inlined.
+ *
+ * Needs to be called after the program has been parsed.
+ */
+
+void subtilis_ir_inline_prog(subtilis_ir_prog_t *p, subtilis_error_t *err);
+
+#endif
@@ -0,0 +1,1344 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir_inline.h"
+#include "ir_opt.h"
+
+/*
+ * The IR generated by the parser is not in SSA form.  Registers that hold
+ * variables are assigned many times and may be live across basic blocks,
+ * so the copy propagation and constant folding passes only track the
+ * contents of registers within a basic block.  Any label, branch or
+ * instruction the passes don't understand invalidates what they know.
+ * Dead code elimination works on the section as a whole, removing side
+ * effect free instructions whose results are never read anywhere in the
+ * section.
+ *
+ * Instructions are never moved.  Instructions that are removed are first
+ * replaced with NOPs and the NOPs are stripped from the section once all
+ * the passes have run.
+ */
+
+#define SUBTILIS_IR_OPT_MAX_ROUNDS 4
+
+/*
+ * Something we know about the contents of a register.  Each definition
+ * of a register, and the start of each basic block, is assigned a new
+ * stamp.  A fact is valid if its stamp matches the stamp of the last
+ * definition of its register and it was recorded in the current block.
+ * A copy fact also requires that the source register has not been
+ * redefined since the copy was made.
+ */
+
+struct subtilis_ir_opt_fact_t_ {
+	size_t stamp;
+	bool is_const;
+	subtilis_ir_operand_t value;
+	size_t src;
+	size_t src_stamp;
+};
+
+typedef struct subtilis_ir_opt_fact_t_ subtilis_ir_opt_fact_t;
+
+struct subtilis_ir_opt_regs_t_ {
+	size_t count;
+	size_t first;
+	size_t *defs;
+	size_t *uses;
+	size_t *writes;
+	size_t *marks;
+	subtilis_ir_opt_fact_t *facts;
+};
+
+typedef struct subtilis_ir_opt_regs_t_ subtilis_ir_opt_regs_t;
+
+struct subtilis_ir_opt_t_ {
+	subtilis_ir_opt_regs_t regs;
+	subtilis_ir_opt_regs_t fregs;
+	size_t stamp;
+	size_t block;
+	size_t changes;
+};
+
+typedef struct subtilis_ir_opt_t_ subtilis_ir_opt_t;
+
+typedef void (*subtilis_ir_opt_instr_fn_t)(subtilis_ir_opt_t *o,
+					   subtilis_ir_inst_t *instr,
+					   const char *sig);
+
+typedef void (*subtilis_ir_opt_pass_fn_t)(subtilis_ir_opt_t *o,
+					  subtilis_ir_section_t *s);
+
+struct subtilis_ir_opt_pass_t_ {
+	const char *name;
+	uint32_t level;
+	subtilis_ir_opt_pass_fn_t fn;
+};
+
+typedef struct subtilis_ir_opt_pass_t_ subtilis_ir_opt_pass_t;
+
+/*
+ * Maps an instruction that takes two register operands onto its
+ * immediate form.  imm is used when the second operand is constant and
+ * swapped when the first operand is constant, in which case the register
+ * operands are exchanged.  swapped is SUBTILIS_OP_INSTR_NOP if there is
+ * no such form.
+ */
+
+struct subtilis_ir_opt_imm_t_ {
+	subtilis_op_instr_type_t type;
+	subtilis_op_instr_type_t imm;
+	subtilis_op_instr_type_t swapped;
+};
+
+typedef struct subtilis_ir_opt_imm_t_ subtilis_ir_opt_imm_t;
+
+/* clang-format off */
+static const subtilis_ir_opt_imm_t prv_imm_forms[] = {
+	{ SUBTILIS_OP_INSTR_ADD_I32, SUBTILIS_OP_INSTR_ADDI_I32,
+	  SUBTILIS_OP_INSTR_ADDI_I32 },
+	{ SUBTILIS_OP_INSTR_SUB_I32, SUBTILIS_OP_INSTR_SUBI_I32,
+	  SUBTILIS_OP_INSTR_RSUBI_I32 },
+	{ SUBTILIS_OP_INSTR_MUL_I32, SUBTILIS_OP_INSTR_MULI_I32,
+	  SUBTILIS_OP_INSTR_MULI_I32 },
+	{ SUBTILIS_OP_INSTR_AND_I32, SUBTILIS_OP_INSTR_ANDI_I32,
+	  SUBTILIS_OP_INSTR_ANDI_I32 },
+	{ SUBTILIS_OP_INSTR_OR_I32, SUBTILIS_OP_INSTR_ORI_I32,
+	  SUBTILIS_OP_INSTR_ORI_I32 },
+	{ SUBTILIS_OP_INSTR_EOR_I32, SUBTILIS_OP_INSTR_EORI_I32,
+	  SUBTILIS_OP_INSTR_EORI_I32 },
+	{ SUBTILIS_OP_INSTR_EQ_I32, SUBTILIS_OP_INSTR_EQI_I32,
+	  SUBTILIS_OP_INSTR_EQI_I32 },
+	{ SUBTILIS_OP_INSTR_NEQ_I32, SUBTILIS_OP_INSTR_NEQI_I32,
+	  SUBTILIS_OP_INSTR_NEQI_I32 },
+	{ SUBTILIS_OP_INSTR_GT_I32, SUBTILIS_OP_INSTR_GTI_I32,
+	  SUBTILIS_OP_INSTR_LTI_I32 },
+	{ SUBTILIS_OP_INSTR_LTE_I32, SUBTILIS_OP_INSTR_LTEI_I32,
+	  SUBTILIS_OP_INSTR_GTEI_I32 },
+	{ SUBTILIS_OP_INSTR_LT_I32, SUBTILIS_OP_INSTR_LTI_I32,
+	  SUBTILIS_OP_INSTR_GTI_I32 },
+	{ SUBTILIS_OP_INSTR_GTE_I32, SUBTILIS_OP_INSTR_GTEI_I32,
+	  SUBTILIS_OP_INSTR_LTEI_I32 },
+	{ SUBTILIS_OP_INSTR_LSL_I32, SUBTILIS_OP_INSTR_LSLI_I32,
+	  SUBTILIS_OP_INSTR_NOP },
+	{ SUBTILIS_OP_INSTR_LSR_I32, SUBTILIS_OP_INSTR_LSRI_I32,
+	  SUBTILIS_OP_INSTR_NOP },
+	{ SUBTILIS_OP_INSTR_ASR_I32, SUBTILIS_OP_INSTR_ASRI_I32,
+	  SUBTILIS_OP_INSTR_NOP },
+	{ SUBTILIS_OP_INSTR_ADD_REAL, SUBTILIS_OP_INSTR_ADDI_REAL,
+	  SUBTILIS_OP_INSTR_ADDI_REAL },
+	{ SUBTILIS_OP_INSTR_SUB_REAL, SUBTILIS_OP_INSTR_SUBI_REAL,
+	  SUBTILIS_OP_INSTR_RSUBI_REAL },
+	{ SUBTILIS_OP_INSTR_MUL_REAL, SUBTILIS_OP_INSTR_MULI_REAL,
+	  SUBTILIS_OP_INSTR_MULI_REAL },
+	{ SUBTILIS_OP_INSTR_EQ_REAL, SUBTILIS_OP_INSTR_EQI_REAL,
+	  SUBTILIS_OP_INSTR_EQI_REAL },
+	{ SUBTILIS_OP_INSTR_NEQ_REAL, SUBTILIS_OP_INSTR_NEQI_REAL,
+	  SUBTILIS_OP_INSTR_NEQI_REAL },
+	{ SUBTILIS_OP_INSTR_GT_REAL, SUBTILIS_OP_INSTR_GTI_REAL,
+	  SUBTILIS_OP_INSTR_LTI_REAL },
+	{ SUBTILIS_OP_INSTR_LTE_REAL, SUBTILIS_OP_INSTR_LTEI_REAL,
+	  SUBTILIS_OP_INSTR_GTEI_REAL },
+	{ SUBTILIS_OP_INSTR_LT_REAL, SUBTILIS_OP_INSTR_LTI_REAL,
+	  SUBTILIS_OP_INSTR_GTI_REAL },
+	{ SUBTILIS_OP_INSTR_GTE_REAL, SUBTILIS_OP_INSTR_GTEI_REAL,
+	  SUBTILIS_OP_INSTR_LTEI_REAL },
+};
+
+/* clang-format on */
+
+/*
+ * Returns a string describing the operands of the instructions understood
+ * by the passes, or NULL for all other instructions.  Each character
+ * describes one operand.  'd' and 'u' denote integer registers that are
+ * written and read, 'D' and 'U' floating point registers that are written
+ * and read, and '-' operands that are not registers.  pure is set to true
+ * if the instruction has no effect other than writing its destination
+ * register, and so can be removed if that register is never read.
+ */
+
+static const char *prv_signature(subtilis_op_instr_type_t type, bool *pure)
+{
+	*pure = true;
+
+	switch (type) {
+	case SUBTILIS_OP_INSTR_ADD_I32:
+	case SUBTILIS_OP_INSTR_SUB_I32:
+	case SUBTILIS_OP_INSTR_MUL_I32:
+	case SUBTILIS_OP_INSTR_MULH_I32:
+	case SUBTILIS_OP_INSTR_AND_I32:
+	case SUBTILIS_OP_INSTR_OR_I32:
+	case SUBTILIS_OP_INSTR_EOR_I32:
+	case SUBTILIS_OP_INSTR_EQ_I32:
+	case SUBTILIS_OP_INSTR_NEQ_I32:
+	case SUBTILIS_OP_INSTR_GT_I32:
+	case SUBTILIS_OP_INSTR_LTE_I32:
+	case SUBTILIS_OP_INSTR_LT_I32:
+	case SUBTILIS_OP_INSTR_GTE_I32:
+	case SUBTILIS_OP_INSTR_LSL_I32:
+	case SUBTILIS_OP_INSTR_LSR_I32:
+	case SUBTILIS_OP_INSTR_ASR_I32:
+		return "duu";
+	case SUBTILIS_OP_INSTR_ADDI_I32:
+	case SUBTILIS_OP_INSTR_SUBI_I32:
+	case SUBTILIS_OP_INSTR_MULI_I32:
+	case SUBTILIS_OP_INSTR_RSUBI_I32:
+	case SUBTILIS_OP_INSTR_ANDI_I32:
+	case SUBTILIS_OP_INSTR_ORI_I32:
+	case SUBTILIS_OP_INSTR_EORI_I32:
+	case SUBTILIS_OP_INSTR_EQI_I32:
+	case SUBTILIS_OP_INSTR_NEQI_I32:
+	case SUBTILIS_OP_INSTR_GTI_I32:
+	case SUBTILIS_OP_INSTR_LTEI_I32:
+	case SUBTILIS_OP_INSTR_LTI_I32:
+	case SUBTILIS_OP_INSTR_GTEI_I32:
+	case SUBTILIS_OP_INSTR_LSLI_I32:
+	case SUBTILIS_OP_INSTR_LSRI_I32:
+	case SUBTILIS_OP_INSTR_ASRI_I32:
+	case SUBTILIS_OP_INSTR_LOADO_I8:
+	case SUBTILIS_OP_INSTR_LOADO_I32:
+		return "du-";
+	case SUBTILIS_OP_INSTR_MOVI_I32:
+	case SUBTILIS_OP_INSTR_LCA:
+	case SUBTILIS_OP_INSTR_GET_PROC_ADDR:
+		return "d-";
+	case SUBTILIS_OP_INSTR_MOV:
+	case SUBTILIS_OP_INSTR_NOT_I32:
+	case SUBTILIS_OP_INSTR_SIGNX_8_TO_32:
+	case SUBTILIS_OP_INSTR_LOAD_I32:
+		return "du";
+	case SUBTILIS_OP_INSTR_ADD_REAL:
+	case SUBTILIS_OP_INSTR_SUB_REAL:
+	case SUBTILIS_OP_INSTR_MUL_REAL:
+		return "DUU";
+	case SUBTILIS_OP_INSTR_ADDI_REAL:
+	case SUBTILIS_OP_INSTR_SUBI_REAL:
+	case SUBTILIS_OP_INSTR_MULI_REAL:
+	case SUBTILIS_OP_INSTR_RSUBI_REAL:
+		return "DU-";
+	case SUBTILIS_OP_INSTR_EQ_REAL:
+	case SUBTILIS_OP_INSTR_NEQ_REAL:
+	case SUBTILIS_OP_INSTR_GT_REAL:
+	case SUBTILIS_OP_INSTR_LTE_REAL:
+	case SUBTILIS_OP_INSTR_LT_REAL:
+	case SUBTILIS_OP_INSTR_GTE_REAL:
+		return "dUU";
+	case SUBTILIS_OP_INSTR_EQI_REAL:
+	case SUBTILIS_OP_INSTR_NEQI_REAL:
+	case SUBTILIS_OP_INSTR_GTI_REAL:
+	case SUBTILIS_OP_INSTR_LTEI_REAL:
+	case SUBTILIS_OP_INSTR_LTI_REAL:
+	case SUBTILIS_OP_INSTR_GTEI_REAL:
+		return "dU-";
+	case SUBTILIS_OP_INSTR_MOVI_REAL:
+		return "D-";
+	case SUBTILIS_OP_INSTR_MOVFP:
+	case SUBTILIS_OP_INSTR_ABSR:
+		return "DU";
+	case SUBTILIS_OP_INSTR_MOV_I32_FP:
+	case SUBTILIS_OP_INSTR_MOV_I8_FP:
+		return "Du";
+	case SUBTILIS_OP_INSTR_MOV_FP_I32:
+	case SUBTILIS_OP_INSTR_MOV_FPRD_I32:
+		return "dU";
+	case SUBTILIS_OP_INSTR_LOADO_REAL:
+		return "Du-";
+	default:
+		break;
+	}
+
+	*pure = false;
+
+	switch (type) {
+	case SUBTILIS_OP_INSTR_STOREO_I8:
+	case SUBTILIS_OP_INSTR_STOREO_I32:
+		return "uu-";
+	case SUBTILIS_OP_INSTR_STOREO_REAL:
+		return "Uu-";
+	case SUBTILIS_OP_INSTR_STORE_I32:
+	case SUBTILIS_OP_INSTR_PRINT_STR:
+		return "uu";
+	case SUBTILIS_OP_INSTR_I32TODEC:
+	case SUBTILIS_OP_INSTR_I32TOHEX:
+		return "duu";
+	case SUBTILIS_OP_INSTR_REALTODEC:
+		return "dUu";
+	case SUBTILIS_OP_INSTR_RET_I32:
+		return "u";
+	case SUBTILIS_OP_INSTR_RET_REAL:
+		return "U";
+	default:
+		return NULL;
+	}
+}
+
+static bool prv_ends_block(subtilis_ir_op_t *op)
+{
+	if (op->type == SUBTILIS_OP_LABEL)
+		return true;
+
+	if (op->type != SUBTILIS_OP_INSTR)
+		return false;
+
+	switch (op->op.instr.type) {
+	case SUBTILIS_OP_INSTR_JMPC:
+	case SUBTILIS_OP_INSTR_JMPC_NF:
+	case SUBTILIS_OP_INSTR_JMP:
+	case SUBTILIS_OP_INSTR_RET:
+	case SUBTILIS_OP_INSTR_RET_I32:
+	case SUBTILIS_OP_INSTR_RETI_I32:
+	case SUBTILIS_OP_INSTR_RET_REAL:
+	case SUBTILIS_OP_INSTR_RETI_REAL:
+	case SUBTILIS_OP_INSTR_END:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool prv_is_call(subtilis_ir_op_t *op)
+{
+	return (op->type == SUBTILIS_OP_CALL) ||
+	       (op->type == SUBTILIS_OP_CALLI32) ||
+	       (op->type == SUBTILIS_OP_CALLREAL) ||
+	       (op->type == SUBTILIS_OP_CALL_PTR) ||
+	       (op->type == SUBTILIS_OP_CALLI32_PTR) ||
+	       (op->type == SUBTILIS_OP_CALLREAL_PTR);
+}
+
+static bool prv_is_call_ptr(subtilis_ir_op_t *op)
+{
+	return (op->type == SUBTILIS_OP_CALL_PTR) ||
+	       (op->type == SUBTILIS_OP_CALLI32_PTR) ||
+	       (op->type == SUBTILIS_OP_CALLREAL_PTR);
+}
+
+static bool prv_is_nop(subtilis_ir_op_t *op)
+{
+	return (op->type == SUBTILIS_OP_INSTR) &&
+	       (op->op.instr.type == SUBTILIS_OP_INSTR_NOP);
+}
+
+static void prv_regs_init(subtilis_ir_opt_regs_t *regs, size_t count,
+			  size_t first, subtilis_error_t *err)
+{
+	regs->count = count;
+	regs->first = first;
+	regs->defs = calloc(count + 1, sizeof(*regs->defs));
+	regs->uses = calloc(count + 1, sizeof(*regs->uses));
+	regs->writes = calloc(count + 1, sizeof(*regs->writes));
+	regs->marks = calloc(count + 1, sizeof(*regs->marks));
+	regs->facts = calloc(count + 1, sizeof(*regs->facts));
+	if (!regs->defs || !regs->uses || !regs->writes || !regs->marks ||
+	    !regs->facts)
+		subtilis_error_set_oom(err);
+}
+
+static void prv_regs_free(subtilis_ir_opt_regs_t *regs)
+{
+	free(regs->facts);
+	free(regs->marks);
+	free(regs->writes);
+	free(regs->uses);
+	free(regs->defs);
+}
+
+static void prv_regs_reset(subtilis_ir_opt_regs_t *regs)
+{
+	memset(regs->defs, 0, (regs->count + 1) * sizeof(*regs->defs));
+	memset(regs->facts, 0, (regs->count + 1) * sizeof(*regs->facts));
+}
+
+static void prv_reset(subtilis_ir_opt_t *o)
+{
+	prv_regs_reset(&o->regs);
+	prv_regs_reset(&o->fregs);
+	o->stamp = 0;
+	o->block = 0;
+}
+
+static void prv_new_block(subtilis_ir_opt_t *o)
+{
+	o->block = ++o->stamp;
+}
+
+static void prv_define(subtilis_ir_opt_t *o, subtilis_ir_opt_regs_t *regs,
+		       size_t reg)
+{
+	if (reg < regs->count)
+		regs->defs[reg] = ++o->stamp;
+}
+
+/*
+ * Returns the fact we know about reg, or NULL if we don't know anything
+ * about it.  Facts are never recorded for the fixed registers.
+ */
+
+static subtilis_ir_opt_fact_t *prv_fact(subtilis_ir_opt_t *o,
+					subtilis_ir_opt_regs_t *regs,
+					size_t reg)
+{
+	subtilis_ir_opt_fact_t *fact;
+
+	if (reg < regs->first || reg >= regs->count)
+		return NULL;
+
+	fact = &regs->facts[reg];
+	if ((fact->stamp <= o->block) || (fact->stamp != regs->defs[reg]))
+		return NULL;
+
+	return fact;
+}
+
+static subtilis_ir_opt_fact_t *prv_new_fact(subtilis_ir_opt_regs_t *regs,
+					    size_t reg)
+{
+	subtilis_ir_opt_fact_t *fact;
+
+	if (reg < regs->first || reg >= regs->count)
+		return NULL;
+
+	fact = &regs->facts[reg];
+	fact->stamp = regs->defs[reg];
+	fact->is_const = false;
+
+	return fact;
+}
+
+static bool prv_const_i32(subtilis_ir_opt_t *o, size_t reg, int32_t *val)
+{
+	subtilis_ir_opt_fact_t *fact = prv_fact(o, &o->regs, reg);
+
+	if (!fact || !fact->is_const)
+		return false;
+	*val = fact->value.integer;
+	return true;
+}
+
+static bool prv_const_real(subtilis_ir_opt_t *o, size_t reg, double *val)
+{
+	subtilis_ir_opt_fact_t *fact = prv_fact(o, &o->fregs, reg);
+
+	if (!fact || !fact->is_const)
+		return false;
+	*val = fact->value.real;
+	return true;
+}
+
+/*
+ * Invalidates everything we know about the register operands of an
+ * instruction the passes don't understand.  As we don't know which of its
+ * operands are integer registers and which are floating point registers,
+ * each register operand is assumed to be both.
+ */
+
+static void prv_clobber_instr(subtilis_ir_opt_t *o, subtilis_ir_inst_t *instr)
+{
+	size_t i;
+	uint32_t mask = subtilis_ir_instr_reg_operands(instr->type);
+
+	for (i = 0; i < SUBTILIS_IR_MAX_OP_ARGS; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+		prv_define(o, &o->regs, instr->operands[i].reg);
+		prv_define(o, &o->fregs, instr->operands[i].reg);
+	}
+}
+
+static subtilis_ir_opt_regs_t *prv_arg_regs(subtilis_ir_opt_t *o,
+					    subtilis_ir_arg_t *arg)
+{
+	return (arg->type == SUBTILIS_IR_REG_TYPE_REAL) ? &o->fregs : &o->regs;
+}
+
+static void prv_copy_use(subtilis_ir_opt_t *o, subtilis_ir_opt_regs_t *regs,
+			 size_t *reg)
+{
+	subtilis_ir_opt_fact_t *fact = prv_fact(o, regs, *reg);
+
+	if (!fact || fact->is_const)
+		return;
+
+	if (regs->defs[fact->src] != fact->src_stamp)
+		return;
+
+	*reg = fact->src;
+	o->changes++;
+}
+
+static void prv_copy_call(subtilis_ir_opt_t *o, subtilis_ir_op_t *op)
+{
+	size_t i;
+	subtilis_ir_call_t *call = &op->op.call;
+
+	for (i = 0; i < call->arg_count; i++)
+		prv_copy_use(o, prv_arg_regs(o, &call->args[i]),
+			     &call->args[i].reg);
+
+	if (prv_is_call_ptr(op))
+		prv_copy_use(o, &o->regs, &call->proc_id);
+}
+
+static void prv_copy_sys_call(subtilis_ir_opt_t *o, subtilis_ir_op_t *op)
+{
+	size_t i;
+	subtilis_ir_sys_call_t *sys_call = &op->op.sys_call;
+
+	for (i = 0; i < 16; i++)
+		if (sys_call->in_mask & (1 << i))
+			prv_copy_use(o, &o->regs, &sys_call->in_regs[i]);
+
+	for (i = 0; i < 16; i++)
+		if ((sys_call->out_mask & (1 << i)) &&
+		    !sys_call->out_regs[i].local)
+			prv_copy_use(o, &o->regs, &sys_call->out_regs[i].reg);
+
+	if ((sys_call->flags_reg != SIZE_MAX) && !sys_call->flags_local)
+		prv_copy_use(o, &o->regs, &sys_call->flags_reg);
+}
+
+static void prv_define_call(subtilis_ir_opt_t *o, subtilis_ir_op_t *op)
+{
+	if ((op->type == SUBTILIS_OP_CALLI32) ||
+	    (op->type == SUBTILIS_OP_CALLI32_PTR))
+		prv_define(o, &o->regs, op->op.call.reg);
+	else if ((op->type == SUBTILIS_OP_CALLREAL) ||
+		 (op->type == SUBTILIS_OP_CALLREAL_PTR))
+		prv_define(o, &o->fregs, op->op.call.reg);
+}
+
+static void prv_define_sys_call(subtilis_ir_opt_t *o, subtilis_ir_op_t *op)
+{
+	size_t i;
+	subtilis_ir_sys_call_t *sys_call = &op->op.sys_call;
+
+	for (i = 0; i < 16; i++)
+		if ((sys_call->out_mask & (1 << i)) &&
+		    sys_call->out_regs[i].local)
+			prv_define(o, &o->regs, sys_call->out_regs[i].reg);
+
+	if ((sys_call->flags_reg != SIZE_MAX) && sys_call->flags_local)
+		prv_define(o, &o->regs, sys_call->flags_reg);
+}
+
+static void prv_define_instr(subtilis_ir_opt_t *o, subtilis_ir_inst_t *instr,
+			     const char *sig)
+{
+	size_t i;
+
+	for (i = 0; sig[i]; i++) {
+		if (sig[i] == 'd')
+			prv_define(o, &o->regs, instr->operands[i].reg);
+		else if (sig[i] == 'D')
+			prv_define(o, &o->fregs, instr->operands[i].reg);
+	}
+}
+
+/*
+ * Walks the ops of a section in order, calling fn for each instruction
+ * understood by the passes and keeping track of basic blocks and register
+ * definitions for everything else.  If copy is true, the register
+ * arguments of calls and system calls are rewritten to use the sources
+ * of any copies made earlier in the block.
+ */
+
+static void prv_walk(subtilis_ir_opt_t *o, subtilis_ir_section_t *s,
+		     subtilis_ir_opt_instr_fn_t fn, bool copy)
+{
+	size_t i;
+	bool pure;
+	const char *sig;
+	subtilis_ir_op_t *op;
+
+	prv_reset(o);
+	prv_new_block(o);
+
+	for (i = 0; i < s->len; i++) {
+		op = s->ops[i];
+		if (op->type == SUBTILIS_OP_INSTR) {
+			sig = prv_signature(op->op.instr.type, &pure);
+			if (sig)
+				fn(o, &op->op.instr, sig);
+			else
+				prv_clobber_instr(o, &op->op.instr);
+		} else if (prv_is_call(op)) {
+			if (copy)
+				prv_copy_call(o, op);
+			prv_define_call(o, op);
+		} else if (op->type == SUBTILIS_OP_SYS_CALL) {
+			if (copy)
+				prv_copy_sys_call(o, op);
+			prv_define_sys_call(o, op);
+		}
+
+		if (prv_ends_block(op) || (op->type == SUBTILIS_OP_PHI))
+			prv_new_block(o);
+	}
+}
+
+static void prv_copy_instr(subtilis_ir_opt_t *o, subtilis_ir_inst_t *instr,
+			   const char *sig)
+{
+	size_t i;
+	size_t src;
+	size_t dest;
+	subtilis_ir_opt_fact_t *fact;
+	subtilis_ir_opt_regs_t *regs;
+
+	for (i = 0; sig[i]; i++) {
+		if (sig[i] == 'u')
+			prv_copy_use(o, &o->regs, &instr->operands[i].reg);
+		else if (sig[i] == 'U')
+			prv_copy_use(o, &o->fregs, &instr->operands[i].reg);
+	}
+
+	if ((instr->type != SUBTILIS_OP_INSTR_MOV) &&
+	    (instr->type != SUBTILIS_OP_INSTR_MOVFP)) {
+		prv_define_instr(o, instr, sig);
+		return;
+	}
+
+	dest = instr->operands[0].reg;
+	src = instr->operands[1].reg;
+	if (dest == src) {
+		instr->type = SUBTILIS_OP_INSTR_NOP;
+		o->changes++;
+		return;
+	}
+
+	regs = (instr->type == SUBTILIS_OP_INSTR_MOV) ? &o->regs : &o->fregs;
+	prv_define(o, regs, dest);
+	if (src < regs->first || src >= regs->count)
+		return;
+
+	fact = prv_new_fact(regs, dest);
+	if (!fact)
+		return;
+	fact->src = src;
+	fact->src_stamp = regs->defs[src];
+}
+
+static void prv_copy_prop(subtilis_ir_opt_t *o, subtilis_ir_section_t *s)
+{
+	prv_walk(o, s, prv_copy_instr, true);
+}
+
+static bool prv_eval_i32(subtilis_op_instr_type_t type, int32_t a, int32_t b,
+			 int32_t *res)
+{
+	uint32_t ua = (uint32_t)a;
+	uint32_t ub = (uint32_t)b;
+
+	switch (type) {
+	case SUBTILIS_OP_INSTR_ADD_I32:
+	case SUBTILIS_OP_INSTR_ADDI_I32:
+		*res = (int32_t)(ua + ub);
+		return true;
+	case SUBTILIS_OP_INSTR_SUB_I32:
+	case SUBTILIS_OP_INSTR_SUBI_I32:
+		*res = (int32_t)(ua - ub);
+		return true;
+	case SUBTILIS_OP_INSTR_RSUBI_I32:
+		*res = (int32_t)(ub - ua);
+		return true;
+	case SUBTILIS_OP_INSTR_MUL_I32:
+	case SUBTILIS_OP_INSTR_MULI_I32:
+		*res = (int32_t)(ua * ub);
+		return true;
+	case SUBTILIS_OP_INSTR_AND_I32:
+	case SUBTILIS_OP_INSTR_ANDI_I32:
+		*res = a & b;
+		return true;
+	case SUBTILIS_OP_INSTR_OR_I32:
+	case SUBTILIS_OP_INSTR_ORI_I32:
+		*res = a | b;
+		return true;
+	case SUBTILIS_OP_INSTR_EOR_I32:
+	case SUBTILIS_OP_INSTR_EORI_I32:
+		*res = a ^ b;
+		return true;
+	case SUBTILIS_OP_INSTR_EQ_I32:
+	case SUBTILIS_OP_INSTR_EQI_I32:
+		*res = a == b ? -1 : 0;
+		return true;
+	case SUBTILIS_OP_INSTR_NEQ_I32:
+	case SUBTILIS_OP_INSTR_NEQI_I32:
+		*res = a != b ? -1 : 0;
+		return true;
+	case SUBTILIS_OP_INSTR_GT_I32:
+	case SUBTILIS_OP_INSTR_GTI_I32:
+		*res = a > b ? -1 : 0;
+		return true;
+	case SUBTILIS_OP_INSTR_LTE_I32:
+	case SUBTILIS_OP_INSTR_LTEI_I32:
+		*res = a <= b ? -1 : 0;
+		return true;
+	case SUBTILIS_OP_INSTR_LT_I32:
+	case SUBTILIS_OP_INSTR_LTI_I32:
+		*res = a < b ? -1 : 0;
+		return true;
+	case SUBTILIS_OP_INSTR_GTE_I32:
+	case SUBTILIS_OP_INSTR_GTEI_I32:
+		*res = a >= b ? -1 : 0;
+		return true;
+	default:
+		break;
+	}
+
+	/*
+	 * The backends don't agree on the result of shifting by 32 or more
+	 * bits, so we leave these shifts alone.
+	 */
+
+	if (b < 0 || b > 31)
+		return false;
+
+	switch (type) {
+	case SUBTILIS_OP_INSTR_LSL_I32:
+	case SUBTILIS_OP_INSTR_LSLI_I32:
+		*res = (int32_t)(ua << b);
+		return true;
+	case SUBTILIS_OP_INSTR_LSR_I32:
+	case SUBTILIS_OP_INSTR_LSRI_I32:
+		*res = (int32_t)(ua >> b);
+		return true;
+	case SUBTILIS_OP_INSTR_ASR_I32:
+	case SUBTILIS_OP_INSTR_ASRI_I32:
+		*res = a < 0 ? ~(~a >> b) : a >> b;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static const subtilis_ir_opt_imm_t *
+prv_imm_form(subtilis_op_instr_type_t type)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(prv_imm_forms) / sizeof(prv_imm_forms[0]); i++)
+		if (prv_imm_forms[i].type == type)
+			return &prv_imm_forms[i];
+
+	return NULL;
+}
+
+static void prv_set_movi_i32(subtilis_ir_inst_t *instr, int32_t val)
+{
+	instr->type = SUBTILIS_OP_INSTR_MOVI_I32;
+	instr->operands[1].integer = val;
+}
+
+static bool prv_fold_i32(subtilis_ir_opt_t *o, subtilis_ir_inst_t *instr,
+			 const subtilis_ir_opt_imm_t *imm)
+{
+	int32_t a;
+	int32_t b;
+	int32_t res;
+	bool a_const = prv_const_i32(o, instr->operands[1].reg, &a);
+	bool b_const = prv_const_i32(o, instr->operands[2].reg, &b);
+
+	if (a_const && b_const && prv_eval_i32(instr->type, a, b, &res)) {
+		prv_set_movi_i32(instr, res);
+		return true;
+	}
+
+	if (b_const && ((imm->swapped != SUBTILIS_OP_INSTR_NOP) ||
+			(b >= 0 && b <= 31))) {
+		instr->type = imm->imm;
+		instr->operands[2].integer = b;
+		return true;
+	}
+
+	if (a_const && (imm->swapped != SUBTILIS_OP_INSTR_NOP)) {
+		instr->type = imm->swapped;
+		instr->operands[1] = instr->operands[2];
+		instr->operands[2].integer = a;
+		return true;
+	}
+
+	return false;
+}
+
+static bool prv_fold_real(subtilis_ir_opt_t *o, subtilis_ir_inst_t *instr,
+			  const subtilis_ir_opt_imm_t *imm)
+{
+	double a;
+	double b;
+
+	/*
+	 * We don't evaluate floating point expressions ourselves as the
+	 * results may differ from those computed by the target's floating
+	 * point unit.  We just move the constants into the instructions.
+	 */
+
+	if (prv_const_real(o, instr->operands[2].reg, &b)) {
+		instr->type = imm->imm;
+		instr->operands[2].real = b;
+		return true;
+	}
+
+	if (prv_const_real(o, instr->operands[1].reg, &a)) {
+		instr->type = imm->swapped;
+		instr->operands[1] = instr->operands[2];
+		instr->operands[2].real = a;
+		return true;
+	}
+
+	return false;
+}
+
+static bool prv_fold(subtilis_ir_opt_t *o, subtilis_ir_inst_t *instr,
+		     const char *sig)
+{
+	int32_t a;
+	int32_t res;
+	double r;
+	const subtilis_ir_opt_imm_t *imm;
+
+	imm = prv_imm_form(instr->type);
+	if (imm) {
+		if (sig[1] == 'u')
+			return prv_fold_i32(o, instr, imm);
+		return prv_fold_real(o, instr, imm);
+	}
+
+	switch (instr->type) {
+	case SUBTILIS_OP_INSTR_MOV:
+		if (!prv_const_i32(o, instr->operands[1].reg, &a))
+			return false;
+		prv_set_movi_i32(instr, a);
+		return true;
+	case SUBTILIS_OP_INSTR_NOT_I32:
+		if (!prv_const_i32(o, instr->operands[1].reg, &a))
+			return false;
+		prv_set_movi_i32(instr, ~a);
+		return true;
+	case SUBTILIS_OP_INSTR_MOVFP:
+		if (!prv_const_real(o, instr->operands[1].reg, &r))
+			return false;
+		instr->type = SUBTILIS_OP_INSTR_MOVI_REAL;
+		instr->operands[1].real = r;
+		return true;
+	default:
+		break;
+	}
+
+	if (strcmp(sig, "du-") || !prv_const_i32(o, instr->operands[1].reg, &a))
+		return false;
+
+	if (!prv_eval_i32(instr->type, a, instr->operands[2].integer, &res))
+		return false;
+
+	prv_set_movi_i32(instr, res);
+	return true;
+}
+
+static void prv_fold_instr(subtilis_ir_opt_t *o, subtilis_ir_inst_t *instr,
+			   const char *sig)
+{
+	bool pure;
+	subtilis_ir_opt_fact_t *fact;
+
+	if (prv_fold(o, instr, sig)) {
+		o->changes++;
+		sig = prv_signature(instr->type, &pure);
+	}
+
+	prv_define_instr(o, instr, sig);
+
+	if (instr->type == SUBTILIS_OP_INSTR_MOVI_I32)
+		fact = prv_new_fact(&o->regs, instr->operands[0].reg);
+	else if (instr->type == SUBTILIS_OP_INSTR_MOVI_REAL)
+		fact = prv_new_fact(&o->fregs, instr->operands[0].reg);
+	else
+		return;
+
+	if (!fact)
+		return;
+	fact->is_const = true;
+	fact->value = instr->operands[1];
+}
+
+static void prv_const_fold(subtilis_ir_opt_t *o, subtilis_ir_section_t *s)
+{
+	prv_walk(o, s, prv_fold_instr, false);
+}
+
+static void prv_use(subtilis_ir_opt_regs_t *regs, size_t reg, bool add)
+{
+	if (reg >= regs->count)
+		return;
+	if (add)
+		regs->uses[reg]++;
+	else if (regs->uses[reg] > 0)
+		regs->uses[reg]--;
+}
+
+/*
+ * Adds, or if add is false removes, the register reads made by op to the
+ * use counts of the section's registers.
+ */
+
+static void prv_count_uses(subtilis_ir_opt_t *o, subtilis_ir_op_t *op,
+			   bool add)
+{
+	size_t i;
+	bool pure;
+	const char *sig;
+	uint32_t mask;
+	subtilis_ir_call_t *call;
+	subtilis_ir_sys_call_t *sys_call;
+	subtilis_ir_inst_t *instr;
+
+	if (op->type == SUBTILIS_OP_INSTR) {
+		instr = &op->op.instr;
+		sig = prv_signature(instr->type, &pure);
+		if (sig) {
+			for (i = 0; sig[i]; i++) {
+				if (sig[i] == 'u')
+					prv_use(&o->regs,
+						instr->operands[i].reg, add);
+				else if (sig[i] == 'U')
+					prv_use(&o->fregs,
+						instr->operands[i].reg, add);
+			}
+			return;
+		}
+		mask = subtilis_ir_instr_reg_operands(instr->type);
+		for (i = 0; i < SUBTILIS_IR_MAX_OP_ARGS; i++) {
+			if (!(mask & (1 << i)))
+				continue;
+			prv_use(&o->regs, instr->operands[i].reg, add);
+			prv_use(&o->fregs, instr->operands[i].reg, add);
+		}
+	} else if (prv_is_call(op)) {
+		call = &op->op.call;
+		for (i = 0; i < call->arg_count; i++)
+			prv_use(prv_arg_regs(o, &call->args[i]),
+				call->args[i].reg, add);
+		if (prv_is_call_ptr(op))
+			prv_use(&o->regs, call->proc_id, add);
+	} else if (op->type == SUBTILIS_OP_SYS_CALL) {
+		sys_call = &op->op.sys_call;
+		for (i = 0; i < 16; i++) {
+			if (sys_call->in_mask & (1 << i))
+				prv_use(&o->regs, sys_call->in_regs[i], add);
+			if ((sys_call->out_mask & (1 << i)) &&
+			    !sys_call->out_regs[i].local)
+				prv_use(&o->regs, sys_call->out_regs[i].reg,
+					add);
+		}
+		if ((sys_call->flags_reg != SIZE_MAX) && !sys_call->flags_local)
+			prv_use(&o->regs, sys_call->flags_reg, add);
+	}
+}
+
+/*
+ * Returns true if op is a side effect free instruction whose result is
+ * never read.
+ */
+
+static bool prv_is_dead(subtilis_ir_opt_t *o, subtilis_ir_op_t *op)
+{
+	bool pure;
+	const char *sig;
+	size_t reg;
+	subtilis_ir_opt_regs_t *regs;
+
+	if (op->type != SUBTILIS_OP_INSTR)
+		return false;
+
+	sig = prv_signature(op->op.instr.type, &pure);
+	if (!sig || !pure)
+		return false;
+
+	regs = (sig[0] == 'd') ? &o->regs : &o->fregs;
+	reg = op->op.instr.operands[0].reg;
+
+	return (reg >= regs->first) && (reg < regs->count) &&
+	       (regs->uses[reg] == 0);
+}
+
+static void prv_count_all_uses(subtilis_ir_opt_t *o, subtilis_ir_section_t *s)
+{
+	size_t i;
+
+	memset(o->regs.uses, 0, (o->regs.count + 1) * sizeof(size_t));
+	memset(o->fregs.uses, 0, (o->fregs.count + 1) * sizeof(size_t));
+
+	for (i = 0; i < s->len; i++)
+		prv_count_uses(o, s->ops[i], true);
+}
+
+static void prv_remove(subtilis_ir_opt_t *o, subtilis_ir_op_t *op)
+{
+	prv_count_uses(o, op, false);
+	op->op.instr.type = SUBTILIS_OP_INSTR_NOP;
+	o->changes++;
+}
+
+/*
+ * Removes side effect free instructions whose results are overwritten
+ * later in the same basic block before they are read.  The ops are
+ * walked backwards, marking each register written with the current block
+ * number and clearing the mark when the register is read.  Any op we
+ * don't understand starts a new block.
+ */
+
+static void prv_dead_stores(subtilis_ir_opt_t *o, subtilis_ir_section_t *s)
+{
+	size_t i;
+	size_t j;
+	bool pure;
+	const char *sig;
+	size_t reg;
+	subtilis_ir_op_t *op;
+	subtilis_ir_inst_t *instr;
+	subtilis_ir_opt_regs_t *regs;
+	size_t block = 1;
+
+	memset(o->regs.marks, 0, (o->regs.count + 1) * sizeof(size_t));
+	memset(o->fregs.marks, 0, (o->fregs.count + 1) * sizeof(size_t));
+
+	for (i = s->len; i > 0; i--) {
+		op = s->ops[i - 1];
+		if (prv_is_nop(op))
+			continue;
+		sig = NULL;
+		if (op->type == SUBTILIS_OP_INSTR)
+			sig = prv_signature(op->op.instr.type, &pure);
+		if (!sig) {
+			block++;
+			continue;
+		}
+		if (prv_ends_block(op))
+			block++;
+
+		instr = &op->op.instr;
+		if (pure) {
+			regs = (sig[0] == 'd') ? &o->regs : &o->fregs;
+			reg = instr->operands[0].reg;
+			if ((reg >= regs->first) && (reg < regs->count) &&
+			    (regs->marks[reg] == block)) {
+				prv_remove(o, op);
+				continue;
+			}
+		}
+
+		for (j = 0; sig[j]; j++) {
+			reg = instr->operands[j].reg;
+			if ((sig[j] == 'd') && (reg < o->regs.count))
+				o->regs.marks[reg] = block;
+			else if ((sig[j] == 'D') && (reg < o->fregs.count))
+				o->fregs.marks[reg] = block;
+		}
+
+		for (j = 0; sig[j]; j++) {
+			reg = instr->operands[j].reg;
+			if ((sig[j] == 'u') && (reg < o->regs.count))
+				o->regs.marks[reg] = 0;
+			else if ((sig[j] == 'U') && (reg < o->fregs.count))
+				o->fregs.marks[reg] = 0;
+		}
+	}
+}
+
+static void prv_dce(subtilis_ir_opt_t *o, subtilis_ir_section_t *s)
+{
+	size_t i;
+	bool removed;
+	subtilis_ir_op_t *op;
+
+	prv_count_all_uses(o, s);
+	prv_dead_stores(o, s);
+
+	/*
+	 * Removing an instruction may make the instructions that compute
+	 * its operands dead, so we keep going until nothing changes.
+	 * Walking backwards means that most chains are removed in a single
+	 * iteration.
+	 */
+
+	do {
+		removed = false;
+		for (i = s->len; i > 0; i--) {
+			op = s->ops[i - 1];
+			if (!prv_is_dead(o, op))
+				continue;
+			prv_remove(o, op);
+			removed = true;
+		}
+	} while (removed);
+}
+
+static void prv_write(subtilis_ir_opt_regs_t *regs, size_t reg)
+{
+	if (reg < regs->count)
+		regs->writes[reg]++;
+}
+
+typedef void (*subtilis_ir_opt_write_fn_t)(void *data, bool real,
+					   size_t reg);
+
+/*
+ * Calls fn for each register written by op.  Each register operand of an
+ * instruction we don't understand is assumed to be written and is passed
+ * to fn twice, once as an integer and once as a floating point register.
+ */
+
+static void prv_op_writes(subtilis_ir_op_t *op, subtilis_ir_opt_write_fn_t fn,
+			  void *data)
+{
+	size_t i;
+	bool pure;
+	const char *sig;
+	uint32_t mask;
+	subtilis_ir_inst_t *instr;
+	subtilis_ir_sys_call_t *sys_call;
+
+	if (op->type == SUBTILIS_OP_INSTR) {
+		instr = &op->op.instr;
+		sig = prv_signature(instr->type, &pure);
+		if (sig) {
+			for (i = 0; sig[i]; i++) {
+				if (sig[i] == 'd')
+					fn(data, false, instr->operands[i].reg);
+				else if (sig[i] == 'D')
+					fn(data, true, instr->operands[i].reg);
+			}
+			return;
+		}
+		mask = subtilis_ir_instr_reg_operands(instr->type);
+		for (i = 0; i < SUBTILIS_IR_MAX_OP_ARGS; i++) {
+			if (!(mask & (1 << i)))
+				continue;
+			fn(data, false, instr->operands[i].reg);
+			fn(data, true, instr->operands[i].reg);
+		}
+	} else if ((op->type == SUBTILIS_OP_CALLI32) ||
+		   (op->type == SUBTILIS_OP_CALLI32_PTR)) {
+		fn(data, false, op->op.call.reg);
+	} else if ((op->type == SUBTILIS_OP_CALLREAL) ||
+		   (op->type == SUBTILIS_OP_CALLREAL_PTR)) {
+		fn(data, true, op->op.call.reg);
+	} else if (op->type == SUBTILIS_OP_SYS_CALL) {
+		sys_call = &op->op.sys_call;
+		for (i = 0; i < 16; i++)
+			if ((sys_call->out_mask & (1 << i)) &&
+			    sys_call->out_regs[i].local)
+				fn(data, false, sys_call->out_regs[i].reg);
+		if ((sys_call->flags_reg != SIZE_MAX) && sys_call->flags_local)
+			fn(data, false, sys_call->flags_reg);
+	}
+}
+
+static void prv_count_write(void *data, bool real, size_t reg)
+{
+	subtilis_ir_opt_t *o = data;
+
+	prv_write(real ? &o->fregs : &o->regs, reg);
+}
+
+/*
+ * Adds the register writes made by op to the write counts of the
+ * section's registers.
+ */
+
+static void prv_count_writes(subtilis_ir_opt_t *o, subtilis_ir_op_t *op)
+{
+	prv_op_writes(op, prv_count_write, o);
+}
+
+/*
+ * The parser computes the value of an assignment into a temporary
+ * register and then copies it into the variable's register, e.g.,
+ *
+ * addii32 r10, r8, #1
+ * mov r8, r10
+ *
+ * If the temporary is written and read only once, the instruction
+ * computing its value can write directly into the variable's register
+ * and the copy can be dropped.
+ */
+
+static void prv_coalesce(subtilis_ir_opt_t *o, subtilis_ir_section_t *s)
+{
+	size_t i;
+	bool pure;
+	const char *sig;
+	size_t tmp;
+	size_t var;
+	subtilis_ir_inst_t *mov;
+	subtilis_ir_inst_t *prev;
+	subtilis_ir_opt_regs_t *regs;
+
+	prv_count_all_uses(o, s);
+	memset(o->regs.writes, 0, (o->regs.count + 1) * sizeof(size_t));
+	memset(o->fregs.writes, 0, (o->fregs.count + 1) * sizeof(size_t));
+	for (i = 0; i < s->len; i++)
+		prv_count_writes(o, s->ops[i]);
+
+	for (i = 1; i < s->len; i++) {
+		if ((s->ops[i]->type != SUBTILIS_OP_INSTR) ||
+		    (s->ops[i - 1]->type != SUBTILIS_OP_INSTR))
+			continue;
+		mov = &s->ops[i]->op.instr;
+		if (mov->type == SUBTILIS_OP_INSTR_MOV)
+			regs = &o->regs;
+		else if (mov->type == SUBTILIS_OP_INSTR_MOVFP)
+			regs = &o->fregs;
+		else
+			continue;
+
+		prev = &s->ops[i - 1]->op.instr;
+		sig = prv_signature(prev->type, &pure);
+		if (!sig || !pure ||
+		    (sig[0] != (regs == &o->regs ? 'd' : 'D')))
+			continue;
+
+		var = mov->operands[0].reg;
+		tmp = mov->operands[1].reg;
+		if ((prev->operands[0].reg != tmp) || (tmp == var) ||
+		    (tmp < regs->first) || (tmp >= regs->count) ||
+		    (var < regs->first) || (regs->uses[tmp] != 1) ||
+		    (regs->writes[tmp] != 1))
+			continue;
+
+		prev->operands[0].reg = var;
+		regs->uses[tmp] = 0;
+		regs->writes[tmp] = 0;
+		mov->type = SUBTILIS_OP_INSTR_NOP;
+		o->changes++;
+	}
+}
+
+static void prv_strip_nops(subtilis_ir_section_t *s)
+{
+	size_t i;
+	size_t j;
+
+	for (i = 0, j = 0; i < s->len; i++) {
+		if (prv_is_nop(s->ops[i])) {
+			free(s->ops[i]);
+			continue;
+		}
+		s->ops[j++] = s->ops[i];
+	}
+	s->len = j;
+}
+
+/* clang-format off */
+static const subtilis_ir_opt_pass_t prv_passes[] = {
+	{ "coalesce", 1, prv_coalesce },
+	{ "copy", 1, prv_copy_prop },
+	{ "fold", 1, prv_const_fold },
+	{ "dce", 1, prv_dce },
+};
+
+/* clang-format on */
+
+void subtilis_ir_opt_section(subtilis_ir_section_t *s, uint32_t level,
+			     subtilis_error_t *err)
+{
+	size_t i;
+	size_t round;
+	subtilis_ir_opt_t o;
+	const size_t pass_count = sizeof(prv_passes) / sizeof(prv_passes[0]);
+
+	if ((level == 0) || (s->section_type != SUBTILIS_IR_SECTION_IR))
+		return;
+
+	memset(&o, 0, sizeof(o));
+	prv_regs_init(&o.regs, s->reg_counter, SUBTILIS_IR_REG_TEMP_START,
+		      err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	prv_regs_init(&o.fregs, s->freg_counter, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	for (round = 0; round < SUBTILIS_IR_OPT_MAX_ROUNDS; round++) {
+		o.changes = 0;
+		for (i = 0; i < pass_count; i++)
+			if (prv_passes[i].level <= level)
+				prv_passes[i].fn(&o, s);
+		if ((level < 2) || (o.changes == 0))
+			break;
+	}
+
+	prv_strip_nops(s);
+
+cleanup:
+
+	prv_regs_free(&o.fregs);
+	prv_regs_free(&o.regs);
+}
+
+void subtilis_ir_opt_prog(subtilis_ir_prog_t *p, subtilis_error_t *err)
+{
+	size_t i;
+	uint32_t level = p->settings ? p->settings->opt_level : 0;
+
+	if (level == 0)
+		return;
+
+	if (level >= 2) {
+		subtilis_ir_inline_prog(p, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	for (i = 0; i < p->num_sections; i++) {
+		subtilis_ir_opt_section(p->sections[i], level, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+}
+
+struct subtilis_ir_opt_written_t_ {
+	size_t reg;
+	bool written;
+};
+
+typedef struct subtilis_ir_opt_written_t_ subtilis_ir_opt_written_t;
+
+static void prv_check_write(void *data, bool real, size_t reg)
+{
+	subtilis_ir_opt_written_t *w = data;
+
+	if (!real && (reg == w->reg))
+		w->written = true;
+}
+
+bool subtilis_ir_opt_reg_written(subtilis_ir_section_t *s, size_t start,
+				 size_t end, size_t reg)
+{
+	size_t i;
+	subtilis_ir_opt_written_t w;
+
+	w.reg = reg;
+	w.written = false;
+
+	for (i = start; i < end && !w.written; i++)
+		prv_op_writes(s->ops[i], prv_check_write, &w);
+
+	return w.written;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBTILIS_IR_OPT_H
+#define __SUBTILIS_IR_OPT_H
+
+#include "ir.h"
+
+/*
+ * Runs the IR optimisation passes enabled by the opt_level setting over
+ * each of the IR sections in p.  Needs to be called after the program has
+ * been parsed and before it is handed to a backend.  Does nothing if
+ * opt_level is 0.
+ *
+ * Level 1 runs copy propagation, constant folding and dead code
+ * elimination once.  Level 2 and above first inline small procedures and
+ * functions and then repeat these passes until they stop making changes.
+ */
+
+void subtilis_ir_opt_prog(subtilis_ir_prog_t *p, subtilis_error_t *err);
+
+/*
+ * Runs the optimisation passes enabled for level over a single section.
+ */
+
+void subtilis_ir_opt_section(subtilis_ir_section_t *s, uint32_t level,
+			     subtilis_error_t *err);
+
+/*
+ * Returns true if any of the ops in s from start up to, but not
+ * including, end might write to the integer register reg.  Instructions
+ * that are not understood by the optimiser are assumed to write to all
+ * of their register operands.
+ */
+
+bool subtilis_ir_opt_reg_written(subtilis_ir_section_t *s, size_t start,
+				 size_t end, size_t reg);
+
+#endif
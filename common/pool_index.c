@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "pool_index.h"
+
+/*
+ * The index uses open addressing with linear probing.  The number of
+ * slots is always a power of 2 and the table is grown when it becomes
+ * half full, so probe sequences stay short.  The hash of each entry is
+ * stored alongside its position so that the table can be rebuilt
+ * without consulting the pool.
+ */
+
+#define SUBTILIS_POOL_INDEX_MIN_SIZE 64
+
+void subtilis_pool_index_init(subtilis_pool_index_t *pi)
+{
+	pi->slots = NULL;
+	pi->size = 0;
+	pi->count = 0;
+}
+
+void subtilis_pool_index_free(subtilis_pool_index_t *pi)
+{
+	free(pi->slots);
+	subtilis_pool_index_init(pi);
+}
+
+/* FNV-1a */
+
+size_t subtilis_pool_index_hash(const void *data, size_t len)
+{
+	size_t i;
+	const uint8_t *ptr = data;
+	size_t hash = 2166136261u;
+
+	for (i = 0; i < len; i++) {
+		hash ^= ptr[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+bool subtilis_pool_index_find(subtilis_pool_index_t *pi, size_t hash,
+			      subtilis_pool_index_equal_t eq_func,
+			      const void *pool, const void *key, size_t *index)
+{
+	size_t i;
+	subtilis_pool_index_slot_t *slot;
+
+	if (pi->size == 0)
+		return false;
+
+	for (i = hash & (pi->size - 1);; i = (i + 1) & (pi->size - 1)) {
+		slot = &pi->slots[i];
+		if (slot->index == SIZE_MAX)
+			return false;
+		if ((slot->hash == hash) && eq_func(pool, slot->index, key)) {
+			*index = slot->index;
+			return true;
+		}
+	}
+}
+
+static void prv_insert(subtilis_pool_index_slot_t *slots, size_t size,
+		       size_t hash, size_t index)
+{
+	size_t i;
+
+	for (i = hash & (size - 1); slots[i].index != SIZE_MAX;
+	     i = (i + 1) & (size - 1))
+		;
+
+	slots[i].hash = hash;
+	slots[i].index = index;
+}
+
+static void prv_grow(subtilis_pool_index_t *pi, subtilis_error_t *err)
+{
+	size_t i;
+	size_t new_size;
+	subtilis_pool_index_slot_t *slots;
+
+	new_size = pi->size ? pi->size * 2 : SUBTILIS_POOL_INDEX_MIN_SIZE;
+	slots = malloc(new_size * sizeof(*slots));
+	if (!slots) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < new_size; i++)
+		slots[i].index = SIZE_MAX;
+
+	for (i = 0; i < pi->size; i++)
+		if (pi->slots[i].index != SIZE_MAX)
+			prv_insert(slots, new_size, pi->slots[i].hash,
+				   pi->slots[i].index);
+
+	free(pi->slots);
+	pi->slots = slots;
+	pi->size = new_size;
+}
+
+/*
+ * Adds an entry to the index.  The caller is expected to have checked
+ * that an equal entry isn't already present.
+ */
+
+void subtilis_pool_index_add(subtilis_pool_index_t *pi, size_t hash,
+			     size_t index, subtilis_error_t *err)
+{
+	if ((pi->count + 1) * 2 > pi->size) {
+		prv_grow(pi, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
+	prv_insert(pi->slots, pi->size, hash, index);
+	pi->count++;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBTILIS_POOL_INDEX_H
+#define __SUBTILIS_POOL_INDEX_H
+
+#include "error.h"
+
+/*
+ * A hash index over the entries of an array based pool, such as the
+ * string and constant pools.  The index doesn't own or store the
+ * entries themselves.  It maps hashes to positions in the pool's array,
+ * so entries keep the positions they were given when they were added.
+ * The pool supplies an equality function which is used to compare a key
+ * against the entry at a given position when the hashes match.
+ */
+
+typedef bool (*subtilis_pool_index_equal_t)(const void *pool, size_t index,
+					    const void *key);
+
+struct subtilis_pool_index_slot_t_ {
+	size_t hash;
+	size_t index;
+};
+
+typedef struct subtilis_pool_index_slot_t_ subtilis_pool_index_slot_t;
+
+struct subtilis_pool_index_t_ {
+	subtilis_pool_index_slot_t *slots;
+	size_t size;
+	size_t count;
+};
+
+typedef struct subtilis_pool_index_t_ subtilis_pool_index_t;
+
+void subtilis_pool_index_init(subtilis_pool_index_t *pi);
+void subtilis_pool_index_free(subtilis_pool_index_t *pi);
+size_t subtilis_pool_index_hash(const void *data, size_t len);
+bool subtilis_pool_index_find(subtilis_pool_index_t *pi, size_t hash,
+			      subtilis_pool_index_equal_t eq_func,
+			      const void *pool, const void *key, size_t *index);
+void subtilis_pool_index_add(subtilis_pool_index_t *pi, size_t hash,
+			     size_t index, subtilis_error_t *err);
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2022 Mark Ryan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "constant_pool.h"
+#include "pool_test.h"
+#include "string_pool.h"
+
+#define SUBTILIS_POOL_TEST_ENTRIES 100000
+
+static void prv_print_time(clock_t start)
+{
+	double secs = ((double)(clock() - start)) / CLOCKS_PER_SEC;
+
+	printf(" (%d entries in %.3fs)", SUBTILIS_POOL_TEST_ENTRIES, secs);
+}
+
+static int prv_string_pool_100k(void)
+{
+	subtilis_error_t err;
+	char name[32];
+	size_t i;
+	size_t index;
+	clock_t start;
+	subtilis_string_pool_t *pool;
+	int retval = 1;
+
+	printf("string_pool_100k");
+
+	subtilis_error_init(&err);
+	pool = subtilis_string_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	start = clock();
+
+	for (i = 0; i < SUBTILIS_POOL_TEST_ENTRIES; i++) {
+		sprintf(name, "PROCname%zu", i);
+		index = subtilis_string_pool_register(pool, name, &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto fail;
+		if (index != i)
+			goto fail;
+	}
+
+	/*
+	 * Registering a string a second time should return its original
+	 * index and not grow the pool.
+	 */
+
+	for (i = 0; i < SUBTILIS_POOL_TEST_ENTRIES; i++) {
+		sprintf(name, "PROCname%zu", i);
+		index = subtilis_string_pool_register(pool, name, &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto fail;
+		if (index != i)
+			goto fail;
+		if (!subtilis_string_pool_find(pool, name, &index) ||
+		    (index != i))
+			goto fail;
+	}
+
+	prv_print_time(start);
+
+	if (pool->length != SUBTILIS_POOL_TEST_ENTRIES)
+		goto fail;
+
+	if (subtilis_string_pool_find(pool, "PROCname", &index))
+		goto fail;
+
+	retval = 0;
+
+fail:
+
+	subtilis_string_pool_delete(pool);
+
+	printf(": [%s]\n", retval ? "FAIL" : "OK");
+
+	return retval;
+}
+
+static uint8_t *prv_make_constant(size_t i, size_t *size,
+				  subtilis_error_t *err)
+{
+	uint8_t *data;
+	int32_t val = (int32_t)i;
+
+	/*
+	 * Vary the size of the constants so that the pool contains entries
+	 * with the same prefix but different lengths.
+	 */
+
+	*size = sizeof(val) + (i & 3);
+	data = calloc(1, *size);
+	if (!data) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+	memcpy(data, &val, sizeof(val));
+
+	return data;
+}
+
+static int prv_constant_pool_100k(void)
+{
+	subtilis_error_t err;
+	size_t i;
+	size_t index;
+	size_t size;
+	clock_t start;
+	uint8_t *data;
+	subtilis_constant_pool_t *pool;
+	int retval = 1;
+
+	printf("constant_pool_100k");
+
+	subtilis_error_init(&err);
+	pool = subtilis_constant_pool_new(&err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+
+	start = clock();
+
+	for (i = 0; i < SUBTILIS_POOL_TEST_ENTRIES * 2; i++) {
+		data = prv_make_constant(i % SUBTILIS_POOL_TEST_ENTRIES, &size,
+					 &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto fail;
+		index = subtilis_constant_pool_add(pool, data, size, false,
+						   &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto fail;
+		if (index != i % SUBTILIS_POOL_TEST_ENTRIES)
+			goto fail;
+	}
+
+	prv_print_time(start);
+
+	if (pool->size != SUBTILIS_POOL_TEST_ENTRIES)
+		goto fail;
+
+	/* The same bytes flagged as a double are a different constant. */
+
+	data = prv_make_constant(0, &size, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+	index = subtilis_constant_pool_add(pool, data, size, true, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto fail;
+	if (index != SUBTILIS_POOL_TEST_ENTRIES)
+		goto fail;
+
+	retval = 0;
+
+fail:
+
+	subtilis_constant_pool_delete(pool);
+
+	printf(": [%s]\n", retval ? "FAIL" : "OK");
+
+	return retval;
+}
+
+int pool_test(void)
+{
+	int retval;
+
+	retval = prv_string_pool_100k();
+	retval |= prv_constant_pool_100k();
+
+	return retval;
+}
@@ -19,10 +19,83 @@
 
 #include <stdint.h>
 
+/*
+ * Determines how often loops test for escape when handle_escapes is
+ * true.
+ *
+ * SUBTILIS_ESCAPE_POLICY_LOOP tests on every iteration of every loop.
+ * SUBTILIS_ESCAPE_POLICY_OUTER tests only on the iterations of loops
+ * that are not nested inside another loop of the same procedure.
+ * SUBTILIS_ESCAPE_POLICY_BUDGET tests once every escape_budget
+ * iterations of each loop.
+ *
+ * Under the OUTER and BUDGET policies, innermost FOR loops with
+ * constant bounds that are known to execute only a small number of
+ * times never test for escape.  Procedures and functions always test
+ * for escape on entry.
+ */
+
+typedef enum {
+	SUBTILIS_ESCAPE_POLICY_LOOP,
+	SUBTILIS_ESCAPE_POLICY_OUTER,
+	SUBTILIS_ESCAPE_POLICY_BUDGET,
+} subtilis_escape_policy_t;
+
+/*
+ * Selects the accuracy of the SIN, COS, TAN, ASN, ACS, ATN, EXP and ^
+ * routines generated by backends that have no hardware support for
+ * these functions.  LOG and LN are always generated in their accurate
+ * form so that, for example, LOG(1000) is exactly 3.
+ *
+ * SUBTILIS_TRANS_TIER_ACCURATE aims for results within a few ulps of the
+ * correctly rounded result.  SUBTILIS_TRANS_TIER_FAST uses lower degree
+ * polynomials, giving results with a relative error of around 1e-9,
+ * which is still more accurate than the 5 byte floats used by BBC BASIC.
+ */
+
+typedef enum {
+	SUBTILIS_TRANS_TIER_ACCURATE,
+	SUBTILIS_TRANS_TIER_FAST,
+} subtilis_trans_tier_t;
+
 struct subtilis_settings_t_ {
 	bool handle_escapes;
+	subtilis_escape_policy_t escape_policy;
+	uint32_t escape_budget;
 	bool ignore_graphics_errors;
 	bool check_mem_leaks;
+	bool global_reg_alloc;
+	uint32_t opt_level;
+
+	/*
+	 * The number of threads the backend may use to generate code for
+	 * the program's sections.  0 and 1 generate all the sections on
+	 * the calling thread, as do builds in which SUBTILIS_CONFIG_THREADS
+	 * is not defined.
+	 */
+
+	uint32_t jobs;
+
+	/*
+	 * The number of slots in the heaps of programs generated by the ARM
+	 * backends.  All but the last slot hold blocks of a single power of
+	 * 2 size, starting at 32 bytes.  The last slot holds larger blocks,
+	 * which are split and coalesced as needed.  Each target chooses its
+	 * own default.
+	 */
+
+	uint32_t heap_slots;
+	subtilis_trans_tier_t trans_tier;
+
+	/*
+	 * If set, the ARM register allocator checks every distance it
+	 * obtains from its next use tables against the distance obtained by
+	 * walking the section, failing with an assertion if they differ.
+	 * Only the unit tests set this as it defeats the purpose of the
+	 * tables.
+	 */
+
+	bool check_next_use;
 };
 
 typedef struct subtilis_settings_t_ subtilis_settings_t;
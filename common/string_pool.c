@@ -24,9 +24,12 @@ subtilis_string_pool_t *subtilis_string_pool_new(subtilis_error_t *err)
 	subtilis_string_pool_t *pool;
 
 	pool = calloc(1, sizeof(*pool));
-	if (!pool)
+	if (!pool) {
 		subtilis_error_set_oom(err);
+		return NULL;
+	}
 	pool->ref = 1;
+	subtilis_pool_index_init(&pool->index);
 	return pool;
 }
 
@@ -36,36 +39,40 @@ subtilis_string_pool_t *subtilis_string_pool_clone(subtilis_string_pool_t *src)
 	return src;
 }
 
-bool subtilis_string_pool_find(subtilis_string_pool_t *pool, const char *str,
-			       size_t *index)
+static bool prv_string_equal(const void *pool, size_t index, const void *key)
 {
-	size_t i;
+	const subtilis_string_pool_t *sp = pool;
 
-	for (i = 0; i < pool->length; i++) {
-		if (!strcmp(pool->strings[i], str))
-			break;
-	}
+	return !strcmp(sp->strings[index], key);
+}
 
-	if (i == pool->length)
-		return false;
+bool subtilis_string_pool_find(subtilis_string_pool_t *pool, const char *str,
+			       size_t *index)
+{
+	size_t hash = subtilis_pool_index_hash(str, strlen(str));
 
-	*index = i;
-	return true;
+	return subtilis_pool_index_find(&pool->index, hash, prv_string_equal,
+					pool, str, index);
 }
 
 size_t subtilis_string_pool_register(subtilis_string_pool_t *pool,
 				     const char *str, subtilis_error_t *err)
 {
 	size_t i;
+	size_t hash;
+	size_t len;
 	char **new_pool;
 	size_t new_max;
 	char *str_dup = NULL;
 
-	if (subtilis_string_pool_find(pool, str, &i))
+	len = strlen(str);
+	hash = subtilis_pool_index_hash(str, len);
+	if (subtilis_pool_index_find(&pool->index, hash, prv_string_equal, pool,
+				     str, &i))
 		return i;
 
 	i = pool->length;
-	str_dup = malloc(strlen(str) + 1);
+	str_dup = malloc(len + 1);
 	if (!str_dup) {
 		subtilis_error_set_oom(err);
 		return 0;
@@ -84,6 +91,10 @@ size_t subtilis_string_pool_register(subtilis_string_pool_t *pool,
 		pool->strings = new_pool;
 	}
 
+	subtilis_pool_index_add(&pool->index, hash, i, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
 	pool->strings[i] = str_dup;
 	pool->length++;
 
@@ -111,6 +122,7 @@ void subtilis_string_pool_delete(subtilis_string_pool_t *pool)
 	for (i = 0; i < pool->length; i++)
 		free(pool->strings[i]);
 	free(pool->strings);
+	subtilis_pool_index_free(&pool->index);
 	free(pool);
 }
 
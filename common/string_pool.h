@@ -18,12 +18,14 @@
 #define __SUBTILIS_STRING_POOL_H
 
 #include "error.h"
+#include "pool_index.h"
 
 struct subtilis_string_pool_t_ {
 	char **strings;
 	size_t length;
 	size_t max_length;
 	size_t ref;
+	subtilis_pool_index_t index;
 };
 
 typedef struct subtilis_string_pool_t_ subtilis_string_pool_t;
@@ -187,6 +187,7 @@ static void prv_zero_buf(subtilis_parser_t *p, const subtilis_type_t *type,
 	subtilis_type_t el_type;
 	subtilis_exp_t *e = NULL;
 
+	el_type.type = SUBTILIS_TYPE_VOID;
 	subtilis_type_if_element_type(p, type, &el_type, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
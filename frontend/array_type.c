@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include "../common/error_codes.h"
+#include "../common/ir_opt.h"
 #include "array_type.h"
 #include "builtins_helper.h"
 #include "builtins_ir.h"
@@ -1647,6 +1648,92 @@ static subtilis_exp_t *prv_get_dynamic_dim_size(subtilis_parser_t *p,
 	return maxe;
 }
 
+void subtilis_array_loop_start(subtilis_parser_t *p, size_t reg, int32_t min,
+			       int32_t max, subtilis_error_t *err)
+{
+	subtilis_parser_loop_t *loop;
+
+	loop = malloc(sizeof(*loop));
+	if (!loop) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	loop->section = p->current;
+	loop->reg = reg;
+	loop->min = min;
+	loop->max = max;
+	loop->body = p->current->len;
+	subtilis_sizet_vector_init(&loop->checks);
+	loop->next = p->loops;
+	p->loops = loop;
+}
+
+void subtilis_array_loop_end(subtilis_parser_t *p)
+{
+	size_t i;
+	size_t j;
+	subtilis_ir_op_t *op;
+	subtilis_parser_loop_t *loop = p->loops;
+
+	if (!loop)
+		return;
+
+	p->loops = loop->next;
+
+	/*
+	 * We couldn't know whether the counter was going to be modified
+	 * when we parsed the bounds checks, so they were generated in the
+	 * normal way.  Now that we've seen the whole body we can replace
+	 * them with NOPs if the counter is never written.
+	 */
+
+	if ((loop->checks.len > 0) &&
+	    !subtilis_ir_opt_reg_written(loop->section, loop->body,
+					 loop->section->len, loop->reg)) {
+		for (i = 0; i < loop->checks.len; i += 2) {
+			for (j = loop->checks.vals[i];
+			     j < loop->checks.vals[i + 1]; j++) {
+				op = loop->section->ops[j];
+				op->type = SUBTILIS_OP_INSTR;
+				op->op.instr.type = SUBTILIS_OP_INSTR_NOP;
+			}
+		}
+	}
+
+	subtilis_sizet_vector_free(&loop->checks);
+	free(loop);
+}
+
+/*
+ * Returns the innermost loop whose counter is used as the index e if
+ * its range is known to fall within 0 and dim_size.
+ */
+
+static subtilis_parser_loop_t *prv_bounded_loop(subtilis_parser_t *p,
+						subtilis_exp_t *e,
+						int32_t dim_size)
+{
+	subtilis_parser_loop_t *loop;
+
+	if ((dim_size == SUBTILIS_DYNAMIC_DIMENSION) ||
+	    (e->type.type != SUBTILIS_TYPE_INTEGER) ||
+	    p->current->in_error_handler)
+		return NULL;
+
+	for (loop = p->loops; loop; loop = loop->next) {
+		if (loop->section != p->current)
+			return NULL;
+		if (loop->reg == e->exp.ir_op.reg)
+			break;
+	}
+
+	if (!loop || (loop->min < 0) || (loop->max > dim_size))
+		return NULL;
+
+	return loop;
+}
+
 /* Does not consume e. */
 
 static subtilis_exp_t *prv_check_dynamic_index(subtilis_parser_t *p,
@@ -1657,6 +1744,8 @@ static subtilis_exp_t *prv_check_dynamic_index(subtilis_parser_t *p,
 {
 	subtilis_exp_t *maxe;
 	subtilis_exp_t *maxe_dup = NULL;
+	subtilis_parser_loop_t *loop;
+	size_t start;
 
 	maxe = prv_get_dynamic_dim_size(p, dim_size, offset, mem_reg, err);
 	if (err->type != SUBTILIS_ERROR_OK)
@@ -1665,10 +1754,23 @@ static subtilis_exp_t *prv_check_dynamic_index(subtilis_parser_t *p,
 	maxe_dup = subtilis_type_if_dup(maxe, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
+
+	start = p->current->len;
 	prv_check_dynamic_dim(p, e, 0, maxe_dup, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	loop = prv_bounded_loop(p, e, dim_size);
+	if (loop) {
+		subtilis_sizet_vector_append(&loop->checks, start, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+		subtilis_sizet_vector_append(&loop->checks, p->current->len,
+					     err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
 	return maxe;
 
 cleanup:
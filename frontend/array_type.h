@@ -235,6 +235,19 @@ void subtilis_array_sub(subtilis_parser_t *p, const char *var_name,
 			size_t loc, subtilis_exp_t *e, subtilis_exp_t **indices,
 			size_t index_count, subtilis_error_t *err);
 subtilis_ir_operand_t subtilis_array_type_error_label(subtilis_parser_t *p);
+
+/*
+ * Called before parsing the body of a loop whose counter, held in the
+ * integer register reg, is known to lie between min and max at the start
+ * of each iteration.  Bounds checks on array accesses indexed by the
+ * counter, that are known to succeed, are removed by
+ * subtilis_array_loop_end if the body of the loop does not modify the
+ * counter.  Calls to the two functions must be paired.
+ */
+
+void subtilis_array_loop_start(subtilis_parser_t *p, size_t reg, int32_t min,
+			       int32_t max, subtilis_error_t *err);
+void subtilis_array_loop_end(subtilis_parser_t *p);
 void subtilis_array_gen_index_error_code(subtilis_parser_t *p,
 					 subtilis_error_t *err);
 
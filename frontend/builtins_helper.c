@@ -187,3 +187,96 @@ cleanup:
 	subtilis_exp_delete(val_exp);
 	subtilis_exp_delete(size_exp);
 }
+
+/*
+ * Returns SUBTILIS_BUILTINS_MAX for functions, such as SQR, that are
+ * always emitted as IR instructions.
+ */
+
+static subtilis_builtin_type_t
+prv_real_fn_builtin(subtilis_op_instr_type_t itype)
+{
+	switch (itype) {
+	case SUBTILIS_OP_INSTR_SIN:
+		return SUBTILIS_BUILTINS_SIN;
+	case SUBTILIS_OP_INSTR_COS:
+		return SUBTILIS_BUILTINS_COS;
+	case SUBTILIS_OP_INSTR_TAN:
+		return SUBTILIS_BUILTINS_TAN;
+	case SUBTILIS_OP_INSTR_ASN:
+		return SUBTILIS_BUILTINS_ASN;
+	case SUBTILIS_OP_INSTR_ACS:
+		return SUBTILIS_BUILTINS_ACS;
+	case SUBTILIS_OP_INSTR_ATN:
+		return SUBTILIS_BUILTINS_ATN;
+	case SUBTILIS_OP_INSTR_LOG:
+		return SUBTILIS_BUILTINS_LOG;
+	case SUBTILIS_OP_INSTR_LN:
+		return SUBTILIS_BUILTINS_LN;
+	case SUBTILIS_OP_INSTR_EXPR:
+		return SUBTILIS_BUILTINS_EXP;
+	case SUBTILIS_OP_INSTR_POWR:
+		return SUBTILIS_BUILTINS_POW;
+	default:
+		return SUBTILIS_BUILTINS_MAX;
+	}
+}
+
+size_t subtilis_builtin_real_fn(subtilis_parser_t *p,
+				subtilis_op_instr_type_t itype,
+				subtilis_ir_operand_t a,
+				subtilis_ir_operand_t b, subtilis_error_t *err)
+{
+	subtilis_builtin_type_t ftype;
+	subtilis_ir_arg_t *args;
+	subtilis_exp_t *e;
+	const subtilis_builtin_t *f;
+	size_t res;
+	char *name = NULL;
+
+	if (p->backend.caps & SUBTILIS_BACKEND_HAVE_TRANS)
+		ftype = SUBTILIS_BUILTINS_MAX;
+	else
+		ftype = prv_real_fn_builtin(itype);
+
+	if (ftype == SUBTILIS_BUILTINS_MAX) {
+		if (itype == SUBTILIS_OP_INSTR_POWR)
+			return subtilis_ir_section_add_instr(p->current, itype,
+							     a, b, err);
+		return subtilis_ir_section_add_instr2(p->current, itype, a,
+						      err);
+	}
+
+	f = &subtilis_builtin_list[ftype];
+
+	name = malloc(strlen(f->str) + 1);
+	if (!name) {
+		subtilis_error_set_oom(err);
+		return 0;
+	}
+	strcpy(name, f->str);
+
+	args = malloc(sizeof(*args) * f->num_parameters);
+	if (!args) {
+		free(name);
+		subtilis_error_set_oom(err);
+		return 0;
+	}
+
+	args[0].type = SUBTILIS_IR_REG_TYPE_REAL;
+	args[0].reg = a.reg;
+	if (f->num_parameters > 1) {
+		args[1].type = SUBTILIS_IR_REG_TYPE_REAL;
+		args[1].reg = b.reg;
+	}
+
+	e = subtilis_exp_add_call(p, name, ftype, NULL, args,
+				  &subtilis_type_real, f->num_parameters, false,
+				  err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return 0;
+	res = e->exp.ir_op.reg;
+	subtilis_exp_delete(e);
+
+	return res;
+}
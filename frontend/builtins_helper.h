@@ -34,4 +34,18 @@ void subtilis_builtin_bzero_reg(subtilis_parser_t *p, size_t base_reg,
 				size_t loc, size_t size_reg,
 				subtilis_error_t *err);
 
+/*
+ * Emits code to compute the real function identified by itype, e.g.,
+ * SIN or POWR.  b is only used for POWR.  If the backend has no support
+ * for the transcendental functions a call to a builtin is emitted
+ * instead of the IR instruction.  Errors are not checked, so callers
+ * of LOG and LN need to do this themselves.  Returns the register
+ * holding the result.
+ */
+
+size_t subtilis_builtin_real_fn(subtilis_parser_t *p,
+				subtilis_op_instr_type_t itype,
+				subtilis_ir_operand_t a,
+				subtilis_ir_operand_t b, subtilis_error_t *err);
+
 #endif
@@ -16,6 +16,7 @@
 
 #include <math.h>
 
+#include "builtins_helper.h"
 #include "builtins_ir.h"
 #include "float64_type.h"
 #include "int32_type.h"
@@ -1272,8 +1273,8 @@ static subtilis_exp_t *prv_pow(subtilis_parser_t *p, subtilis_exp_t *a1,
 	}
 
 	a1->exp.ir_op.reg =
-	    subtilis_ir_section_add_instr(p->current, SUBTILIS_OP_INSTR_POWR,
-					  a1->exp.ir_op, a2->exp.ir_op, err);
+	    subtilis_builtin_real_fn(p, SUBTILIS_OP_INSTR_POWR, a1->exp.ir_op,
+				     a2->exp.ir_op, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto on_error;
 
@@ -19,26 +19,30 @@
 
 #include "hash_table.h"
 
+/* Buckets with a NULL key are empty. */
+
 struct subtilis_hashtable_node_t_ {
-	subtilis_hashtable_node_t *next;
+	size_t hash;
 	void *key;
 	void *value;
 };
 
-static void prv_free_bucket(subtilis_hashtable_t *h, size_t bucket)
+static size_t prv_round_up(size_t num_buckets)
 {
-	subtilis_hashtable_node_t *next;
-	subtilis_hashtable_node_t *node = h->buckets[bucket];
-
-	while (node) {
-		next = node->next;
-		if (h->free_key)
-			h->free_key(node->key);
-		if (h->free_value)
-			h->free_value(node->value);
-		free(node);
-		node = next;
-	}
+	size_t size = 8;
+
+	while (size < num_buckets)
+		size *= 2;
+
+	return size;
+}
+
+static void prv_free_node(subtilis_hashtable_t *h, subtilis_hashtable_node_t *n)
+{
+	if (h->free_key)
+		h->free_key(n->key);
+	if (h->free_value)
+		h->free_value(n->value);
 }
 
 subtilis_hashtable_t *subtilis_hashtable_new(size_t num_buckets,
@@ -53,12 +57,14 @@ subtilis_hashtable_t *subtilis_hashtable_new(size_t num_buckets,
 	if (!h)
 		goto on_error;
 
-	h->buckets = calloc(num_buckets, sizeof(subtilis_hashtable_node_t *));
+	num_buckets = prv_round_up(num_buckets);
+	h->buckets = calloc(num_buckets, sizeof(*h->buckets));
 	if (!h->buckets)
 		goto on_error;
 
 	h->num_buckets = num_buckets;
 	h->elements = 0;
+	h->resizes = 0;
 	h->hash_func = h_func;
 	h->equal_func = eq_func;
 	h->free_key = free_k;
@@ -82,120 +88,182 @@ void subtilis_hashtable_delete(subtilis_hashtable_t *h)
 
 	if (h->buckets) {
 		for (i = 0; i < h->num_buckets; i++)
-			prv_free_bucket(h, i);
+			if (h->buckets[i].key)
+				prv_free_node(h, &h->buckets[i]);
 		free(h->buckets);
 	}
 	free(h);
 }
 
-static subtilis_hashtable_node_t *prv_find_node(subtilis_hashtable_t *h,
-						const void *key, size_t hash)
+/*
+ * The string hash functions don't distribute similar keys well across
+ * the low order bits, which are all we use to select a bucket, so we
+ * mix the hash before masking it.
+ */
+
+static size_t prv_home(subtilis_hashtable_t *h, size_t hash)
 {
-	subtilis_hashtable_node_t *n;
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+
+	return hash & (h->num_buckets - 1);
+}
 
-	n = h->buckets[hash];
-	while (n && !h->equal_func(key, n->key))
-		n = n->next;
+static size_t prv_next(subtilis_hashtable_t *h, size_t bucket)
+{
+	return (bucket + 1) & (h->num_buckets - 1);
+}
 
-	if (!n)
-		return NULL;
+/*
+ * Returns the bucket containing key, or the empty bucket that
+ * terminated the search if the key isn't present.  The load factor
+ * guarantees that there is always at least one empty bucket.
+ */
+
+static size_t prv_find_bucket(subtilis_hashtable_t *h, const void *key,
+			      size_t hash)
+{
+	size_t i;
+	subtilis_hashtable_node_t *n;
 
-	return n;
+	for (i = prv_home(h, hash);; i = prv_next(h, i)) {
+		n = &h->buckets[i];
+		if (!n->key)
+			return i;
+		if ((n->hash == hash) && h->equal_func(key, n->key))
+			return i;
+	}
 }
 
 void *subtilis_hashtable_find(subtilis_hashtable_t *h, const void *k)
 {
 	size_t hash = h->hash_func(h, k);
-	subtilis_hashtable_node_t *n = prv_find_node(h, k, hash);
+	size_t i = prv_find_bucket(h, k, hash);
 
-	if (!n)
-		return NULL;
+	return h->buckets[i].value;
+}
+
+static void prv_grow(subtilis_hashtable_t *h, subtilis_error_t *err)
+{
+	size_t i;
+	size_t j;
+	size_t old_num_buckets = h->num_buckets;
+	subtilis_hashtable_node_t *old_buckets = h->buckets;
+	subtilis_hashtable_node_t *buckets;
 
-	return n->value;
+	buckets = calloc(old_num_buckets * 2, sizeof(*buckets));
+	if (!buckets) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	h->buckets = buckets;
+	h->num_buckets = old_num_buckets * 2;
+	h->resizes++;
+
+	for (i = 0; i < old_num_buckets; i++) {
+		if (!old_buckets[i].key)
+			continue;
+		for (j = prv_home(h, old_buckets[i].hash); buckets[j].key;
+		     j = prv_next(h, j))
+			;
+		buckets[j] = old_buckets[i];
+	}
+
+	free(old_buckets);
 }
 
 bool subtilis_hashtable_insert(subtilis_hashtable_t *h, void *k, void *v,
 			       subtilis_error_t *err)
 {
-	subtilis_hashtable_node_t *old_n;
+	size_t i;
+	subtilis_hashtable_node_t *n;
 	size_t hash = h->hash_func(h, k);
-	subtilis_hashtable_node_t *n = prv_find_node(h, k, hash);
 
-	if (n)
+	i = prv_find_bucket(h, k, hash);
+	if (h->buckets[i].key)
 		return false;
 
-	n = malloc(sizeof(*n));
-	if (!n) {
-		subtilis_error_set_oom(err);
-		return false;
+	if ((h->elements + 1) * 100 >
+	    h->num_buckets * SUBTILIS_HASHTABLE_MAX_LOAD) {
+		prv_grow(h, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return false;
+		i = prv_find_bucket(h, k, hash);
 	}
 
-	old_n = h->buckets[hash];
+	n = &h->buckets[i];
+	n->hash = hash;
 	n->key = k;
 	n->value = v;
-	n->next = old_n;
-	h->buckets[hash] = n;
 	h->elements++;
 
 	return true;
 }
 
-bool subtilis_hashtable_remove(subtilis_hashtable_t *h, const void *k)
+/*
+ * Removes the element in bucket i without leaving a tombstone.  Any
+ * elements in the same run of buckets that would no longer be reachable
+ * from their home bucket are shifted back to fill the gap.
+ */
+
+static void prv_remove_bucket(subtilis_hashtable_t *h, size_t i)
 {
+	size_t j;
+	size_t home;
 	subtilis_hashtable_node_t *n;
-	subtilis_hashtable_node_t *old_n = NULL;
-	size_t hash = h->hash_func(h, k);
 
-	n = h->buckets[hash];
-	while (n && !h->equal_func(k, n->key)) {
-		old_n = n;
-		n = n->next;
+	for (j = prv_next(h, i);; j = prv_next(h, j)) {
+		n = &h->buckets[j];
+		if (!n->key)
+			break;
+		home = prv_home(h, n->hash);
+
+		/*
+		 * The element in j can be moved to i if i lies cyclically
+		 * between its home bucket and j.
+		 */
+
+		if (((j > i) && ((home <= i) || (home > j))) ||
+		    ((j < i) && ((home <= i) && (home > j)))) {
+			h->buckets[i] = *n;
+			i = j;
+		}
 	}
 
-	if (!n)
-		return false;
+	h->buckets[i].key = NULL;
+	h->buckets[i].value = NULL;
+	h->elements--;
+}
 
-	if (h->free_key)
-		h->free_key(n->key);
-	if (h->free_value)
-		h->free_value(n->value);
-	if (old_n)
-		old_n->next = n->next;
-	else
-		h->buckets[hash] = n->next;
-	free(n);
+bool subtilis_hashtable_remove(subtilis_hashtable_t *h, const void *k)
+{
+	size_t hash = h->hash_func(h, k);
+	size_t i = prv_find_bucket(h, k, hash);
 
-	h->elements--;
+	if (!h->buckets[i].key)
+		return false;
+
+	prv_free_node(h, &h->buckets[i]);
+	prv_remove_bucket(h, i);
 
 	return true;
 }
 
 void *subtilis_hashtable_extract(subtilis_hashtable_t *h, const void *k)
 {
-	subtilis_hashtable_node_t *n;
 	void *retval;
-	subtilis_hashtable_node_t *old_n = NULL;
 	size_t hash = h->hash_func(h, k);
+	size_t i = prv_find_bucket(h, k, hash);
 
-	n = h->buckets[hash];
-	while (n && !h->equal_func(k, n->key)) {
-		old_n = n;
-		n = n->next;
-	}
-
-	if (!n)
+	if (!h->buckets[i].key)
 		return NULL;
 
-	retval = n->value;
+	retval = h->buckets[i].value;
 	if (h->free_key)
-		h->free_key(n->key);
-	if (old_n)
-		old_n->next = n->next;
-	else
-		h->buckets[hash] = n->next;
-	free(n);
-
-	h->elements--;
+		h->free_key(h->buckets[i].key);
+	prv_remove_bucket(h, i);
 
 	return retval;
 }
@@ -205,38 +273,57 @@ void subtilis_hashtable_reset(subtilis_hashtable_t *h)
 	size_t i;
 
 	for (i = 0; i < h->num_buckets; i++) {
-		prv_free_bucket(h, i);
-		h->buckets[i] = NULL;
+		if (!h->buckets[i].key)
+			continue;
+		prv_free_node(h, &h->buckets[i]);
+		h->buckets[i].key = NULL;
+		h->buckets[i].value = NULL;
 	}
+	h->elements = 0;
 }
 
-size_t subtilis_hashtable_perfection(subtilis_hashtable_t *h)
+void subtilis_hashtable_stats(subtilis_hashtable_t *h,
+			      subtilis_hashtable_stats_t *stats)
 {
 	size_t i;
-	subtilis_hashtable_node_t *n;
-	size_t percentage;
-	size_t list_count = 0;
-	size_t duplicates = 0;
+	size_t probe;
+	size_t home;
 
-	if (h->elements == 0)
-		return 100;
+	stats->elements = h->elements;
+	stats->num_buckets = h->num_buckets;
+	stats->resizes = h->resizes;
+	stats->max_probe = 0;
+	stats->total_probe = 0;
+	stats->home = 0;
 
 	for (i = 0; i < h->num_buckets; i++) {
-		n = h->buckets[i];
-		while (n) {
-			++list_count;
-			n = n->next;
-		}
+		if (!h->buckets[i].key)
+			continue;
+		home = prv_home(h, h->buckets[i].hash);
+		probe = ((i - home) & (h->num_buckets - 1)) + 1;
+		if (probe == 1)
+			stats->home++;
+		if (probe > stats->max_probe)
+			stats->max_probe = probe;
+		stats->total_probe += probe;
+	}
+}
 
-		if (list_count > 1)
-			duplicates += list_count - 1;
+/*
+ * Returns the percentage of elements that are stored in their home
+ * bucket.
+ */
 
-		list_count = 0;
-	}
+size_t subtilis_hashtable_perfection(subtilis_hashtable_t *h)
+{
+	subtilis_hashtable_stats_t stats;
+
+	if (h->elements == 0)
+		return 100;
 
-	percentage = 100 - ((duplicates * 100) / h->elements);
+	subtilis_hashtable_stats(h, &stats);
 
-	return percentage;
+	return (stats.home * 100) / stats.elements;
 }
 
 size_t subtilis_hashtable_sdbm(subtilis_hashtable_t *h, const void *k)
@@ -247,7 +334,7 @@ size_t subtilis_hashtable_sdbm(subtilis_hashtable_t *h, const void *k)
 	for (ch = (const char *)k; *ch; ch++)
 		hash = *ch + (hash << 6) + (hash << 16) - hash;
 
-	return hash % h->num_buckets;
+	return hash;
 }
 
 size_t subtilis_hashtable_djb2(subtilis_hashtable_t *h, const void *k)
@@ -258,7 +345,7 @@ size_t subtilis_hashtable_djb2(subtilis_hashtable_t *h, const void *k)
 	for (ch = (const char *)k; *ch; ch++)
 		hash = ((hash << 5) + hash) + *ch;
 
-	return hash % h->num_buckets;
+	return hash;
 }
 
 bool subtilis_hashtable_string_equal(const void *k1, const void *k2)
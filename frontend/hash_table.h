@@ -31,16 +31,45 @@ typedef void (*subtilis_hashtable_free_t)(void *);
 
 typedef struct subtilis_hashtable_node_t_ subtilis_hashtable_node_t;
 
+/*
+ * The hash table uses open addressing with linear probing.  The number
+ * of buckets is always a power of 2 and the table doubles in size when
+ * its load factor would exceed SUBTILIS_HASHTABLE_MAX_LOAD percent.  The
+ * hash function should return the full hash of the key.  The table
+ * stores this alongside the key and reduces it to a bucket index
+ * itself.
+ */
+
+#define SUBTILIS_HASHTABLE_MAX_LOAD 70
+
 struct subtilis_hashtable_t_ {
-	subtilis_hashtable_node_t **buckets;
+	subtilis_hashtable_node_t *buckets;
 	size_t elements;
 	size_t num_buckets;
+	size_t resizes;
 	subtilis_hashtable_func_t hash_func;
 	subtilis_hashtable_equal_t equal_func;
 	subtilis_hashtable_free_t free_key;
 	subtilis_hashtable_free_t free_value;
 };
 
+/*
+ * The probe length of an element is the number of buckets that need to
+ * be examined to find it.  An element stored in its home bucket has a
+ * probe length of 1.
+ */
+
+struct subtilis_hashtable_stats_t_ {
+	size_t elements;
+	size_t num_buckets;
+	size_t resizes;
+	size_t max_probe;
+	size_t total_probe;
+	size_t home;
+};
+
+typedef struct subtilis_hashtable_stats_t_ subtilis_hashtable_stats_t;
+
 subtilis_hashtable_t *subtilis_hashtable_new(size_t num_buckets,
 					     subtilis_hashtable_func_t h_func,
 					     subtilis_hashtable_equal_t eq_func,
@@ -51,6 +80,8 @@ subtilis_hashtable_t *subtilis_hashtable_new(size_t num_buckets,
 void *subtilis_hashtable_find(subtilis_hashtable_t *h, const void *k);
 void subtilis_hashtable_delete(subtilis_hashtable_t *h);
 size_t subtilis_hashtable_perfection(subtilis_hashtable_t *h);
+void subtilis_hashtable_stats(subtilis_hashtable_t *h,
+			      subtilis_hashtable_stats_t *stats);
 bool subtilis_hashtable_insert(subtilis_hashtable_t *h, void *k, void *v,
 			       subtilis_error_t *err);
 bool subtilis_hashtable_remove(subtilis_hashtable_t *h, const void *k);
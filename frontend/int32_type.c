@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "builtins_helper.h"
 #include "builtins_ir.h"
 #include "int32_type.h"
 #include "parser_exp.h"
@@ -1615,13 +1616,123 @@ static bool prv_optimise_div(subtilis_parser_t *p, subtilis_ir_operand_t a,
 	return true;
 }
 
+/*
+ * Computes the magic number and shift needed to replace a division by
+ * the constant d with a multiplication, using the method described in
+ * chapter 10 of Hacker's Delight.  d must not be 0, 1 or -1.
+ */
+
+static void prv_div_magic(int32_t d, int32_t *magic, int32_t *shift)
+{
+	int32_t p;
+	uint32_t ad;
+	uint32_t anc;
+	uint32_t delta;
+	uint32_t q1;
+	uint32_t r1;
+	uint32_t q2;
+	uint32_t r2;
+	uint32_t t;
+	const uint32_t two31 = 0x80000000;
+
+	ad = (d < 0) ? -(uint32_t)d : (uint32_t)d;
+	t = two31 + ((uint32_t)d >> 31);
+	anc = t - 1 - t % ad;
+	p = 31;
+	q1 = two31 / anc;
+	r1 = two31 - q1 * anc;
+	q2 = two31 / ad;
+	r2 = two31 - q2 * ad;
+	do {
+		p++;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= anc) {
+			q1++;
+			r1 -= anc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= ad) {
+			q2++;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	*magic = (int32_t)(q2 + 1);
+	if (d < 0)
+		*magic = -*magic;
+	*shift = p - 32;
+}
+
+/*
+ * Divides a by the constant b, which must not be 0, 1 or -1, by
+ * multiplying by a magic number and keeping the top 32 bits of the
+ * result.  This is much quicker than calling the division routine on
+ * backends that don't have a divide instruction.
+ */
+
+static size_t prv_div_by_magic(subtilis_parser_t *p, subtilis_ir_operand_t a,
+			       subtilis_ir_operand_t b, subtilis_error_t *err)
+{
+	int32_t magic;
+	int32_t shift;
+	subtilis_ir_operand_t c;
+	subtilis_ir_operand_t q;
+	subtilis_ir_operand_t tmp;
+
+	prv_div_magic(b.integer, &magic, &shift);
+
+	c.integer = magic;
+	tmp.reg = subtilis_ir_section_add_instr2(
+	    p->current, SUBTILIS_OP_INSTR_MOVI_I32, c, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return 0;
+
+	q.reg = subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_MULH_I32, a, tmp, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return 0;
+
+	if ((b.integer > 0) && (magic < 0)) {
+		q.reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_ADD_I32, q, a, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return 0;
+	} else if ((b.integer < 0) && (magic > 0)) {
+		q.reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_SUB_I32, q, a, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return 0;
+	}
+
+	if (shift > 0) {
+		c.integer = shift;
+		q.reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_ASRI_I32, q, c, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return 0;
+	}
+
+	/* Round towards zero by adding 1 if the quotient is negative. */
+
+	c.integer = 31;
+	tmp.reg = subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_LSRI_I32, q, c, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return 0;
+
+	return subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_ADD_I32, q, tmp, err);
+}
+
 static size_t prv_div_by_constant(subtilis_parser_t *p, subtilis_ir_operand_t a,
 				  subtilis_ir_operand_t b,
 				  subtilis_error_t *err)
 {
 	bool can_optimise;
 	subtilis_op_instr_type_t instr;
-	size_t reg;
 	size_t res = 0;
 
 	if (b.integer == 0) {
@@ -1640,14 +1751,7 @@ static size_t prv_div_by_constant(subtilis_parser_t *p, subtilis_ir_operand_t a,
 						     err);
 	}
 
-	reg = subtilis_ir_section_add_instr2(
-	    p->current, SUBTILIS_OP_INSTR_MOVI_I32, b, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return 0;
-
-	b.reg = reg;
-
-	return prv_div_mod_vars(p, a, b, SUBTILIS_OP_INSTR_DIV_I32, err);
+	return prv_div_by_magic(p, a, b, err);
 }
 
 static subtilis_exp_t *prv_div(subtilis_parser_t *p, subtilis_exp_t *a1,
@@ -1747,6 +1851,7 @@ static size_t prv_mod_by_constant(subtilis_parser_t *p, subtilis_ir_operand_t a,
 	bool can_optimise;
 	size_t reg;
 	size_t res = 0;
+	subtilis_ir_operand_t q;
 
 	if (b.integer == 0) {
 		subtilis_error_set_divide_by_zero(err, p->l->stream->name,
@@ -1758,6 +1863,22 @@ static size_t prv_mod_by_constant(subtilis_parser_t *p, subtilis_ir_operand_t a,
 	if ((err->type != SUBTILIS_ERROR_OK) || can_optimise)
 		return res;
 
+	if (!(p->backend.caps & SUBTILIS_BACKEND_HAVE_DIV)) {
+		/* a MOD b = a - (a DIV b) * b */
+
+		q.reg = prv_div_by_magic(p, a, b, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return 0;
+
+		q.reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_MULI_I32, q, b, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return 0;
+
+		return subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_SUB_I32, a, q, err);
+	}
+
 	reg = subtilis_ir_section_add_instr2(
 	    p->current, SUBTILIS_OP_INSTR_MOVI_I32, b, err);
 	if (err->type != SUBTILIS_ERROR_OK)
@@ -1940,8 +2061,8 @@ static subtilis_exp_t *prv_pow(subtilis_parser_t *p, subtilis_exp_t *a1,
 	}
 
 	a1->exp.ir_op.reg =
-	    subtilis_ir_section_add_instr(p->current, SUBTILIS_OP_INSTR_POWR,
-					  a1->exp.ir_op, a2->exp.ir_op, err);
+	    subtilis_builtin_real_fn(p, SUBTILIS_OP_INSTR_POWR, a1->exp.ir_op,
+				     a2->exp.ir_op, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto on_error;
 
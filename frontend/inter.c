@@ -34,7 +34,7 @@ static void prv_run_prog(subtilis_parser_t *p, int argc, char *argv[],
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	subitlis_vm_run(vm, &b, err);
+	subitlis_vm_run_bytecode(vm, &b, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -79,8 +79,16 @@ int main(int argc, char *argv[])
 		goto cleanup;
 
 	settings.handle_escapes = true;
+	settings.escape_policy = SUBTILIS_ESCAPE_POLICY_LOOP;
+	settings.escape_budget = SUBTILIS_CONFIG_ESCAPE_BUDGET;
 	settings.ignore_graphics_errors = true;
 	settings.check_mem_leaks = true;
+	settings.global_reg_alloc = false;
+	settings.opt_level = 0;
+	settings.jobs = 1;
+	settings.heap_slots = SUBTILIS_CONFIG_HEAP_SLOTS;
+	settings.trans_tier = SUBTILIS_TRANS_TIER_ACCURATE;
+	settings.check_next_use = false;
 
 	backend.caps = SUBTILIS_BACKEND_INTER_CAPS;
 	backend.sys_trans = NULL;
@@ -18,6 +18,8 @@
 #include <string.h>
 
 #include "../common/ir.h"
+#include "../common/ir_inline.h"
+#include "../common/ir_opt.h"
 #include "ir_test.h"
 #include "parser_test.h"
 
@@ -392,6 +394,7 @@ static int prv_check_matcher(subtilis_lexer_t *l, subtilis_parser_t *p,
 	const size_t rule_count =
 	    sizeof(raw_rules) / sizeof(subtilis_ir_rule_raw_t);
 	subtilis_ir_rule_t parsed[rule_count];
+	subtilis_ir_rules_t rules;
 	const size_t rule_order[] = {4, 5, 4, 5, 4, 5, 3, 5, 4, 5,
 				     6, 1, 6, 2, 5, 7, 7, 7, 8};
 
@@ -411,7 +414,8 @@ static int prv_check_matcher(subtilis_lexer_t *l, subtilis_parser_t *p,
 		return 1;
 	}
 
-	subtilis_ir_match(p->main, parsed, rule_count, &data, &err);
+	subtilis_ir_rules_init(&rules, parsed, rule_count);
+	subtilis_ir_match(p->main, &rules, &data, &err);
 	if (err.type != SUBTILIS_ERROR_OK) {
 		subtilis_error_fprintf(stderr, &err, true);
 		return 1;
@@ -451,6 +455,157 @@ static int prv_test_matcher(void)
 				   SUBTILIS_ERROR_OK, NULL, false);
 }
 
+static int prv_check_opt(subtilis_lexer_t *l, subtilis_parser_t *p,
+			 subtilis_error_type_t expected_err,
+			 const char *expected, bool mem_leaks_ok)
+{
+	subtilis_error_t err;
+	size_t i;
+	size_t old_len;
+	subtilis_ir_op_t *op;
+	bool found = false;
+
+	p->settings.check_mem_leaks = false;
+	subtilis_error_init(&err);
+	subtilis_parse(p, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stderr, &err, true);
+		return 1;
+	}
+
+	old_len = p->main->len;
+	subtilis_ir_opt_section(p->main, 2, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stderr, &err, true);
+		return 1;
+	}
+
+	if (p->main->len >= old_len) {
+		fprintf(stderr, "Section not reduced, %zu before, %zu after",
+			old_len, p->main->len);
+		return 1;
+	}
+
+	for (i = 0; i < p->main->len; i++) {
+		op = p->main->ops[i];
+		if (op->type != SUBTILIS_OP_INSTR)
+			continue;
+		if (op->op.instr.type == SUBTILIS_OP_INSTR_MUL_I32) {
+			fprintf(stderr, "muli32 not folded");
+			return 1;
+		}
+		if (op->op.instr.type == SUBTILIS_OP_INSTR_MOVI_I32 &&
+		    op->op.instr.operands[1].integer == 42)
+			found = true;
+	}
+
+	if (!found) {
+		fprintf(stderr, "movii32 #42 not found");
+		return 1;
+	}
+
+	return 0;
+}
+
+static int prv_test_opt(void)
+{
+	subtilis_backend_t backend;
+
+	memset(&backend, 0, sizeof(backend));
+	backend.caps = SUBTILIS_BACKEND_INTER_CAPS;
+
+	const char *source = "LOCAL a%\n"
+			     "LOCAL b%\n"
+			     "a% = 6\n"
+			     "b% = 7\n"
+			     "PRINT a% * b%\n";
+
+	printf("ir_test_opt");
+	return parser_test_wrapper(source, &backend, prv_check_opt, NULL, 0,
+				   SUBTILIS_ERROR_OK, NULL, false);
+}
+
+static int prv_check_inline(subtilis_lexer_t *l, subtilis_parser_t *p,
+			    subtilis_error_type_t expected_err,
+			    const char *expected, bool mem_leaks_ok)
+{
+	subtilis_error_t err;
+	size_t i;
+	subtilis_ir_op_t *op;
+	size_t old_regs;
+	subtilis_ir_section_t *add;
+	subtilis_ir_section_t *sq;
+	subtilis_ir_section_t *callee;
+	size_t muls = 0;
+
+	p->settings.check_mem_leaks = false;
+	subtilis_error_init(&err);
+	subtilis_parse(p, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stderr, &err, true);
+		return 1;
+	}
+
+	add = subtilis_ir_prog_find_section(p->prog, "add");
+	sq = subtilis_ir_prog_find_section(p->prog, "sq%");
+	old_regs = p->main->reg_counter;
+	subtilis_ir_inline_prog(p->prog, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stderr, &err, true);
+		return 1;
+	}
+
+	for (i = 0; i < p->main->len; i++) {
+		op = p->main->ops[i];
+		if ((op->type == SUBTILIS_OP_CALL) ||
+		    (op->type == SUBTILIS_OP_CALLI32)) {
+			callee = p->prog->sections[op->op.call.proc_id];
+			if ((callee == add) || (callee == sq)) {
+				fprintf(stderr, "call %zu not inlined",
+					op->op.call.proc_id);
+				return 1;
+			}
+		}
+		if ((op->type != SUBTILIS_OP_INSTR) ||
+		    (op->op.instr.type != SUBTILIS_OP_INSTR_MUL_I32))
+			continue;
+		if ((op->op.instr.operands[0].reg < old_regs) ||
+		    (op->op.instr.operands[0].reg >= p->main->reg_counter)) {
+			fprintf(stderr, "inlined register not renumbered");
+			return 1;
+		}
+		muls++;
+	}
+
+	if (muls != 2) {
+		fprintf(stderr, "expected 2 muli32s, found %zu", muls);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int prv_test_inline(void)
+{
+	subtilis_backend_t backend;
+
+	memset(&backend, 0, sizeof(backend));
+	backend.caps = SUBTILIS_BACKEND_INTER_CAPS;
+
+	const char *source = "x% = FNsq%(3)\n"
+			     "PROCadd(FNsq%(x%))\n"
+			     "PRINT x%\n"
+			     "DEF PROCadd(a%)\n"
+			     "  x% += a%\n"
+			     "ENDPROC\n"
+			     "DEF FNsq%(a%)\n"
+			     "<-a% * a%\n";
+
+	printf("ir_test_inline");
+	return parser_test_wrapper(source, &backend, prv_check_inline, NULL, 0,
+				   SUBTILIS_ERROR_OK, NULL, false);
+}
+
 int ir_test(void)
 {
 	int res;
@@ -461,6 +616,8 @@ int ir_test(void)
 	res |= prv_test_floating_rule();
 	res |= prv_test_label_rule();
 	res |= prv_test_matcher();
+	res |= prv_test_opt();
+	res |= prv_test_inline();
 
 	return res;
 }
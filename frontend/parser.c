@@ -118,10 +118,18 @@ on_error:
 void subtilis_parser_delete(subtilis_parser_t *p)
 {
 	size_t i;
+	subtilis_parser_loop_t *loop;
 
 	if (!p)
 		return;
 
+	while (p->loops) {
+		loop = p->loops;
+		p->loops = loop->next;
+		subtilis_sizet_vector_free(&loop->checks);
+		free(loop);
+	}
+
 	for (i = 0; i < p->num_calls; i++)
 		subtilis_parser_call_delete(p->calls[i]);
 	free(p->calls);
@@ -300,6 +308,23 @@ int subtilis_parser_if_compound(subtilis_parser_t *p, subtilis_token_t *t,
 	return key_type;
 }
 
+void subtilis_parser_alloc_scratch(subtilis_parser_t *p,
+				   subtilis_error_t *err)
+{
+	const subtilis_symbol_t *s;
+	size_t size = p->current->scratch_size;
+
+	if (p->current->scratch_ops_len == 0)
+		return;
+
+	s = subtilis_symbol_table_create_local_buf(
+	    p->local_st, (size + 3) & ~((size_t)3), err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_ir_section_set_scratch(p->current, (int32_t)s->loc);
+}
+
 static void prv_proc(subtilis_parser_t *p, subtilis_token_t *t,
 		     subtilis_error_t *err)
 {
@@ -513,6 +538,11 @@ static void prv_root(subtilis_parser_t *p, subtilis_token_t *t,
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
 	}
+
+	subtilis_parser_alloc_scratch(p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
 	p->main->locals = p->main_st->max_allocated;
 
 	subtilis_ir_section_add_label(p->current, p->current->end_label, err);
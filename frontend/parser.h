@@ -26,6 +26,53 @@
 #include "call.h"
 #include "symbol_table.h"
 
+/*
+ * A FOR or RANGE loop, currently being parsed, whose integer counter is
+ * known to lie between min and max inclusive at the start of each
+ * iteration, providing that the counter is not modified by the body of
+ * the loop.  body is the index in section of the first op of the loop.
+ * checks holds pairs of op indices delimiting the array bounds checks
+ * made redundant by this knowledge.
+ */
+
+typedef struct subtilis_parser_loop_t_ subtilis_parser_loop_t;
+
+struct subtilis_parser_loop_t_ {
+	subtilis_ir_section_t *section;
+	size_t reg;
+	int32_t min;
+	int32_t max;
+	size_t body;
+	subtilis_sizet_vector_t checks;
+	subtilis_parser_loop_t *next;
+};
+
+/*
+ * Tracks the escape testing for a loop currently being parsed.  These
+ * live on the stack of the function that parses the loop and are
+ * chained together, innermost first, through parent.  inner is set if
+ * another loop is found in the body of the loop in the same section.
+ * counter is the register holding the number of iterations left
+ * before the next test for escape when using
+ * SUBTILIS_ESCAPE_POLICY_BUDGET, or SIZE_MAX.  If the loop is a FOR
+ * loop known to iterate no more than trips times, providing that its
+ * counter, held in the register reg, is not modified by the body, reg
+ * and trips are set, and body is the index of the first op of the
+ * body.  Otherwise reg is SIZE_MAX.
+ */
+
+typedef struct subtilis_parser_escape_t_ subtilis_parser_escape_t;
+
+struct subtilis_parser_escape_t_ {
+	subtilis_ir_section_t *section;
+	bool inner;
+	size_t counter;
+	size_t reg;
+	uint32_t trips;
+	size_t body;
+	subtilis_parser_escape_t *parent;
+};
+
 struct subtilis_parser_t_ {
 	subtilis_lexer_t *l;
 	subtilis_backend_t backend;
@@ -45,6 +92,8 @@ struct subtilis_parser_t_ {
 	int32_t eflag_offset;
 	int32_t error_offset;
 	subtilis_settings_t settings;
+	subtilis_parser_loop_t *loops;
+	subtilis_parser_escape_t *escape;
 };
 
 typedef struct subtilis_parser_t_ subtilis_parser_t;
@@ -60,4 +109,13 @@ void subtilis_parser_statement(subtilis_parser_t *p, subtilis_token_t *t,
 int subtilis_parser_if_compound(subtilis_parser_t *p, subtilis_token_t *t,
 				subtilis_error_t *err);
 
+/*
+ * Allocates the scratch buffer, if any, requested by the current section
+ * on its stack.  Must be called once the section has been parsed, before
+ * its locals are computed.
+ */
+
+void subtilis_parser_alloc_scratch(subtilis_parser_t *p,
+				   subtilis_error_t *err);
+
 #endif
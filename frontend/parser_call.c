@@ -1309,6 +1309,10 @@ static void prv_def_internal(subtilis_parser_t *p, subtilis_token_t *t,
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto on_error;
 
+	subtilis_parser_alloc_scratch(p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto on_error;
+
 	p->current->locals = p->local_st->max_allocated;
 
 on_error:
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../common/ir_opt.h"
 #include "globals.h"
 #include "parser_array.h"
 #include "parser_call.h"
@@ -62,6 +63,137 @@ void subtilis_parser_handle_escape(subtilis_parser_t *p, subtilis_error_t *err)
 	subtilis_exp_handle_errors(p, err);
 }
 
+void subtilis_parser_loop_escape_start(subtilis_parser_t *p,
+				       subtilis_parser_escape_t *esc,
+				       size_t reg, uint32_t trips,
+				       subtilis_error_t *err)
+{
+	subtilis_ir_operand_t op;
+
+	esc->section = p->current;
+	esc->inner = false;
+	esc->counter = SIZE_MAX;
+	esc->reg = reg;
+	esc->trips = trips;
+	esc->body = p->current->len;
+	esc->parent = p->escape;
+	if (esc->parent && (esc->parent->section == p->current))
+		esc->parent->inner = true;
+	p->escape = esc;
+
+	if (!p->settings.handle_escapes || p->current->in_error_handler ||
+	    (p->settings.escape_policy != SUBTILIS_ESCAPE_POLICY_BUDGET))
+		return;
+
+	op.integer = (int32_t)p->settings.escape_budget;
+	esc->counter = subtilis_ir_section_add_instr2(
+	    p->current, SUBTILIS_OP_INSTR_MOVI_I32, op, err);
+}
+
+/*
+ * An innermost FOR loop that iterates a small, known, number of times
+ * cannot run for long, so there's no need for it to test for escape.
+ * We do need to check that the body of the loop doesn't modify the
+ * counter, otherwise the loop may never terminate.  The default policy
+ * promises a test on every iteration of every loop, so we only omit
+ * the test under the other policies.
+ */
+
+static bool prv_short_loop(subtilis_parser_t *p,
+			   const subtilis_parser_escape_t *esc)
+{
+	if ((p->settings.escape_policy == SUBTILIS_ESCAPE_POLICY_LOOP) ||
+	    (esc->reg == SIZE_MAX) || esc->inner ||
+	    (esc->trips > SUBTILIS_CONFIG_ESCAPE_SHORT_LOOP))
+		return false;
+
+	return !subtilis_ir_opt_reg_written(p->current, esc->body,
+					    p->current->len, esc->reg);
+}
+
+/*
+ * Decrements the loop's counter, only testing for escape and resetting
+ * the counter when it reaches 0.
+ */
+
+static void prv_escape_budget(subtilis_parser_t *p,
+			      const subtilis_parser_escape_t *esc,
+			      subtilis_error_t *err)
+{
+	subtilis_ir_operand_t counter;
+	subtilis_ir_operand_t op;
+	subtilis_ir_operand_t cond;
+	subtilis_ir_operand_t test_label;
+	subtilis_ir_operand_t skip_label;
+
+	counter.reg = esc->counter;
+	op.integer = 1;
+	subtilis_ir_section_add_instr_reg(
+	    p->current, SUBTILIS_OP_INSTR_SUBI_I32, counter, counter, op, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	op.integer = 0;
+	cond.reg = subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_EQI_I32, counter, op, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	test_label.label = subtilis_ir_section_new_label(p->current);
+	skip_label.label = subtilis_ir_section_new_label(p->current);
+	subtilis_ir_section_add_instr_reg(p->current, SUBTILIS_OP_INSTR_JMPC,
+					  cond, test_label, skip_label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_ir_section_add_label(p->current, test_label.label, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	op.integer = (int32_t)p->settings.escape_budget;
+	subtilis_ir_section_add_instr_no_reg2(
+	    p->current, SUBTILIS_OP_INSTR_MOVI_I32, counter, op, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_parser_handle_escape(p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_ir_section_add_label(p->current, skip_label.label, err);
+}
+
+void subtilis_parser_loop_escape_end(subtilis_parser_t *p,
+				     subtilis_error_t *err)
+{
+	subtilis_parser_escape_t *esc = p->escape;
+
+	p->escape = esc->parent;
+
+	if (!p->settings.handle_escapes || p->current->in_error_handler)
+		return;
+
+	if (prv_short_loop(p, esc))
+		return;
+
+	switch (p->settings.escape_policy) {
+	case SUBTILIS_ESCAPE_POLICY_OUTER:
+		if (esc->parent && (esc->parent->section == p->current))
+			return;
+		break;
+	case SUBTILIS_ESCAPE_POLICY_BUDGET:
+		if (esc->counter != SIZE_MAX) {
+			prv_escape_budget(p, esc, err);
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+
+	subtilis_parser_handle_escape(p, err);
+}
+
 void subtilis_parser_onerror(subtilis_parser_t *p, subtilis_token_t *t,
 			     subtilis_error_t *err)
 {
@@ -24,6 +24,23 @@ subtilis_exp_t *subtilis_parser_get_err(subtilis_parser_t *p,
 					subtilis_token_t *t,
 					subtilis_error_t *err);
 void subtilis_parser_handle_escape(subtilis_parser_t *p, subtilis_error_t *err);
+
+/*
+ * Loops call subtilis_parser_loop_escape_start before emitting their
+ * first label and subtilis_parser_loop_escape_end at their back edge,
+ * where any test for escape required by the escape policy is emitted.
+ * reg and trips describe the counter of a FOR loop with constant
+ * bounds that is known to iterate at most trips times.  reg should be
+ * SIZE_MAX for other loops.
+ */
+
+void subtilis_parser_loop_escape_start(subtilis_parser_t *p,
+				       subtilis_parser_escape_t *esc,
+				       size_t reg, uint32_t trips,
+				       subtilis_error_t *err);
+void subtilis_parser_loop_escape_end(subtilis_parser_t *p,
+				     subtilis_error_t *err);
+
 void subtilis_parser_onerror(subtilis_parser_t *p, subtilis_token_t *t,
 			     subtilis_error_t *err);
 void subtilis_parser_error(subtilis_parser_t *p, subtilis_token_t *t,
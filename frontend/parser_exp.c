@@ -34,6 +34,7 @@
 #include "parser_rnd.h"
 #include "parser_string.h"
 #include "reference_type.h"
+#include "string_type.h"
 #include "type_if.h"
 #include "variable.h"
 
@@ -638,6 +639,88 @@ cleanup:
 	return NULL;
 }
 
+static bool prv_is_string(subtilis_exp_t *e)
+{
+	return (e->type.type == SUBTILIS_TYPE_STRING) ||
+	       (e->type.type == SUBTILIS_TYPE_CONST_STRING);
+}
+
+/*
+ * Gathers a chain of string additions, e.g., a$ + b$ + c$ + d$, so that
+ * the result can be allocated once and each string copied straight into
+ * place, rather than creating and copying an intermediate string for each
+ * addition.  Adjacent constant strings are folded as they're parsed.  If
+ * we encounter an operand that isn't a string we stop gathering and add
+ * it to what we have so far in the normal way, so that the usual error
+ * gets reported.
+ */
+
+static subtilis_exp_t *prv_string_concat(subtilis_parser_t *p,
+					 subtilis_token_t *t,
+					 subtilis_exp_t *e1,
+					 subtilis_error_t *err)
+{
+	const char *tbuf;
+	size_t i;
+	subtilis_exp_t *e[SUBTILIS_CONFIG_CONCAT_MAX];
+	subtilis_exp_t *e2 = NULL;
+	size_t count = 1;
+
+	e[0] = e1;
+	while (t->type == SUBTILIS_TOKEN_OPERATOR) {
+		tbuf = subtilis_token_get_text(t);
+		if (strcmp(tbuf, "+"))
+			break;
+
+		subtilis_lexer_get(p->l, t, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+		e2 = prv_priority3(p, t, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		if (!prv_is_string(e2)) {
+			e1 = subtilis_string_type_concat(p, e, count, err);
+			count = 0;
+			if (err->type != SUBTILIS_ERROR_OK)
+				goto cleanup;
+			return subtilis_exp_add(p, e1, e2, err);
+		}
+
+		if ((e2->type.type == SUBTILIS_TYPE_CONST_STRING) &&
+		    (e[count - 1]->type.type == SUBTILIS_TYPE_CONST_STRING)) {
+			e[count - 1] =
+			    subtilis_exp_add(p, e[count - 1], e2, err);
+			e2 = NULL;
+			if (err->type != SUBTILIS_ERROR_OK) {
+				count--;
+				goto cleanup;
+			}
+			continue;
+		}
+
+		if (count == SUBTILIS_CONFIG_CONCAT_MAX) {
+			e[0] = subtilis_string_type_concat(p, e, count, err);
+			count = 0;
+			if (err->type != SUBTILIS_ERROR_OK)
+				goto cleanup;
+			count = 1;
+		}
+		e[count++] = e2;
+		e2 = NULL;
+	}
+
+	return subtilis_string_type_concat(p, e, count, err);
+
+cleanup:
+
+	for (i = 0; i < count; i++)
+		subtilis_exp_delete(e[i]);
+	subtilis_exp_delete(e2);
+
+	return NULL;
+}
+
 static subtilis_exp_t *prv_priority4(subtilis_parser_t *p, subtilis_token_t *t,
 				     subtilis_error_t *err)
 {
@@ -664,6 +747,12 @@ static subtilis_exp_t *prv_priority4(subtilis_parser_t *p, subtilis_token_t *t,
 
 	while (t->type == SUBTILIS_TOKEN_OPERATOR) {
 		tbuf = subtilis_token_get_text(t);
+		if (!strcmp(tbuf, "+") && prv_is_string(e1)) {
+			e1 = prv_string_concat(p, t, e1, err);
+			if (err->type != SUBTILIS_ERROR_OK)
+				goto cleanup;
+			continue;
+		}
 		if (!strcmp(tbuf, "+"))
 			exp_fn = subtilis_exp_add;
 		else if (!strcmp(tbuf, "-"))
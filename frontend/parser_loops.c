@@ -133,6 +133,8 @@ struct subtilis_for_context_t_ {
 	size_t reg;
 	size_t loc;
 	subtilis_type_t type;
+	bool bounded;
+	uint32_t trips;
 };
 
 typedef struct subtilis_for_context_t_ subtilis_for_context_t;
@@ -416,7 +418,7 @@ cleanup:
 
 static void prv_for_assignment(subtilis_parser_t *p, subtilis_token_t *t,
 			       subtilis_for_context_t *for_ctx, bool new_local,
-			       subtilis_error_t *err)
+			       subtilis_exp_t **start, subtilis_error_t *err)
 {
 	char *var_name;
 	const char *tbuf;
@@ -437,6 +439,13 @@ static void prv_for_assignment(subtilis_parser_t *p, subtilis_token_t *t,
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	if (e->type.type == SUBTILIS_TYPE_CONST_INTEGER &&
+	    for_ctx->type.type == SUBTILIS_TYPE_INTEGER) {
+		*start = subtilis_type_if_dup(e, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
 	/* Ownership of e is passed to the following functions. */
 
 	e = subtilis_type_if_coerce_type(p, e, &for_ctx->type, err);
@@ -471,16 +480,22 @@ cleanup:
 }
 
 static void prv_for_loop_start(subtilis_parser_t *p, subtilis_token_t *t,
+			       const subtilis_for_context_t *for_ctx,
 			       subtilis_ir_operand_t *start_label,
 			       subtilis_ir_operand_t *true_label,
 			       subtilis_error_t *err)
 {
+	subtilis_parser_escape_t esc;
+	size_t reg = (for_ctx->trips > 0) ? for_ctx->loc : SIZE_MAX;
+
 	start_label->reg = subtilis_ir_section_new_label(p->current);
-	subtilis_ir_section_add_label(p->current, start_label->reg, err);
+	true_label->reg = subtilis_ir_section_new_label(p->current);
+
+	subtilis_parser_loop_escape_start(p, &esc, reg, for_ctx->trips, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	subtilis_parser_handle_escape(p, err);
+	subtilis_ir_section_add_label(p->current, start_label->reg, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
@@ -488,7 +503,12 @@ static void prv_for_loop_start(subtilis_parser_t *p, subtilis_token_t *t,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	true_label->reg = subtilis_ir_section_new_label(p->current);
+	subtilis_parser_loop_escape_end(p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (for_ctx->bounded)
+		subtilis_array_loop_end(p);
 }
 
 static void prv_for_step_generic_var(subtilis_parser_t *p, subtilis_token_t *t,
@@ -508,7 +528,7 @@ static void prv_for_step_generic_var(subtilis_parser_t *p, subtilis_token_t *t,
 	subtilis_exp_t *conde = NULL;
 	subtilis_exp_t *zero = NULL;
 
-	prv_for_loop_start(p, t, &start_label, &true_label, err);
+	prv_for_loop_start(p, t, for_ctx, &start_label, &true_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -651,7 +671,7 @@ static void prv_for_step_int_var(subtilis_parser_t *p, subtilis_token_t *t,
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	prv_for_loop_start(p, t, &start_label, &true_label, err);
+	prv_for_loop_start(p, t, for_ctx, &start_label, &true_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -745,7 +765,7 @@ static void prv_for_step_const(subtilis_parser_t *p, subtilis_token_t *t,
 	subtilis_exp_t *conde = NULL;
 	subtilis_exp_t *var = NULL;
 
-	prv_for_loop_start(p, t, &start_label, &true_label, err);
+	prv_for_loop_start(p, t, for_ctx, &start_label, &true_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -793,7 +813,7 @@ static void prv_for_no_step(subtilis_parser_t *p, subtilis_token_t *t,
 	subtilis_exp_t *var = NULL;
 	subtilis_exp_t *conde = NULL;
 
-	prv_for_loop_start(p, t, &start_label, &true_label, err);
+	prv_for_loop_start(p, t, for_ctx, &start_label, &true_label, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -825,6 +845,64 @@ cleanup:
 	subtilis_exp_delete(to);
 }
 
+/*
+ * If the counter of the loop is an integer held in a register and the
+ * start, limit and step of the loop are all integer constants, we know
+ * the range of values the counter can take inside the loop, providing
+ * that the body of the loop doesn't modify it.  The body is always
+ * executed once, even if start is past the limit.  We need to be
+ * careful that the counter does not overflow when it's stepped past the
+ * limit, as the loop would not then terminate.
+ */
+
+static void prv_for_bounds(subtilis_parser_t *p,
+			   subtilis_for_context_t *for_ctx,
+			   subtilis_exp_t *start, subtilis_exp_t *to,
+			   subtilis_exp_t *step, subtilis_error_t *err)
+{
+	int64_t min;
+	int64_t max;
+	int64_t inc = 1;
+
+	if (!start || !for_ctx->is_reg ||
+	    (for_ctx->type.type != SUBTILIS_TYPE_INTEGER) ||
+	    (to->type.type != SUBTILIS_TYPE_CONST_INTEGER))
+		return;
+
+	if (step) {
+		if (step->type.type != SUBTILIS_TYPE_CONST_INTEGER)
+			return;
+		inc = step->exp.ir_op.integer;
+	}
+
+	min = start->exp.ir_op.integer;
+	max = to->exp.ir_op.integer;
+	if (min > max) {
+		max = min;
+		min = to->exp.ir_op.integer;
+	}
+
+	if ((max + inc > INT32_MAX) || (min + inc < INT32_MIN))
+		return;
+
+	subtilis_array_loop_start(p, for_ctx->loc, (int32_t)min, (int32_t)max,
+				  err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	for_ctx->bounded = true;
+
+	/*
+	 * A step of 0 never terminates.  Otherwise the counter can only
+	 * take each value between min and max once.
+	 */
+
+	if (inc < 0)
+		inc = -inc;
+	if ((inc != 0) && ((max - min) / inc < UINT32_MAX))
+		for_ctx->trips = (uint32_t)((max - min) / inc) + 1;
+}
+
 void subtilis_parser_for(subtilis_parser_t *p, subtilis_token_t *t,
 			 subtilis_error_t *err)
 {
@@ -834,11 +912,14 @@ void subtilis_parser_for(subtilis_parser_t *p, subtilis_token_t *t,
 	char *var_name = NULL;
 	subtilis_exp_t *to = NULL;
 	subtilis_exp_t *step = NULL;
+	subtilis_exp_t *start = NULL;
 	bool new_local = false;
 	subtilis_step_type_t step_type = SUBTILIS_STEP_MAX;
 
 	var_type.type = SUBTILIS_TYPE_VOID;
 	for_ctx.type.type = SUBTILIS_TYPE_VOID;
+	for_ctx.bounded = false;
+	for_ctx.trips = 0;
 
 	subtilis_lexer_get(p->l, t, err);
 	if (err->type != SUBTILIS_ERROR_OK)
@@ -885,7 +966,7 @@ void subtilis_parser_for(subtilis_parser_t *p, subtilis_token_t *t,
 	}
 	strcpy(var_name, tbuf);
 
-	prv_for_assignment(p, t, &for_ctx, new_local, err);
+	prv_for_assignment(p, t, &for_ctx, new_local, &start, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -910,6 +991,10 @@ void subtilis_parser_for(subtilis_parser_t *p, subtilis_token_t *t,
 		if (err->type != SUBTILIS_ERROR_OK)
 			goto cleanup;
 
+		prv_for_bounds(p, &for_ctx, start, to, step, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
 		/* Takes ownership of to and step */
 
 		if (step_type == SUBTILIS_STEP_VAR) {
@@ -928,6 +1013,10 @@ void subtilis_parser_for(subtilis_parser_t *p, subtilis_token_t *t,
 		}
 		step = NULL;
 	} else {
+		prv_for_bounds(p, &for_ctx, start, to, NULL, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
 		/* Takes ownership of to */
 
 		prv_for_no_step(p, t, to, &for_ctx, err);
@@ -944,6 +1033,7 @@ cleanup:
 	subtilis_type_free(&var_type);
 	subtilis_type_free(&for_ctx.type);
 	subtilis_exp_delete(step);
+	subtilis_exp_delete(start);
 	free(var_name);
 	subtilis_exp_delete(to);
 }
@@ -956,6 +1046,11 @@ void subtilis_parser_while(subtilis_parser_t *p, subtilis_token_t *t,
 	subtilis_ir_operand_t start_label;
 	subtilis_ir_operand_t true_label;
 	subtilis_ir_operand_t false_label;
+	subtilis_parser_escape_t esc;
+
+	subtilis_parser_loop_escape_start(p, &esc, SIZE_MAX, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
 
 	start_label.reg = subtilis_ir_section_new_label(p->current);
 	subtilis_ir_section_add_label(p->current, start_label.reg, err);
@@ -978,11 +1073,11 @@ void subtilis_parser_while(subtilis_parser_t *p, subtilis_token_t *t,
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	subtilis_parser_handle_escape(p, err);
+	subtilis_parser_compound(p, t, SUBTILIS_KEYWORD_ENDWHILE, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	subtilis_parser_compound(p, t, SUBTILIS_KEYWORD_ENDWHILE, err);
+	subtilis_parser_loop_escape_end(p, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -1010,6 +1105,11 @@ void subtilis_parser_repeat(subtilis_parser_t *p, subtilis_token_t *t,
 	subtilis_ir_operand_t cond;
 	subtilis_ir_operand_t start_label;
 	subtilis_ir_operand_t true_label;
+	subtilis_parser_escape_t esc;
+
+	subtilis_parser_loop_escape_start(p, &esc, SIZE_MAX, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
 
 	start_label.reg = subtilis_ir_section_new_label(p->current);
 	subtilis_ir_section_add_label(p->current, start_label.reg, err);
@@ -1020,11 +1120,11 @@ void subtilis_parser_repeat(subtilis_parser_t *p, subtilis_token_t *t,
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	subtilis_parser_handle_escape(p, err);
+	subtilis_parser_compound(p, t, SUBTILIS_KEYWORD_UNTIL, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	subtilis_parser_compound(p, t, SUBTILIS_KEYWORD_UNTIL, err);
+	subtilis_parser_loop_escape_end(p, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
@@ -1379,10 +1479,6 @@ static size_t prv_range_loop_start(subtilis_parser_t *p, subtilis_exp_t *e,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return SIZE_MAX;
 
-	subtilis_parser_handle_escape(p, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return SIZE_MAX;
-
 	if (range_vars[0].name) {
 		prv_assign_range_var(p, ptr, &range_vars[0], new_locals, err);
 		if (err->type != SUBTILIS_ERROR_OK)
@@ -1484,10 +1580,6 @@ static size_t prv_range_loop_start_index(subtilis_parser_t *p,
 			return SIZE_MAX;
 	}
 
-	subtilis_parser_handle_escape(p, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return SIZE_MAX;
-
 	if (range_vars[0].name) {
 		prv_assign_range_var(p, ptr, &range_vars[0], new_locals, err);
 		if (err->type != SUBTILIS_ERROR_OK)
@@ -1701,6 +1793,41 @@ static void prv_init_local_range_var(subtilis_parser_t *p, subtilis_token_t *t,
 	for_ctx->loc = s->loc;
 }
 
+/*
+ * The index variables of a range loop over an array whose dimensions are
+ * known at compile time run from 0 to the size of their dimension.
+ * Returns the number of loops registered with subtilis_array_loop_start.
+ */
+
+static size_t prv_range_bounds(subtilis_parser_t *p, subtilis_exp_t *e,
+			       size_t var_count,
+			       subtilis_range_var_t *range_vars,
+			       subtilis_error_t *err)
+{
+	size_t i;
+	int32_t dim_size;
+	subtilis_for_context_t *for_ctx;
+	size_t bounded = 0;
+
+	if (!subtilis_type_if_is_array(&e->type))
+		return 0;
+
+	for (i = 1; i < var_count; i++) {
+		for_ctx = &range_vars[i].for_ctx;
+		dim_size = e->type.params.array.dims[i - 1];
+		if (!for_ctx->is_reg ||
+		    (for_ctx->type.type != SUBTILIS_TYPE_INTEGER) ||
+		    (dim_size == SUBTILIS_DYNAMIC_DIMENSION))
+			continue;
+		subtilis_array_loop_start(p, for_ctx->loc, 0, dim_size, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return bounded;
+		bounded++;
+	}
+
+	return bounded;
+}
+
 static void prv_range_compound(subtilis_parser_t *p, subtilis_token_t *t,
 			       subtilis_exp_t *e, size_t var_count,
 			       bool new_locals,
@@ -1713,6 +1840,8 @@ static void prv_range_compound(subtilis_parser_t *p, subtilis_token_t *t,
 	subtilis_ir_operand_t ptr;
 	size_t i;
 	unsigned int start;
+	size_t bounded = 0;
+	subtilis_parser_escape_t esc;
 
 	/*
 	 * If they're global variables we need to create them at
@@ -1769,6 +1898,10 @@ static void prv_range_compound(subtilis_parser_t *p, subtilis_token_t *t,
 	start_label.label = subtilis_ir_section_new_label(p->current);
 	end_label.label = subtilis_ir_section_new_label(p->current);
 
+	subtilis_parser_loop_escape_start(p, &esc, SIZE_MAX, 0, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
 	if (var_count == 1)
 		ptr.reg = prv_range_loop_start(p, e, range_vars, start_label,
 					       end_label, new_locals, err);
@@ -1778,6 +1911,12 @@ static void prv_range_compound(subtilis_parser_t *p, subtilis_token_t *t,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	if (var_count > 1) {
+		bounded = prv_range_bounds(p, e, var_count, range_vars, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+
 	start = p->l->line;
 	while (t->type != SUBTILIS_TOKEN_EOF) {
 		if ((t->type == SUBTILIS_TOKEN_KEYWORD) &&
@@ -1794,12 +1933,19 @@ static void prv_range_compound(subtilis_parser_t *p, subtilis_token_t *t,
 		return;
 	}
 
+	for (i = 0; i < bounded; i++)
+		subtilis_array_loop_end(p);
+
 	var_reg.reg = SUBTILIS_IR_REG_LOCAL;
 	subtilis_reference_deallocate_refs(p, var_reg, p->local_st, p->level,
 					   err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	subtilis_parser_loop_escape_end(p, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
 	if (var_count == 1)
 		prv_range_loop_end(p, range_vars, ptr, start_label, end_label,
 				   err);
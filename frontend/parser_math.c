@@ -18,6 +18,7 @@
 #include <stdlib.h>
 
 #include "../common/lexer.h"
+#include "builtins_helper.h"
 #include "parser_exp.h"
 #include "parser_math.h"
 #include "type_if.h"
@@ -39,8 +40,8 @@ static subtilis_exp_t *prv_real_unary_fn(subtilis_parser_t *p,
 	if (e->type.type == SUBTILIS_TYPE_CONST_REAL) {
 		e2 = subtilis_exp_new_real(const_fn(e->exp.ir_op.real), err);
 	} else {
-		reg = subtilis_ir_section_add_instr2(p->current, itype,
-						     e->exp.ir_op, err);
+		reg = subtilis_builtin_real_fn(p, itype, e->exp.ir_op,
+					       e->exp.ir_op, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			goto cleanup;
 
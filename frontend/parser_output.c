@@ -14,14 +14,53 @@
  * limitations under the License.
  */
 
+#include <stdint.h>
 #include <string.h>
 
 #include "parser_exp.h"
 #include "parser_output.h"
+#include "string_type.h"
 #include "type_if.h"
 
-static void prv_vdu_byte(subtilis_parser_t *p, subtilis_exp_t *e,
-			 subtilis_error_t *err)
+/*
+ * The bytes of a VDU statement are gathered together and sent to the VDU
+ * driver in a single block write, rather than with one OS_WriteC per
+ * byte.  bytes holds the value of each byte that is known at compile
+ * time.  regs holds, for each byte, either the register that contains
+ * its value or SIZE_MAX if the byte is a constant.
+ */
+
+struct subtilis_vdu_run_t_ {
+	subtilis_buffer_t bytes;
+	subtilis_sizet_vector_t regs;
+};
+
+typedef struct subtilis_vdu_run_t_ subtilis_vdu_run_t;
+
+static void prv_vdu_run_init(subtilis_vdu_run_t *run)
+{
+	subtilis_buffer_init(&run->bytes, 32);
+	subtilis_sizet_vector_init(&run->regs);
+}
+
+static void prv_vdu_run_free(subtilis_vdu_run_t *run)
+{
+	subtilis_sizet_vector_free(&run->regs);
+	subtilis_buffer_free(&run->bytes);
+}
+
+static void prv_vdu_run_add(subtilis_vdu_run_t *run, uint8_t byte, size_t reg,
+			    subtilis_error_t *err)
+{
+	subtilis_buffer_append(&run->bytes, &byte, 1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_sizet_vector_append(&run->regs, reg, err);
+}
+
+static void prv_vdu_emit_byte(subtilis_parser_t *p, subtilis_exp_t *e,
+			      subtilis_error_t *err)
 {
 	subtilis_op_instr_type_t itype;
 
@@ -43,86 +82,172 @@ static void prv_vdu_byte(subtilis_parser_t *p, subtilis_exp_t *e,
 		subtilis_exp_handle_errors(p, err);
 }
 
-static void prv_vdu_2bytes(subtilis_parser_t *p, subtilis_exp_t *e,
-			   subtilis_error_t *err)
+static void prv_vdu_byte(subtilis_parser_t *p, subtilis_vdu_run_t *run,
+			 subtilis_exp_t *e, subtilis_error_t *err)
+{
+	if (e->type.type == SUBTILIS_TYPE_INTEGER)
+		prv_vdu_run_add(run, 0, e->exp.ir_op.reg, err);
+	else if (e->type.type == SUBTILIS_TYPE_CONST_INTEGER)
+		prv_vdu_run_add(run, e->exp.ir_op.integer & 0xff, SIZE_MAX,
+				err);
+	else
+		subtilis_error_set_assertion_failed(err);
+}
+
+static void prv_vdu_2bytes(subtilis_parser_t *p, subtilis_vdu_run_t *run,
+			   subtilis_exp_t *e, subtilis_error_t *err)
 {
 	subtilis_ir_operand_t op1;
 	subtilis_ir_operand_t op2;
+	size_t reg;
 
 	if (e->type.type == SUBTILIS_TYPE_INTEGER) {
-		op2.integer = 0xff;
-		op1.reg = subtilis_ir_section_add_instr(
-		    p->current, SUBTILIS_OP_INSTR_ANDI_I32, e->exp.ir_op, op2,
-		    err);
-		if (err->type != SUBTILIS_ERROR_OK)
-			return;
-		subtilis_ir_section_add_instr_no_reg(
-		    p->current, SUBTILIS_OP_INSTR_VDU, op1, err);
+		prv_vdu_run_add(run, 0, e->exp.ir_op.reg, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
-		if (!p->settings.ignore_graphics_errors) {
-			subtilis_exp_handle_errors(p, err);
-			if (err->type != SUBTILIS_ERROR_OK)
-				return;
-		}
 		op2.integer = 8;
-		op1.reg = subtilis_ir_section_add_instr(
+		reg = subtilis_ir_section_add_instr(
 		    p->current, SUBTILIS_OP_INSTR_LSRI_I32, e->exp.ir_op, op2,
 		    err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
-		subtilis_ir_section_add_instr_no_reg(
-		    p->current, SUBTILIS_OP_INSTR_VDU, op1, err);
-		if (err->type != SUBTILIS_ERROR_OK)
-			return;
+		prv_vdu_run_add(run, 0, reg, err);
 	} else if (e->type.type == SUBTILIS_TYPE_CONST_INTEGER) {
-		op1.integer = e->exp.ir_op.integer & 0xff;
-		subtilis_ir_section_add_instr_no_reg(
-		    p->current, SUBTILIS_OP_INSTR_VDUI, op1, err);
+		op1.integer = e->exp.ir_op.integer;
+		prv_vdu_run_add(run, op1.integer & 0xff, SIZE_MAX, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
-		if (!p->settings.ignore_graphics_errors) {
-			subtilis_exp_handle_errors(p, err);
-			if (err->type != SUBTILIS_ERROR_OK)
-				return;
-		}
-		op1.integer = (e->exp.ir_op.integer >> 8) & 0xff;
-		subtilis_ir_section_add_instr_no_reg(
-		    p->current, SUBTILIS_OP_INSTR_VDUI, op1, err);
+		prv_vdu_run_add(run, (op1.integer >> 8) & 0xff, SIZE_MAX, err);
 	} else {
 		subtilis_error_set_assertion_failed(err);
-		return;
 	}
-	if (!p->settings.ignore_graphics_errors)
-		subtilis_exp_handle_errors(p, err);
 }
 
-static void prv_vdu_1byte9zeros(subtilis_parser_t *p, subtilis_exp_t *e,
-				subtilis_error_t *err)
+static void prv_vdu_1byte9zeros(subtilis_parser_t *p, subtilis_vdu_run_t *run,
+				subtilis_exp_t *e, subtilis_error_t *err)
 {
 	size_t i;
-	subtilis_ir_operand_t op1;
 
-	prv_vdu_byte(p, e, err);
+	prv_vdu_byte(p, run, e, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	op1.integer = 0;
 	for (i = 0; i < 9; i++) {
-		subtilis_ir_section_add_instr_no_reg(
-		    p->current, SUBTILIS_OP_INSTR_VDUI, op1, err);
+		prv_vdu_run_add(run, 0, SIZE_MAX, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
-		if (!p->settings.ignore_graphics_errors) {
-			subtilis_exp_handle_errors(p, err);
+	}
+}
+
+/*
+ * Copies the bytes of a run that contains non-constant values into the
+ * section's scratch buffer, returning a register that points to the
+ * buffer.  All the runs in a section share the same buffer, which is
+ * sized to fit the largest of them.
+ */
+
+static size_t prv_vdu_stack_run(subtilis_parser_t *p, subtilis_vdu_run_t *run,
+				subtilis_error_t *err)
+{
+	size_t i;
+	size_t base;
+	size_t len = run->regs.len;
+	const uint8_t *bytes;
+	subtilis_ir_operand_t op0;
+	subtilis_ir_operand_t op1;
+	subtilis_ir_operand_t op2;
+
+	base = subtilis_ir_section_add_scratch(p->current, len, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return SIZE_MAX;
+
+	bytes = (const uint8_t *)subtilis_buffer_get_string(&run->bytes);
+	op1.reg = base;
+	for (i = 0; i < len; i++) {
+		if (run->regs.vals[i] != SIZE_MAX) {
+			op0.reg = run->regs.vals[i];
+		} else {
+			op2.integer = bytes[i];
+			op0.reg = subtilis_ir_section_add_instr2(
+			    p->current, SUBTILIS_OP_INSTR_MOVI_I32, op2, err);
 			if (err->type != SUBTILIS_ERROR_OK)
-				return;
+				return SIZE_MAX;
 		}
+		op2.integer = (int32_t)i;
+		subtilis_ir_section_add_instr_reg(p->current,
+						  SUBTILIS_OP_INSTR_STOREO_I8,
+						  op0, op1, op2, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return SIZE_MAX;
+	}
+
+	return base;
+}
+
+/*
+ * Writes the bytes gathered from a VDU statement.  Single bytes are still
+ * written with OS_WriteC as there's no point in setting up a block write
+ * for them.  Runs consisting entirely of constants are written directly
+ * from the constant pool.  Everything else is copied into the section's
+ * scratch buffer.  Note that the values of all the bytes are computed
+ * before any of them are written.
+ */
+
+static void prv_vdu_flush(subtilis_parser_t *p, subtilis_vdu_run_t *run,
+			  subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_exp_t *e;
+	size_t len = run->regs.len;
+	bool all_const = true;
+	subtilis_ir_operand_t op0;
+	subtilis_ir_operand_t op1;
+
+	if (len == 0)
+		return;
+
+	if (len == 1) {
+		if (run->regs.vals[0] != SIZE_MAX)
+			e = subtilis_exp_new_int32_var(run->regs.vals[0], err);
+		else
+			e = subtilis_exp_new_int32(
+			    (uint8_t)subtilis_buffer_get_string(&run->bytes)[0],
+			    err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		prv_vdu_emit_byte(p, e, err);
+		subtilis_exp_delete(e);
+		return;
 	}
+
+	for (i = 0; i < len && all_const; i++)
+		all_const = run->regs.vals[i] == SIZE_MAX;
+
+	if (all_const)
+		op0.reg = subtilis_string_type_lca_const(
+		    p, subtilis_buffer_get_string(&run->bytes), len, err);
+	else
+		op0.reg = prv_vdu_stack_run(p, run, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	op1.integer = (int32_t)len;
+	op1.reg = subtilis_ir_section_add_instr2(
+	    p->current, SUBTILIS_OP_INSTR_MOVI_I32, op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_ir_section_add_instr_no_reg2(
+	    p->current, SUBTILIS_OP_INSTR_PRINT_STR, op0, op1, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	if (!p->settings.ignore_graphics_errors)
+		subtilis_exp_handle_errors(p, err);
 }
 
 static void prv_vdu_brackets(subtilis_parser_t *p, subtilis_token_t *t,
-			     subtilis_error_t *err)
+			     subtilis_vdu_run_t *run, subtilis_error_t *err)
 {
 	subtilis_exp_t *e;
 	const char *tbuf;
@@ -143,18 +268,18 @@ static void prv_vdu_brackets(subtilis_parser_t *p, subtilis_token_t *t,
 		tbuf = subtilis_token_get_text(t);
 		if (t->type == SUBTILIS_TOKEN_OPERATOR) {
 			if (strcmp(tbuf, ",") == 0) {
-				prv_vdu_byte(p, e, err);
+				prv_vdu_byte(p, run, e, err);
 			} else if (strcmp(tbuf, "]") == 0) {
-				prv_vdu_byte(p, e, err);
+				prv_vdu_byte(p, run, e, err);
 				if (err->type != SUBTILIS_ERROR_OK)
 					goto cleanup;
 				subtilis_exp_delete(e);
 				e = NULL;
 				break;
 			} else if (strcmp(tbuf, ";") == 0) {
-				prv_vdu_2bytes(p, e, err);
+				prv_vdu_2bytes(p, run, e, err);
 			} else if (strcmp(tbuf, "|") == 0) {
-				prv_vdu_1byte9zeros(p, e, err);
+				prv_vdu_1byte9zeros(p, run, e, err);
 			} else {
 				subtilis_error_set_expected(
 				    err, ">, ','. ; or |", tbuf,
@@ -195,39 +320,12 @@ cleanup:
 	subtilis_exp_delete(e);
 }
 
-void subtilis_parser_vdu(subtilis_parser_t *p, subtilis_token_t *t,
-			 subtilis_error_t *err)
+static void prv_vdu_list(subtilis_parser_t *p, subtilis_token_t *t,
+			 subtilis_vdu_run_t *run, subtilis_error_t *err)
 {
 	subtilis_exp_t *e;
 	const char *tbuf;
 
-	/*
-	 * NOTE that there is a problem with the grammar here.  We cannot
-	 * allow a VDU statement to terminate with an operator otherwise
-	 * we will not know whether a variable following the operator
-	 * should be sent to the VDU driver or be used to assign a value to
-	 * a variable, e.g,
-	 *
-	 * VDU 19,2,4;0;
-	 * A% = 10
-	 *
-	 * will fail to parse.  Consequently, subtilis will allow
-	 *
-	 * VDU [19,2,4;0;]
-	 */
-
-	subtilis_lexer_get(p->l, t, err);
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
-	if (t->type == SUBTILIS_TOKEN_OPERATOR) {
-		tbuf = subtilis_token_get_text(t);
-		if (strcmp(tbuf, "[") == 0) {
-			prv_vdu_brackets(p, t, err);
-			return;
-		}
-	}
-
 	do {
 		e = subtilis_parser_priority7(p, t, err);
 		if (err->type != SUBTILIS_ERROR_OK)
@@ -240,11 +338,11 @@ void subtilis_parser_vdu(subtilis_parser_t *p, subtilis_token_t *t,
 		tbuf = subtilis_token_get_text(t);
 		if (t->type == SUBTILIS_TOKEN_OPERATOR) {
 			if (strcmp(tbuf, ",") == 0) {
-				prv_vdu_byte(p, e, err);
+				prv_vdu_byte(p, run, e, err);
 			} else if (strcmp(tbuf, ";") == 0) {
-				prv_vdu_2bytes(p, e, err);
+				prv_vdu_2bytes(p, run, e, err);
 			} else if (strcmp(tbuf, "|") == 0) {
-				prv_vdu_1byte9zeros(p, e, err);
+				prv_vdu_1byte9zeros(p, run, e, err);
 			} else {
 				subtilis_error_set_expected(
 				    err, ",. ; or |", tbuf, p->l->stream->name,
@@ -252,7 +350,7 @@ void subtilis_parser_vdu(subtilis_parser_t *p, subtilis_token_t *t,
 				goto cleanup;
 			}
 		} else {
-			prv_vdu_byte(p, e, err);
+			prv_vdu_byte(p, run, e, err);
 		}
 		if (err->type != SUBTILIS_ERROR_OK)
 			goto cleanup;
@@ -269,10 +367,54 @@ void subtilis_parser_vdu(subtilis_parser_t *p, subtilis_token_t *t,
 
 	} while (true);
 
+	return;
+
 cleanup:
 	subtilis_exp_delete(e);
 }
 
+void subtilis_parser_vdu(subtilis_parser_t *p, subtilis_token_t *t,
+			 subtilis_error_t *err)
+{
+	const char *tbuf;
+	subtilis_vdu_run_t run;
+
+	/*
+	 * NOTE that there is a problem with the grammar here.  We cannot
+	 * allow a VDU statement to terminate with an operator otherwise
+	 * we will not know whether a variable following the operator
+	 * should be sent to the VDU driver or be used to assign a value to
+	 * a variable, e.g,
+	 *
+	 * VDU 19,2,4;0;
+	 * A% = 10
+	 *
+	 * will fail to parse.  Consequently, subtilis will allow
+	 *
+	 * VDU [19,2,4;0;]
+	 */
+
+	subtilis_lexer_get(p->l, t, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	prv_vdu_run_init(&run);
+
+	tbuf = subtilis_token_get_text(t);
+	if ((t->type == SUBTILIS_TOKEN_OPERATOR) && (strcmp(tbuf, "[") == 0))
+		prv_vdu_brackets(p, t, &run, err);
+	else
+		prv_vdu_list(p, t, &run, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	prv_vdu_flush(p, &run, err);
+
+cleanup:
+
+	prv_vdu_run_free(&run);
+}
+
 static void prv_spc(subtilis_parser_t *p, subtilis_exp_t *e,
 		    subtilis_error_t *err)
 {
@@ -331,7 +473,7 @@ static void prv_spc(subtilis_parser_t *p, subtilis_exp_t *e,
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
-	prv_vdu_byte(p, space, err);
+	prv_vdu_emit_byte(p, space, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
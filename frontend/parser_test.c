@@ -24,6 +24,24 @@
 #include "parser.h"
 #include "vm.h"
 
+typedef struct subtilis_parser_test_fn_t_ subtilis_parser_test_fn_t;
+
+struct subtilis_parser_test_fn_t_ {
+	int (*fn)(subtilis_lexer_t *, subtilis_parser_t *,
+		  subtilis_error_type_t, const char *expected,
+		  bool mem_leaks_ok);
+};
+
+static int prv_call_test_fn(subtilis_lexer_t *l, subtilis_parser_t *p,
+			    subtilis_error_type_t expected_err,
+			    const char *expected, bool mem_leaks_ok,
+			    void *data)
+{
+	subtilis_parser_test_fn_t *test_fn = data;
+
+	return test_fn->fn(l, p, expected_err, expected, mem_leaks_ok);
+}
+
 int parser_test_wrapper(const char *text, const subtilis_backend_t *backend,
 			int (*fn)(subtilis_lexer_t *, subtilis_parser_t *,
 				  subtilis_error_type_t, const char *expected,
@@ -32,6 +50,23 @@ int parser_test_wrapper(const char *text, const subtilis_backend_t *backend,
 			size_t num_ass_keywords,
 			subtilis_error_type_t expected_err,
 			const char *expected, bool mem_leaks_ok)
+{
+	subtilis_parser_test_fn_t test_fn;
+
+	test_fn.fn = fn;
+	return parser_test_wrapper_data(text, backend, prv_call_test_fn,
+					&test_fn, ass_keywords,
+					num_ass_keywords, expected_err,
+					expected, mem_leaks_ok);
+}
+
+int parser_test_wrapper_data(
+    const char *text, const subtilis_backend_t *backend,
+    int (*fn)(subtilis_lexer_t *, subtilis_parser_t *, subtilis_error_type_t,
+	      const char *expected, bool mem_leaks_ok, void *data),
+    void *data, const subtilis_keyword_t *ass_keywords,
+    size_t num_ass_keywords, subtilis_error_type_t expected_err,
+    const char *expected, bool mem_leaks_ok)
 {
 	subtilis_stream_t s;
 	subtilis_error_t err;
@@ -54,14 +89,22 @@ int parser_test_wrapper(const char *text, const subtilis_backend_t *backend,
 	}
 
 	settings.handle_escapes = true;
+	settings.escape_policy = SUBTILIS_ESCAPE_POLICY_LOOP;
+	settings.escape_budget = SUBTILIS_CONFIG_ESCAPE_BUDGET;
 	settings.ignore_graphics_errors = true;
 	settings.check_mem_leaks = !mem_leaks_ok;
+	settings.global_reg_alloc = false;
+	settings.opt_level = 0;
+	settings.jobs = 1;
+	settings.heap_slots = SUBTILIS_CONFIG_HEAP_SLOTS;
+	settings.trans_tier = SUBTILIS_TRANS_TIER_ACCURATE;
+	settings.check_next_use = false;
 
 	p = subtilis_parser_new(l, backend, &settings, &err);
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto fail;
 
-	retval = fn(l, p, expected_err, expected, mem_leaks_ok);
+	retval = fn(l, p, expected_err, expected, mem_leaks_ok, data);
 
 	printf(": [%s]\n", retval ? "FAIL" : "OK");
 
@@ -153,6 +196,39 @@ static int prv_check_eval_res(subtilis_lexer_t *l, subtilis_parser_t *p,
 		goto cleanup;
 	}
 
+	/*
+	 * Check that the bytecode interpreter produces the same output as
+	 * the reference VM.
+	 */
+
+	subitlis_vm_delete(vm);
+	subtilis_buffer_reset(&b);
+
+	vm = subitlis_vm_new(p->prog, p->st, 2, argv, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stderr, &err, true);
+		goto cleanup;
+	}
+
+	subitlis_vm_run_bytecode(vm, &b, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stderr, &err, true);
+		goto cleanup;
+	}
+
+	subtilis_buffer_zero_terminate(&b, &err);
+	if (err.type != SUBTILIS_ERROR_OK) {
+		subtilis_error_fprintf(stderr, &err, true);
+		goto cleanup;
+	}
+
+	tbuf = subtilis_buffer_get_string(&b);
+	if (strcmp(tbuf, expected)) {
+		fprintf(stderr, "Expected result %s got %s (bytecode)\n",
+			expected, tbuf);
+		goto cleanup;
+	}
+
 	retval = 0;
 
 cleanup:
@@ -229,6 +305,105 @@ static int prv_test_print(void)
 				   SUBTILIS_ERROR_OK, "45\n", false);
 }
 
+/*
+ * Under the default policy each of the loops in this program should
+ * test for escape.  The outer policy omits the tests from the first
+ * loop, which is short, and the third, which is nested.  The budget
+ * policy omits the test only from the first loop.
+ */
+
+static const char *prv_escape_test = "dim a%(10)\n"
+				     "for i% := 0 to 10\n"
+				     "  a%(i%) = i%\n"
+				     "next\n"
+				     "s% := 0\n"
+				     "for j% := 1 to 300\n"
+				     "  k% := 0\n"
+				     "  while k% < 3\n"
+				     "    s% += a%(k%)\n"
+				     "    k% += 1\n"
+				     "  endwhile\n"
+				     "next\n"
+				     "for i% := 0 to 10\n"
+				     "  i% += 1\n"
+				     "next\n"
+				     "print s%\n";
+
+static int prv_check_escapes(subtilis_lexer_t *l, subtilis_parser_t *p,
+			     subtilis_escape_policy_t policy,
+			     size_t expected_tests)
+{
+	size_t i;
+	subtilis_ir_op_t *op;
+	size_t tests = 0;
+
+	p->settings.escape_policy = policy;
+	p->settings.escape_budget = 16;
+
+	if (prv_check_eval_res(l, p, SUBTILIS_ERROR_OK, "900\n", false))
+		return 1;
+
+	for (i = 0; i < p->main->len; i++) {
+		op = p->main->ops[i];
+		if ((op->type == SUBTILIS_OP_INSTR) &&
+		    (op->op.instr.type == SUBTILIS_OP_INSTR_TESTESC))
+			tests++;
+	}
+
+	if (tests != expected_tests) {
+		fprintf(stderr, "Expected %zu escape tests, found %zu\n",
+			expected_tests, tests);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int prv_check_escape_loop(subtilis_lexer_t *l, subtilis_parser_t *p,
+				 subtilis_error_type_t expected_err,
+				 const char *expected, bool mem_leaks_ok)
+{
+	return prv_check_escapes(l, p, SUBTILIS_ESCAPE_POLICY_LOOP, 4);
+}
+
+static int prv_check_escape_outer(subtilis_lexer_t *l, subtilis_parser_t *p,
+				  subtilis_error_type_t expected_err,
+				  const char *expected, bool mem_leaks_ok)
+{
+	return prv_check_escapes(l, p, SUBTILIS_ESCAPE_POLICY_OUTER, 2);
+}
+
+static int prv_check_escape_budget(subtilis_lexer_t *l, subtilis_parser_t *p,
+				   subtilis_error_type_t expected_err,
+				   const char *expected, bool mem_leaks_ok)
+{
+	return prv_check_escapes(l, p, SUBTILIS_ESCAPE_POLICY_BUDGET, 3);
+}
+
+static int prv_test_escape_policy(void)
+{
+	subtilis_backend_t backend;
+	int retval;
+
+	memset(&backend, 0, sizeof(backend));
+	backend.caps = SUBTILIS_BACKEND_INTER_CAPS;
+
+	printf("parser_escape_policy_loop");
+	retval = parser_test_wrapper(prv_escape_test, &backend,
+				     prv_check_escape_loop, NULL, 0,
+				     SUBTILIS_ERROR_OK, "", false);
+	printf("parser_escape_policy_outer");
+	retval |= parser_test_wrapper(prv_escape_test, &backend,
+				      prv_check_escape_outer, NULL, 0,
+				      SUBTILIS_ERROR_OK, "", false);
+	printf("parser_escape_policy_budget");
+	retval |= parser_test_wrapper(prv_escape_test, &backend,
+				      prv_check_escape_budget, NULL, 0,
+				      SUBTILIS_ERROR_OK, "", false);
+
+	return retval;
+}
+
 int parser_test(void)
 {
 	int failure = 0;
@@ -237,6 +412,7 @@ int parser_test(void)
 	failure |= prv_test_print();
 	failure |= prv_test_expressions();
 	failure |= prv_test_bad_cases();
+	failure |= prv_test_escape_policy();
 
 	return failure;
 }
@@ -29,4 +29,18 @@ int parser_test_wrapper(const char *text, const subtilis_backend_t *backend,
 			subtilis_error_type_t expected_err,
 			const char *expected, bool mem_leaks_ok);
 
+/*
+ * Identical to parser_test_wrapper except that data is passed through to
+ * fn.  Tests use this to pass options to fn and to retrieve statistics
+ * about the programs it compiles.
+ */
+
+int parser_test_wrapper_data(
+    const char *text, const subtilis_backend_t *backend,
+    int (*fn)(subtilis_lexer_t *, subtilis_parser_t *, subtilis_error_type_t,
+	      const char *expected, bool mem_leaks_ok, void *data),
+    void *data, const subtilis_keyword_t *ass_keywords,
+    size_t num_ass_keywords, subtilis_error_type_t expected_err,
+    const char *expected, bool mem_leaks_ok);
+
 #endif
@@ -579,6 +579,39 @@ void subtilis_reference_type_set_size(subtilis_parser_t *p, size_t mem_reg,
 	    p->current, SUBTILIS_OP_INSTR_STOREO_I32, op0, op1, op2, err);
 }
 
+/*
+ * Blocks allocated with more space than they currently need, e.g., to
+ * leave room for appends, record only the space they use so that the
+ * spare capacity is reported by BLOCK_FREE and can be filled in place by
+ * subsequent appends.
+ */
+
+static void prv_release_spare_capacity(subtilis_parser_t *p, size_t block_reg,
+				       size_t size_reg, size_t alloc_size_reg,
+				       subtilis_error_t *err)
+{
+	subtilis_ir_operand_t block;
+	subtilis_ir_operand_t size;
+	subtilis_ir_operand_t alloc_size;
+	subtilis_ir_operand_t delta;
+
+	if ((p->backend.caps & SUBTILIS_BACKEND_HAVE_ALLOC) ||
+	    (size_reg == alloc_size_reg))
+		return;
+
+	block.reg = block_reg;
+	size.reg = size_reg;
+	alloc_size.reg = alloc_size_reg;
+
+	delta.reg = subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_SUB_I32, size, alloc_size, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	subtilis_ir_section_add_instr_no_reg2(
+	    p->current, SUBTILIS_OP_INSTR_BLOCK_ADJUST, block, delta, err);
+}
+
 /* clang-format off */
 size_t subtilis_reference_type_re_malloc(subtilis_parser_t *p, size_t store_reg,
 					 size_t loc, size_t heap_reg,
@@ -597,6 +630,11 @@ size_t subtilis_reference_type_re_malloc(subtilis_parser_t *p, size_t store_reg,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return SIZE_MAX;
 
+	prv_release_spare_capacity(p, dest_reg, new_size_reg, alloc_size_reg,
+				   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return SIZE_MAX;
+
 	/*
 	 * There's no leak potential here as mempcy and deref cannot fail.
 	 */
@@ -1014,6 +1052,11 @@ static size_t prv_resize_with_malloc(subtilis_parser_t *p, size_t loc,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return SIZE_MAX;
 
+	prv_release_spare_capacity(p, new_block.reg, new_size_reg,
+				   alloc_size_reg, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return SIZE_MAX;
+
 	/*
 	 * We copy from the old data_reg not the heap_reg.  This means that when
 	 * this function exits, the data and heap regs will be the same even if
@@ -1236,6 +1279,11 @@ void subtilis_reference_type_grow(subtilis_parser_t *p, size_t a1_loc,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	prv_release_spare_capacity(p, dest_reg, new_size.reg, alloc_size_reg,
+				   err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
 	subtilis_reference_type_set_size(p, a1_mem_reg, a1_loc, new_size.reg,
 					 err);
 	if (err->type != SUBTILIS_ERROR_OK)
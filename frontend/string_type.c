@@ -3511,6 +3511,160 @@ cleanup:
 	return NULL;
 }
 
+static size_t prv_concat_compact(subtilis_exp_t **e, size_t count)
+{
+	size_t i;
+	size_t j = 0;
+
+	for (i = 0; i < count; i++) {
+		if ((e[i]->type.type == SUBTILIS_TYPE_CONST_STRING) &&
+		    (subtilis_buffer_get_size(&e[i]->exp.str) == 1) &&
+		    (j > 0 || i + 1 < count)) {
+			subtilis_exp_delete(e[i]);
+			continue;
+		}
+		e[j++] = e[i];
+	}
+
+	return j;
+}
+
+subtilis_exp_t *subtilis_string_type_concat(subtilis_parser_t *p,
+					    subtilis_exp_t **e, size_t count,
+					    subtilis_error_t *err)
+{
+	size_t i;
+	subtilis_ir_operand_t sizes[SUBTILIS_CONFIG_CONCAT_MAX];
+	subtilis_ir_operand_t data[SUBTILIS_CONFIG_CONCAT_MAX];
+	subtilis_ir_operand_t total;
+	subtilis_ir_operand_t delta;
+	subtilis_ir_operand_t op1;
+	const subtilis_symbol_t *s;
+	size_t heap_reg;
+	size_t dest_reg;
+	size_t ptr_reg;
+	char *a_tmp;
+	size_t copy_from = 0;
+	char *tmp_name = NULL;
+
+	if (count > SUBTILIS_CONFIG_CONCAT_MAX) {
+		subtilis_error_set_assertion_failed(err);
+		goto cleanup;
+	}
+
+	count = prv_concat_compact(e, count);
+	if (count < 3) {
+		if (count == 1)
+			return e[0];
+		return subtilis_type_if_add(p, e[0], e[1], err);
+	}
+
+	/*
+	 * If the first string is a temporary, e.g., the result of a function
+	 * call, we can grow it and append the other strings to it.
+	 * Otherwise we need a new temporary large enough to hold all the
+	 * strings.  Either way there's only one allocation.
+	 */
+
+	if ((e[0]->type.type == SUBTILIS_TYPE_STRING) && e[0]->temporary) {
+		tmp_name = e[0]->temporary;
+		e[0]->temporary = NULL;
+		copy_from = 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		(void)prv_get_string_details(p, e[i], &sizes[i], &data[i],
+					     &a_tmp, err);
+		e[i] = NULL;
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
+	total.reg = subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_ADD_I32, sizes[0], sizes[1], err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	for (i = 2; i < count; i++) {
+		total.reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_ADD_I32, total, sizes[i],
+		    err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
+	if (tmp_name) {
+		s = subtilis_symbol_table_lookup(p->local_st, tmp_name);
+		if (!s) {
+			subtilis_error_set_assertion_failed(err);
+			goto cleanup;
+		}
+		heap_reg = subtilis_reference_get_heap(p, SUBTILIS_IR_REG_LOCAL,
+						       s->loc, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		delta.reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_SUB_I32, total, sizes[0],
+		    err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		dest_reg = subtilis_reference_type_realloc(
+		    p, s->loc, SUBTILIS_IR_REG_LOCAL, heap_reg, data[0].reg,
+		    sizes[0].reg, total.reg, delta.reg, SIZE_MAX, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		op1.reg = dest_reg;
+		dest_reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_ADD_I32, op1, sizes[0], err);
+	} else {
+		s = subtilis_symbol_table_insert_tmp(
+		    p->local_st, &subtilis_type_string, &tmp_name, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		dest_reg = subtilis_reference_type_alloc(
+		    p, &subtilis_type_string, s->loc, SUBTILIS_IR_REG_LOCAL,
+		    total.reg, true, err);
+	}
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	for (i = copy_from; i < count; i++) {
+		subtilis_reference_type_memcpy_dest(p, dest_reg, data[i].reg,
+						    sizes[i].reg, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+
+		if (i + 1 == count)
+			break;
+
+		op1.reg = dest_reg;
+		dest_reg = subtilis_ir_section_add_instr(
+		    p->current, SUBTILIS_OP_INSTR_ADD_I32, op1, sizes[i], err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			goto cleanup;
+	}
+
+	ptr_reg = subtilis_reference_get_pointer(p, SUBTILIS_IR_REG_LOCAL,
+						 s->loc, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
+	return subtilis_exp_new_tmp_var(&subtilis_type_string, ptr_reg,
+					tmp_name, err);
+
+cleanup:
+
+	free(tmp_name);
+	for (i = 0; i < count; i++)
+		subtilis_exp_delete(e[i]);
+
+	return NULL;
+}
+
 void subtilis_string_type_add_eq(subtilis_parser_t *p, size_t store_reg,
 				 size_t loc, subtilis_exp_t *a2,
 				 subtilis_error_t *err)
@@ -3522,6 +3676,7 @@ void subtilis_string_type_add_eq(subtilis_parser_t *p, size_t store_reg,
 	subtilis_ir_operand_t op2;
 	subtilis_ir_operand_t a2_data;
 	subtilis_ir_operand_t store;
+	subtilis_ir_operand_t gran;
 	bool a2_gt_0;
 	subtilis_exp_t *e;
 
@@ -3544,8 +3699,27 @@ void subtilis_string_type_add_eq(subtilis_parser_t *p, size_t store_reg,
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
+	/*
+	 * Strings that are appended to are often appended to again, e.g.,
+	 * when building up a line of output in a loop.  If we need to
+	 * allocate a new block we add half the existing size again as
+	 * spare capacity so that subsequent appends can be performed in
+	 * place.
+	 */
+
+	op2.integer = 1;
+	gran.reg = subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_LSRI_I32, a1_size, op2, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
+	gran.reg = subtilis_ir_section_add_instr(
+	    p->current, SUBTILIS_OP_INSTR_ADD_I32, gran, a2_size, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+
 	e = subtilis_builtin_ir_call_ref_grow(p, store_reg, a1_size.reg,
-					      a2_size.reg, a2_size.reg, err);
+					      gran.reg, a2_size.reg, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 	dest_reg = e->exp.ir_op.reg;
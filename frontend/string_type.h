@@ -135,6 +135,17 @@ subtilis_exp_t *subtilis_string_type_string(subtilis_parser_t *p,
 subtilis_exp_t *subtilis_string_type_add(subtilis_parser_t *p,
 					 subtilis_exp_t *a1, subtilis_exp_t *a2,
 					 bool swapped, subtilis_error_t *err);
+
+/*
+ * Concatenates the count strings in e, consuming them.  The total length
+ * of the new string is computed up front so that only a single allocation
+ * is needed.  Empty constant strings are ignored.  count must not exceed
+ * SUBTILIS_CONFIG_CONCAT_MAX.
+ */
+
+subtilis_exp_t *subtilis_string_type_concat(subtilis_parser_t *p,
+					    subtilis_exp_t **e, size_t count,
+					    subtilis_error_t *err);
 void subtilis_string_type_add_eq(subtilis_parser_t *p, size_t store_reg,
 				 size_t loc, subtilis_exp_t *a2,
 				 subtilis_error_t *err);
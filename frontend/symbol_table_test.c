@@ -14,9 +14,13 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "symbol_table_test.h"
 
 #include "basic_keywords.h"
+#include "hash_table.h"
 #include "symbol_table.h"
 
 static int prv_test_type(subtilis_symbol_table_t *st, subtilis_token_t *t,
@@ -135,11 +139,151 @@ on_error:
 	return retval;
 }
 
+#define SUBTILIS_HASHTABLE_TEST_KEYS 10000
+
+static char *prv_hashtable_key(size_t i, subtilis_error_t *err)
+{
+	char *key;
+
+	key = malloc(32);
+	if (!key) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+	sprintf(key, "var%zu%%", i);
+
+	return key;
+}
+
+static int prv_check_keys(subtilis_hashtable_t *h, size_t removed)
+{
+	size_t i;
+	char key[32];
+	size_t *value;
+
+	for (i = 0; i < SUBTILIS_HASHTABLE_TEST_KEYS; i++) {
+		sprintf(key, "var%zu%%", i);
+		value = subtilis_hashtable_find(h, key);
+		if ((i % 3 == 0) && (i < removed)) {
+			if (value)
+				return 1;
+		} else if (!value || (*value != i)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int prv_test_hashtable(void)
+{
+	size_t i;
+	char *key;
+	char tmp[32];
+	size_t *value;
+	subtilis_error_t err;
+	subtilis_hashtable_stats_t stats;
+	subtilis_hashtable_t *h;
+	int retval = 1;
+
+	printf("hashtable_test");
+
+	subtilis_error_init(&err);
+
+	/*
+	 * Start with a tiny table to ensure that it has to be resized many
+	 * times.
+	 */
+
+	h = subtilis_hashtable_new(1, subtilis_hashtable_djb2,
+				   subtilis_hashtable_string_equal, free, free,
+				   &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto on_error;
+
+	for (i = 0; i < SUBTILIS_HASHTABLE_TEST_KEYS; i++) {
+		key = prv_hashtable_key(i, &err);
+		if (err.type != SUBTILIS_ERROR_OK)
+			goto on_error;
+		value = malloc(sizeof(*value));
+		if (!value) {
+			free(key);
+			goto on_error;
+		}
+		*value = i;
+		if (!subtilis_hashtable_insert(h, key, value, &err)) {
+			free(key);
+			free(value);
+			goto on_error;
+		}
+	}
+
+	if (h->elements != SUBTILIS_HASHTABLE_TEST_KEYS)
+		goto on_error;
+
+	if (prv_check_keys(h, 0))
+		goto on_error;
+
+	/* Duplicates should be rejected. */
+
+	sprintf(tmp, "var%d%%", 7);
+	if (subtilis_hashtable_insert(h, tmp, NULL, &err))
+		goto on_error;
+
+	/*
+	 * Remove every third key.  The remaining keys must still be
+	 * reachable after the removals have shifted them around.
+	 */
+
+	for (i = 0; i < SUBTILIS_HASHTABLE_TEST_KEYS; i += 3) {
+		sprintf(tmp, "var%zu%%", i);
+		if (!subtilis_hashtable_remove(h, tmp))
+			goto on_error;
+	}
+
+	if (prv_check_keys(h, SUBTILIS_HASHTABLE_TEST_KEYS))
+		goto on_error;
+
+	sprintf(tmp, "var%d%%", 1);
+	value = subtilis_hashtable_extract(h, tmp);
+	if (!value || (*value != 1))
+		goto on_error;
+	free(value);
+	if (subtilis_hashtable_find(h, tmp))
+		goto on_error;
+
+	subtilis_hashtable_stats(h, &stats);
+	if ((stats.elements != h->elements) || (stats.resizes == 0) ||
+	    (stats.elements * 100 >
+	     stats.num_buckets * SUBTILIS_HASHTABLE_MAX_LOAD))
+		goto on_error;
+
+	printf(" (avg probe %zu.%02zu max %zu)",
+	       stats.total_probe / stats.elements,
+	       ((stats.total_probe * 100) / stats.elements) % 100,
+	       stats.max_probe);
+
+	subtilis_hashtable_reset(h);
+	if ((h->elements != 0) || subtilis_hashtable_perfection(h) != 100)
+		goto on_error;
+
+	retval = 0;
+
+on_error:
+
+	subtilis_hashtable_delete(h);
+
+	printf(": [%s]\n", retval ? "FAIL" : "OK");
+
+	return retval;
+}
+
 int symbol_table_test(void)
 {
 	int failure = 0;
 
 	failure |= prv_test();
+	failure |= prv_test_hashtable();
 
 	return failure;
 }
@@ -23,38 +23,113 @@
 #include "../common/utils.h"
 #include "vm.h"
 
-static void prv_ensure_label_buffer(subitlis_vm_t *vm, size_t label,
-				    subtilis_error_t *err)
+static void prv_ensure_label_buffer(subtilis_vm_label_table_t *table,
+				    size_t label, subtilis_error_t *err)
 {
 	size_t new_max;
 	size_t *new_labels;
 
-	if (label < vm->max_labels)
+	if (label < table->max_labels)
 		return;
 
 	new_max = label + SUBTILIS_CONFIG_LABEL_GRAN;
-	new_labels = realloc(vm->labels, new_max * sizeof(size_t));
+	new_labels = realloc(table->labels, new_max * sizeof(size_t));
 	if (!new_labels) {
 		subtilis_error_set_oom(err);
 		return;
 	}
-	vm->max_labels = new_max;
-	vm->labels = new_labels;
+	table->max_labels = new_max;
+	table->labels = new_labels;
 }
 
-static void prv_compute_labels(subitlis_vm_t *vm, subtilis_error_t *err)
+static void prv_compute_labels(subtilis_vm_label_table_t *table,
+			       subtilis_ir_section_t *s, subtilis_error_t *err)
 {
 	size_t i;
 	size_t label;
 
-	for (i = 0; i < vm->s->len; i++) {
-		if (vm->s->ops[i]->type != SUBTILIS_OP_LABEL)
+	for (i = 0; i < s->len; i++) {
+		if (!s->ops[i] || s->ops[i]->type != SUBTILIS_OP_LABEL)
 			continue;
-		label = vm->s->ops[i]->op.label;
-		prv_ensure_label_buffer(vm, label, err);
+		label = s->ops[i]->op.label;
+		prv_ensure_label_buffer(table, label, err);
 		if (err->type != SUBTILIS_ERROR_OK)
 			return;
-		vm->labels[label] = i;
+		table->labels[label] = i;
+	}
+}
+
+static void prv_compute_all_labels(subitlis_vm_t *vm, subtilis_error_t *err)
+{
+	size_t i;
+
+	vm->label_tables =
+	    calloc(vm->p->num_sections, sizeof(*vm->label_tables));
+	if (!vm->label_tables) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < vm->p->num_sections; i++) {
+		prv_compute_labels(&vm->label_tables[i], vm->p->sections[i],
+				   err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+}
+
+static void prv_set_section(subitlis_vm_t *vm, size_t section_index)
+{
+	vm->labels = vm->label_tables[section_index].labels;
+	vm->max_labels = vm->label_tables[section_index].max_labels;
+	if (vm->bytecode)
+		vm->code = vm->bytecode[section_index];
+}
+
+/*
+ * Ensures that there's enough space on the register stacks for windows of
+ * reg_count and freg_count registers starting at reg_base and freg_base.
+ * The stacks may move, so vm->regs and vm->fregs need to be recomputed by
+ * the caller.  Newly allocated registers are zeroed.
+ */
+
+static void prv_reserve_regs(subitlis_vm_t *vm, size_t reg_base,
+			     size_t reg_count, size_t freg_base,
+			     size_t freg_count, subtilis_error_t *err)
+{
+	size_t new_max;
+	int32_t *new_regs;
+	double *new_fregs;
+
+	if (reg_base + reg_count > vm->reg_stack_size) {
+		new_max = vm->reg_stack_size * 2;
+		if (new_max < reg_base + reg_count)
+			new_max = reg_base + reg_count;
+		new_regs = realloc(vm->reg_stack, new_max * sizeof(*new_regs));
+		if (!new_regs) {
+			subtilis_error_set_oom(err);
+			return;
+		}
+		memset(&new_regs[vm->reg_stack_size], 0,
+		       (new_max - vm->reg_stack_size) * sizeof(*new_regs));
+		vm->reg_stack = new_regs;
+		vm->reg_stack_size = new_max;
+	}
+
+	if (freg_base + freg_count > vm->freg_stack_size) {
+		new_max = vm->freg_stack_size * 2;
+		if (new_max < freg_base + freg_count)
+			new_max = freg_base + freg_count;
+		new_fregs =
+		    realloc(vm->freg_stack, new_max * sizeof(*new_fregs));
+		if (!new_fregs) {
+			subtilis_error_set_oom(err);
+			return;
+		}
+		memset(&new_fregs[vm->freg_stack_size], 0,
+		       (new_max - vm->freg_stack_size) * sizeof(*new_fregs));
+		vm->freg_stack = new_fregs;
+		vm->freg_stack_size = new_max;
 	}
 }
 
@@ -106,17 +181,11 @@ subitlis_vm_t *subitlis_vm_new(subtilis_ir_prog_t *p,
 	vm->max_fregs = vm->s->freg_counter;
 	vm->st = st;
 
-	vm->regs = calloc(sizeof(int32_t), vm->max_regs);
-	if (!vm->regs) {
-		subtilis_error_set_oom(err);
-		goto fail;
-	}
-
-	vm->fregs = calloc(sizeof(double), vm->max_fregs);
-	if (!vm->fregs) {
-		subtilis_error_set_oom(err);
+	prv_reserve_regs(vm, 0, vm->max_regs, 0, vm->max_fregs, err);
+	if (err->type != SUBTILIS_ERROR_OK)
 		goto fail;
-	}
+	vm->regs = vm->reg_stack;
+	vm->fregs = vm->freg_stack;
 
 	const_size = subtilis_constant_pool_mem_size(p->constant_pool,
 						     &vm->constants, err);
@@ -158,9 +227,10 @@ subitlis_vm_t *subitlis_vm_new(subtilis_ir_prog_t *p,
 	    vm->regs[SUBTILIS_IR_REG_GLOBAL] + st->max_allocated;
 	vm->top = vm->memory_size;
 
-	prv_compute_labels(vm, err);
+	prv_compute_all_labels(vm, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		goto fail;
+	prv_set_section(vm, 0);
 
 	subtilis_vm_heap_init(&vm->heap);
 	vm->heap.free_list =
@@ -213,6 +283,15 @@ static void prv_muli32(subitlis_vm_t *vm, subtilis_buffer_t *b,
 	vm->regs[ops[0].reg] = vm->regs[ops[1].reg] * vm->regs[ops[2].reg];
 }
 
+static void prv_mulhi32(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	int64_t res =
+	    (int64_t)vm->regs[ops[1].reg] * (int64_t)vm->regs[ops[2].reg];
+
+	vm->regs[ops[0].reg] = (int32_t)(res >> 32);
+}
+
 static void prv_mulr(subitlis_vm_t *vm, subtilis_buffer_t *b,
 		     subtilis_ir_operand_t *ops, subtilis_error_t *err)
 {
@@ -634,7 +713,7 @@ static void prv_jmpc(subitlis_vm_t *vm, subtilis_buffer_t *b,
 	size_t label;
 
 	label = (vm->regs[ops[0].reg]) ? ops[1].label : ops[2].label;
-	if (label > vm->max_labels) {
+	if (label >= vm->max_labels) {
 		subtilis_error_set_assertion_failed(err);
 		return;
 	}
@@ -651,7 +730,7 @@ static void prv_jmp(subitlis_vm_t *vm, subtilis_buffer_t *b,
 	size_t label;
 
 	label = ops[0].label;
-	if (label > vm->max_labels) {
+	if (label >= vm->max_labels) {
 		subtilis_error_set_assertion_failed(err);
 		return;
 	}
@@ -663,43 +742,22 @@ static void prv_jmp(subitlis_vm_t *vm, subtilis_buffer_t *b,
 }
 
 static void prv_set_args(subitlis_vm_t *vm, subtilis_ir_call_t *call,
-			 subtilis_error_t *err)
+			 int32_t *regs, double *fregs)
 {
 	size_t i;
 	size_t int_args = 0;
 	size_t real_args = 0;
-	double *real_args_copy = NULL;
-	int32_t *int_args_copy = NULL;
 
-	real_args_copy = malloc(sizeof(double) * call->arg_count);
-	if (!real_args_copy) {
-		subtilis_error_set_oom(err);
-		return;
-	}
-
-	int_args_copy = malloc(sizeof(int32_t) * call->arg_count);
-	if (!real_args_copy) {
-		free(real_args_copy);
-		subtilis_error_set_oom(err);
-		return;
-	}
+	for (i = 0; i < SUBTILIS_IR_REG_TEMP_START; i++)
+		regs[i] = vm->regs[i];
 
 	for (i = 0; i < call->arg_count; i++) {
 		if (call->args[i].type == SUBTILIS_IR_REG_TYPE_REAL)
-			real_args_copy[real_args++] =
-			    vm->fregs[call->args[i].reg];
+			fregs[real_args++] = vm->fregs[call->args[i].reg];
 		else
-			int_args_copy[int_args++] = vm->regs[call->args[i].reg];
+			regs[SUBTILIS_IR_REG_TEMP_START + int_args++] =
+			    vm->regs[call->args[i].reg];
 	}
-
-	for (i = 0; i < int_args; i++)
-		vm->regs[SUBTILIS_IR_REG_TEMP_START + i] = int_args_copy[i];
-
-	for (i = 0; i < real_args; i++)
-		vm->fregs[i] = real_args_copy[i];
-
-	free(int_args_copy);
-	free(real_args_copy);
 }
 
 static void prv_memseti32(subitlis_vm_t *vm, subtilis_ir_call_t *call,
@@ -806,15 +864,42 @@ static void prv_handle_builtin(subitlis_vm_t *vm, subtilis_builtin_type_t ftype,
 	}
 }
 
+static void prv_push_frame_int(subitlis_vm_t *vm, size_t val)
+{
+	int32_t num = (int32_t)val;
+
+	memcpy(&vm->memory[vm->top], &num, sizeof(num));
+	vm->top += sizeof(num);
+}
+
+static size_t prv_pop_frame_int(subitlis_vm_t *vm)
+{
+	int32_t num;
+
+	vm->top -= sizeof(num);
+	memcpy(&num, &vm->memory[vm->top], sizeof(num));
+	return (size_t)num;
+}
+
+/*
+ * The callee gets a new register window directly above that of the caller
+ * so the caller's registers do not need to be saved.  The only registers
+ * that are copied are the arguments and the fixed registers.  The frame
+ * record pushed onto the stack contains the bases of the caller's
+ * register windows, its pc, its section index and, for functions, the
+ * register into which the return value should be written.
+ */
+
 static void prv_call(subitlis_vm_t *vm, subtilis_buffer_t *b,
 		     const subtilis_type_t *call_type, subtilis_ir_call_t *call,
 		     size_t section_index, subtilis_error_t *err)
 {
-	int32_t num;
 	subtilis_ir_section_t *s;
-	int32_t *new_regs;
-	double *new_fregs;
 	size_t space_needed;
+	size_t reg_base;
+	size_t freg_base;
+	size_t reg_count;
+	size_t freg_count;
 
 	if (section_index >= vm->p->num_sections) {
 		subtilis_error_set_assertion_failed(err);
@@ -827,66 +912,46 @@ static void prv_call(subitlis_vm_t *vm, subtilis_buffer_t *b,
 		return;
 	}
 
-	if (s->reg_counter > vm->max_regs) {
-		new_regs =
-		    realloc(vm->regs, sizeof(*vm->regs) * s->reg_counter);
-		if (!new_regs) {
-			subtilis_error_set_oom(err);
-			return;
-		}
-		vm->regs = new_regs;
-		vm->max_regs = s->reg_counter;
-	}
+	reg_base = vm->reg_base + vm->max_regs;
+	reg_count = s->reg_counter;
+	if (reg_count < SUBTILIS_IR_REG_TEMP_START + call->arg_count)
+		reg_count = SUBTILIS_IR_REG_TEMP_START + call->arg_count;
+	freg_base = vm->freg_base + vm->max_fregs;
+	freg_count = s->freg_counter;
+	if (freg_count < call->arg_count)
+		freg_count = call->arg_count;
 
-	if (s->freg_counter > vm->max_fregs) {
-		new_fregs =
-		    realloc(vm->fregs, sizeof(*vm->fregs) * s->freg_counter);
-		if (!new_fregs) {
-			subtilis_error_set_oom(err);
-			return;
-		}
-		vm->fregs = new_fregs;
-		vm->max_fregs = s->freg_counter;
-	}
+	prv_reserve_regs(vm, reg_base, reg_count, freg_base, freg_count, err);
+	if (err->type != SUBTILIS_ERROR_OK)
+		return;
+	vm->regs = &vm->reg_stack[vm->reg_base];
+	vm->fregs = &vm->freg_stack[vm->freg_base];
 
-	space_needed = ((vm->s->label_counter) * sizeof(*vm->labels));
-	space_needed += ((vm->s->reg_counter + 2) * sizeof(*vm->regs));
-	space_needed += ((vm->s->freg_counter) * sizeof(*vm->fregs));
-	space_needed += s->locals;
+	space_needed = 4 * sizeof(int32_t) + s->locals;
 	if (call_type->type != SUBTILIS_TYPE_VOID)
-		space_needed += sizeof(*vm->regs);
+		space_needed += sizeof(int32_t);
 	prv_reserve_stack(vm, space_needed, err);
 	if (err->type != SUBTILIS_ERROR_OK)
 		return;
 
-	memcpy(&vm->memory[vm->top], &vm->labels[0],
-	       vm->s->label_counter * sizeof(*vm->labels));
-	vm->top += vm->s->label_counter * sizeof(*vm->labels);
-	memcpy(&vm->memory[vm->top], &vm->regs[0],
-	       vm->s->reg_counter * sizeof(*vm->regs));
-	vm->top += vm->s->reg_counter * sizeof(*vm->regs);
-
-	memcpy(&vm->memory[vm->top], &vm->fregs[0],
-	       vm->s->freg_counter * sizeof(*vm->fregs));
-	vm->top += vm->s->freg_counter * sizeof(*vm->fregs);
+	prv_set_args(vm, call, &vm->reg_stack[reg_base],
+		     &vm->freg_stack[freg_base]);
 
-	num = (int32_t)vm->pc;
-	memcpy(&vm->memory[vm->top], &num, sizeof(num));
-	vm->top += 4;
-	num = (int32_t)vm->current_index;
-	memcpy(&vm->memory[vm->top], &num, sizeof(num));
-	vm->top += 4;
-	if (call_type->type != SUBTILIS_TYPE_VOID) {
-		num = (int32_t)call->reg;
-		memcpy(&vm->memory[vm->top], &num, sizeof(num));
-		vm->top += 4;
-	}
-	prv_set_args(vm, call, err);
+	prv_push_frame_int(vm, vm->reg_base);
+	prv_push_frame_int(vm, vm->freg_base);
+	prv_push_frame_int(vm, vm->pc);
+	prv_push_frame_int(vm, vm->current_index);
+	if (call_type->type != SUBTILIS_TYPE_VOID)
+		prv_push_frame_int(vm, call->reg);
+
+	vm->reg_base = reg_base;
+	vm->max_regs = reg_count;
+	vm->regs = &vm->reg_stack[reg_base];
+	vm->freg_base = freg_base;
+	vm->max_fregs = freg_count;
+	vm->fregs = &vm->freg_stack[freg_base];
 	vm->regs[SUBTILIS_IR_REG_LOCAL] = vm->top;
 
-	if (err->type != SUBTILIS_ERROR_OK)
-		return;
-
 	if (s->locals > 0) {
 		memset(&vm->memory[vm->top], 0, s->locals);
 		vm->top += s->locals;
@@ -895,8 +960,7 @@ static void prv_call(subitlis_vm_t *vm, subtilis_buffer_t *b,
 	vm->s = s;
 	vm->current_index = section_index;
 	vm->pc = -1;
-
-	prv_compute_labels(vm, err);
+	prv_set_section(vm, section_index);
 }
 
 static void prv_call_direct(subitlis_vm_t *vm, subtilis_buffer_t *b,
@@ -918,59 +982,47 @@ static size_t prv_ret_gen(subitlis_vm_t *vm, const subtilis_type_t *call_type,
 			  subtilis_error_t *err)
 {
 	size_t caller_index;
-	subtilis_ir_section_t *cs;
 	size_t to_pop;
-	int32_t num;
+	size_t reg_base;
+	size_t freg_base;
 	size_t reg = SUBTILIS_IR_REG_UNDEFINED;
 
-	to_pop = vm->s->locals + sizeof(*vm->regs);
+	to_pop = vm->s->locals + 4 * sizeof(int32_t);
 	if (call_type->type != SUBTILIS_TYPE_VOID)
-		to_pop += sizeof(*vm->regs);
+		to_pop += sizeof(int32_t);
 
 	if (to_pop > vm->top) {
 		subtilis_error_set_assertion_failed(err);
 		return reg;
 	}
 
-	vm->top -= vm->s->locals + sizeof(*vm->regs);
-	if (call_type->type != SUBTILIS_TYPE_VOID) {
-		memcpy(&num, &vm->memory[vm->top], sizeof(num));
-		reg = (size_t)num;
-		vm->top -= sizeof(*vm->regs);
-	}
+	vm->top -= vm->s->locals;
+	if (call_type->type != SUBTILIS_TYPE_VOID)
+		reg = prv_pop_frame_int(vm);
 
-	memcpy(&num, &vm->memory[vm->top], sizeof(num));
-	caller_index = (size_t)num;
+	caller_index = prv_pop_frame_int(vm);
 	if (caller_index >= vm->p->num_sections) {
 		subtilis_error_set_assertion_failed(err);
 		return reg;
 	}
-
-	cs = vm->p->sections[caller_index];
-
-	to_pop = (cs->reg_counter + 1) * sizeof(*vm->regs);
-	to_pop += cs->freg_counter * sizeof(*vm->fregs);
-	if (to_pop > vm->top) {
+	vm->pc = prv_pop_frame_int(vm);
+	freg_base = prv_pop_frame_int(vm);
+	reg_base = prv_pop_frame_int(vm);
+	if (reg_base > vm->reg_base || freg_base > vm->freg_base) {
 		subtilis_error_set_assertion_failed(err);
 		return reg;
 	}
-	vm->s = cs;
-	vm->top -= sizeof(*vm->regs);
-	memcpy(&num, &vm->memory[vm->top], sizeof(num));
-	vm->pc = (size_t)num;
-	vm->current_index = caller_index;
 
-	vm->top -= vm->s->freg_counter * sizeof(*vm->fregs);
-	memcpy(&vm->fregs[0], &vm->memory[vm->top],
-	       vm->s->freg_counter * sizeof(*vm->fregs));
-
-	vm->top -= vm->s->reg_counter * sizeof(*vm->regs);
-	memcpy(&vm->regs[0], &vm->memory[vm->top],
-	       vm->s->reg_counter * sizeof(*vm->regs));
+	vm->s = vm->p->sections[caller_index];
+	vm->current_index = caller_index;
+	prv_set_section(vm, caller_index);
 
-	vm->top -= vm->s->label_counter * sizeof(*vm->labels);
-	memcpy(&vm->labels[0], &vm->memory[vm->top],
-	       vm->s->label_counter * sizeof(*vm->labels));
+	vm->max_regs = vm->reg_base - reg_base;
+	vm->reg_base = reg_base;
+	vm->regs = &vm->reg_stack[reg_base];
+	vm->max_fregs = vm->freg_base - freg_base;
+	vm->freg_base = freg_base;
+	vm->fregs = &vm->freg_stack[freg_base];
 
 	return reg;
 }
@@ -1964,6 +2016,7 @@ static subtilis_vm_op_fn op_execute_fns[] = {
 	prv_oscli,                         /* SUBTILIS_OP_INSTR_OSCLI */
 	prv_getprocaddr,                   /* SUBTILIS_OP_INSTR_GET_PROC_ADDR */
 	prv_getcmdline,                    /* SUBTILIS_OP_INSTR_OS_ARGS */
+	prv_mulhi32,                       /* SUBTILIS_OP_INSTR_MULH_I32 */
 };
 
 /* clang-format on */
@@ -2021,6 +2074,279 @@ void subitlis_vm_run(subitlis_vm_t *vm, subtilis_buffer_t *b,
 	prv_check_heap(vm, err);
 }
 
+/*
+ * Bytecode.
+ *
+ * Each section is lowered into a contiguous array of subtilis_vm_bc_t.
+ * Each entry contains the handler and a copy of the operands of an
+ * instruction, so the dispatch loop just needs to make one indirect call
+ * per instruction.  Labels are dropped and the targets of jumps are
+ * resolved to bytecode indices.  As vm->pc is incremented after each
+ * instruction, a jump target is stored as the index of the first
+ * instruction after the label less one.  Calls store the index of the IR
+ * op in their first operand so that their handlers can locate the call
+ * details.  Each section is terminated by a sentinel that halts the VM.
+ */
+
+struct subtilis_vm_bc_t_ {
+	subtilis_vm_op_fn fn;
+	subtilis_ir_operand_t operands[SUBTILIS_IR_MAX_OP_ARGS];
+};
+
+static void prv_bc_jmpc(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	vm->pc = (vm->regs[ops[0].reg]) ? ops[1].label : ops[2].label;
+}
+
+static void prv_bc_jmp(subitlis_vm_t *vm, subtilis_buffer_t *b,
+		       subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	vm->pc = ops[0].label;
+}
+
+static void prv_bc_bad(subitlis_vm_t *vm, subtilis_buffer_t *b,
+		       subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	subtilis_error_set_assertion_failed(err);
+}
+
+static void prv_bc_halt(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	vm->halted = true;
+}
+
+static subtilis_ir_call_t *prv_bc_call_op(subitlis_vm_t *vm,
+					  subtilis_ir_operand_t *ops)
+{
+	return &vm->s->ops[ops[0].reg]->op.call;
+}
+
+static void prv_bc_call(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	prv_call_direct(vm, b, &subtilis_type_void, prv_bc_call_op(vm, ops),
+			err);
+}
+
+static void prv_bc_calli32(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			   subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	prv_call_direct(vm, b, &subtilis_type_integer,
+			prv_bc_call_op(vm, ops), err);
+}
+
+static void prv_bc_callreal(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			    subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	prv_call_direct(vm, b, &subtilis_type_real, prv_bc_call_op(vm, ops),
+			err);
+}
+
+static void prv_bc_call_ptr(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			    subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	prv_call_indirect(vm, b, &subtilis_type_void, prv_bc_call_op(vm, ops),
+			  err);
+}
+
+static void prv_bc_calli32_ptr(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			       subtilis_ir_operand_t *ops,
+			       subtilis_error_t *err)
+{
+	prv_call_indirect(vm, b, &subtilis_type_integer,
+			  prv_bc_call_op(vm, ops), err);
+}
+
+static void prv_bc_callreal_ptr(subitlis_vm_t *vm, subtilis_buffer_t *b,
+				subtilis_ir_operand_t *ops,
+				subtilis_error_t *err)
+{
+	prv_call_indirect(vm, b, &subtilis_type_real, prv_bc_call_op(vm, ops),
+			  err);
+}
+
+static void prv_bc_sys_call(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			    subtilis_ir_operand_t *ops, subtilis_error_t *err)
+{
+	prv_sys_call(vm, b, &vm->s->ops[ops[0].reg]->op.sys_call, err);
+}
+
+static subtilis_vm_op_fn prv_bc_call_fn(subtilis_op_type_t type)
+{
+	switch (type) {
+	case SUBTILIS_OP_CALL:
+		return prv_bc_call;
+	case SUBTILIS_OP_CALLI32:
+		return prv_bc_calli32;
+	case SUBTILIS_OP_CALLREAL:
+		return prv_bc_callreal;
+	case SUBTILIS_OP_CALL_PTR:
+		return prv_bc_call_ptr;
+	case SUBTILIS_OP_CALLI32_PTR:
+		return prv_bc_calli32_ptr;
+	case SUBTILIS_OP_CALLREAL_PTR:
+		return prv_bc_callreal_ptr;
+	case SUBTILIS_OP_SYS_CALL:
+		return prv_bc_sys_call;
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Returns the value to store in vm->pc to jump to label, or sets fn to
+ * prv_bc_bad if the label is unknown.
+ */
+
+static size_t prv_bc_target(subtilis_vm_label_table_t *table,
+			    const size_t *bc_index, size_t label,
+			    subtilis_vm_op_fn *fn)
+{
+	if (label >= table->max_labels) {
+		*fn = prv_bc_bad;
+		return 0;
+	}
+
+	return bc_index[table->labels[label]] - 1;
+}
+
+static subtilis_vm_bc_t *prv_lower_section(subitlis_vm_t *vm,
+					   size_t section_index,
+					   subtilis_error_t *err)
+{
+	size_t i;
+	size_t len;
+	subtilis_ir_op_t *op;
+	subtilis_vm_bc_t *bc;
+	subtilis_vm_op_fn call_fn;
+	subtilis_ir_section_t *s = vm->p->sections[section_index];
+	subtilis_vm_label_table_t *table = &vm->label_tables[section_index];
+	subtilis_vm_bc_t *code = NULL;
+	size_t *bc_index = NULL;
+
+	/*
+	 * bc_index[i] records the index of the first bytecode instruction
+	 * emitted for, or after, the IR op i.
+	 */
+
+	bc_index = malloc(sizeof(*bc_index) * (s->len + 1));
+	if (!bc_index) {
+		subtilis_error_set_oom(err);
+		return NULL;
+	}
+
+	len = 0;
+	for (i = 0; i < s->len; i++) {
+		bc_index[i] = len;
+		op = s->ops[i];
+		if (!op)
+			continue;
+		if ((op->type == SUBTILIS_OP_INSTR) ||
+		    prv_bc_call_fn(op->type))
+			len++;
+	}
+	bc_index[s->len] = len;
+
+	code = malloc(sizeof(*code) * (len + 1));
+	if (!code) {
+		subtilis_error_set_oom(err);
+		goto cleanup;
+	}
+
+	bc = code;
+	for (i = 0; i < s->len; i++) {
+		op = s->ops[i];
+		if (!op)
+			continue;
+		call_fn = prv_bc_call_fn(op->type);
+		if (call_fn) {
+			bc->fn = call_fn;
+			bc->operands[0].reg = i;
+			bc++;
+			continue;
+		}
+		if (op->type != SUBTILIS_OP_INSTR)
+			continue;
+
+		memcpy(bc->operands, op->op.instr.operands,
+		       sizeof(bc->operands));
+		switch (op->op.instr.type) {
+		case SUBTILIS_OP_INSTR_JMPC:
+		case SUBTILIS_OP_INSTR_JMPC_NF:
+			bc->fn = prv_bc_jmpc;
+			bc->operands[1].label =
+			    prv_bc_target(table, bc_index,
+					  bc->operands[1].label, &bc->fn);
+			bc->operands[2].label =
+			    prv_bc_target(table, bc_index,
+					  bc->operands[2].label, &bc->fn);
+			break;
+		case SUBTILIS_OP_INSTR_JMP:
+			bc->fn = prv_bc_jmp;
+			bc->operands[0].label =
+			    prv_bc_target(table, bc_index,
+					  bc->operands[0].label, &bc->fn);
+			break;
+		default:
+			bc->fn = op_execute_fns[op->op.instr.type];
+			if (!bc->fn)
+				bc->fn = prv_bc_bad;
+			break;
+		}
+		bc++;
+	}
+	bc->fn = prv_bc_halt;
+
+cleanup:
+
+	free(bc_index);
+
+	return code;
+}
+
+static void prv_lower(subitlis_vm_t *vm, subtilis_error_t *err)
+{
+	size_t i;
+
+	vm->bytecode = calloc(vm->p->num_sections, sizeof(*vm->bytecode));
+	if (!vm->bytecode) {
+		subtilis_error_set_oom(err);
+		return;
+	}
+
+	for (i = 0; i < vm->p->num_sections; i++) {
+		vm->bytecode[i] = prv_lower_section(vm, i, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+}
+
+void subitlis_vm_run_bytecode(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			      subtilis_error_t *err)
+{
+	subtilis_vm_bc_t *bc;
+
+	if (!vm->bytecode) {
+		prv_lower(vm, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+	}
+	vm->code = vm->bytecode[vm->current_index];
+	vm->halted = false;
+
+	for (vm->pc = 0; !vm->halted; vm->pc++) {
+		bc = &vm->code[vm->pc];
+		bc->fn(vm, b, bc->operands, err);
+		if (err->type != SUBTILIS_ERROR_OK)
+			return;
+		if (vm->quit_flag)
+			return;
+	}
+	prv_check_heap(vm, err);
+}
+
 void subitlis_vm_delete(subitlis_vm_t *vm)
 {
 	size_t i;
@@ -2032,9 +2358,16 @@ void subitlis_vm_delete(subitlis_vm_t *vm)
 		if (vm->files[i])
 			fclose(vm->files[i]);
 	free(vm->constants);
-	free(vm->labels);
-	free(vm->fregs);
-	free(vm->regs);
+	if (vm->label_tables)
+		for (i = 0; i < vm->p->num_sections; i++)
+			free(vm->label_tables[i].labels);
+	free(vm->label_tables);
+	if (vm->bytecode)
+		for (i = 0; i < vm->p->num_sections; i++)
+			free(vm->bytecode[i]);
+	free(vm->bytecode);
+	free(vm->freg_stack);
+	free(vm->reg_stack);
 	subtilis_vm_heap_free(&vm->heap);
 	free(vm->memory);
 	free(vm);
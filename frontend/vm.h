@@ -27,8 +27,29 @@
 
 #define SUBTILIS_VM_HEAP_SIZE (32 * 1024)
 #define SUBTILIS_VM_MAX_FILES 16
+
+typedef struct subtilis_vm_bc_t_ subtilis_vm_bc_t;
+
+struct subtilis_vm_label_table_t_ {
+	size_t *labels;
+	size_t max_labels;
+};
+
+typedef struct subtilis_vm_label_table_t_ subtilis_vm_label_table_t;
+
 /*
  * TODO: We need this as we only have 32 bit registers.
+ *
+ * Each active call has its own window in reg_stack and freg_stack.  regs
+ * and fregs point to the window of the current section, which start at
+ * reg_base and freg_base and contain max_regs and max_fregs registers
+ * respectively.  labels points to the label table of the current section.
+ * The label tables for all sections are computed up front and stored in
+ * label_tables.
+ *
+ * bytecode contains the lowered code for each section, if
+ * subitlis_vm_run_bytecode has been called, and code points to the
+ * bytecode of the current section.
  */
 
 struct subitlis_vm_t_ {
@@ -37,6 +58,12 @@ struct subitlis_vm_t_ {
 	size_t max_regs;
 	double *fregs;
 	size_t max_fregs;
+	int32_t *reg_stack;
+	size_t reg_stack_size;
+	size_t reg_base;
+	double *freg_stack;
+	size_t freg_stack_size;
+	size_t freg_base;
 	uint8_t *memory;
 	size_t memory_size;
 	subtilis_ir_prog_t *p;
@@ -45,8 +72,11 @@ struct subitlis_vm_t_ {
 	subtilis_symbol_table_t *st;
 	size_t pc;
 	size_t *labels;
-	size_t label_len;
 	size_t max_labels;
+	subtilis_vm_label_table_t *label_tables;
+	subtilis_vm_bc_t **bytecode;
+	subtilis_vm_bc_t *code;
+	bool halted;
 	size_t top;
 	bool quit_flag;
 	subtilis_vm_heap_t heap;
@@ -66,6 +96,15 @@ subitlis_vm_t *subitlis_vm_new(subtilis_ir_prog_t *p,
 			       char *argv[], subtilis_error_t *err);
 void subitlis_vm_run(subitlis_vm_t *vm, subtilis_buffer_t *b,
 		     subtilis_error_t *err);
+
+/*
+ * Lowers the program into a compact bytecode and runs it.  The output
+ * should be identical to that produced by subitlis_vm_run, which remains
+ * the reference implementation.
+ */
+
+void subitlis_vm_run_bytecode(subitlis_vm_t *vm, subtilis_buffer_t *b,
+			      subtilis_error_t *err);
 void subitlis_vm_delete(subitlis_vm_t *vm);
 
 #endif
@@ -14,8 +14,11 @@
  * limitations under the License.
  */
 
+#include <ctype.h>
 #include <locale.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "arch/arm32/arm_encode.h"
 #include "arch/arm32/arm_keywords.h"
@@ -23,6 +26,7 @@
 #include "backends/riscos/riscos_arm2.h"
 #include "backends/riscos_common/riscos_arm.h"
 #include "common/error.h"
+#include "common/ir_opt.h"
 #include "common/lexer.h"
 #include "frontend/basic_keywords.h"
 #include "frontend/parser.h"
@@ -38,6 +42,23 @@ static void prv_set_prog_size(uint8_t *code, size_t bytes_written,
 	    SUBTILIS_RISCOS_ARM2_PROGRAM_START + (int32_t)bytes_written;
 }
 
+static bool prv_parse_count(const char *str, uint32_t *count)
+{
+	char *end;
+	unsigned long val;
+
+	if (!isdigit(str[0]))
+		return false;
+
+	val = strtoul(str, &end, 10);
+	if (*end || (val == 0) || (val > INT32_MAX))
+		return false;
+
+	*count = (uint32_t)val;
+
+	return true;
+}
+
 int main(int argc, char *argv[])
 {
 	subtilis_error_t err;
@@ -49,9 +70,42 @@ int main(int argc, char *argv[])
 	subtilis_parser_t *p = NULL;
 	subtilis_arm_prog_t *arm_p = NULL;
 	subtilis_arm_op_pool_t *pool = NULL;
+	bool global_reg_alloc = false;
+	uint32_t opt_level = 0;
+	subtilis_escape_policy_t escape_policy = SUBTILIS_ESCAPE_POLICY_LOOP;
+	uint32_t escape_budget = SUBTILIS_CONFIG_ESCAPE_BUDGET;
+	uint32_t jobs = 1;
+	uint32_t count;
+	const char *map_fname = NULL;
+
+	while (argc > 2 && argv[1][0] == '-') {
+		if (!strcmp(argv[1], "-g"))
+			global_reg_alloc = true;
+		else if (!strcmp(argv[1], "-O"))
+			opt_level = 1;
+		else if (!strncmp(argv[1], "-O", 2) && isdigit(argv[1][2]) &&
+			 !argv[1][3])
+			opt_level = argv[1][2] - '0';
+		else if (!strcmp(argv[1], "-E"))
+			escape_policy = SUBTILIS_ESCAPE_POLICY_OUTER;
+		else if (!strncmp(argv[1], "-E", 2) &&
+			 prv_parse_count(&argv[1][2], &escape_budget))
+			escape_policy = SUBTILIS_ESCAPE_POLICY_BUDGET;
+		else if (!strncmp(argv[1], "-j", 2) &&
+			 prv_parse_count(&argv[1][2], &count))
+			jobs = count;
+		else if (!strcmp(argv[1], "-m"))
+			map_fname = "RunImage.map";
+		else
+			break;
+		argc--;
+		argv++;
+	}
 
 	if (argc != 2) {
-		fprintf(stderr, "Usage: subtro file\n");
+		fprintf(stderr,
+			"Usage: subtro [-g] [-O[level]] [-E[budget]] [-jjobs] "
+			"[-m] file\n");
 		return 1;
 	}
 
@@ -70,8 +124,16 @@ int main(int argc, char *argv[])
 		goto cleanup;
 
 	settings.handle_escapes = true;
+	settings.escape_policy = escape_policy;
+	settings.escape_budget = escape_budget;
 	settings.ignore_graphics_errors = true;
 	settings.check_mem_leaks = false;
+	settings.global_reg_alloc = global_reg_alloc;
+	settings.opt_level = opt_level;
+	settings.jobs = jobs;
+	settings.heap_slots = SUBTILIS_RISCOS_ARM2_HEAP_SLOTS;
+	settings.trans_tier = SUBTILIS_TRANS_TIER_ACCURATE;
+	settings.check_next_use = false;
 
 	pool = subtilis_arm_op_pool_new(&err);
 	if (err.type != SUBTILIS_ERROR_OK)
@@ -94,6 +156,10 @@ int main(int argc, char *argv[])
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
+	subtilis_ir_opt_prog(p->prog, &err);
+	if (err.type != SUBTILIS_ERROR_OK)
+		goto cleanup;
+
 	//	subtilis_ir_prog_dump(p->prog);
 
 	arm_p = subtilis_riscos_generate(
@@ -106,7 +172,8 @@ int main(int argc, char *argv[])
 	//	printf("\n\n");
 	//	subtilis_arm_prog_dump(arm_p);
 
-	subtilis_arm_encode(arm_p, "RunImage", prv_set_prog_size, &err);
+	subtilis_arm_encode(arm_p, "RunImage", map_fname, prv_set_prog_size,
+			    &err);
 	if (err.type != SUBTILIS_ERROR_OK)
 		goto cleanup;
 
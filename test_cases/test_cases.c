@@ -6471,6 +6471,222 @@ const subtilis_test_case_t test_cases[] = {
 	"3\n11\n4\n12\nhello\nworld\n\ngoodbye\ncruel\nuniverse\n"
 	"100\n101\n0\n1\nhooray\nwhoops\n1\n3\n",
 	},
+	{"mul_in_place",
+	"a% := 3\n"
+	"b% := 2\n"
+	"for i% := 1 to 3\n"
+	"  a% = a% * a%\n"
+	"  b% = b% * 3\n"
+	"next\n"
+	"print a%\n"
+	"print b%\n",
+	"6561\n54\n",
+	},
+	{"for_bounds_check",
+	"PROCBounds\n"
+	"def PROCBounds\n"
+	"  local dim a%(10)\n"
+	"  local dim b%(3, 4)\n"
+	"  local s%\n"
+	"  for i% := 0 to 10\n"
+	"    a%(i%) = i%\n"
+	"  next\n"
+	"  for i% := 10 to 0 step -2\n"
+	"    s% += a%(i%)\n"
+	"  next\n"
+	"  print s%\n"
+	"  range v%, j%, k% := b%()\n"
+	"    b%(j%, k%) = j% * k%\n"
+	"  endrange\n"
+	"  print b%(3, 4)\n"
+	"  onerror\n"
+	"    print err\n"
+	"  enderror\n"
+	"  for i% := 0 to 10\n"
+	"    i% += 1\n"
+	"    a%(i%) = i%\n"
+	"  next\n"
+	"endproc\n",
+	"30\n12\n10\n",
+	},
+	{"mod_sign",
+	"a% := -3\n"
+	"b% := 7\n"
+	"print a% mod b%\n"
+	"print -a% mod -b%\n"
+	"print (a% - b%) mod -b%\n"
+	"print (b% + 3) mod b%\n",
+	"-3\n3\n-3\n3\n",
+	},
+	{"div_mod_magic",
+	"dim d%(11)\n"
+	"d%() = 3, 7, 10, 60, 641, 65537, &7FFFFFFF, -3, -10, -641, "
+	"&80000001, -12345678\n"
+	"dim e%(5)\n"
+	"e%() = &80000000, &80000001, &7FFFFFFF, &7FFFFFFE, 2147483000, "
+	"-2147483000\n"
+	"f% := 0\n"
+	"for i% := -300 to 300\n"
+	"  f% += FNCheck%(i% * 7919)\n"
+	"next\n"
+	"range v% := e%()\n"
+	"  f% += FNCheck%(v%)\n"
+	"endrange\n"
+	"print f%\n"
+	"def FNCheck%(n%)\n"
+	"  local f%\n"
+	"  f% -= n% div 3 <> n% div d%(0)\n"
+	"  f% -= n% mod 3 <> n% mod d%(0)\n"
+	"  f% -= n% div 7 <> n% div d%(1)\n"
+	"  f% -= n% mod 7 <> n% mod d%(1)\n"
+	"  f% -= n% div 10 <> n% div d%(2)\n"
+	"  f% -= n% mod 10 <> n% mod d%(2)\n"
+	"  f% -= n% div 60 <> n% div d%(3)\n"
+	"  f% -= n% mod 60 <> n% mod d%(3)\n"
+	"  f% -= n% div 641 <> n% div d%(4)\n"
+	"  f% -= n% mod 641 <> n% mod d%(4)\n"
+	"  f% -= n% div 65537 <> n% div d%(5)\n"
+	"  f% -= n% mod 65537 <> n% mod d%(5)\n"
+	"  f% -= n% div &7FFFFFFF <> n% div d%(6)\n"
+	"  f% -= n% mod &7FFFFFFF <> n% mod d%(6)\n"
+	"  f% -= n% div -3 <> n% div d%(7)\n"
+	"  f% -= n% mod -3 <> n% mod d%(7)\n"
+	"  f% -= n% div -10 <> n% div d%(8)\n"
+	"  f% -= n% mod -10 <> n% mod d%(8)\n"
+	"  f% -= n% div -641 <> n% div d%(9)\n"
+	"  f% -= n% mod -641 <> n% mod d%(9)\n"
+	"  f% -= n% div &80000001 <> n% div d%(10)\n"
+	"  f% -= n% mod &80000001 <> n% mod d%(10)\n"
+	"  f% -= n% div -12345678 <> n% div d%(11)\n"
+	"  f% -= n% mod -12345678 <> n% mod d%(11)\n"
+	"<-f%\n",
+	"0\n",
+	},
+	{"inline",
+	"dim d%(3)\n"
+	"d%() = 1, 2, 3, 4\n"
+	"x% = 0\n"
+	"for i% := 1 to 10\n"
+	"  PROCadd(i%)\n"
+	"  x% += FNsq%(i%)\n"
+	"next\n"
+	"print x%\n"
+	"print FNmix(3, 0.5, 4)\n"
+	"print FNabs%(-7) + FNabs%(7)\n"
+	"print FNget%(3)\n"
+	"onerror\n"
+	"  print err\n"
+	"enderror\n"
+	"print FNget%(4)\n"
+	"def PROCadd(a%)\n"
+	"  x% += a%\n"
+	"endproc\n"
+	"def FNsq%(a%)\n"
+	"<-a% * a%\n"
+	"def FNmix(a%, b, c%)\n"
+	"<-a% * b + c%\n"
+	"def FNabs%(a%)\n"
+	"  if a% < 0 then\n"
+	"    a% = -a%\n"
+	"  endif\n"
+	"<-a%\n"
+	"def FNget%(i%)\n"
+	"<-d%(i%)\n",
+	"440\n5.5\n14\n4\n10\n",
+	},
+	{"if_convert",
+	"a% := 0\n"
+	"b% := 0\n"
+	"c% := 0\n"
+	"for i% := -5 to 5\n"
+	"  if i% < 0 then\n"
+	"    a% -= i%\n"
+	"  else\n"
+	"    b% += i%\n"
+	"  endif\n"
+	"  if i% and 1 then\n"
+	"    c% += 1\n"
+	"    if i% > 2 then\n"
+	"      c% += 10\n"
+	"    endif\n"
+	"  else\n"
+	"    c% -= 1\n"
+	"  endif\n"
+	"  if i% = 3 then\n"
+	"    a% = a% * 2\n"
+	"  endif\n"
+	"next\n"
+	"print a%\n"
+	"print b%\n"
+	"print c%\n",
+	"30\n15\n21\n",
+	},
+	{"string_concat",
+	"a$ := \"hello\"\n"
+	"b$ := \" \"\n"
+	"c$ := \"world\"\n"
+	"print a$ + b$ + c$ + \"!\"\n"
+	"print \"<\" + a$ + c$ + \">\"\n"
+	"d$ := a$ + b$ + string$(3, \"x\") + b$ + c$\n"
+	"print d$\n"
+	"print str$(1) + a$ + str$(2) + c$\n"
+	"f$ := \"\" + a$ + \"\" + c$ + \"\"\n"
+	"print f$\n"
+	"g$ := a$ + a$ + a$ + a$ + a$ + a$ + a$ + a$ + a$ + a$ + "
+	"a$ + a$ + a$ + a$ + a$ + a$ + a$ + a$ + a$ + a$\n"
+	"print len(g$)\n"
+	"e$ := \"\"\n"
+	"for i% := 1 to 50\n"
+	"  e$ += \"a\" + \"b\"\n"
+	"next\n"
+	"print len(e$)\n"
+	"e$ += a$ + b$ + c$\n"
+	"print right$(e$, 13)\n",
+	"hello world!\n<helloworld>\nhello xxx world\n1hello2world\n"
+	"helloworld\n100\n100\nabhello world\n",
+	},
+	{"vdu_block",
+	"LOCAL A%\n"
+	"LET A% = &6968\n"
+	"VDU 72, 101, 108, 108, 111\n"
+	"PRINT \"\"\n"
+	"FOR I% := 1 TO 3\n"
+	"  PROCv(64 + I%)\n"
+	"NEXT\n"
+	"VDU A%; 33, 33\n"
+	"PRINT \"\"\n"
+	"DEF PROCv(C%)\n"
+	"  VDU [C%, C% + 32, 45, C%]\n"
+	"  VDU C%\n"
+	"  PRINT \"\"\n"
+	"ENDPROC\n",
+	"Hello\nAa-AA\nBb-BB\nCc-CC\nhi!!\n",
+	},
+	{"vdu_scratch",
+	"LOCAL A%\n"
+	"LET A% = 65\n"
+	"VDU A%, A% + 1\n"
+	"PRINT \"\"\n"
+	"VDU A%, A% + 1, A% + 2, A% + 3, A% + 4, A% + 5\n"
+	"PRINT \"\"\n"
+	"VDU A% + 25, FNl%(A% + 32)\n"
+	"PRINT \"\"\n"
+	"DEF FNl%(C%)\n"
+	"  VDU C%, C% + 1, C% + 2\n"
+	"  PRINT \"\"\n"
+	"<-C% + 1\n",
+	"AB\nABCDEF\nabc\nZb\n",
+	},
+	{"vdu_newline",
+	"LOCAL A%\n"
+	"LET A% = 10\n"
+	"VDU 10\n"
+	"VDU 67, 10\n"
+	"VDU A%\n"
+	"VDU 68, A%\n"
+	"VDU 69, 70, 10, 71, 10\n",
+	"\nC\n\nD\nEF\nG\n",
+	},
 };
 
 /* clang-format on */
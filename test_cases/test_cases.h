@@ -447,6 +447,16 @@ typedef enum {
 	SUBTILIS_TEST_CASE_ID_APPEND_GRAN,
 	SUBTILIS_TEST_CASE_ID_APPEND_BAD_GRAN,
 	SUBTILIS_TEST_CASE_ID_SWAP_REC_FIELD,
+	SUBTILIS_TEST_CASE_ID_MUL_IN_PLACE,
+	SUBTILIS_TEST_CASE_ID_FOR_BOUNDS_CHECK,
+	SUBTILIS_TEST_CASE_ID_MOD_SIGN,
+	SUBTILIS_TEST_CASE_ID_DIV_MOD_MAGIC,
+	SUBTILIS_TEST_CASE_ID_INLINE,
+	SUBTILIS_TEST_CASE_ID_IF_CONVERT,
+	SUBTILIS_TEST_CASE_ID_STRING_CONCAT,
+	SUBTILIS_TEST_CASE_ID_VDU_BLOCK,
+	SUBTILIS_TEST_CASE_ID_VDU_SCRATCH,
+	SUBTILIS_TEST_CASE_ID_VDU_NEWLINE,
 	SUBTILIS_TEST_CASE_ID_MAX,
 } subtilis_test_case_id_t;
 
@@ -22,6 +22,7 @@
 #include "backends/ptd/ptd_test.h"
 #include "backends/riscos/arm_test.h"
 #include "common/bitset_test.h"
+#include "common/pool_test.h"
 #include "frontend/ir_test.h"
 #include "frontend/lexer_test.h"
 #include "frontend/parser_test.h"
@@ -43,6 +44,7 @@ int main(int argc, char *argv[])
 	failure |= fpa_test();
 	failure |= ptd_test();
 	failure |= bitset_test();
+	failure |= pool_test();
 
 	return failure;
 }